@@ -0,0 +1,127 @@
+// batch_bench... thousands of tiny scatter shards, a process each against a few dozen per worker
+//
+// usage: batch_bench [--shards N] [--batch N] [--parallel N] [--dir DIR] [--keep]
+// every shard writes one line to a file in its own call dir, and every 500th one fails on purpose. the same
+// shards run
+//   unbatched  a process per shard, the way the supervisor runs a call
+//   batched    --batch shards per worker script
+// and then batched twice more with a call cache, into fresh call dirs: the first stores what succeeded, the
+// second should find all of it and run only the ones that failed. prints processes spawned, wall time and
+// shards per second, and checks every shard's exit code, output and stderr came back where it should
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "call_cache.h"
+#include "process_supervisor.h"
+#include "shard_batch.h"
+
+namespace fs = std::filesystem;
+
+static bool fails(std::size_t i) { return i % 500 == 7; }
+
+static std::vector<soto::batch_shard> make_shards(const fs::path &dir, std::size_t n)
+{
+    std::vector<soto::batch_shard> shards(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const fs::path call = dir / ("shard-" + std::to_string(i));
+        fs::create_directories(call);
+        const std::string command = fails(i) ? "echo \"shard " + std::to_string(i) + " can't\" >&2; exit 3"
+                                             : "echo $((" + std::to_string(i) + " * 2)) > out.txt";
+        shards[i].spec = {command, call.string(), (call / "stdout").string(), (call / "stderr").string()};
+        shards[i].cache_key = "batch_bench-" + std::to_string(i);
+        shards[i].outputs = {{"out", (call / "out.txt").string()}};
+    }
+    return shards;
+}
+
+// every shard where it should be: exit code, out.txt (restored or written), the failures' stderr
+static std::size_t check(const std::vector<soto::batch_shard> &shards, const std::vector<soto::batch_shard_result> &results)
+{
+    std::size_t bad = 0;
+    for (std::size_t i = 0; i < shards.size(); ++i)
+    {
+        const soto::batch_shard_result &r = results[i];
+        if (fails(i))
+        {
+            bad += r.exit_code != 3 || r.stderr_tail.find("can't") == std::string::npos;
+            continue;
+        }
+        std::ifstream out(fs::path(shards[i].spec.working_dir) / "out.txt");
+        std::string line;
+        std::getline(out, line);
+        bad += r.exit_code != 0 || line != std::to_string(i * 2) || (r.cached && r.outputs.size() != 1);
+    }
+    return bad;
+}
+
+struct mode_result
+{
+public:
+    soto::batch_stats stats;
+    double seconds = 0;
+    std::size_t bad = 0;
+};
+
+static mode_result run(soto::process_supervisor &supervisor, const fs::path &dir, std::size_t n, const soto::batch_policy &policy, soto::call_cache *cache)
+{
+    const std::vector<soto::batch_shard> shards = make_shards(dir, n);
+    mode_result result;
+    auto t0 = std::chrono::steady_clock::now();
+    const auto results = soto::run_shards(supervisor, shards, policy, (dir / "batches").string(), cache, &result.stats);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    result.bad = check(shards, results);
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_shards = 5000;
+    soto::batch_policy batched{50, 0};
+    std::string dir = "/tmp/wdlrunner_batch_bench";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--shards" && i + 1 < argc)
+            n_shards = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--batch" && i + 1 < argc)
+            batched.shards_per_batch = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--parallel" && i + 1 < argc)
+            batched.parallel = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--keep")
+            keep = true;
+    }
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    soto::process_supervisor supervisor;
+    soto::call_cache cache((fs::path(dir) / "cache").string());
+    const soto::batch_policy unbatched{1, batched.parallel};
+    const mode_result single = run(supervisor, fs::path(dir) / "unbatched", n_shards, unbatched, nullptr);
+    const mode_result batch = run(supervisor, fs::path(dir) / "batched", n_shards, batched, nullptr);
+    const mode_result cold = run(supervisor, fs::path(dir) / "cold", n_shards, batched, &cache);
+    const mode_result warm = run(supervisor, fs::path(dir) / "warm", n_shards, batched, &cache);
+
+    const std::size_t failing = n_shards / 500 + (n_shards % 500 > 7);
+    const bool ok = single.bad + batch.bad + cold.bad + warm.bad == 0 && cold.stats.stored == n_shards - failing &&
+                    warm.stats.cache_hits == n_shards - failing && warm.stats.shards_run == failing;
+
+    std::printf("%zu shards, %zu per batch, %zu failing on purpose\n\n", n_shards, batched.shards_per_batch, failing);
+    std::printf("%-10s %10s %10s %10s %10s %12s %10s\n", "", "processes", "run", "cached", "failed", "shards/s", "ms");
+    for (const auto &[name, r] : {std::pair<const char *, const mode_result &>{"unbatched", single}, {"batched", batch}, {"cold", cold}, {"warm", warm}})
+        std::printf("%-10s %10zu %10zu %10zu %10zu %12.0f %10.1f\n", name, r.stats.processes, r.stats.shards_run, r.stats.cache_hits, r.stats.failed,
+                    static_cast<double>(n_shards) / r.seconds, r.seconds * 1e3);
+    std::printf("\n%s\n", ok ? "every shard came back where it should" : "MISMATCH");
+
+    if (!keep)
+        fs::remove_all(dir);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// capture_bench... thousands of concurrent children, all logging, one capture thread
+//
+// usage: capture_bench [--children N] [--lines N] [--dir DIR] [--keep]
+// every child writes --lines lines to stdout and stderr. reports wall time, bytes captured,
+// peak RSS of the runner and its thread count while everything is in flight...
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "process_supervisor.h"
+
+namespace fs = std::filesystem;
+
+static int thread_count()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.rfind("Threads:", 0) == 0)
+            return std::stoi(line.substr(8));
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_children = 2000;
+    std::size_t lines = 200;
+    std::string dir = "/tmp/wdlrunner_capture_bench";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--children" && i + 1 < argc)
+            n_children = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--lines" && i + 1 < argc)
+            lines = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--keep")
+            keep = true;
+    }
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    // sleep first so they all overlap, then a GATK-ish amount of chatter on both streams
+    std::string command = "sleep 0.5; i=0; while [ $i -lt " + std::to_string(lines) +
+                          " ]; do echo \"INFO  ProgressMeter - chr1:$i  0.1 minutes  $i reads\"; echo \"WARN  line $i\" >&2; i=$((i+1)); done; exit 3";
+
+    std::atomic<std::size_t> done{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::size_t> bad{0};
+    int peak_threads = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        soto::process_supervisor supervisor;
+        for (std::size_t c = 0; c < n_children; ++c)
+        {
+            soto::process_spec spec{command, dir, dir + "/" + std::to_string(c) + ".stdout", dir + "/" + std::to_string(c) + ".stderr"};
+            supervisor.spawn(spec, [&](const soto::process_result &r)
+                             {
+                                 bytes += r.stdout_bytes + r.stderr_bytes;
+                                 if (r.exit_code != 3 || !r.error.empty() || r.stderr_tail.find("WARN") == std::string::npos)
+                                     bad++;
+                                 done++; });
+        }
+        peak_threads = thread_count();
+        while (done.load() < n_children)
+        {
+            peak_threads = std::max(peak_threads, thread_count());
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    std::uint64_t on_disk = 0;
+    for (const auto &entry : fs::directory_iterator(dir))
+        on_disk += fs::file_size(entry.path());
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    std::printf("children=%zu  wall=%.2f s  captured=%.1f MB  on disk=%.1f MB  bad=%zu\n", n_children, secs, bytes / 1e6, on_disk / 1e6, bad.load());
+    std::printf("peak RSS=%.1f MB  threads in runner=%d\n", usage.ru_maxrss / 1024.0, peak_threads);
+
+    if (!keep)
+        fs::remove_all(dir);
+    return bad.load() == 0 && on_disk == bytes.load() ? 0 : 1;
+}
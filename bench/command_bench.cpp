@@ -0,0 +1,287 @@
+// command_bench... rendering the command of every task of a workflow for a scatter's worth of shards
+//
+// usage: command_bench [--wdl FILE] [--shards N] [--print TASK]
+// parses --wdl (default: the corpus's mutect2.wdl), compiles each task's command once, then builds --shards scopes per
+// task with made-up values for every input (by declared type, different per shard) and the task's private
+// declarations evaluated on top where the evaluator can. three ways to render all of them:
+//   naive       compile + render per shard, what rendering costs when nothing is kept between shards
+//   render      the precompiled template, a new string per shard
+//   render_into the precompiled template into one reused buffer
+// per way: µs per command, MB/s of command text and allocations per command. --print shows shard 0 of a task
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <regex>
+#include <string>
+#include <vector>
+#include "command_template.h"
+#include "json_inputs.h"
+#include "lexer.h"
+#include "mem_report.h" // mem_heap, counted by src/mem_hooks.cpp which CMake links in
+#include "parser.h"
+#include "wdl_eval.h"
+
+#ifndef WDLRUNNER_CORPUS_DIR
+#define WDLRUNNER_CORPUS_DIR "case-study-examples"
+#endif
+
+static std::string read_file(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::string text;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        text.append(buf, n);
+    std::fclose(f);
+    return text;
+}
+
+// something of the declared type that looks like what a real run would pass... paths and names carry the shard
+static soto::wdl_value synthetic(const soto::wdl_type &type, const std::string &name, std::size_t shard, const soto::struct_table &structs)
+{
+    using soto::wdl_value;
+    switch (type.kind)
+    {
+    case soto::WT_BOOLEAN:
+        return wdl_value::boolean(shard % 2 == 0);
+    case soto::WT_INT:
+        return wdl_value::integer(static_cast<std::int64_t>(1000 + shard % 97));
+    case soto::WT_FLOAT:
+        return wdl_value::floating(0.001 * static_cast<double>(shard % 1000));
+    case soto::WT_STRING:
+        return wdl_value::string(name + "_" + std::to_string(shard));
+    case soto::WT_FILE:
+    case soto::WT_DIRECTORY:
+        return wdl_value::string("gs://bucket/shard-" + std::to_string(shard) + "/" + name + ".bam", type.kind);
+    case soto::WT_ARRAY:
+    {
+        soto::wdl_array elements;
+        for (int i = 0; i < 4; ++i)
+            elements.push_back(synthetic(type.params.empty() ? soto::wdl_type(soto::WT_STRING) : type.params[0], name + std::to_string(i), shard, structs));
+        return wdl_value::array(std::move(elements));
+    }
+    case soto::WT_MAP:
+    case soto::WT_PAIR:
+    {
+        soto::wdl_type left = type.params.size() > 0 ? type.params[0] : soto::wdl_type(soto::WT_STRING);
+        soto::wdl_type right = type.params.size() > 1 ? type.params[1] : soto::wdl_type(soto::WT_STRING);
+        if (type.kind == soto::WT_PAIR)
+            return wdl_value::pair(synthetic(left, name + "_l", shard, structs), synthetic(right, name + "_r", shard, structs));
+        return wdl_value::map({{synthetic(left, name + "_k", shard, structs), synthetic(right, name + "_v", shard, structs)}});
+    }
+    case soto::WT_STRUCT:
+    {
+        soto::wdl_object object;
+        object.struct_name = type.name;
+        auto it = structs.find(type.name);
+        if (it != structs.end())
+            for (const auto &[member, member_type] : it->second)
+                object.members.emplace_back(member, synthetic(member_type, member, shard, structs));
+        return wdl_value::object(std::move(object));
+    }
+    default:
+        return wdl_value::string(name);
+    }
+}
+
+struct bench_task
+{
+    std::string name;
+    soto::command_template command;
+    const soto::command_decl *decl = nullptr;
+    std::vector<soto::eval_scope> shards;
+};
+
+// inputs get made-up values, private declarations the value their expression has... or a made-up one when
+// the evaluator can't do it yet (select_first and friends)
+static void bind_declarations(const std::vector<soto::ast_node_ptr> &decls, soto::eval_scope &scope, std::size_t shard, const soto::struct_table &structs, bool evaluate)
+{
+    for (const auto &node : decls)
+    {
+        const auto *var = node ? std::get_if<soto::var_decl>(&node->node) : nullptr;
+        if (!var || !var->type || !var->type->tok || !var->identifier || !var->identifier->tok)
+            continue;
+        const std::string &name = var->identifier->tok->lexeme;
+        soto::wdl_type type;
+        try
+        {
+            type = soto::wdl_type::parse(var->type->tok->lexeme);
+        }
+        catch (const std::exception &)
+        {
+            type = soto::wdl_type(soto::WT_STRING);
+        }
+        if (evaluate && var->initializer)
+        {
+            try
+            {
+                scope.set(name, soto::evaluate(var->initializer, scope));
+                continue;
+            }
+            catch (const std::exception &)
+            {
+            }
+        }
+        scope.set(name, synthetic(type, name, shard, structs));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = WDLRUNNER_CORPUS_DIR "/mutect2_wdl/mutect2.wdl";
+    std::size_t n_shards = 10000;
+    std::string print_task;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--wdl" && i + 1 < argc)
+            path = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc)
+            n_shards = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--print" && i + 1 < argc)
+            print_task = argv[++i];
+    }
+
+    // every top-level struct/task/workflow parsed on its own, like the LSP does... one declaration the parser
+    // trips over (mutect2's workflow, today) doesn't take the tasks after it down with it
+    std::string source = read_file(path);
+    // keywords are matched case-insensitively for now, so mutect2's `struct Runtime` reads as a runtime section...
+    // a struct named like a keyword gets renamed before parsing
+    for (const char *keyword : {"Runtime", "Input", "Output", "Meta", "Command"})
+        if (source.find(std::string("struct ") + keyword + " ") != std::string::npos)
+            source = std::regex_replace(source, std::regex(std::string("\\b") + keyword + "\\b"), std::string(keyword) + "Struct");
+    std::vector<std::string> chunks;
+    for (std::size_t at = 0; at < source.size();)
+    {
+        std::size_t next = at;
+        do
+        {
+            next = source.find('\n', next);
+            next = next == std::string::npos ? source.size() : next + 1;
+        } while (next < source.size() && source.compare(next, 5, "task ") != 0 && source.compare(next, 7, "struct ") != 0 &&
+                 source.compare(next, 9, "workflow ") != 0);
+        chunks.push_back("version 1.0\n" + source.substr(at, next - at));
+        at = next;
+    }
+    std::vector<soto::parse_diagnostic> diagnostics;
+    std::vector<soto::ast_node_ptr> programs;
+    soto::struct_table structs;
+    for (const std::string &chunk : chunks)
+    {
+        soto::parser parser{std::make_unique<soto::lexer>(chunk), &diagnostics};
+        programs.push_back(parser.parse_program());
+        structs.merge(soto::collect_structs(programs.back()));
+    }
+
+    std::vector<bench_task> tasks;
+    std::vector<const soto::ast_node *> decls;
+    for (const auto &prog : programs)
+        for (const auto &decl : std::get<soto::program>(prog->node).declarations)
+            decls.push_back(decl.get());
+    for (const soto::ast_node *decl : decls)
+    {
+        if (!decl || decl->type != soto::N_CLASS_DECL || !decl->tok || decl->tok->lexeme != "task")
+            continue;
+        const auto &klass = std::get<soto::class_decl>(decl->node);
+        bench_task task;
+        task.name = klass.identifier && klass.identifier->tok ? klass.identifier->tok->lexeme : "?";
+        const std::vector<soto::ast_node_ptr> *inputs = nullptr;
+        for (const auto &member : klass.members)
+        {
+            if (!member)
+                continue;
+            if (const auto *input = std::get_if<soto::input_decl>(&member->node))
+            {
+                if (input->body)
+                    if (const auto *body = std::get_if<soto::block>(&input->body->node))
+                        inputs = &body->statements;
+            }
+            else if (const auto *command = std::get_if<soto::command_decl>(&member->node))
+                task.decl = command;
+        }
+        if (!task.decl)
+            continue;
+        try
+        {
+            task.command = soto::command_template::from_command(*task.decl);
+        }
+        catch (const std::exception &e)
+        {
+            std::printf("%-28s skipped: %s\n", task.name.c_str(), e.what());
+            continue;
+        }
+        task.shards.resize(n_shards);
+        for (std::size_t s = 0; s < n_shards; ++s)
+        {
+            if (inputs)
+                bind_declarations(*inputs, task.shards[s], s, structs, false);
+            bind_declarations(klass.members, task.shards[s], s, structs, true);
+        }
+        tasks.push_back(std::move(task));
+    }
+
+    std::printf("%s: %zu task command(s), %zu shards each, %zu parse diagnostic(s)\n\n", path.c_str(), tasks.size(), n_shards, diagnostics.size());
+    std::printf("%-28s %7s %6s %12s %12s %12s %9s %9s %9s\n", "task", "bytes", "slots", "naive us", "render us", "into us", "naive/al", "render/al", "into/al");
+
+    double total_naive = 0, total_render = 0, total_into = 0, total_bytes = 0;
+    std::uint64_t renders = 0;
+    for (bench_task &task : tasks)
+    {
+        try
+        {
+            if (!task.shards.empty())
+                task.command.render(task.shards[0]);
+        }
+        catch (const std::exception &e)
+        {
+            std::printf("%-28s skipped: %s\n", task.name.c_str(), e.what());
+            continue;
+        }
+        const std::string &body = task.decl->body->tok->lexeme;
+        const bool dollar = !task.decl->heredoc;
+        std::size_t bytes = 0;
+        auto time = [&](const std::function<void(const soto::eval_scope &)> &render, std::uint64_t &allocs)
+        {
+            std::uint64_t a0 = soto::mem_heap.allocs.load();
+            auto t0 = std::chrono::steady_clock::now();
+            for (const soto::eval_scope &scope : task.shards)
+                render(scope);
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            allocs = soto::mem_heap.allocs.load() - a0;
+            return secs;
+        };
+
+        std::uint64_t naive_allocs, render_allocs, into_allocs;
+        std::string out;
+        double naive = time([&](const soto::eval_scope &scope)
+                            { bytes += soto::command_template::compile(body, dollar).render(scope).size(); },
+                            naive_allocs);
+        double render = time([&](const soto::eval_scope &scope)
+                             { out = task.command.render(scope); },
+                             render_allocs);
+        double into = time([&](const soto::eval_scope &scope)
+                           { task.command.render_into(scope, out); },
+                           into_allocs);
+
+        const double n = static_cast<double>(task.shards.size());
+        std::printf("%-28s %7.0f %6zu %12.2f %12.2f %12.2f %9.1f %9.2f %9.2f\n", task.name.c_str(), bytes / n, task.command.placeholders.size(),
+                    naive / n * 1e6, render / n * 1e6, into / n * 1e6, naive_allocs / n, render_allocs / n, into_allocs / n);
+        total_naive += naive;
+        total_render += render;
+        total_into += into;
+        total_bytes += static_cast<double>(bytes);
+        renders += task.shards.size();
+
+        if (task.name == print_task && !task.shards.empty())
+            std::printf("\n%s\n", task.command.render(task.shards[0]).c_str());
+    }
+
+    const double n = static_cast<double>(renders);
+    std::printf("\n%-28s %7.0f %6s %12.2f %12.2f %12.2f\n", "all", total_bytes / n, "", total_naive / n * 1e6, total_render / n * 1e6, total_into / n * 1e6);
+    std::printf("MB/s: naive %.0f  render %.0f  render_into %.0f\n", total_bytes / total_naive / 1e6, total_bytes / total_render / 1e6, total_bytes / total_into / 1e6);
+    return 0;
+}
@@ -0,0 +1,318 @@
+// fold_bench... what constant folding takes off the per-shard evaluation of a workflow's tasks
+//
+// usage: fold_bench [--wdl FILE] [--shards N]
+// first, fold_program over every .wdl of the corpus: expressions, AST nodes before/after, subtrees folded,
+// simplifications and declarations that came out a constant. then for each task of --wdl (default: the corpus's
+// mutect2.wdl), its private declarations and runtime values evaluated for --shards shards, three ways:
+//   raw     the tree as parsed
+//   folded  fold_declarations with no inputs, what's constant on its own
+//   bound   fold_declarations with the inputs a scatter doesn't change bound... every input but the File ones,
+//           which get a different value per shard
+// per way: AST nodes evaluate() walks per shard and µs per shard
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <regex>
+#include <string>
+#include <vector>
+#include "json_inputs.h"
+#include "lexer.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_fold.h"
+
+#ifndef WDLRUNNER_CORPUS_DIR
+#define WDLRUNNER_CORPUS_DIR "case-study-examples"
+#endif
+
+namespace fs = std::filesystem;
+
+static std::string read_file(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::string text;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        text.append(buf, n);
+    std::fclose(f);
+    return text;
+}
+
+// every top-level struct/task/workflow parsed on its own, like command_bench... with keyword-named structs
+// renamed first since keywords are matched case-insensitively
+static std::vector<soto::ast_node_ptr> parse_chunks(const std::string &path, soto::struct_table &structs)
+{
+    std::string source = read_file(path);
+    for (const char *keyword : {"Runtime", "Input", "Output", "Meta", "Command"})
+        if (source.find(std::string("struct ") + keyword + " ") != std::string::npos)
+            source = std::regex_replace(source, std::regex(std::string("\\b") + keyword + "\\b"), std::string(keyword) + "Struct");
+    std::vector<soto::ast_node_ptr> programs;
+    std::vector<soto::parse_diagnostic> diagnostics;
+    for (std::size_t at = 0; at < source.size();)
+    {
+        std::size_t next = at;
+        do
+        {
+            next = source.find('\n', next);
+            next = next == std::string::npos ? source.size() : next + 1;
+        } while (next < source.size() && source.compare(next, 5, "task ") != 0 && source.compare(next, 7, "struct ") != 0 &&
+                 source.compare(next, 9, "workflow ") != 0);
+        std::string chunk = "version 1.0\n" + source.substr(at, next - at);
+        soto::parser parser{std::make_unique<soto::lexer>(chunk), &diagnostics};
+        programs.push_back(parser.parse_program());
+        structs.merge(soto::collect_structs(programs.back()));
+        at = next;
+    }
+    return programs;
+}
+
+static bool is_file_type(const soto::wdl_type &type)
+{
+    if (type.kind == soto::WT_FILE || type.kind == soto::WT_DIRECTORY)
+        return true;
+    return type.kind == soto::WT_ARRAY && !type.params.empty() && is_file_type(type.params[0]);
+}
+
+// a made-up value of the declared type... paths carry the shard, everything else is the same in every shard
+static soto::wdl_value synthetic(const soto::wdl_type &type, const std::string &name, std::size_t shard)
+{
+    using soto::wdl_value;
+    switch (type.kind)
+    {
+    case soto::WT_BOOLEAN:
+        return wdl_value::boolean(true);
+    case soto::WT_INT:
+        return wdl_value::integer(1000);
+    case soto::WT_FLOAT:
+        return wdl_value::floating(0.5);
+    case soto::WT_FILE:
+    case soto::WT_DIRECTORY:
+        return wdl_value::string("gs://bucket/shard-" + std::to_string(shard) + "/" + name + ".bam", type.kind);
+    case soto::WT_ARRAY:
+    {
+        soto::wdl_array elements;
+        for (int i = 0; i < 4; ++i)
+            elements.push_back(synthetic(type.params.empty() ? soto::wdl_type(soto::WT_STRING) : type.params[0], name + std::to_string(i), shard));
+        return wdl_value::array(std::move(elements));
+    }
+    default:
+        return wdl_value::string(name);
+    }
+}
+
+static soto::wdl_type type_of(const soto::var_decl &var)
+{
+    try
+    {
+        return soto::wdl_type::parse(var.type->tok->lexeme);
+    }
+    catch (const std::exception &)
+    {
+        return soto::wdl_type(soto::WT_STRING);
+    }
+}
+
+// what gets evaluated per shard: the task's private declarations (name set) and runtime values (name empty)
+struct shard_expr
+{
+    std::string name;
+    soto::ast_node_ptr *slot;
+};
+
+struct task_view
+{
+    std::string name;
+    std::vector<const soto::var_decl *> inputs;
+    std::vector<const soto::var_decl *> privates;
+    std::vector<shard_expr> exprs;
+};
+
+static std::vector<task_view> tasks_of(std::vector<soto::ast_node_ptr> &programs)
+{
+    std::vector<task_view> tasks;
+    for (auto &prog : programs)
+        for (auto &decl : std::get<soto::program>(prog->node).declarations)
+        {
+            if (!decl || decl->type != soto::N_CLASS_DECL || !decl->tok || decl->tok->lexeme != "task")
+                continue;
+            auto &klass = std::get<soto::class_decl>(decl->node);
+            task_view task;
+            task.name = klass.identifier && klass.identifier->tok ? klass.identifier->tok->lexeme : "?";
+            for (auto &member : klass.members)
+            {
+                if (!member)
+                    continue;
+                if (auto *input = std::get_if<soto::input_decl>(&member->node))
+                {
+                    if (auto *body = input->body ? std::get_if<soto::block>(&input->body->node) : nullptr)
+                        for (auto &d : body->statements)
+                            if (auto *var = d ? std::get_if<soto::var_decl>(&d->node) : nullptr)
+                                if (var->type && var->type->tok && var->identifier && var->identifier->tok)
+                                    task.inputs.push_back(var);
+                }
+                else if (auto *var = std::get_if<soto::var_decl>(&member->node))
+                {
+                    if (!var->type || !var->type->tok || !var->identifier || !var->identifier->tok)
+                        continue;
+                    task.privates.push_back(var);
+                    if (var->initializer)
+                        task.exprs.push_back({var->identifier->tok->lexeme, &var->initializer});
+                }
+                else if (auto *runtime = std::get_if<soto::runtime_decl>(&member->node))
+                    for (auto &[key, value] : runtime->members)
+                        task.exprs.push_back({"", &value});
+            }
+            tasks.push_back(std::move(task));
+        }
+    return tasks;
+}
+
+static soto::eval_scope shard_scope(const task_view &task, std::size_t shard)
+{
+    soto::eval_scope scope;
+    for (const soto::var_decl *var : task.inputs)
+        scope.set(var->identifier->tok->lexeme, synthetic(type_of(*var), var->identifier->tok->lexeme, shard));
+    // a private declaration the evaluator can't do (read_*, size of a made-up path) still needs a value for
+    // the ones after it
+    for (const soto::var_decl *var : task.privates)
+        scope.set(var->identifier->tok->lexeme, synthetic(type_of(*var), var->identifier->tok->lexeme, shard));
+    return scope;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string path = WDLRUNNER_CORPUS_DIR "/mutect2_wdl/mutect2.wdl";
+    std::size_t n_shards = 10000;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--wdl" && i + 1 < argc)
+            path = argv[++i];
+        else if (arg == "--shards" && i + 1 < argc)
+            n_shards = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::printf("%-52s %6s %8s %8s %7s %7s %7s\n", "file", "exprs", "nodes", "after", "folded", "simpl", "decls");
+    soto::fold_stats corpus;
+    std::vector<std::string> files;
+    for (const auto &entry : fs::recursive_directory_iterator(WDLRUNNER_CORPUS_DIR))
+        if (entry.path().extension() == ".wdl")
+            files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+    for (const std::string &file : files)
+    {
+        soto::struct_table structs;
+        soto::fold_stats stats;
+        for (auto &prog : parse_chunks(file, structs))
+            stats += soto::fold_program(*prog);
+        std::printf("%-52s %6zu %8zu %8zu %7zu %7zu %7zu\n", fs::path(file).lexically_relative(WDLRUNNER_CORPUS_DIR).string().c_str(), stats.expressions,
+                    stats.nodes_before, stats.nodes_after, stats.folded, stats.simplified, stats.constant_decls);
+        corpus += stats;
+    }
+    std::printf("%-52s %6zu %8zu %8zu %7zu %7zu %7zu\n\n", "all", corpus.expressions, corpus.nodes_before, corpus.nodes_after, corpus.folded,
+                corpus.simplified, corpus.constant_decls);
+
+    // three copies of the tree, one per way... the AST doesn't copy, so it's parsed three times
+    soto::struct_table structs;
+    std::vector<soto::ast_node_ptr> raw_programs = parse_chunks(path, structs);
+    std::vector<soto::ast_node_ptr> folded_programs = parse_chunks(path, structs);
+    std::vector<soto::ast_node_ptr> bound_programs = parse_chunks(path, structs);
+    std::vector<task_view> raw = tasks_of(raw_programs), folded = tasks_of(folded_programs), bound = tasks_of(bound_programs);
+    for (auto &prog : folded_programs)
+        soto::fold_program(*prog);
+    for (auto &prog : bound_programs)
+        for (auto &decl : std::get<soto::program>(prog->node).declarations)
+        {
+            if (!decl || decl->type != soto::N_CLASS_DECL || !decl->tok || decl->tok->lexeme != "task")
+                continue;
+            const auto &klass = std::get<soto::class_decl>(decl->node);
+            for (const task_view &task : raw)
+                if (klass.identifier && klass.identifier->tok && task.name == klass.identifier->tok->lexeme)
+                {
+                    soto::eval_scope inputs;
+                    for (const soto::var_decl *var : task.inputs)
+                    {
+                        soto::wdl_type type = type_of(*var);
+                        if (!is_file_type(type))
+                            inputs.set(var->identifier->tok->lexeme, synthetic(type, var->identifier->tok->lexeme, 0));
+                    }
+                    soto::fold_declarations(*decl, &inputs);
+                    break;
+                }
+        }
+
+    std::printf("%s: %zu shards per task\n", path.c_str(), n_shards);
+    std::printf("%-28s %6s %8s %8s %8s %10s %10s %10s\n", "task", "exprs", "raw n", "fold n", "bound n", "raw us", "fold us", "bound us");
+    double totals[3] = {0, 0, 0};
+    std::size_t node_totals[3] = {0, 0, 0};
+    for (std::size_t t = 0; t < raw.size(); ++t)
+    {
+        std::vector<soto::eval_scope> shards;
+        shards.reserve(n_shards);
+        for (std::size_t s = 0; s < n_shards; ++s)
+            shards.push_back(shard_scope(raw[t], s));
+
+        // the expressions that evaluate as parsed... only those are timed, in all three ways
+        std::vector<bool> ok(raw[t].exprs.size(), false);
+        std::size_t n_ok = 0;
+        {
+            soto::eval_scope local(&shards[0]);
+            for (std::size_t e = 0; e < raw[t].exprs.size(); ++e)
+                try
+                {
+                    soto::wdl_value v = soto::evaluate(*raw[t].exprs[e].slot, local);
+                    if (!raw[t].exprs[e].name.empty())
+                        local.set(raw[t].exprs[e].name, std::move(v));
+                    ok[e] = true;
+                    ++n_ok;
+                }
+                catch (const std::exception &)
+                {
+                }
+        }
+        if (!n_ok)
+            continue;
+
+        double us[3];
+        std::size_t nodes[3];
+        const task_view *views[3] = {&raw[t], &folded[t], &bound[t]};
+        for (int way = 0; way < 3; ++way)
+        {
+            const task_view &view = *views[way];
+            nodes[way] = 0;
+            for (std::size_t e = 0; e < view.exprs.size(); ++e)
+                if (ok[e])
+                    nodes[way] += soto::count_nodes(*view.exprs[e].slot);
+            auto t0 = std::chrono::steady_clock::now();
+            for (const soto::eval_scope &scope : shards)
+            {
+                soto::eval_scope local(&scope);
+                for (std::size_t e = 0; e < view.exprs.size(); ++e)
+                {
+                    if (!ok[e])
+                        continue;
+                    try
+                    {
+                        soto::wdl_value v = soto::evaluate(*view.exprs[e].slot, local);
+                        if (!view.exprs[e].name.empty())
+                            local.set(view.exprs[e].name, std::move(v));
+                    }
+                    catch (const std::exception &)
+                    {
+                    }
+                }
+            }
+            us[way] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / static_cast<double>(n_shards);
+            totals[way] += us[way];
+            node_totals[way] += nodes[way];
+        }
+        std::printf("%-28s %6zu %8zu %8zu %8zu %10.2f %10.2f %10.2f\n", raw[t].name.c_str(), n_ok, nodes[0], nodes[1], nodes[2], us[0], us[1], us[2]);
+    }
+    std::printf("\n%-28s %6s %8zu %8zu %8zu %10.2f %10.2f %10.2f\n", "all", "", node_totals[0], node_totals[1], node_totals[2], totals[0], totals[1], totals[2]);
+    return 0;
+}
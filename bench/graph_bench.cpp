@@ -0,0 +1,227 @@
+// graph_bench... what pruning false if blocks as soon as their condition is known keeps out of the scheduler
+//
+// usage: graph_bench [--stages N] [--enabled N] [--shards N] [--runs N]
+// first the corpus's cnv somatic pair workflow, tumor only (normal_bam unset, no oncotator / funcotator) and
+// with a matched normal: a workflow_graph run with a stand-in scheduler that finishes every call it's handed
+// straight away, with made-up outputs. then a generated pipeline of --stages optional stages, each an
+// `if (run_stage_N)` around a scatter of --shards shards with two calls in it plus a call gathering them, with
+// the first --enabled of them switched on. prints, per run, the call statements in the graph, the calls (and
+// call shards) a scheduler that builds the whole graph up front would track, those graph_run handed out, what
+// it pruned, and µs for building the graph and running it
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_graph.h"
+#include "wdl_resolve.h"
+
+#ifndef WDLRUNNER_CORPUS_DIR
+#define WDLRUNNER_CORPUS_DIR "case-study-examples"
+#endif
+
+static std::string read_file(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::string text;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        text.append(buf, n);
+    std::fclose(f);
+    return text;
+}
+
+static std::string name_of(const soto::ast_node_ptr &node)
+{
+    return node && node->tok ? node->tok->lexeme : "";
+}
+
+struct parsed
+{
+public:
+    soto::ast_node_ptr prog;
+    soto::resolve_result resolved;
+    const soto::ast_node *workflow = nullptr;
+    std::unordered_map<std::string, const soto::ast_node *> tasks;
+};
+
+static parsed parse(const std::string &source)
+{
+    parsed p;
+    std::vector<soto::parse_diagnostic> diagnostics;
+    soto::parser parser{std::make_unique<soto::lexer>(source), &diagnostics};
+    p.prog = parser.parse_program();
+    if (!diagnostics.empty())
+        throw std::runtime_error(diagnostics.front().message);
+    p.resolved = soto::resolve_program(*p.prog);
+    for (const auto &decl : std::get<soto::program>(p.prog->node).declarations)
+        if (decl && decl->type == soto::N_CLASS_DECL && decl->tok)
+        {
+            if (decl->tok->lexeme == "task")
+                p.tasks.emplace(name_of(std::get<soto::class_decl>(decl->node).identifier), decl.get());
+            else
+                p.workflow = decl.get();
+        }
+    return p;
+}
+
+// what a call gives back... every output its task declares, as a made-up path
+static soto::wdl_value outputs_of(const soto::ast_node *task)
+{
+    soto::wdl_object outputs;
+    if (task)
+        for (const auto &member : std::get<soto::class_decl>(task->node).members)
+            if (const auto *out = member ? std::get_if<soto::output_decl>(&member->node) : nullptr)
+                if (const auto *b = out->body ? std::get_if<soto::block>(&out->body->node) : nullptr)
+                    for (const auto &d : b->statements)
+                        if (const auto *var = d ? std::get_if<soto::var_decl>(&d->node) : nullptr)
+                            outputs.members.emplace_back(name_of(var->identifier), soto::wdl_value::string("out/" + name_of(var->identifier), soto::WT_FILE));
+    return soto::wdl_value::object(std::move(outputs));
+}
+
+static const soto::ast_node *task_of(const soto::ast_node &stmt, const std::vector<const parsed *> &sources)
+{
+    const auto &call = std::get<soto::call_decl>(stmt.node);
+    const auto *target = call.member_accessed ? std::get_if<soto::member_access>(&call.member_accessed->node) : nullptr;
+    const std::string name = !target ? "" : target->member ? name_of(target->member) : name_of(target->object);
+    for (const parsed *p : sources)
+        if (auto it = p->tasks.find(name); it != p->tasks.end())
+            return it->second;
+    return nullptr;
+}
+
+struct run_result
+{
+public:
+    std::size_t calls = 0;
+    std::size_t up_front = 0;
+    soto::graph_stats stats;
+    double build_us = 0;
+    double run_us = 0;
+};
+
+// the stand-in scheduler: hand out whatever's ready, finish it at once
+static run_result run(const parsed &main, const std::vector<const parsed *> &sources, const std::unordered_map<std::string, soto::wdl_value> &inputs,
+                      std::size_t runs)
+{
+    run_result result;
+    auto t0 = std::chrono::steady_clock::now();
+    soto::workflow_graph graph;
+    for (std::size_t r = 0; r < runs; ++r)
+        graph = soto::workflow_graph::build(*main.workflow);
+    auto t1 = std::chrono::steady_clock::now();
+    for (std::size_t r = 0; r < runs; ++r)
+    {
+        soto::eval_scope scope(main.resolved.layout_of(*main.workflow), nullptr);
+        for (const auto &member : std::get<soto::class_decl>(main.workflow->node).members)
+            if (const auto *in = member ? std::get_if<soto::input_decl>(&member->node) : nullptr)
+                if (const auto *b = in->body ? std::get_if<soto::block>(&in->body->node) : nullptr)
+                    for (const auto &d : b->statements)
+                        if (const auto *var = d ? std::get_if<soto::var_decl>(&d->node) : nullptr)
+                        {
+                            const std::string name = name_of(var->identifier);
+                            auto given = inputs.find(name);
+                            if (given != inputs.end())
+                                scope.set(name, given->second);
+                            else if (!var->initializer)
+                                scope.set(name, var->type->type == soto::N_TYPE_NULLABLE ? soto::wdl_value::none() : soto::wdl_value::string(name, soto::WT_FILE));
+                        }
+        soto::graph_run g(graph, scope);
+        while (!g.ready.empty())
+        {
+            const std::uint32_t n = g.ready.front();
+            g.ready.pop_front();
+            const soto::graph_node &node = graph.nodes[n];
+            if (node.kind == soto::GN_CALL)
+            {
+                g.finish(n, outputs_of(task_of(*node.stmt, sources)));
+                continue;
+            }
+            soto::wdl_object gathered;
+            for (const std::string &name : node.names)
+                gathered.members.emplace_back(name, g.gather(n, soto::wdl_array(g.shards[n], soto::wdl_value::none())));
+            g.finish(n, soto::wdl_value::object(std::move(gathered)));
+        }
+        if (!g.done())
+            throw std::runtime_error("graph run stalled");
+        result.stats = g.stats;
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    result.calls = graph.calls;
+    result.build_us = std::chrono::duration<double, std::micro>(t1 - t0).count() / static_cast<double>(runs);
+    result.run_us = std::chrono::duration<double, std::micro>(t2 - t1).count() / static_cast<double>(runs);
+    return result;
+}
+
+static std::string generate(std::size_t stages, std::size_t shards)
+{
+    std::string wdl = "version 1.0\n\ntask Step {\n  input {\n    Int i\n    File? prev\n  }\n  command <<<\n    echo ~{i}\n  >>>\n"
+                      "  output {\n    File out = stdout()\n  }\n}\n\ntask Gather {\n  input {\n    Array[File] parts\n  }\n"
+                      "  command <<<\n    cat ~{sep=' ' parts}\n  >>>\n  output {\n    File out = stdout()\n  }\n}\n\nworkflow Pipeline {\n  input {\n";
+    for (std::size_t s = 0; s < stages; ++s)
+        wdl += "    Boolean run_stage_" + std::to_string(s) + "\n";
+    wdl += "    Int shards = " + std::to_string(shards) + "\n  }\n";
+    for (std::size_t s = 0; s < stages; ++s)
+    {
+        const std::string n = std::to_string(s);
+        wdl += "  if (run_stage_" + n + ") {\n    scatter (i in range(shards)) {\n      call Step as First" + n + " { input: i = i }\n";
+        wdl += "      call Step as Second" + n + " { input: i = i, prev = First" + n + ".out }\n    }\n";
+        wdl += "    call Gather as Gather" + n + " { input: parts = Second" + n + ".out }\n  }\n";
+    }
+    return wdl + "}\n";
+}
+
+static void print(const char *what, const run_result &r)
+{
+    std::printf("%-24s %7zu %10zu %10zu %8zu %10.1f %10.1f\n", what, r.calls, r.up_front, r.stats.materialized, r.stats.pruned_calls, r.build_us, r.run_us);
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_stages = 200, n_enabled = 10, n_shards = 100, n_runs = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--stages" && i + 1 < argc)
+            n_stages = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--enabled" && i + 1 < argc)
+            n_enabled = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--shards" && i + 1 < argc)
+            n_shards = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--runs" && i + 1 < argc)
+            n_runs = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::printf("%-24s %7s %10s %10s %8s %10s %10s\n", "workflow", "calls", "up front", "handed", "pruned", "build us", "run us");
+
+    const parsed pair = parse(read_file(WDLRUNNER_CORPUS_DIR "/cnv_wdl/somatic/cnv_somatic_pair_workflow.wdl"));
+    const parsed common = parse(read_file(WDLRUNNER_CORPUS_DIR "/cnv_wdl/cnv_common_tasks.wdl"));
+    const std::vector<const parsed *> cnv = {&pair, &common};
+    std::unordered_map<std::string, soto::wdl_value> tumor_only;
+    run_result r = run(pair, cnv, tumor_only, n_runs);
+    r.up_front = r.calls; // no scatters
+    print("cnv pair, tumor only", r);
+    std::unordered_map<std::string, soto::wdl_value> matched = {{"normal_bam", soto::wdl_value::string("normal.bam", soto::WT_FILE)},
+                                                                {"normal_bam_idx", soto::wdl_value::string("normal.bai", soto::WT_FILE)}};
+    r = run(pair, cnv, matched, n_runs);
+    r.up_front = r.calls;
+    print("cnv pair, matched", r);
+
+    const parsed pipeline = parse(generate(n_stages, n_shards));
+    const std::vector<const parsed *> self = {&pipeline};
+    std::unordered_map<std::string, soto::wdl_value> flags;
+    for (std::size_t s = 0; s < n_stages; ++s)
+        flags.emplace("run_stage_" + std::to_string(s), soto::wdl_value::boolean(s < n_enabled));
+    r = run(pipeline, self, flags, n_runs);
+    r.up_front = n_stages * (2 * n_shards + 1);
+    const std::string label = std::to_string(n_enabled) + "/" + std::to_string(n_stages) + " stages x " + std::to_string(n_shards);
+    print(label.c_str(), r);
+    return 0;
+}
@@ -0,0 +1,146 @@
+// hash_bench... throughput of the file hashing subsystem in GB/s
+//
+// usage: hash_bench [--size-mb N] [--dir DIR] [--threads N] [--keep] [file...]
+// with no files, a scratch file of --size-mb (default 2048) is written to --dir (default /tmp) and hashed.
+// note the page cache is warm after the first pass, drop caches yourself if you want cold-disk numbers...
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "file_hash.h"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double seconds_since(bench_clock::time_point t0)
+{
+    return std::chrono::duration<double>(bench_clock::now() - t0).count();
+}
+
+static void report(const std::string &name, std::uint64_t bytes, double secs)
+{
+    std::printf("%-28s %10.3f GB/s  %8.3f s  %12llu bytes\n", name.c_str(), (bytes / 1e9) / secs, secs, static_cast<unsigned long long>(bytes));
+}
+
+static void write_scratch_file(const std::string &path, std::uint64_t size)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::vector<std::uint64_t> block((8u << 20) / sizeof(std::uint64_t));
+    std::uint64_t x = 0x9E3779B97F4A7C15ULL;
+    std::uint64_t written = 0;
+    while (written < size)
+    {
+        for (auto &w : block)
+        {
+            // xorshift, we only need bytes that don't compress to nothing...
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            w = x;
+        }
+        std::uint64_t n = std::min<std::uint64_t>(size - written, block.size() * sizeof(std::uint64_t));
+        file.write(reinterpret_cast<const char *>(block.data()), static_cast<std::streamsize>(n));
+        written += n;
+    }
+    if (!file)
+        throw std::runtime_error("Failed to write to file: " + path);
+}
+
+int main(int argc, char *argv[])
+{
+    std::uint64_t size_mb = 2048;
+    std::string dir = "/tmp";
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool keep = false;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--size-mb" && i + 1 < argc)
+            size_mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc)
+            threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--keep")
+            keep = true;
+        else
+            files.push_back(arg);
+    }
+
+    // known xxh64 vectors first, a fast wrong hash is worth nothing...
+    if (soto::xxh64("", 0) != 0xEF46DB3751D8E999ULL || soto::xxh64("abc", 3) != 0x44BC2CF5AD770999ULL)
+    {
+        std::cerr << "xxh64 does not match the reference vectors" << std::endl;
+        return 1;
+    }
+
+    std::string scratch;
+    if (files.empty())
+    {
+        scratch = dir + "/wdlrunner_hash_bench.bin";
+        std::cout << "writing " << size_mb << " MB scratch file " << scratch << std::endl;
+        write_scratch_file(scratch, size_mb << 20);
+        files.push_back(scratch);
+    }
+
+    {
+        std::vector<unsigned char> buf(256u << 20, 0x5a);
+        auto t0 = bench_clock::now();
+        volatile std::uint64_t sink = soto::xxh64(buf.data(), buf.size());
+        (void)sink;
+        report("xxh64 in-memory, 1 thread", buf.size(), seconds_since(t0));
+    }
+
+    std::uint64_t total = 0;
+    {
+        soto::file_hasher warmup("", threads);
+        warmup.hash_uncached(files); // pull the files into the page cache so both runs below see the same thing...
+        total = warmup.bytes_hashed();
+    }
+    {
+        soto::file_hasher hasher("", 1);
+        auto t0 = bench_clock::now();
+        hasher.hash_uncached(files);
+        report("files, 1 thread", total, seconds_since(t0));
+    }
+    {
+        soto::file_hasher hasher("", threads);
+        auto t0 = bench_clock::now();
+        hasher.hash_uncached(files);
+        report("files, " + std::to_string(threads) + " threads", total, seconds_since(t0));
+    }
+    {
+        std::string memo = dir + "/wdlrunner_hash_bench.memo";
+        std::remove(memo.c_str());
+        soto::file_hasher cold(memo, threads);
+        auto t0 = bench_clock::now();
+        auto first = cold.hash_all(files);
+        report("memo miss (hash + record)", total, seconds_since(t0));
+
+        soto::file_hasher warm(memo, threads); // fresh process as far as the memo is concerned...
+        t0 = bench_clock::now();
+        auto second = warm.hash_all(files);
+        double secs = seconds_since(t0);
+        std::printf("%-28s %10.3f ms  (%zu hits)\n", "memo hit (stat only)", secs * 1e3, warm.memo_hits());
+        if (first != second)
+        {
+            std::cerr << "memoized digest differs from the computed one" << std::endl;
+            return 1;
+        }
+        std::remove(memo.c_str());
+    }
+
+    if (!scratch.empty() && !keep)
+        std::remove(scratch.c_str());
+    return 0;
+}
@@ -0,0 +1,127 @@
+// inputs_bench... binding a cohort-sized inputs JSON (tens of thousands of sample paths and then some)
+//
+// usage: inputs_bench [--mb N] [--path FILE] [--keep]
+// writes an inputs JSON of about --mb megabytes for a cohort workflow (bams, bais, sample names,
+// a per-sample Map and an Array[Pair]), then binds it against the parsed workflow and reports
+// throughput and peak RSS. there's no DOM in between, RSS is the bound values plus the mapped file's page cache...
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include "json_inputs.h"
+
+namespace fs = std::filesystem;
+
+static const char *WORKFLOW = R"(version 1.0
+
+workflow CNVGermlineCohortWorkflow {
+    input {
+        Array[File] normal_bams
+        Array[File] normal_bais
+        Array[String] sample_names
+        Map[String, Int] read_counts
+        Array[Pair[String, File]] sample_to_bam
+        File intervals
+        Int num_intervals_per_scatter = 5000
+        Float? mapping_error_rate
+        Boolean do_explicit_gc_correction = true
+    }
+}
+)";
+
+static double max_rss_mb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t mb = 100;
+    std::string path = "/tmp/wdlrunner_inputs_bench.json";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--mb" && i + 1 < argc)
+            mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--path" && i + 1 < argc)
+            path = argv[++i];
+        else if (arg == "--keep")
+            keep = true;
+    }
+
+    // one record per sample in each field... about 300 bytes a sample
+    const std::size_t n_samples = mb * 1000000 / 300;
+    {
+        std::ofstream out(path);
+        auto sample = [](std::size_t i)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "SM-%08zu", i);
+            return std::string(buf);
+        };
+        auto bam = [&](std::size_t i)
+        { return "gs://broad-gotc-prod-storage/cohort/" + sample(i) + "/" + sample(i) + ".bam"; };
+        auto write_array = [&](const char *key, auto element)
+        {
+            out << "  \"CNVGermlineCohortWorkflow." << key << "\": [";
+            for (std::size_t i = 0; i < n_samples; ++i)
+                out << (i ? ",\n    " : "\n    ") << element(i);
+            out << "\n  ],\n";
+        };
+        out << "{\n";
+        write_array("normal_bams", [&](std::size_t i)
+                    { return "\"" + bam(i) + "\""; });
+        write_array("normal_bais", [&](std::size_t i)
+                    { return "\"" + bam(i) + ".bai\""; });
+        write_array("sample_names", [&](std::size_t i)
+                    { return "\"" + sample(i) + "\""; });
+        write_array("sample_to_bam", [&](std::size_t i)
+                    { return "{\"left\": \"" + sample(i) + "\", \"right\": \"" + bam(i) + "\"}"; });
+        out << "  \"CNVGermlineCohortWorkflow.read_counts\": {";
+        for (std::size_t i = 0; i < n_samples; ++i)
+            out << (i ? ",\n    \"" : "\n    \"") << sample(i) << "\": " << (i * 7919 % 100000);
+        out << "\n  },\n";
+        out << "  \"CNVGermlineCohortWorkflow.intervals\": \"gs://gcp-public-data--broad-references/hg38/v0/exome_calling_regions.v1.interval_list\",\n";
+        out << "  \"CNVGermlineCohortWorkflow.mapping_error_rate\": 0.01,\n";
+        out << "  \"CNVGermlineCohortWorkflow.PreprocessIntervals.bin_length\": 0\n";
+        out << "}\n";
+    }
+    const double file_mb = fs::file_size(path) / 1e6;
+
+    // the parser is chatty on stdout, keep it out of the report
+    std::ostringstream sink;
+    auto *old = std::cout.rdbuf(sink.rdbuf());
+    soto::lexer lexer{WORKFLOW};
+    soto::parser parser{std::make_unique<soto::lexer>(lexer)};
+    soto::ast_node_ptr prog = parser.parse_program();
+    std::cout.rdbuf(old);
+
+    const double rss_before = max_rss_mb();
+    auto t0 = std::chrono::steady_clock::now();
+    soto::bound_inputs inputs = soto::bind_inputs_json(path, prog);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    for (const auto &error : inputs.errors)
+        std::printf("%s\n", soto::format_input_error(error, path).c_str());
+    bool ok = inputs.ok() && inputs.values.size() == 7 &&
+              inputs.values.at("normal_bams").as_array().size() == n_samples &&
+              inputs.values.at("read_counts").as_map().size() == n_samples &&
+              inputs.values.at("sample_to_bam").as_array().back().as_pair().first.as_string() == inputs.values.at("sample_names").as_array().back().as_string();
+
+    std::printf("samples=%zu  file=%.1f MB  bind=%.3f s  %.0f MB/s  values bound=%zu  ignored keys=%zu\n",
+                n_samples, file_mb, secs, file_mb / secs, inputs.values.size(), inputs.ignored_keys.size());
+    std::printf("peak RSS before=%.1f MB  after=%.1f MB\n", rss_before, max_rss_mb());
+    std::printf("%s\n", ok ? "binding OK" : "binding MISMATCH");
+
+    if (!keep)
+        fs::remove(path);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,481 @@
+// lazy_bench... how many declarations a run of a workflow actually needs, against evaluating all of them
+//
+// usage: lazy_bench [--wdl FILE] [--tasks FILE] [--samples N] [--shards N] [--runs N]
+// walks --wdl's workflow (default: the corpus's cnv germline cohort workflow, its tasks from --tasks, the
+// corpus's cnv_common_tasks.wdl) the way the scheduler would hand calls out: call inputs evaluated as a call
+// is reached, scatters run shard by shard (--samples bams, --shards interval shards), every call into a frame of
+// the task's own where its runtime values, command and outputs are evaluated. tasks don't run, a call's outputs
+// are made-up values of the types its task declares. the whole walk happens --runs times, two ways:
+//   eager   every declaration of every frame evaluated where it's written, like a runtime without defer()
+//   lazy    declarations deferred (eval_scope::defer), evaluated the first time something reads them
+// and prints declarations per run, how many were evaluated, how many that saved, and µs per run.
+// expressions that need a file (read_*, size of a made-up path) fail either way and are counted, not fatal
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "command_template.h"
+#include "lexer.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_resolve.h"
+
+#ifndef WDLRUNNER_CORPUS_DIR
+#define WDLRUNNER_CORPUS_DIR "case-study-examples"
+#endif
+
+static std::string read_file(const std::string &path)
+{
+    std::FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::string text;
+    char buf[65536];
+    for (std::size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;)
+        text.append(buf, n);
+    std::fclose(f);
+    return text;
+}
+
+static std::string name_of(const soto::ast_node_ptr &node)
+{
+    return node && node->tok ? node->tok->lexeme : "";
+}
+
+static soto::wdl_type type_of(const soto::var_decl &var)
+{
+    try
+    {
+        return soto::wdl_type::parse(var.type->tok->lexeme);
+    }
+    catch (const std::exception &)
+    {
+        return soto::wdl_type(soto::WT_STRING);
+    }
+}
+
+template <typename Fn>
+static void for_each_decl(const soto::ast_node_ptr &body, Fn fn)
+{
+    if (const auto *b = body ? std::get_if<soto::block>(&body->node) : nullptr)
+        for (const auto &d : b->statements)
+            if (const auto *var = d ? std::get_if<soto::var_decl>(&d->node) : nullptr)
+                if (var->identifier && var->identifier->tok && var->type && var->type->tok)
+                    fn(*var);
+}
+
+static const std::vector<soto::ast_node_ptr> &statements_of(const soto::ast_node_ptr &body)
+{
+    static const std::vector<soto::ast_node_ptr> none;
+    const auto *b = body ? std::get_if<soto::block>(&body->node) : nullptr;
+    return b ? b->statements : none;
+}
+
+struct walk_stats
+{
+public:
+    std::size_t frames = 0;
+    std::size_t calls = 0;
+    std::size_t call_inputs = 0;
+    std::size_t declarations = 0;
+    std::size_t evaluated = 0;
+    std::size_t errors = 0;
+};
+
+struct walker
+{
+public:
+    bool eager = false;
+    std::size_t samples = 0;
+    std::size_t shards = 0;
+    std::vector<const soto::resolve_result *> resolved;
+    std::unordered_map<std::string, const soto::ast_node *> tasks; // name -> N_CLASS_DECL
+    std::unordered_map<const soto::command_decl *, soto::command_template> commands; // compiled once per task
+    std::deque<soto::eval_scope> frames;                          // every frame of the run, for the counts
+    walk_stats stats;
+
+    std::shared_ptr<const soto::frame_layout> layout_of(const soto::ast_node &node) const
+    {
+        for (const auto *r : resolved)
+            if (auto layout = r->layout_of(node))
+                return layout;
+        throw std::runtime_error("no frame layout, was the program resolved?");
+    }
+
+    // a made-up value of the declared type... an Array is one per sample, or per shard when it's the intervals
+    // being scattered over
+    soto::wdl_value synthetic(const soto::wdl_type &type, const std::string &name) const
+    {
+        using soto::wdl_value;
+        switch (type.kind)
+        {
+        case soto::WT_BOOLEAN:
+            return wdl_value::boolean(true);
+        case soto::WT_INT:
+            return wdl_value::integer(name.find("scatter") != std::string::npos ? static_cast<std::int64_t>(shards) : 1000);
+        case soto::WT_FLOAT:
+            return wdl_value::floating(0.5);
+        case soto::WT_FILE:
+        case soto::WT_DIRECTORY:
+            return wdl_value::string("gs://bucket/" + name, type.kind);
+        case soto::WT_ARRAY:
+        {
+            soto::wdl_array elements;
+            const std::size_t n = name.find("scatter") != std::string::npos ? shards : samples;
+            for (std::size_t i = 0; i < n; ++i)
+                elements.push_back(synthetic(type.params.empty() ? soto::wdl_type(soto::WT_STRING) : type.params[0], name + std::to_string(i)));
+            return wdl_value::array(std::move(elements));
+        }
+        case soto::WT_PAIR:
+            return wdl_value::pair(synthetic(type.params[0], name + "_left"), synthetic(type.params[1], name + "_right"));
+        default:
+            return wdl_value::string(name);
+        }
+    }
+
+    soto::eval_scope &open(const soto::ast_node &owner, const soto::eval_scope *parent)
+    {
+        ++stats.frames;
+        return frames.emplace_back(layout_of(owner), parent);
+    }
+
+    void evaluate(const soto::ast_node_ptr &expr, const soto::eval_scope &scope)
+    {
+        try
+        {
+            soto::evaluate(expr, scope);
+        }
+        catch (const std::exception &)
+        {
+            ++stats.errors;
+        }
+    }
+
+    void read(const soto::eval_scope &scope, const std::string &name)
+    {
+        try
+        {
+            scope.find(name);
+        }
+        catch (const std::exception &)
+        {
+            ++stats.errors;
+        }
+    }
+
+    // eager: a declaration is evaluated where it's written, once the calls before it have their outputs...
+    // lazy: it was deferred with the rest of its frame, and this does nothing
+    void declared(const soto::ast_node &node, const soto::eval_scope &scope)
+    {
+        if (!eager)
+            return;
+        if (const auto *var = std::get_if<soto::var_decl>(&node.node))
+        {
+            if (var->initializer)
+                read(scope, name_of(var->identifier));
+        }
+        else if (const auto *inputs = std::get_if<soto::input_decl>(&node.node))
+            for_each_decl(inputs->body, [&](const soto::var_decl &var)
+                          {
+                              if (var.initializer)
+                                  read(scope, var.identifier->tok->lexeme); });
+    }
+
+    // the task's frame, with what the call gave it... then everything running it would evaluate
+    soto::wdl_value run_task(const soto::ast_node &task, const std::vector<std::pair<std::string, soto::wdl_value>> &given)
+    {
+        const auto &klass = std::get<soto::class_decl>(task.node);
+        soto::eval_scope &scope = open(task, nullptr);
+        for (const auto &[name, value] : given)
+            if (scope.layout->find(name))
+                scope.set(name, value);
+        soto::wdl_object outputs;
+        for (const auto &member : klass.members)
+            if (const auto *inputs = member ? std::get_if<soto::input_decl>(&member->node) : nullptr)
+                for_each_decl(inputs->body, [&](const soto::var_decl &var)
+                              {
+                                  const std::string &name = var.identifier->tok->lexeme;
+                                  const std::uint32_t slot = *scope.layout->find(name);
+                                  if (scope.state[slot] != soto::SLOT_EMPTY || var.initializer)
+                                      return;
+                                  // not given, no default: None when it's optional, otherwise something made up
+                                  scope.set_slot(slot, var.type->type == soto::N_TYPE_NULLABLE ? soto::wdl_value::none() : synthetic(type_of(var), name)); });
+        soto::defer_declarations(scope, klass.members);
+        for (const auto &member : klass.members)
+            if (member)
+                declared(*member, scope);
+        for (const auto &member : klass.members)
+        {
+            if (!member)
+                continue;
+            if (const auto *runtime = std::get_if<soto::runtime_decl>(&member->node))
+                for (const auto &[key, value] : runtime->members)
+                    evaluate(value, scope);
+            else if (const auto *command = std::get_if<soto::command_decl>(&member->node))
+            {
+                try
+                {
+                    if (command->compiled)
+                    {
+                        command->compiled->render(scope); // the resolver's, placeholders read through slots
+                        continue;
+                    }
+                    auto compiled = commands.find(command);
+                    if (compiled == commands.end())
+                        compiled = commands.emplace(command, soto::command_template::from_command(*command)).first;
+                    compiled->second.render(scope);
+                }
+                catch (const std::exception &)
+                {
+                    ++stats.errors;
+                }
+            }
+            else if (const auto *out = std::get_if<soto::output_decl>(&member->node))
+                for_each_decl(out->body, [&](const soto::var_decl &var)
+                              {
+                                  evaluate(var.initializer, scope);
+                                  outputs.members.emplace_back(var.identifier->tok->lexeme, synthetic(type_of(var), var.identifier->tok->lexeme)); });
+        }
+        return soto::wdl_value::object(std::move(outputs));
+    }
+
+    void call(const soto::call_decl &call, soto::eval_scope &scope)
+    {
+        const auto *target = call.member_accessed ? std::get_if<soto::member_access>(&call.member_accessed->node) : nullptr;
+        if (!target)
+            return;
+        const std::string task_name = target->member ? name_of(target->member) : name_of(target->object);
+        const std::string alias = call.alias ? name_of(call.alias) : task_name;
+        ++stats.calls;
+        std::vector<std::pair<std::string, soto::wdl_value>> given;
+        for (const auto &[key, value] : call.arguments)
+        {
+            ++stats.call_inputs;
+            try
+            {
+                given.emplace_back(name_of(key), soto::evaluate(value, scope));
+            }
+            catch (const std::exception &)
+            {
+                ++stats.errors;
+            }
+        }
+        auto task = tasks.find(task_name);
+        scope.set(alias, task == tasks.end() ? soto::wdl_value::none() : run_task(*task->second, given));
+    }
+
+    // a scatter's names out in the frame around it... an Array per name, and a call's outputs an object of Arrays
+    static soto::wdl_value gather(const std::vector<const soto::wdl_value *> &shard_values)
+    {
+        if (!shard_values.empty() && shard_values.front() && shard_values.front()->kind == soto::WT_OBJECT)
+        {
+            soto::wdl_object gathered;
+            for (std::size_t m = 0; m < shard_values.front()->as_object().members.size(); ++m)
+            {
+                soto::wdl_array column;
+                for (const soto::wdl_value *v : shard_values)
+                    column.push_back(v->as_object().members[m].second);
+                gathered.members.emplace_back(shard_values.front()->as_object().members[m].first, soto::wdl_value::array(std::move(column)));
+            }
+            return soto::wdl_value::object(std::move(gathered));
+        }
+        soto::wdl_array elements;
+        for (const soto::wdl_value *v : shard_values)
+            elements.push_back(v ? *v : soto::wdl_value::none());
+        return soto::wdl_value::array(std::move(elements));
+    }
+
+    void statements(const std::vector<soto::ast_node_ptr> &body, soto::eval_scope &scope)
+    {
+        for (const auto &node : body)
+        {
+            if (!node)
+                continue;
+            declared(*node, scope);
+            if (const auto *c = std::get_if<soto::call_decl>(&node->node))
+                call(*c, scope);
+            else if (const auto *scatter = std::get_if<soto::scatter_stmt>(&node->node))
+            {
+                soto::wdl_value collection;
+                try
+                {
+                    collection = soto::evaluate(scatter->collection, scope);
+                }
+                catch (const std::exception &)
+                {
+                    ++stats.errors;
+                    continue;
+                }
+                std::vector<soto::eval_scope *> shard_frames;
+                for (const soto::wdl_value &element : collection.as_array())
+                {
+                    soto::eval_scope &shard = open(*node, &scope);
+                    shard.set_slot(0, element);
+                    soto::defer_declarations(shard, statements_of(scatter->body));
+                    statements(statements_of(scatter->body), shard);
+                    shard_frames.push_back(&shard);
+                }
+                const auto inner = layout_of(*node);
+                for (std::uint32_t slot = 1; slot < inner->size(); ++slot)
+                {
+                    std::vector<const soto::wdl_value *> values;
+                    try
+                    {
+                        for (soto::eval_scope *shard : shard_frames)
+                            values.push_back(shard->find(inner->names[slot]));
+                        scope.set(inner->names[slot], gather(values));
+                    }
+                    catch (const std::exception &)
+                    {
+                        ++stats.errors;
+                    }
+                }
+            }
+            else if (const auto *cond = std::get_if<soto::if_stmt>(&node->node))
+            {
+                bool taken = false;
+                try
+                {
+                    taken = soto::evaluate(cond->condition, scope).as_bool();
+                }
+                catch (const std::exception &)
+                {
+                    ++stats.errors;
+                }
+                const auto inner = layout_of(*node);
+                soto::eval_scope *body = nullptr;
+                if (taken)
+                {
+                    body = &open(*node, &scope);
+                    soto::defer_declarations(*body, statements_of(cond->then_));
+                    statements(statements_of(cond->then_), *body);
+                }
+                for (const std::string &name : inner->names)
+                {
+                    const soto::wdl_value *v = nullptr;
+                    try
+                    {
+                        v = body ? body->find(name) : nullptr;
+                    }
+                    catch (const std::exception &)
+                    {
+                        ++stats.errors;
+                    }
+                    scope.set(name, v ? *v : soto::wdl_value::none());
+                }
+            }
+            else if (const auto *out = std::get_if<soto::output_decl>(&node->node))
+                for_each_decl(out->body, [&](const soto::var_decl &var)
+                              { evaluate(var.initializer, scope); });
+        }
+    }
+
+    void run(const soto::ast_node &workflow)
+    {
+        const auto &klass = std::get<soto::class_decl>(workflow.node);
+        soto::eval_scope &scope = open(workflow, nullptr);
+        for (const auto &member : klass.members)
+            if (const auto *inputs = member ? std::get_if<soto::input_decl>(&member->node) : nullptr)
+                for_each_decl(inputs->body, [&](const soto::var_decl &var)
+                              {
+                                  if (var.initializer)
+                                      return; // left to its default
+                                  const std::string &name = var.identifier->tok->lexeme;
+                                  scope.set(name, var.type->type == soto::N_TYPE_NULLABLE ? soto::wdl_value::none() : synthetic(type_of(var), name)); });
+        soto::defer_declarations(scope, klass.members);
+        statements(klass.members, scope);
+        for (const soto::eval_scope &frame : frames)
+        {
+            stats.declarations += frame.deferred;
+            stats.evaluated += frame.evaluated;
+        }
+    }
+};
+
+static soto::ast_node_ptr parse(const std::string &path)
+{
+    std::vector<soto::parse_diagnostic> diagnostics;
+    const std::string source = read_file(path);
+    soto::parser parser{std::make_unique<soto::lexer>(source), &diagnostics};
+    soto::ast_node_ptr prog = parser.parse_program();
+    if (!diagnostics.empty())
+        throw std::runtime_error(path + ": " + diagnostics.front().message);
+    return prog;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string wdl = WDLRUNNER_CORPUS_DIR "/cnv_wdl/germline/cnv_germline_cohort_workflow.wdl";
+    std::string tasks_wdl = WDLRUNNER_CORPUS_DIR "/cnv_wdl/cnv_common_tasks.wdl";
+    std::size_t n_samples = 100, n_shards = 50, n_runs = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--wdl" && i + 1 < argc)
+            wdl = argv[++i];
+        else if (arg == "--tasks" && i + 1 < argc)
+            tasks_wdl = argv[++i];
+        else if (arg == "--samples" && i + 1 < argc)
+            n_samples = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--shards" && i + 1 < argc)
+            n_shards = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--runs" && i + 1 < argc)
+            n_runs = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    soto::ast_node_ptr workflow_prog = parse(wdl), tasks_prog = parse(tasks_wdl);
+    const soto::resolve_result workflow_resolved = soto::resolve_program(*workflow_prog);
+    const soto::resolve_result tasks_resolved = soto::resolve_program(*tasks_prog);
+
+    const soto::ast_node *workflow = nullptr;
+    std::unordered_map<std::string, const soto::ast_node *> tasks;
+    for (const auto *prog : {&workflow_prog, &tasks_prog})
+        for (const auto &decl : std::get<soto::program>((*prog)->node).declarations)
+        {
+            if (!decl || decl->type != soto::N_CLASS_DECL || !decl->tok)
+                continue;
+            const std::string name = name_of(std::get<soto::class_decl>(decl->node).identifier);
+            if (decl->tok->lexeme == "task")
+                tasks.emplace(name, decl.get());
+            else if (!workflow)
+                workflow = decl.get();
+        }
+    if (!workflow)
+    {
+        std::fprintf(stderr, "no workflow in %s\n", wdl.c_str());
+        return 1;
+    }
+
+    auto measure = [&](bool eager, walk_stats &stats)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (std::size_t r = 0; r < n_runs; ++r)
+        {
+            walker w;
+            w.eager = eager;
+            w.samples = n_samples;
+            w.shards = n_shards;
+            w.resolved = {&workflow_resolved, &tasks_resolved};
+            w.tasks = tasks;
+            w.run(*workflow);
+            stats = w.stats;
+        }
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / static_cast<double>(n_runs);
+    };
+    walk_stats eager_stats, lazy_stats;
+    const double eager_us = measure(true, eager_stats);
+    const double lazy_us = measure(false, lazy_stats);
+
+    std::printf("%s: %zu samples, %zu interval shards\n", wdl.c_str(), n_samples, n_shards);
+    std::printf("%zu frames, %zu calls, %zu call inputs per run\n\n", lazy_stats.frames, lazy_stats.calls, lazy_stats.call_inputs);
+    std::printf("%-6s %12s %12s %10s %8s %12s\n", "mode", "declarations", "evaluated", "avoided", "errors", "us/run");
+    for (const auto &[mode, stats, us] : {std::tuple{"eager", eager_stats, eager_us}, std::tuple{"lazy", lazy_stats, lazy_us}})
+        std::printf("%-6s %12zu %12zu %10zu %8zu %12.1f\n", mode, stats.declarations, stats.evaluated, stats.declarations - stats.evaluated,
+                    stats.errors, us);
+    return 0;
+}
@@ -0,0 +1,120 @@
+// localize_bench... per-call input localization time for a wide scatter
+//
+// usage: localize_bench [--shards N] [--size-mb N] [--dir DIR] [--no-symlink] [--keep]
+// every shard localizes the same reference FASTA (+ .fai and .dict) into its own call dir,
+// which is the mutect2/cnv pattern. a handful of shards are also done with a forced copy for comparison...
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "localizer.h"
+
+namespace fs = std::filesystem;
+
+static void write_file_of_size(const std::string &path, std::uint64_t size)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + path);
+    std::string line = ">chr1\n";
+    std::string bases(1 << 20, 'A');
+    for (std::size_t i = 0; i < bases.size(); ++i)
+        bases[i] = "ACGT"[(i * 2654435761u >> 7) & 3];
+    std::uint64_t written = 0;
+    file << line;
+    while (written < size)
+    {
+        std::uint64_t n = std::min<std::uint64_t>(size - written, bases.size());
+        file.write(bases.data(), static_cast<std::streamsize>(n));
+        written += n;
+    }
+}
+
+static void print_stats(const std::string &name, std::vector<double> times)
+{
+    if (times.empty())
+        return;
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for (double t : times)
+        sum += t;
+    auto pct = [&](double p)
+    { return times[std::min(times.size() - 1, static_cast<std::size_t>(p * times.size()))]; };
+    std::printf("%-22s calls=%-6zu mean=%9.1f us  p50=%9.1f us  p99=%9.1f us  max=%9.1f us  total=%8.3f s\n",
+                name.c_str(), times.size(), 1e6 * sum / times.size(), 1e6 * pct(0.50), 1e6 * pct(0.99), 1e6 * times.back(), sum);
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t shards = 1000;
+    std::uint64_t size_mb = 512;
+    std::string dir = "/tmp/wdlrunner_localize_bench";
+    bool keep = false;
+    soto::localizer_options options{};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--shards" && i + 1 < argc)
+            shards = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--size-mb" && i + 1 < argc)
+            size_mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--no-symlink")
+            options.allow_symlink = false;
+        else if (arg == "--keep")
+            keep = true;
+    }
+
+    fs::remove_all(dir);
+    fs::create_directories(dir + "/ref");
+    std::vector<std::string> inputs = {dir + "/ref/Homo_sapiens_assembly38.fasta", dir + "/ref/Homo_sapiens_assembly38.fasta.fai", dir + "/ref/Homo_sapiens_assembly38.dict"};
+    write_file_of_size(inputs[0], size_mb << 20);
+    write_file_of_size(inputs[1], 16 << 10);
+    write_file_of_size(inputs[2], 64 << 10);
+
+    auto t0 = std::chrono::steady_clock::now();
+    soto::localizer links(dir + "/calls", options); // capability probe happens here, once...
+    double probe_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    auto caps = links.capabilities_of(dir + "/calls");
+    std::printf("work dir %s: reflink=%d hardlink=%d symlink=%d (probe %.1f us)\n", (dir + "/calls").c_str(), caps.reflink, caps.hardlink, caps.symlink, probe_secs * 1e6);
+
+    std::vector<double> times;
+    std::size_t counts[soto::L_FAILED + 1] = {0};
+    for (std::size_t s = 0; s < shards; ++s)
+    {
+        auto report = links.localize_call(inputs, dir + "/calls/shard-" + std::to_string(s));
+        times.push_back(report.seconds);
+        for (int k = 0; k <= soto::L_FAILED; ++k)
+            counts[k] += report.counts[k];
+    }
+    print_stats("chain", times);
+    for (int k = 0; k <= soto::L_FAILED; ++k)
+        if (counts[k])
+            std::printf("  %-10s %zu files\n", soto::localize_strategy_to_string(static_cast<soto::localize_strategy>(k)), counts[k]);
+
+    // same thing the naive way, few shards only, this is the cost we're avoiding...
+    std::vector<double> copy_times;
+    for (std::size_t s = 0; s < std::min<std::size_t>(shards, 10); ++s)
+    {
+        std::string call_dir = dir + "/copies/shard-" + std::to_string(s) + "/inputs";
+        fs::create_directories(call_dir);
+        auto c0 = std::chrono::steady_clock::now();
+        for (const auto &input : inputs)
+            soto::copy_file_contents(input, call_dir + "/" + fs::path(input).filename().string());
+        copy_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - c0).count());
+    }
+    print_stats("forced copy", copy_times);
+
+    if (!keep)
+        fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,114 @@
+// map_bench... looking keys up in a WDL Map through its index against walking the entries
+//
+// usage: map_bench [--entries N] [--lookups N]
+// builds a Map[String, Int] of --entries sample-ish keys (in shuffled order, which the Map has to keep), then
+//   scan    --lookups lookups walking the entries and comparing keys, what m[k] did before the index
+//   index   the same lookups through wdl_map::find
+//   as_map  the as_map builtin over the map's pairs, duplicate check included
+//   edit    the map shared by 1000 scopes, one of them adding a key... copied once, the others keep theirs
+// prints ns per lookup / per entry, and checks the order came out as inserted and every key was found
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "wdl_stdlib.h"
+#include "wdl_value.h"
+
+using soto::wdl_map;
+using soto::wdl_value;
+
+template <typename Fn>
+static double time_ns(std::size_t n, Fn fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / static_cast<double>(n ? n : 1);
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_entries = 100000, n_lookups = 1000000;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--entries" && i + 1 < argc)
+            n_entries = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--lookups" && i + 1 < argc)
+            n_lookups = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> keys;
+    keys.reserve(n_entries);
+    for (std::size_t i = 0; i < n_entries; ++i)
+        keys.push_back("SM-" + std::to_string(100000 + i) + ".counts.hdf5");
+    std::shuffle(keys.begin(), keys.end(), rng);
+
+    wdl_map entries;
+    const double insert_ns = time_ns(n_entries, [&]
+                                     {
+        for (std::size_t i = 0; i < n_entries; ++i)
+            entries.insert(wdl_value::string(keys[i]), wdl_value::integer(static_cast<std::int64_t>(i))); });
+    bool ok = entries.size() == n_entries;
+    for (std::size_t i = 0; ok && i < n_entries; ++i)
+        ok = entries[i].first.as_string() == keys[i]; // insertion order
+    ok = ok && !entries.insert(wdl_value::string(keys[0]), wdl_value::integer(-1)) && entries.find(wdl_value::string("missing")) == nullptr;
+
+    std::vector<wdl_value> probes;
+    probes.reserve(n_lookups);
+    std::uniform_int_distribution<std::size_t> pick(0, n_entries - 1);
+    for (std::size_t i = 0; i < n_lookups; ++i)
+        probes.push_back(wdl_value::string(keys[pick(rng)]));
+
+    // the scan gets a fraction of the lookups, it's that slow on a big map
+    const std::size_t n_scans = std::max<std::size_t>(1, n_lookups / (n_entries >= 10000 ? 1000 : 10));
+    std::int64_t scan_sum = 0, index_sum = 0, expect_sum = 0;
+    const double scan_ns = time_ns(n_scans, [&]
+                                   {
+        for (std::size_t i = 0; i < n_scans; ++i)
+            for (const auto &[k, v] : entries)
+                if (k == probes[i])
+                {
+                    scan_sum += v.as_int();
+                    break;
+                } });
+    const double index_ns = time_ns(n_lookups, [&]
+                                    {
+        for (const wdl_value &probe : probes)
+            if (const wdl_value *v = entries.find(probe))
+                index_sum += v->as_int(); });
+    for (std::size_t i = 0; i < n_scans; ++i)
+        for (std::size_t e = 0; e < n_entries; ++e)
+            if (entries[e].first == probes[i])
+            {
+                expect_sum += static_cast<std::int64_t>(e);
+                break;
+            }
+    ok = ok && scan_sum == expect_sum;
+
+    const wdl_value map = wdl_value::map(entries);
+    const wdl_value pairs = soto::call_builtin("as_pairs", {map});
+    std::size_t rebuilt = 0;
+    const double as_map_ns = time_ns(n_entries, [&]
+                                     { rebuilt = soto::call_builtin("as_map", {pairs}).as_map().size(); });
+    ok = ok && rebuilt == n_entries;
+
+    std::vector<wdl_value> scopes(1000, map);
+    const double edit_ns = time_ns(1, [&]
+                                   { scopes[0].edit_map().set(wdl_value::string("extra"), wdl_value::integer(0)); });
+    ok = ok && scopes[0].as_map().size() == n_entries + 1 && scopes[1].as_map().size() == n_entries && &scopes[1].as_map() == &map.as_map();
+
+    std::printf("%zu entries, %zu lookups\n\n", n_entries, n_lookups);
+    std::printf("%-8s %14s\n", "", "ns");
+    std::printf("%-8s %14.1f   per entry\n", "insert", insert_ns);
+    std::printf("%-8s %14.1f   per lookup (%zu lookups)\n", "scan", scan_ns, n_scans);
+    std::printf("%-8s %14.1f   per lookup\n", "index", index_ns);
+    std::printf("%-8s %14.1f   per entry\n", "as_map", as_map_ns);
+    std::printf("%-8s %14.1f   one key added to a map 1000 scopes share\n", "edit", edit_ns);
+    std::printf("\n%s (checksum %lld)\n", ok ? "order and lookups OK" : "MISMATCH", static_cast<long long>(index_sum));
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+// metadata_bench... a 50k-call run reporting into metadata.json / outputs.json as calls finish
+//
+// usage: metadata_bench [--calls N] [--compact] [--dir DIR] [--keep]
+// reports wall time, bytes written and RSS after the first 1k calls vs at the end:
+// if the writer were holding on to calls the second number would grow with --calls, it shouldn't...
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "run_metadata.h"
+
+namespace fs = std::filesystem;
+
+static double rss_mb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.rfind("VmRSS:", 0) == 0)
+            return std::stod(line.substr(6)) / 1024.0;
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_calls = 50000;
+    soto::json_style style = soto::JSON_PRETTY;
+    std::string dir = "/tmp/wdlrunner_metadata_bench";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--calls" && i + 1 < argc)
+            n_calls = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--compact")
+            style = soto::JSON_COMPACT;
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--keep")
+            keep = true;
+    }
+    fs::create_directories(dir);
+
+    double rss_early = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        soto::metadata_writer metadata(dir + "/metadata.json", "CNVGermlineCohortWorkflow", "5f0e1c0a-bench", style);
+        soto::outputs_writer outputs(dir + "/outputs.json", "5f0e1c0a-bench", style);
+        double clock = 1714566896.0;
+        for (std::size_t i = 0; i < n_calls; ++i)
+        {
+            soto::call_metadata call;
+            call.name = "CNVGermlineCohortWorkflow.CollectCounts";
+            call.shard = static_cast<int>(i);
+            call.return_code = 0;
+            call.cache_hit = i % 3 == 0;
+            call.cache_key = "9c1f04e2b7a35d61";
+            call.call_root = "/cromwell-executions/CNVGermlineCohortWorkflow/5f0e1c0a/call-CollectCounts/shard-" + std::to_string(i);
+            call.stdout_path = call.call_root + "/stdout";
+            call.stderr_path = call.call_root + "/stderr";
+            call.start = clock;
+            call.end = clock += 1.25;
+            call.max_rss_kb = 2100000;
+            call.user_seconds = 41.5;
+            call.system_seconds = 2.25;
+            call.outputs.emplace_back("counts", soto::wdl_value::string(call.call_root + "/SM-" + std::to_string(i) + ".counts.hdf5", soto::WT_FILE));
+            call.outputs.emplace_back("entity_id", soto::wdl_value::string("SM-" + std::to_string(i)));
+            metadata.call_finished(call);
+            if (i + 1 == 1000)
+                rss_early = rss_mb();
+        }
+        soto::wdl_array counts;
+        for (std::size_t i = 0; i < 100; ++i)
+            counts.push_back(soto::wdl_value::string("/cromwell-executions/CNVGermlineCohortWorkflow/5f0e1c0a/call-CollectCounts/shard-" + std::to_string(i) + "/counts.hdf5", soto::WT_FILE));
+        outputs.output("CNVGermlineCohortWorkflow.read_counts", soto::wdl_value::array(std::move(counts)));
+        outputs.output("CNVGermlineCohortWorkflow.num_samples", soto::wdl_value::integer(static_cast<std::int64_t>(n_calls)));
+        outputs.finish();
+        metadata.finish("Succeeded");
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    double rss_end = rss_mb();
+
+    std::printf("calls=%zu  style=%s  wall=%.3f s  %.0f calls/s  metadata=%.1f MB  outputs=%.1f KB\n",
+                n_calls, style == soto::JSON_PRETTY ? "pretty" : "compact", secs, n_calls / secs,
+                fs::file_size(dir + "/metadata.json") / 1e6, fs::file_size(dir + "/outputs.json") / 1e3);
+    std::printf("RSS after 1k calls=%.1f MB  at the end=%.1f MB\n", rss_early, rss_end);
+
+    if (!keep)
+        fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,205 @@
+// nest_bench... a scatter nested in a scatter, run as a tree of scatters against as one flattened iteration space
+//
+// usage: nest_bench [--outer N] [--inner M]
+// a generated cohort workflow: scatter over --outer samples, in it a scatter over --inner intervals (a
+// collection that doesn't depend on the sample), in that one call. a stand-in scheduler runs it to the end,
+// "running" a shard by building its scopes and evaluating the call's inputs:
+//   tree       workflow_graph built without flattening... per sample a scope, the inner collection evaluated
+//              in it, its M shards queued and their outputs gathered into the sample's Array, then the
+//              samples' Arrays gathered
+//   flattened  the graph's one node over all N x M shards, the collections evaluated once, the shards
+//              dispatched by index and their outputs gathered once, reshaped back into N Arrays of M
+// prints the scheduler's heap (beyond the graph run itself) once every shard is known and before any has run, its
+// peak, what the gathered Arrays it ends with take, allocations and shards per second, and checks both gathered the same Array[Array[File]]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "mem_report.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_graph.h"
+#include "wdl_resolve.h"
+
+// live heap bytes and their peak come from mem_hooks.cpp's counting allocator, which CMake links in
+static std::int64_t live_bytes() { return static_cast<std::int64_t>(soto::mem_heap.live.load()); }
+
+static std::string generate(std::size_t outer, std::size_t inner)
+{
+    return "version 1.0\n\ntask CollectCounts {\n  input {\n    String sample\n    String interval\n  }\n  command <<<\n    echo ~{sample} ~{interval}\n  >>>\n"
+           "  output {\n    File out = stdout()\n  }\n}\n\nworkflow Cohort {\n  input {\n    Int n_samples = " +
+           std::to_string(outer) + "\n    Int n_intervals = " + std::to_string(inner) +
+           "\n  }\n  Array[String] samples = prefix(\"SM-\", range(n_samples))\n"
+           "  Array[String] intervals = prefix(\"chr1:\", range(n_intervals))\n"
+           "  scatter (sample in samples) {\n    scatter (interval in intervals) {\n"
+           "      call CollectCounts { input: sample = sample, interval = interval }\n    }\n  }\n}\n";
+}
+
+struct mode_result
+{
+public:
+    soto::wdl_value gathered;
+    std::int64_t peak_bytes = 0;
+    std::int64_t expanded = 0; // held once every shard is known and before any has run
+    std::int64_t retained = 0; // still there at the end... the gathered Arrays
+    std::uint64_t allocations = 0;
+    std::size_t shards = 0;
+    double seconds = 0;
+};
+
+static const soto::ast_node &only_statement(const soto::ast_node &scatter)
+{
+    return *std::get<soto::block>(std::get<soto::scatter_stmt>(scatter.node).body->node).statements.front();
+}
+
+// "running" a shard: its call's inputs evaluated in the shard's scope, and what it gives back made up from them
+static soto::wdl_value run_shard(const soto::call_decl &call, const soto::eval_scope &scope)
+{
+    const soto::wdl_value sample = soto::evaluate(std::get<1>(call.arguments[0]), scope);
+    const soto::wdl_value interval = soto::evaluate(std::get<1>(call.arguments[1]), scope);
+    return soto::wdl_value::pair(sample, interval);
+}
+
+static mode_result run(const soto::ast_node &workflow, const soto::resolve_result &resolved, bool flatten)
+{
+    const soto::workflow_graph graph = soto::workflow_graph::build(workflow, flatten);
+    soto::eval_scope scope(resolved.layout_of(workflow), nullptr);
+    soto::graph_run g(graph, scope);
+    mode_result result;
+    if (g.ready.empty())
+    {
+        // no shards at all, the graph run gathered it already
+        result.gathered = *scope.find("CollectCounts");
+        return result;
+    }
+    const std::uint32_t n = g.ready.front();
+    g.ready.pop_front();
+    const soto::graph_node &node = graph.nodes[n];
+    const soto::ast_node &outer = *node.stmt;
+    const soto::ast_node &inner = only_statement(outer);
+    const auto &call = std::get<soto::call_decl>(only_statement(inner).node);
+    const auto outer_layout = resolved.layout_of(outer), inner_layout = resolved.layout_of(inner);
+
+    const std::int64_t base = live_bytes();
+    soto::mem_reset_peak();
+    const std::uint64_t allocs = soto::mem_heap.allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    if (flatten)
+    {
+        // one range of shards, one flat buffer for what they give back. they're handed out in order, so the
+        // shards of one sample follow each other and share its scope
+        soto::wdl_array flat(g.shards[n]);
+        const std::size_t per_sample = g.collections[n][1].as_array().size();
+        std::optional<soto::eval_scope> sample;
+        result.expanded = live_bytes() - base;
+        for (std::size_t k = 0; k < g.shards[n]; ++k)
+        {
+            if (k % per_sample == 0)
+            {
+                sample.emplace(outer_layout, &scope);
+                sample->set_slot(0, g.item(n, 0, k)); // a scatter frame's variable is its slot 0
+            }
+            soto::eval_scope interval(inner_layout, &*sample);
+            interval.set_slot(0, g.item(n, 1, k));
+            flat[k] = run_shard(call, interval);
+        }
+        result.shards = g.shards[n];
+        result.gathered = g.gather(n, std::move(flat));
+    }
+    else
+    {
+        // a scatter per sample, all expanded before any of their shards run
+        struct inner_scatter
+        {
+        public:
+            soto::eval_scope scope;
+            soto::wdl_value collection;
+            soto::wdl_array gathered;
+            std::size_t index = 0; // which sample
+            std::size_t left = 0;
+        };
+        const soto::wdl_array &samples = g.collections[n][0].as_array();
+        std::vector<std::unique_ptr<inner_scatter>> scatters;
+        std::deque<std::pair<inner_scatter *, std::size_t>> queue;
+        soto::wdl_array gathered(samples.size());
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            auto s = std::make_unique<inner_scatter>(inner_scatter{soto::eval_scope(outer_layout, &scope), {}, {}, i, 0});
+            s->scope.set_slot(0, samples[i]);
+            s->collection = soto::evaluate(std::get<soto::scatter_stmt>(inner.node).collection, s->scope);
+            s->left = s->collection.as_array().size();
+            s->gathered.resize(s->left);
+            if (s->left == 0)
+                gathered[i] = soto::wdl_value::array({});
+            for (std::size_t j = 0; j < s->left; ++j)
+                queue.emplace_back(s.get(), j);
+            scatters.push_back(std::move(s));
+        }
+        result.expanded = live_bytes() - base;
+        while (!queue.empty())
+        {
+            auto [s, j] = queue.front();
+            queue.pop_front();
+            soto::eval_scope interval(inner_layout, &s->scope);
+            interval.set_slot(0, s->collection.as_array()[j]);
+            s->gathered[j] = run_shard(call, interval);
+            ++result.shards;
+            if (--s->left == 0)
+            {
+                // the sample's scatter is done, gathered into its Array and let go
+                gathered[s->index] = soto::wdl_value::array(std::move(s->gathered));
+                scatters[s->index].reset();
+            }
+        }
+        result.gathered = soto::wdl_value::array(std::move(gathered));
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    result.peak_bytes = static_cast<std::int64_t>(soto::mem_heap.peak.load()) - base;
+    result.retained = live_bytes() - base;
+    result.allocations = soto::mem_heap.allocs.load() - allocs;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_outer = 200, n_inner = 500;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--outer" && i + 1 < argc)
+            n_outer = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--inner" && i + 1 < argc)
+            n_inner = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::vector<soto::parse_diagnostic> diagnostics;
+    soto::parser parser{std::make_unique<soto::lexer>(generate(n_outer, n_inner)), &diagnostics};
+    soto::ast_node_ptr prog = parser.parse_program();
+    if (!diagnostics.empty())
+    {
+        std::fprintf(stderr, "%s\n", diagnostics.front().to_string().c_str());
+        return 1;
+    }
+    const soto::resolve_result resolved = soto::resolve_program(*prog);
+    const soto::ast_node &workflow = *std::get<soto::program>(prog->node).declarations.back();
+
+    const mode_result tree = run(workflow, resolved, false);
+    const mode_result flat = run(workflow, resolved, true);
+    const bool ok = tree.gathered == flat.gathered && flat.gathered.as_array().size() == n_outer &&
+                    (n_outer == 0 || flat.gathered.as_array()[0].as_array().size() == n_inner);
+
+    std::printf("%zu x %zu nested scatter, %zu shards\n\n", n_outer, n_inner, flat.shards);
+    std::printf("%-10s %12s %12s %12s %12s %14s %10s\n", "", "expanded KB", "peak KB", "result KB", "allocs", "shards/s", "ms");
+    for (const auto &[name, r] : {std::pair<const char *, const mode_result &>{"tree", tree}, {"flattened", flat}})
+        std::printf("%-10s %12.1f %12.1f %12.1f %12llu %14.0f %10.1f\n", name, static_cast<double>(r.expanded) / 1024.0, static_cast<double>(r.peak_bytes) / 1024.0,
+                    static_cast<double>(r.retained) / 1024.0, static_cast<unsigned long long>(r.allocations), static_cast<double>(r.shards) / r.seconds, r.seconds * 1e3);
+    std::printf("\n%s\n", ok ? "both gathered the same Array[Array[File]]" : "MISMATCH");
+    return ok ? 0 : 1;
+}
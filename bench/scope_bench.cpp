@@ -0,0 +1,140 @@
+// scope_bench... looking names up by string through nested frames against the resolver's (depth, slot) refs
+//
+// usage: scope_bench [--inputs N] [--evals N]
+// a generated workflow: --inputs workflow inputs, a scatter with 20 declarations, an if inside it with 10 more,
+// and in there one declaration adding up names from all three frames plus the scatter variable. it's evaluated
+// --evals times against
+//   names   plain eval_scopes chained workflow -> scatter -> if, the tree as parsed
+//   slots   eval_scopes made from the resolver's frame layouts, the tree resolve_program rewrote
+// and prints ns per evaluation and per name looked up
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_resolve.h"
+
+static std::string generate(std::size_t inputs, std::size_t &names)
+{
+    std::string wdl = "version 1.0\nworkflow W {\n  input {\n";
+    for (std::size_t i = 0; i < inputs; ++i)
+        wdl += "    Int a" + std::to_string(i) + "\n";
+    wdl += "  }\n  scatter (s in range(10)) {\n";
+    for (int i = 0; i < 20; ++i)
+        wdl += "    Int b" + std::to_string(i) + " = s + " + std::to_string(i) + "\n";
+    wdl += "    if (s > 0) {\n";
+    for (int i = 0; i < 10; ++i)
+        wdl += "      Int c" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    // a few from each frame, the workflow's ones from across the whole input block
+    std::string sum = "s";
+    names = 1;
+    for (std::size_t i = 0; i < inputs; i += inputs / 8 ? inputs / 8 : 1, ++names)
+        sum += " + a" + std::to_string(i);
+    for (int i = 0; i < 20; i += 4, ++names)
+        sum += " + b" + std::to_string(i);
+    for (int i = 0; i < 10; i += 3, ++names)
+        sum += " + c" + std::to_string(i);
+    wdl += "      Int x = " + sum + "\n    }\n  }\n}\n";
+    return wdl;
+}
+
+// workflow -> scatter -> if -> the declaration of x
+struct nest
+{
+    soto::ast_node *workflow = nullptr;
+    soto::ast_node *scatter = nullptr;
+    soto::ast_node *cond = nullptr;
+    soto::ast_node_ptr *x = nullptr;
+};
+
+static soto::ast_node *first_of(soto::ast_node_ptr &body, soto::ast_node_type type)
+{
+    for (auto &s : std::get<soto::block>(body->node).statements)
+        if (s && s->type == type)
+            return s.get();
+    return nullptr;
+}
+
+static nest find_nest(soto::ast_node_ptr &prog)
+{
+    nest n;
+    n.workflow = std::get<soto::program>(prog->node).declarations.front().get();
+    for (auto &member : std::get<soto::class_decl>(n.workflow->node).members)
+        if (member && member->type == soto::N_SCATTER_STMT)
+            n.scatter = member.get();
+    n.cond = first_of(std::get<soto::scatter_stmt>(n.scatter->node).body, soto::N_IF_STMT);
+    for (auto &s : std::get<soto::block>(std::get<soto::if_stmt>(n.cond->node).then_->node).statements)
+        if (auto *var = std::get_if<soto::var_decl>(&s->node))
+            if (var->identifier->tok->lexeme == "x")
+                n.x = &var->initializer;
+    return n;
+}
+
+static void bind(soto::eval_scope &workflow, soto::eval_scope &scatter, soto::eval_scope &cond, std::size_t inputs)
+{
+    for (std::size_t i = 0; i < inputs; ++i)
+        workflow.set("a" + std::to_string(i), soto::wdl_value::integer(static_cast<std::int64_t>(i)));
+    scatter.set("s", soto::wdl_value::integer(3));
+    for (int i = 0; i < 20; ++i)
+        scatter.set("b" + std::to_string(i), soto::wdl_value::integer(3 + i));
+    for (int i = 0; i < 10; ++i)
+        cond.set("c" + std::to_string(i), soto::wdl_value::integer(i));
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_inputs = 200, n_evals = 1000000;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--inputs" && i + 1 < argc)
+            n_inputs = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--evals" && i + 1 < argc)
+            n_evals = std::strtoull(argv[++i], nullptr, 10);
+    }
+
+    std::size_t names = 0;
+    const std::string wdl = generate(n_inputs, names);
+    soto::parser by_name_parser{std::make_unique<soto::lexer>(wdl)};
+    soto::ast_node_ptr by_name = by_name_parser.parse_program();
+    soto::parser by_slot_parser{std::make_unique<soto::lexer>(wdl)};
+    soto::ast_node_ptr by_slot = by_slot_parser.parse_program();
+    soto::resolve_result resolved = soto::resolve_program(*by_slot);
+    std::printf("%zu frames, %zu declarations, %zu references resolved, %zu diagnostic(s)\n", resolved.frames, resolved.declarations,
+                resolved.references, resolved.diagnostics.size());
+
+    nest plain = find_nest(by_name), slotted = find_nest(by_slot);
+
+    soto::eval_scope name_workflow;
+    soto::eval_scope name_scatter(&name_workflow);
+    soto::eval_scope name_cond(&name_scatter);
+    bind(name_workflow, name_scatter, name_cond, n_inputs);
+
+    soto::eval_scope slot_workflow(resolved.layout_of(*slotted.workflow), nullptr);
+    soto::eval_scope slot_scatter(resolved.layout_of(*slotted.scatter), &slot_workflow);
+    soto::eval_scope slot_cond(resolved.layout_of(*slotted.cond), &slot_scatter);
+    bind(slot_workflow, slot_scatter, slot_cond, n_inputs);
+
+    auto time = [&](const soto::ast_node_ptr &expr, const soto::eval_scope &scope, std::int64_t &sum)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < n_evals; ++i)
+            sum += soto::evaluate(expr, scope).as_int();
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / static_cast<double>(n_evals);
+    };
+    std::int64_t by_name_sum = 0, by_slot_sum = 0;
+    const double name_ns = time(*plain.x, name_cond, by_name_sum);
+    const double slot_ns = time(*slotted.x, slot_cond, by_slot_sum);
+
+    std::printf("%zu workflow inputs, %zu names per evaluation, %zu evaluations\n\n", n_inputs, names, n_evals);
+    std::printf("%-8s %12s %12s\n", "lookup", "ns/eval", "ns/name");
+    std::printf("%-8s %12.1f %12.1f\n", "names", name_ns, name_ns / static_cast<double>(names));
+    std::printf("%-8s %12.1f %12.1f\n", "slots", slot_ns, slot_ns / static_cast<double>(names));
+    std::printf("\n%s (checksums %lld, %lld)\n", by_name_sum == by_slot_sum ? "same values" : "VALUES DIFFER",
+                static_cast<long long>(by_name_sum), static_cast<long long>(by_slot_sum));
+    return by_name_sum == by_slot_sum ? 0 : 1;
+}
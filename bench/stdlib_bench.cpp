@@ -0,0 +1,153 @@
+// stdlib_bench... the standard library builtins on cohort-sized inputs, one row per builtin
+//
+// usage: stdlib_bench [--lines N] [--files N] [--dir DIR] [--keep]
+// writes a --lines line text file / TSV / map file and --files small files under --dir, then times:
+//   read_lines, read_tsv, read_map   against std::getline over an ifstream doing the same splitting
+//   flatten, zip, cross               1000 x 1000 elements
+//   size                              an Array[File] of --files paths, each one listed twice
+//   sub                               100k file names, cached pattern against a std::regex built per call
+// per row: ms, ns per element and MB/s for the readers
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <regex>
+#include <string>
+#include <vector>
+#include "wdl_stdlib.h"
+
+namespace fs = std::filesystem;
+using soto::wdl_array;
+using soto::wdl_value;
+
+static double time_ms(const std::function<void()> &fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void row(const char *name, std::size_t elements, double ms, double mb = 0)
+{
+    std::printf("%-28s %10zu %10.2f %10.1f", name, elements, ms, ms * 1e6 / static_cast<double>(elements ? elements : 1));
+    if (mb > 0)
+        std::printf(" %10.0f", mb / (ms / 1e3));
+    std::printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_lines = 1000000, n_files = 2000;
+    fs::path dir = fs::temp_directory_path() / "wdlrunner_stdlib_bench";
+    bool keep = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--lines" && i + 1 < argc)
+            n_lines = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--files" && i + 1 < argc)
+            n_files = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--dir" && i + 1 < argc)
+            dir = argv[++i];
+        else if (arg == "--keep")
+            keep = true;
+    }
+    fs::create_directories(dir / "files");
+    soto::set_stdlib_write_dir((dir / "writes").string());
+
+    // a sample sheet sort of file... path, sample, read group, lane
+    const fs::path lines_path = dir / "lines.tsv", map_path = dir / "map.tsv";
+    {
+        std::ofstream lines(lines_path), map(map_path);
+        for (std::size_t i = 0; i < n_lines; ++i)
+        {
+            lines << "gs://bucket/cohort/SM-" << i << "/SM-" << i << ".bam\tSM-" << i << "\tRG" << i % 64 << "\tL" << i % 8 << "\n";
+            map << "SM-" << i << "\tgs://bucket/cohort/SM-" << i << ".bam\n";
+        }
+    }
+    std::vector<wdl_value> files;
+    for (std::size_t i = 0; i < n_files; ++i)
+    {
+        fs::path p = dir / "files" / ("f" + std::to_string(i));
+        std::ofstream(p) << std::string(i % 4096, 'x');
+        files.push_back(wdl_value::string(p.string(), soto::WT_FILE));
+        files.push_back(files.back());
+    }
+    const double lines_mb = fs::file_size(lines_path) / 1e6, map_mb = fs::file_size(map_path) / 1e6;
+    const wdl_value lines_file = wdl_value::string(lines_path.string(), soto::WT_FILE);
+    const wdl_value map_file = wdl_value::string(map_path.string(), soto::WT_FILE);
+
+    std::printf("%-28s %10s %10s %10s %10s\n", "builtin", "elements", "ms", "ns/elem", "MB/s");
+
+    std::size_t check = 0;
+    row("read_lines", n_lines, time_ms([&]
+                                       { check += soto::call_builtin("read_lines", {lines_file}).as_array().size(); }),
+        lines_mb);
+    row("  getline baseline", n_lines, time_ms([&]
+                                               {
+        std::ifstream in(lines_path);
+        wdl_array out;
+        for (std::string line; std::getline(in, line);)
+            out.push_back(wdl_value::string(line));
+        check += out.size(); }),
+        lines_mb);
+    row("read_tsv", n_lines, time_ms([&]
+                                     { check += soto::call_builtin("read_tsv", {lines_file}).as_array().size(); }),
+        lines_mb);
+    row("  getline baseline", n_lines, time_ms([&]
+                                               {
+        std::ifstream in(lines_path);
+        wdl_array out;
+        for (std::string line; std::getline(in, line);)
+        {
+            wdl_array fields;
+            std::size_t at = 0;
+            for (std::size_t tab; (tab = line.find('\t', at)) != std::string::npos; at = tab + 1)
+                fields.push_back(wdl_value::string(line.substr(at, tab - at)));
+            fields.push_back(wdl_value::string(line.substr(at)));
+            out.push_back(wdl_value::array(std::move(fields)));
+        }
+        check += out.size(); }),
+        lines_mb);
+    row("read_map", n_lines, time_ms([&]
+                                     { check += soto::call_builtin("read_map", {map_file}).as_map().size(); }),
+        map_mb);
+
+    wdl_array inner, outer;
+    for (int i = 0; i < 1000; ++i)
+        inner.push_back(wdl_value::integer(i));
+    const wdl_value ints = wdl_value::array(inner);
+    for (int i = 0; i < 1000; ++i)
+        outer.push_back(ints);
+    const wdl_value nested = wdl_value::array(outer);
+    wdl_value big = soto::call_builtin("flatten", {nested});
+    row("flatten 1000x1000", 1000000, time_ms([&]
+                                              { check += soto::call_builtin("flatten", {nested}).as_array().size(); }));
+    row("zip 1M", 1000000, time_ms([&]
+                                   { check += soto::call_builtin("zip", {big, big}).as_array().size(); }));
+    row("cross 1000x1000", 1000000, time_ms([&]
+                                            { check += soto::call_builtin("cross", {ints, ints}).as_array().size(); }));
+    row("size", files.size(), time_ms([&]
+                                      { check += static_cast<std::size_t>(soto::call_builtin("size", {wdl_value::array(files), wdl_value::string("KiB")}).as_float()); }));
+
+    std::vector<wdl_value> names;
+    for (int i = 0; i < 100000; ++i)
+        names.push_back(wdl_value::string("SM-" + std::to_string(i) + ".sorted.bam"));
+    const wdl_value pattern = wdl_value::string("\\.sorted\\.bam$"), replacement = wdl_value::string(".cram");
+    row("sub (cached pattern)", names.size(), time_ms([&]
+                                                       {
+        for (const wdl_value &name : names)
+            check += soto::call_builtin("sub", {name, pattern, replacement}).as_string().size(); }));
+    row("  regex per call", names.size(), time_ms([&]
+                                                  {
+        for (const wdl_value &name : names)
+            check += std::regex_replace(name.as_string(), std::regex(pattern.as_string(), std::regex::extended), replacement.as_string()).size(); }));
+
+    std::printf("\n(checksum %zu)\n", check);
+    if (!keep)
+        fs::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,145 @@
+// struct_bench... member access through the struct compiler's slots against looking members up by name
+//
+// usage: struct_bench [--fields N] [--reads N] [--evals N]
+// a generated workflow: a struct of --fields members, a declaration giving it a struct literal, and --reads
+// declarations each reading one member (spread over the struct, the last ones most). they're all evaluated
+// --evals times with
+//   layout   the tree compile_structs laid out, against the struct the literal built... an index
+//   checked  the same tree against the same members without the layout, the way a struct bound from JSON
+//            comes in... an index and a name compare
+//   names    the tree as parsed, member accesses with no slot... a search through the members by name
+// and prints ns per member read, plus what compile_structs found in the program and a literal it rejects
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "parser.h"
+#include "wdl_eval.h"
+#include "wdl_resolve.h"
+#include "wdl_struct.h"
+
+static std::string generate(std::size_t fields, std::size_t reads)
+{
+    static const char *types[] = {"String", "File", "Int", "Float", "Boolean"};
+    static const char *values[] = {"\"SM-1\"", "\"s.bam\"", "30", "0.5", "true"};
+    std::string wdl = "version 1.0\n\nstruct Sample {\n";
+    for (std::size_t f = 0; f < fields; ++f)
+        wdl += std::string("    ") + types[f % 5] + " field_" + std::to_string(f) + "\n";
+    wdl += "}\n\nworkflow W {\n    Sample s = {\n";
+    for (std::size_t f = 0; f < fields; ++f)
+        wdl += "        field_" + std::to_string(f) + ": " + values[f % 5] + (f + 1 < fields ? ",\n" : "\n");
+    wdl += "    }\n";
+    for (std::size_t r = 0; r < reads; ++r)
+    {
+        // r*r spreads them with more towards the end, where a search by name takes longest
+        const std::size_t f = fields - 1 - (r * r) % fields;
+        wdl += std::string("    ") + types[f % 5] + " read_" + std::to_string(r) + " = s.field_" + std::to_string(f) + "\n";
+    }
+    return wdl + "}\n";
+}
+
+struct parsed
+{
+public:
+    soto::ast_node_ptr prog;
+    soto::struct_result structs;
+    soto::resolve_result resolved;
+    soto::ast_node *workflow = nullptr;
+    soto::ast_node_ptr *literal = nullptr;
+    std::vector<soto::ast_node_ptr *> reads;
+};
+
+static parsed parse(const std::string &source, bool compile)
+{
+    parsed p;
+    std::vector<soto::parse_diagnostic> diagnostics;
+    soto::parser parser{std::make_unique<soto::lexer>(source), &diagnostics};
+    p.prog = parser.parse_program();
+    if (!diagnostics.empty())
+        throw std::runtime_error(diagnostics.front().message);
+    if (compile)
+        p.structs = soto::compile_structs(*p.prog);
+    p.resolved = soto::resolve_program(*p.prog);
+    for (auto &decl : std::get<soto::program>(p.prog->node).declarations)
+        if (decl && decl->type == soto::N_CLASS_DECL)
+            p.workflow = decl.get();
+    for (auto &member : std::get<soto::class_decl>(p.workflow->node).members)
+        if (auto *var = member ? std::get_if<soto::var_decl>(&member->node) : nullptr)
+        {
+            if (var->identifier->tok->lexeme == "s")
+                p.literal = &var->initializer;
+            else
+                p.reads.push_back(&var->initializer);
+        }
+    return p;
+}
+
+// evaluates every read --evals times with s bound to `sample`, returns ns per read
+static double run(const parsed &p, const soto::wdl_value &sample, std::size_t evals, std::size_t &checksum)
+{
+    soto::eval_scope scope(p.resolved.layout_of(*p.workflow), nullptr);
+    scope.set("s", sample);
+    auto t0 = std::chrono::steady_clock::now();
+    for (std::size_t e = 0; e < evals; ++e)
+        for (soto::ast_node_ptr *read : p.reads)
+            checksum += static_cast<std::size_t>(soto::evaluate(*read, scope).kind);
+    const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    return ns / static_cast<double>(evals * p.reads.size());
+}
+
+int main(int argc, char *argv[])
+{
+    std::size_t n_fields = 24, n_reads = 200, n_evals = 5000;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--fields" && i + 1 < argc)
+            n_fields = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--reads" && i + 1 < argc)
+            n_reads = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--evals" && i + 1 < argc)
+            n_evals = std::strtoull(argv[++i], nullptr, 10);
+    }
+    if (n_fields == 0)
+        n_fields = 1;
+
+    const std::string source = generate(n_fields, n_reads);
+    const parsed compiled = parse(source, true);
+    const parsed by_name = parse(source, false);
+
+    soto::eval_scope empty;
+    const soto::wdl_value sample = soto::evaluate(*compiled.literal, empty);
+    soto::wdl_object unlaid = sample.as_object();
+    unlaid.layout = nullptr;
+    const soto::wdl_value from_json = soto::wdl_value::object(std::move(unlaid));
+
+    std::size_t layout_sum = 0, checked_sum = 0, names_sum = 0;
+    const double layout_ns = run(compiled, sample, n_evals, layout_sum);
+    const double checked_ns = run(compiled, from_json, n_evals, checked_sum);
+    const double names_ns = run(by_name, sample, n_evals, names_sum);
+    const bool ok = layout_sum == checked_sum && layout_sum == names_sum && sample.as_object().members.size() == n_fields;
+
+    std::printf("struct of %zu members, %zu reads x %zu evals\n", n_fields, n_reads, n_evals);
+    std::printf("compile_structs: %zu struct(s), %zu literal(s), %zu member access(es) given a slot, %zu diagnostic(s)\n\n",
+                compiled.structs.layouts.size(), compiled.structs.literals, compiled.structs.accesses, compiled.structs.diagnostics.size());
+    std::printf("%-8s %10s\n", "", "ns/read");
+    std::printf("%-8s %10.1f\n", "layout", layout_ns);
+    std::printf("%-8s %10.1f\n", "checked", checked_ns);
+    std::printf("%-8s %10.1f\n", "names", names_ns);
+
+    // a literal that doesn't fit... caught before anything runs
+    const std::string bad = "version 1.0\nstruct Sample {\n  String id\n  File bam\n  Int? reads\n}\n"
+                            "workflow W {\n  Sample s = { id: \"a\", reads: 1, bam_file: \"a.bam\" }\n}\n";
+    std::vector<soto::parse_diagnostic> diagnostics;
+    soto::parser parser{std::make_unique<soto::lexer>(bad), &diagnostics};
+    soto::ast_node_ptr prog = parser.parse_program();
+    std::printf("\n");
+    for (const auto &d : soto::compile_structs(*prog).diagnostics)
+        std::printf("%s\n", d.to_string().c_str());
+    std::printf("\n%s\n", ok ? "all three read the same values" : "MISMATCH");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+// wdlgen... writes a synthetic WDL 1.0 workflow (plus its imports) for scale testing
+//
+// usage: wdlgen [--out DIR] [--name FILE] [--seed N] [--tasks N] [--calls N] [--imports N] [--tasks-per-import N]
+//               [--structs N] [--struct-members N] [--inputs N] [--outputs N] [--expr-depth N]
+//               [--scatter-depth N] [--calls-per-scatter N] [--command-lines N]
+// defaults are those of soto::wdl_gen_options. e.g. ~100k lines, 2.5k tasks, 3 nested scatters:
+//   wdlgen --out /tmp/big --tasks 2500 --scatter-depth 3 --imports 4
+// the same flags and seed always give the same files
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "wdl_generator.h"
+
+int main(int argc, char *argv[])
+{
+    soto::wdl_gen_options options;
+    std::string dir = ".";
+    std::string name = "generated.wdl";
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return 1;
+        }
+        std::string value = argv[++i];
+        std::size_t n = std::strtoull(value.c_str(), nullptr, 10);
+        if (arg == "--out")
+            dir = value;
+        else if (arg == "--name")
+            name = value;
+        else if (arg == "--seed")
+            options.seed = n;
+        else if (arg == "--tasks")
+            options.tasks = n;
+        else if (arg == "--calls")
+            options.calls = n;
+        else if (arg == "--imports")
+            options.imports = n;
+        else if (arg == "--tasks-per-import")
+            options.tasks_per_import = n;
+        else if (arg == "--structs")
+            options.structs = n;
+        else if (arg == "--struct-members")
+            options.struct_members = n;
+        else if (arg == "--inputs")
+            options.inputs_per_task = n;
+        else if (arg == "--outputs")
+            options.outputs_per_task = n;
+        else if (arg == "--expr-depth")
+            options.expr_depth = n;
+        else if (arg == "--scatter-depth")
+            options.scatter_depth = n;
+        else if (arg == "--calls-per-scatter")
+            options.calls_per_scatter = n;
+        else if (arg == "--command-lines")
+            options.command_lines = n;
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    soto::generated_wdl wdl = soto::generate_wdl(options);
+    soto::write_generated_wdl(wdl, dir, name);
+    std::printf("wrote %s/%s (+%zu import(s)): %zu lines, %.1f KB\n", dir.c_str(), name.c_str(), wdl.imports.size(),
+                wdl.lines, wdl.bytes / 1e3);
+    return 0;
+}
@@ -0,0 +1,401 @@
+// wdlrunner_bench... front-end throughput over the case-study corpus, to back the "faster WDL compiler" claim
+//
+// usage: wdlrunner_bench [--corpus DIR] [--scale 1,10,100] [--phase lex,parse,ast_dump] [--filter SUBSTR]
+//                        [--min-time SECONDS] [--min-iterations N] [--out results.json] [--label NAME]
+//                        [--gen-tasks 100,1000] [--gen-seed N] [--gen-scatter-depth N] [--gen-expr-depth N]
+// every .wdl under --corpus (default: the repo's case-study-examples) plus synthetic inputs made of the corpus's
+// tasks repeated --scale times, plus one wdl_generator workflow per --gen-tasks count (0 for none), through each phase:
+//   lex        lexer::lex() until T_EOF
+//   parse      lexer + parser::parse_program(), with the number of diagnostics it printed... a file that stops
+//              parsing properly half way is cheap to "parse", check that column before believing a speedup
+//   ast_dump   parser::print_ast_node() of an already parsed program, into a sink
+// per (input, phase): best and median wall time, MB/s, allocations of one iteration and peak RSS.
+// results go to --out as JSON, --label (a commit hash, say) is copied in so runs can be lined up across commits.
+// there's no type checker yet, typecheck is listed under "unavailable" until there is
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "json_writer.h"
+#include "lexer.h"
+#include "mem_report.h" // mem_heap, counted by src/mem_hooks.cpp which CMake links in
+#include "parser.h"
+#include "wdl_generator.h"
+
+#ifndef WDLRUNNER_CORPUS_DIR
+#define WDLRUNNER_CORPUS_DIR "case-study-examples"
+#endif
+
+namespace fs = std::filesystem;
+
+// swallows (and counts) what the parser prints... bytes for AST dumps, lines for diagnostics
+struct counting_sink : std::streambuf
+{
+public:
+    std::uint64_t bytes = 0;
+    std::uint64_t lines = 0;
+
+protected:
+    int overflow(int c) override
+    {
+        bytes++;
+        lines += c == '\n';
+        return c;
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        bytes += static_cast<std::uint64_t>(n);
+        lines += static_cast<std::uint64_t>(std::count(s, s + n, '\n'));
+        return n;
+    }
+};
+
+struct quiet
+{
+public:
+    quiet(counting_sink &out_sink, counting_sink &err_sink) : out(std::cout.rdbuf(&out_sink)), err(std::cerr.rdbuf(&err_sink)) {}
+    ~quiet()
+    {
+        std::cout.rdbuf(out);
+        std::cerr.rdbuf(err);
+    }
+
+private:
+    std::streambuf *out;
+    std::streambuf *err;
+};
+
+// peak RSS since the last reset... writing 5 to clear_refs resets VmHWM, without it this is the process-wide peak
+static void reset_peak_rss()
+{
+    std::ofstream clear("/proc/self/clear_refs");
+    if (clear)
+        clear << "5";
+}
+
+static long peak_rss_kb()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.rfind("VmHWM:", 0) == 0)
+            return std::stol(line.substr(6));
+    return -1;
+}
+
+static std::string read_source(const fs::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Failed to open file: " + path.string());
+    std::ostringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+struct bench_input
+{
+public:
+    std::string name;
+    std::string source;
+};
+
+// everything after the version line of every corpus file, `scale` times over, with each
+// task/workflow/struct renamed per copy so the result still reads like one big WDL file
+static bench_input synthetic_input(const std::vector<bench_input> &corpus, int scale)
+{
+    bench_input input;
+    input.name = "synthetic x" + std::to_string(scale);
+    input.source = "version 1.0\n";
+    for (int copy = 0; copy < scale; ++copy)
+    {
+        for (const auto &file : corpus)
+        {
+            std::istringstream lines(file.source);
+            std::string line;
+            while (std::getline(lines, line))
+            {
+                std::size_t start = line.find_first_not_of(" \t");
+                std::string_view rest = start == std::string::npos ? std::string_view() : std::string_view(line).substr(start);
+                if (rest.rfind("version", 0) == 0 || rest.rfind("import", 0) == 0)
+                    continue;
+                if (rest.rfind("task ", 0) == 0 || rest.rfind("workflow ", 0) == 0 || rest.rfind("struct ", 0) == 0)
+                {
+                    std::size_t brace = line.find('{');
+                    std::size_t end = line.find_last_not_of(" \t", brace == std::string::npos ? line.size() : brace - 1);
+                    line.insert(end + 1, "_" + std::to_string(copy));
+                }
+                input.source += line;
+                input.source += '\n';
+            }
+        }
+    }
+    return input;
+}
+
+struct phase_result
+{
+public:
+    std::string input;
+    std::string phase;
+    std::size_t bytes = 0;
+    std::size_t iterations = 0;
+    double best_seconds = 0;
+    double median_seconds = 0;
+    std::uint64_t allocations = 0; // of one iteration
+    std::uint64_t allocated_bytes = 0;
+    long peak_rss_kb = 0;
+    std::uint64_t units = 0; // tokens for lex, diagnostics for parse, output bytes for ast_dump
+    std::string error;
+};
+
+struct bench_options
+{
+public:
+    double min_time = 0.25;
+    std::size_t min_iterations = 3;
+};
+
+static phase_result run_phase(const bench_input &input, const std::string &phase, const bench_options &options,
+                              const std::function<std::uint64_t()> &iteration)
+{
+    phase_result result;
+    result.input = input.name;
+    result.phase = phase;
+    result.bytes = input.source.size();
+    std::vector<double> times;
+    reset_peak_rss();
+    try
+    {
+        double total = 0;
+        while (times.size() < options.min_iterations || total < options.min_time)
+        {
+            std::uint64_t allocs_before = soto::mem_heap.allocs.load(std::memory_order_relaxed);
+            std::uint64_t bytes_before = soto::mem_heap.bytes.load(std::memory_order_relaxed);
+            auto t0 = std::chrono::steady_clock::now();
+            result.units = iteration();
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (times.empty())
+            {
+                result.allocations = soto::mem_heap.allocs.load(std::memory_order_relaxed) - allocs_before;
+                result.allocated_bytes = soto::mem_heap.bytes.load(std::memory_order_relaxed) - bytes_before;
+            }
+            times.push_back(secs);
+            total += secs;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        result.error = e.what();
+    }
+    result.peak_rss_kb = peak_rss_kb();
+    result.iterations = times.size();
+    if (!times.empty())
+    {
+        std::sort(times.begin(), times.end());
+        result.best_seconds = times.front();
+        result.median_seconds = times[times.size() / 2];
+    }
+    return result;
+}
+
+static std::vector<std::string> split(const std::string &list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static void write_results(const std::string &path, const std::string &label, const std::string &corpus,
+                          const bench_options &options, const std::vector<phase_result> &results)
+{
+    soto::json_writer out(path, soto::JSON_PRETTY);
+    out.begin_object();
+    out.key("label").value(label);
+    out.key("timestamp").value(static_cast<std::int64_t>(std::time(nullptr)));
+    out.key("corpus").value(corpus);
+    out.key("min_time").value(options.min_time);
+    out.key("unavailable").begin_array().value("typecheck").end_array();
+    out.key("results").begin_array();
+    for (const auto &r : results)
+    {
+        out.begin_object();
+        out.key("input").value(r.input);
+        out.key("phase").value(r.phase);
+        out.key("bytes").value(static_cast<std::uint64_t>(r.bytes));
+        out.key("iterations").value(static_cast<std::uint64_t>(r.iterations));
+        out.key("best_seconds").value(r.best_seconds);
+        out.key("median_seconds").value(r.median_seconds);
+        out.key("mb_per_s").value(r.best_seconds > 0 ? r.bytes / 1e6 / r.best_seconds : 0.0);
+        out.key("allocations").value(r.allocations);
+        out.key("allocated_bytes").value(r.allocated_bytes);
+        out.key("peak_rss_kb").value(static_cast<std::int64_t>(r.peak_rss_kb));
+        if (r.phase == "lex")
+            out.key("tokens").value(r.units);
+        if (r.phase == "parse")
+            out.key("diagnostics").value(r.units);
+        if (r.phase == "ast_dump")
+            out.key("output_bytes").value(r.units);
+        if (!r.error.empty())
+            out.key("error").value(r.error);
+        out.end_object();
+    }
+    out.end_array();
+    out.end_object();
+    out.flush();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string corpus_dir = WDLRUNNER_CORPUS_DIR;
+    std::string out_path = "wdlrunner_bench.json";
+    std::string label;
+    std::string filter;
+    std::vector<std::string> phases = {"lex", "parse", "ast_dump"};
+    std::vector<int> scales = {1, 10, 100};
+    std::vector<std::size_t> gen_tasks = {100, 1000};
+    soto::wdl_gen_options gen; // imports stay 0, only the main file is benched
+    bench_options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--corpus" && i + 1 < argc)
+            corpus_dir = argv[++i];
+        else if (arg == "--scale" && i + 1 < argc)
+        {
+            scales.clear();
+            for (const auto &s : split(argv[++i]))
+                scales.push_back(std::stoi(s));
+        }
+        else if (arg == "--gen-tasks" && i + 1 < argc)
+        {
+            gen_tasks.clear();
+            for (const auto &s : split(argv[++i]))
+                gen_tasks.push_back(std::strtoull(s.c_str(), nullptr, 10));
+        }
+        else if (arg == "--gen-seed" && i + 1 < argc)
+            gen.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--gen-scatter-depth" && i + 1 < argc)
+            gen.scatter_depth = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--gen-expr-depth" && i + 1 < argc)
+            gen.expr_depth = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--phase" && i + 1 < argc)
+            phases = split(argv[++i]);
+        else if (arg == "--filter" && i + 1 < argc)
+            filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            options.min_time = std::stod(argv[++i]);
+        else if (arg == "--min-iterations" && i + 1 < argc)
+            options.min_iterations = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+        else if (arg == "--out" && i + 1 < argc)
+            out_path = argv[++i];
+        else if (arg == "--label" && i + 1 < argc)
+            label = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<bench_input> corpus;
+    for (const auto &entry : fs::recursive_directory_iterator(corpus_dir))
+        if (entry.is_regular_file() && entry.path().extension() == ".wdl")
+            corpus.push_back({fs::relative(entry.path(), corpus_dir).string(), read_source(entry.path())});
+    std::sort(corpus.begin(), corpus.end(), [](const bench_input &a, const bench_input &b)
+              { return a.name < b.name; });
+    if (corpus.empty())
+    {
+        std::fprintf(stderr, "No .wdl files under %s\n", corpus_dir.c_str());
+        return 1;
+    }
+
+    std::vector<bench_input> inputs = corpus;
+    for (int scale : scales)
+        if (scale > 0)
+            inputs.push_back(synthetic_input(corpus, scale));
+    for (std::size_t tasks : gen_tasks)
+    {
+        if (tasks == 0)
+            continue;
+        gen.tasks = tasks;
+        inputs.push_back({"generated tasks=" + std::to_string(tasks) + " seed=" + std::to_string(gen.seed),
+                          soto::generate_wdl(gen).main});
+    }
+
+    std::printf("%-58s %-9s %8s %6s %10s %10s %9s %12s %11s %8s\n", "input", "phase", "KB", "iters", "best ms", "median ms",
+                "MB/s", "allocs", "peak RSS MB", "errors");
+    std::vector<phase_result> results;
+    counting_sink sink;
+    counting_sink diagnostics;
+    for (const auto &input : inputs)
+    {
+        if (!filter.empty() && input.name.find(filter) == std::string::npos)
+            continue;
+        for (const auto &phase : phases)
+        {
+            phase_result r;
+            if (phase == "lex")
+            {
+                r = run_phase(input, phase, options, [&]()
+                              {
+                                  quiet q(sink, diagnostics);
+                                  soto::lexer lexer{input.source};
+                                  std::uint64_t tokens = 0;
+                                  while (lexer.lex().kind != soto::T_EOF)
+                                      tokens++;
+                                  return tokens; });
+            }
+            else if (phase == "parse")
+            {
+                r = run_phase(input, phase, options, [&]()
+                              {
+                                  quiet q(sink, diagnostics);
+                                  std::uint64_t before = diagnostics.lines;
+                                  soto::parser parser{std::make_unique<soto::lexer>(input.source)};
+                                  soto::ast_node_ptr prog = parser.parse_program();
+                                  return diagnostics.lines - before; });
+            }
+            else if (phase == "ast_dump")
+            {
+                quiet q(sink, diagnostics);
+                soto::parser parser{std::make_unique<soto::lexer>(input.source)};
+                soto::ast_node_ptr prog = parser.parse_program();
+                r = run_phase(input, phase, options, [&]()
+                              {
+                                  std::uint64_t before = sink.bytes;
+                                  parser.print_ast_node(prog, 0);
+                                  return sink.bytes - before; });
+            }
+            else
+            {
+                std::fprintf(stderr, "Unknown phase: %s (have lex, parse, ast_dump)\n", phase.c_str());
+                return 1;
+            }
+            std::string errors = r.phase == "parse" ? std::to_string(r.units) : "";
+            std::printf("%-58s %-9s %8.1f %6zu %10.3f %10.3f %9.2f %12llu %11.1f %8s%s%s\n", r.input.c_str(), r.phase.c_str(),
+                        r.bytes / 1e3, r.iterations, r.best_seconds * 1e3, r.median_seconds * 1e3,
+                        r.best_seconds > 0 ? r.bytes / 1e6 / r.best_seconds : 0.0, static_cast<unsigned long long>(r.allocations),
+                        r.peak_rss_kb / 1024.0, errors.c_str(), r.error.empty() ? "" : "  error: ", r.error.c_str());
+            std::fflush(stdout);
+            results.push_back(std::move(r));
+        }
+    }
+
+    write_results(out_path, label, corpus_dir, options, results);
+    std::printf("results written to %s\n", out_path.c_str());
+    return 0;
+}
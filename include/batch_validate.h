@@ -0,0 +1,47 @@
+#ifndef BATCH_VALIDATE_H
+#define BATCH_VALIDATE_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace soto
+{
+
+    struct batch_file_result
+    {
+    public:
+        std::string path;                     // canonical
+        std::string imported_by;              // first file that imported it, empty if it was asked for directly
+        bool requested = false;
+        std::size_t bytes = 0;
+        std::vector<std::string> diagnostics; // parser errors, or the one reason it couldn't be read
+    };
+
+    struct batch_report
+    {
+    public:
+        std::vector<batch_file_result> files; // sorted by path
+        std::size_t requested = 0;
+        std::size_t bytes = 0;
+        std::size_t diagnostics = 0;
+        std::size_t files_with_diagnostics = 0;
+        unsigned threads = 1;
+        double wall_ms = 0;
+
+        bool ok() const { return diagnostics == 0; }
+    };
+
+    // directories (recursively, .wdl only), shell globs and plain files -> canonical paths, sorted, no duplicates
+    std::vector<std::string> expand_wdl_paths(const std::vector<std::string> &args);
+
+    // lexes and parses every file plus whatever they import, each distinct file exactly once, on `threads`
+    // threads (0 = one per core)... a library imported by fifty workflows is parsed once, not fifty times
+    batch_report validate_batch(const std::vector<std::string> &paths, unsigned threads = 0);
+
+    void write_batch_report_text(const batch_report &report, std::ostream &out);
+    void write_batch_report_json(const batch_report &report, const std::string &path); // throws std::runtime_error
+
+}
+
+#endif // BATCH_VALIDATE_H
@@ -0,0 +1,73 @@
+#ifndef CALL_CACHE_H
+#define CALL_CACHE_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "file_hash.h"
+#include "localizer.h"
+#include "parser.h"
+
+namespace soto
+{
+
+    // everything that goes into a call's cache key besides the task itself...
+    // values are the evaluated inputs in their canonical text form (name -> value)
+    // files are File inputs (name -> local path), these are keyed by CONTENT not by path...
+    struct call_cache_inputs
+    {
+        std::map<std::string, std::string> values;
+        std::vector<std::pair<std::string, std::string>> files;
+    };
+
+    // one row of the cache index... a finished call and where its outputs live
+    struct call_cache_entry
+    {
+        std::string key;
+        std::string call_dir;
+        std::vector<std::pair<std::string, std::string>> outputs; // output name -> path of the produced file/value
+    };
+
+    // content-addressed call cache...
+    // the index is a plain append-only file under <root>/ so there's nothing to install,
+    // it is loaded once at startup and looked up in memory after that...
+    struct call_cache
+    {
+    public:
+        explicit call_cache(const std::string &root);
+        call_cache() = delete;
+        ~call_cache() = default;
+
+        // key = task AST (command, runtime, outputs, private decls) + input values + content hash of input files
+        std::string make_key(const ast_node_ptr &task, const call_cache_inputs &inputs);
+
+        const call_cache_entry *lookup(const std::string &key) const;
+        void store(const call_cache_entry &entry);
+
+        // put a hit's outputs into dest_dir (reflink/hardlink where we can, copy otherwise)
+        // returns the outputs with their new paths, or false if any of the cached files is gone...
+        bool restore(const call_cache_entry &entry, const std::string &dest_dir, std::vector<std::pair<std::string, std::string>> &restored);
+
+        // hash many files at once, in parallel, skipping anything the memo already knows...
+        std::vector<std::string> hash_files(const std::vector<std::string> &paths) { return hasher.hash_all(paths); }
+
+        std::size_t size() const { return index.size(); }
+
+    private:
+        std::string root;
+        std::string index_path;
+        std::unordered_map<std::string, call_cache_entry> index;
+        file_hasher hasher;
+        localizer links;
+
+        void load_index();
+    };
+
+    // canonical text form of a task's AST... whitespace, comments and source positions don't survive this...
+    std::string normalize_task_ast(const ast_node_ptr &task);
+
+}
+
+#endif // CALL_CACHE_H
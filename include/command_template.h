@@ -0,0 +1,81 @@
+#ifndef COMMAND_TEMPLATE_H
+#define COMMAND_TEMPLATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "parser.h"
+#include "wdl_eval.h"
+
+namespace soto
+{
+
+    // one piece of a placeholder's value... a "-L " + intervals is two of them, written one after the other
+    // straight into the command instead of concatenated into a temporary first
+    struct placeholder_term
+    {
+    public:
+        enum term_kind
+        {
+            PT_TEXT, // a string literal without placeholders of its own
+            PT_NAME, // a plain identifier, looked up in the scope without evaluating anything
+            PT_PATH, // runtime_params.command_mem, pair.left... a name and its members, walked without copying
+            PT_EXPR, // anything else, evaluated
+        };
+        term_kind kind = PT_EXPR;
+        std::string text;              // PT_TEXT's text, PT_NAME's and PT_PATH's name
+        std::vector<std::string> path; // PT_PATH's members
+        const ast_node *expr = nullptr; // PT_EXPR's and PT_PATH's, somewhere inside its placeholder's expr
+        const ast_node *name = nullptr; // PT_NAME's and PT_PATH's identifier... read through its slot once the resolver rewrote it
+    };
+
+    struct command_placeholder
+    {
+    public:
+        std::string source;                // what was between ~{ and }, for messages
+        ast_node_ptr expr;                 // the whole expression, the terms point into it
+        std::vector<placeholder_term> terms; // one, or a string concatenation; any None term makes the whole value None
+        bool has_sep = false;
+        std::string sep;
+        bool has_true_false = false;
+        std::string if_true, if_false;
+        bool has_default = false;
+        std::string default_value;
+    };
+
+    // a command section compiled once: literal byte ranges of the (dedented) text and the placeholders between
+    // them with their options and parsed expressions. render() resolves every placeholder, works out the exact
+    // size of the command, then writes it into one buffer... so each shard of a scatter costs one allocation,
+    // none when the caller hands the same string back to render_into()
+    struct command_template
+    {
+    public:
+        struct part
+        {
+        public:
+            std::uint32_t begin = 0; // literal text [begin, end) ...
+            std::uint32_t end = 0;
+            int placeholder = -1; // ...then this placeholder, -1 for literal text alone
+        };
+
+        std::string text;
+        std::vector<part> parts;
+        std::vector<command_placeholder> placeholders;
+        std::size_t literal_bytes = 0;
+        std::size_t expr_terms = 0; // PT_EXPR and PT_PATH terms, each may need a value of its own per render
+
+        // ~{} placeholders always, ${} too unless this is a <<< >>> command (where ${} is the shell's).
+        // dedent strips the whitespace every line has in common, and the blank first and last lines, like WDL does.
+        // throws std::runtime_error on an unterminated placeholder or one whose expression doesn't parse
+        static command_template compile(std::string_view body, bool dollar_placeholders, bool dedent = true);
+        static command_template from_command(const command_decl &command);
+
+        std::string render(const eval_scope &scope) const;
+        void render_into(const eval_scope &scope, std::string &out) const; // throws std::runtime_error, like evaluate()
+    };
+
+}
+
+#endif // COMMAND_TEMPLATE_H
@@ -0,0 +1,93 @@
+#ifndef FILE_HASH_H
+#define FILE_HASH_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace soto
+{
+
+    // xxh64 of a buffer... fast, non-cryptographic, good enough to tell a BAM from another BAM
+    std::uint64_t xxh64(const void *data, std::size_t len, std::uint64_t seed = 0);
+
+    // 16 hex chars of xxh64 of the string, used for cache keys and the likes...
+    std::string hash_string(const std::string &data);
+
+    // (device, inode, size, mtime) of a file the last time we hashed it...
+    // if none of these changed, we trust the old content hash and skip the re-read
+    struct file_stamp
+    {
+        std::uint64_t device;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t mtime_ns;
+
+        bool operator==(const file_stamp &o) const
+        {
+            return device == o.device && inode == o.inode && size == o.size && mtime_ns == o.mtime_ns;
+        }
+    };
+
+    struct file_stamp_hash
+    {
+        std::size_t operator()(const file_stamp &s) const noexcept
+        {
+            return xxh64(&s, sizeof(s));
+        }
+    };
+
+    bool stat_file(const std::string &path, file_stamp &stamp);
+
+    // content hashing of (big) files...
+    // a file is cut into fixed CHUNK_SIZE chunks, every chunk is hashed on its own (in parallel),
+    // and the file digest is the hash over the chunk digests + the file size. chunk size is fixed
+    // so the digest never depends on how many threads did the work...
+    // results are memoized in <memo_path> keyed by file_stamp, so an unchanged file is never re-read.
+    struct file_hasher
+    {
+    public:
+        static constexpr std::size_t CHUNK_SIZE = 8u << 20; // 8MiB
+        // files open (and mapped) at once... an Array[File] of thousands would run out of descriptors
+        static constexpr std::size_t OPEN_FILES = 256;
+
+        // empty memo_path = in-memory memo only...
+        explicit file_hasher(const std::string &memo_path = "", unsigned threads = 0);
+        ~file_hasher() = default;
+        file_hasher(const file_hasher &) = delete;
+        file_hasher &operator=(const file_hasher &) = delete;
+
+        std::string hash(const std::string &path);
+        // all files in one go, chunks of every file are spread over the same worker pool...
+        std::vector<std::string> hash_all(const std::vector<std::string> &paths);
+
+        // hash without looking at (or filling) the memo... the benchmark uses this. OPEN_FILES files at a time,
+        // the chunks of those spread over the pool
+        std::vector<std::string> hash_uncached(const std::vector<std::string> &paths);
+
+        // rewrite the memo file with only the live entries, once stale rows pile up...
+        void compact();
+
+        std::size_t memo_hits() const { return hits; }
+        std::size_t bytes_hashed() const { return bytes; }
+
+    private:
+        std::string memo_path;
+        unsigned threads;
+        std::unordered_map<file_stamp, std::string, file_stamp_hash> memo;
+        std::size_t stale_rows = 0;
+        std::atomic<std::size_t> hits{0};  // hash_all() can run on several threads at once,
+        std::atomic<std::size_t> bytes{0}; // these are bumped outside memo_mutex
+        std::mutex memo_mutex;
+
+        void load_memo();
+        void append_memo(const std::vector<std::pair<file_stamp, std::string>> &rows);
+    };
+
+}
+
+#endif // FILE_HASH_H
@@ -0,0 +1,113 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace soto
+{
+
+    enum journal_record_kind : std::uint8_t
+    {
+        J_RUN = 1,      // a run (or resumed run) started, carries the workflow digest
+        J_CALL_START,   // call_id started executing
+        J_CALL_FINISH,  // call_id finished, outputs + cache key are final
+        J_CALL_FAILED,  // call_id failed with exit_code, it re-runs on resume
+    };
+
+    struct journal_record
+    {
+        journal_record_kind kind = J_CALL_START;
+        std::string call_id; // e.g. CNVSomaticPairWorkflow.CallCopyRatioSegmentsTumor or ...Mutect2.M2[12] for shards
+        int exit_code = 0;
+        std::string cache_key;
+        std::vector<std::pair<std::string, std::string>> outputs;
+        std::string workflow_digest;
+    };
+
+    enum call_state
+    {
+        CALL_STARTED,
+        CALL_FINISHED,
+        CALL_FAILED,
+    };
+
+    struct journal_call
+    {
+        call_state state = CALL_STARTED;
+        int exit_code = 0;
+        std::string cache_key;
+        std::vector<std::pair<std::string, std::string>> outputs;
+    };
+
+    // what a journal says happened... rebuilt by replaying it front to back, last record per call wins
+    struct journal_state
+    {
+        std::string workflow_digest;
+        std::unordered_map<std::string, journal_call> calls;
+        std::size_t records = 0;
+        std::uint64_t valid_bytes = 0; // everything after this is a torn write from the crash
+        bool torn_tail = false;
+
+        bool is_finished(const std::string &call_id) const
+        {
+            auto it = calls.find(call_id);
+            return it != calls.end() && it->second.state == CALL_FINISHED;
+        }
+        std::size_t count(call_state state) const;
+    };
+
+    // append-only execution journal with group commit...
+    // append() only queues the record, one flusher thread writes out EVERYTHING queued so far with a
+    // single write() + fdatasync(), so a thousand short tasks finishing together cost one fsync, not a thousand.
+    // records are framed (length + checksum) so a crash mid-write is detected and cut off on the next open.
+    struct journal
+    {
+    public:
+        // resume=false starts a fresh journal, resume=true keeps the valid prefix and appends to it
+        // max_delay lets the flusher wait a little for more records before it fsyncs, 0 = only batch what piled up meanwhile
+        journal(const std::string &path, bool resume, std::chrono::microseconds max_delay = std::chrono::microseconds(0));
+        ~journal(); // everything appended gets flushed before we go
+        journal(const journal &) = delete;
+        journal &operator=(const journal &) = delete;
+
+        static journal_state replay(const std::string &path);
+
+        // returns the record's sequence number, durable once sync(seq) returns...
+        std::uint64_t append(const journal_record &record);
+        void sync(std::uint64_t seq);
+        void sync_all();
+
+        std::uint64_t fsync_count();
+        const journal_state &recovered() const { return state; }
+
+    private:
+        std::string path;
+        int fd = -1;
+        std::chrono::microseconds max_delay;
+        journal_state state; // what was there when we opened it (resume only)
+
+        std::mutex mutex;
+        std::condition_variable pending_cv;
+        std::condition_variable durable_cv;
+        std::string pending; // encoded frames waiting for the flusher
+        std::uint64_t appended_seq = 0;
+        std::uint64_t durable_seq = 0;
+        std::uint64_t fsyncs = 0;
+        std::string write_error;
+        bool stopping = false;
+        std::thread flusher;
+
+        void flush_loop();
+    };
+
+}
+
+#endif // JOURNAL_H
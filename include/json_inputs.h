@@ -0,0 +1,61 @@
+#ifndef JSON_INPUTS_H
+#define JSON_INPUTS_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "parser.h"
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    // one declared input of a workflow, straight out of its input { } block
+    struct workflow_input
+    {
+        std::string name;
+        wdl_type type;
+        bool has_default = false;
+        int line = 0; // where the declaration is in the WDL source
+    };
+
+    // struct name -> its members in declaration order
+    using struct_table = std::unordered_map<std::string, std::vector<std::pair<std::string, wdl_type>>>;
+
+    struct input_error
+    {
+        std::string key;     // where in the JSON... W.normal_bams[3], W.sample.bam, ...
+        std::string message;
+        std::size_t json_line = 0; // 0 when it isn't about a spot in the JSON, e.g. a missing input
+        std::size_t json_column = 0;
+        int decl_line = 0; // the input declaration the value was checked against, 0 if none
+    };
+
+    struct bound_inputs
+    {
+        std::string workflow;
+        std::unordered_map<std::string, wdl_value> values; // input name -> value, only what the JSON set
+        std::vector<input_error> errors;
+        std::vector<std::string> ignored_keys; // call-level keys (W.call.input), not bound yet
+        bool ok() const { return errors.empty(); }
+    };
+
+    // workflow by name, or the first workflow in the program when name is empty... nullptr if none
+    const ast_node *find_workflow(const ast_node_ptr &program, const std::string &name = "");
+    std::vector<workflow_input> collect_workflow_inputs(const ast_node_ptr &program, const ast_node &workflow); // program for the line numbers
+    struct_table collect_structs(const ast_node_ptr &program);
+
+    // binds an inputs JSON straight into typed values for the declared inputs...
+    // the JSON is mmapped and walked once, values are built as they're read, no DOM in between.
+    // type errors are collected (not thrown) against the input declarations, syntax errors stop the walk
+    bound_inputs bind_inputs(std::string_view json, const std::string &workflow, const std::vector<workflow_input> &inputs, const struct_table &structs);
+    bound_inputs bind_inputs_json(const std::string &json_path, const ast_node_ptr &program, const std::string &workflow = "");
+
+    // inputs.json:12:5: W.normal_bams[3]: expected File, got number (declared at line 8)
+    std::string format_input_error(const input_error &error, const std::string &json_path);
+
+}
+
+#endif // JSON_INPUTS_H
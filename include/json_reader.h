@@ -0,0 +1,46 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace soto
+{
+
+    enum json_kind
+    {
+        JN_NULL,
+        JN_BOOL,
+        JN_NUMBER,
+        JN_STRING,
+        JN_ARRAY,
+        JN_OBJECT,
+    };
+
+    // small JSON tree for protocol messages (LSP and friends)... inputs files don't come through here,
+    // json_inputs.cpp binds those straight out of the text without building anything
+    struct json_node
+    {
+    public:
+        json_kind kind = JN_NULL;
+        bool boolean = false;
+        double number = 0;
+        std::string text;                                        // JN_STRING
+        std::vector<json_node> items;                            // JN_ARRAY
+        std::vector<std::pair<std::string, json_node>> members; // JN_OBJECT, in document order
+
+        // a shared null node for anything missing, so lookups chain: msg["params"]["textDocument"]["uri"]
+        const json_node &operator[](std::string_view key) const;
+        bool has(std::string_view key) const;
+        std::string str(const std::string &fallback = "") const { return kind == JN_STRING ? text : fallback; }
+        std::int64_t integer(std::int64_t fallback = 0) const { return kind == JN_NUMBER ? static_cast<std::int64_t>(number) : fallback; }
+    };
+
+    json_node parse_json(std::string_view text); // throws std::runtime_error on malformed input
+
+}
+
+#endif // JSON_READER_H
@@ -0,0 +1,82 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    enum json_style
+    {
+        JSON_COMPACT, // no whitespace at all
+        JSON_PRETTY,  // two-space indent, one member/element per line
+    };
+
+    // streaming JSON writer... whatever is written goes out on flush(), all it keeps is a small
+    // buffer and the nesting stack, so a document with 50k calls in it never exists in memory as a whole.
+    // a file being written is a valid JSON PREFIX at every flush, that's what lets tooling tail it
+    struct json_writer
+    {
+    public:
+        json_writer(const std::string &path, json_style style = JSON_PRETTY, std::size_t buffer_bytes = 64u << 10); // throws std::runtime_error
+        explicit json_writer(std::string &target, json_style style = JSON_COMPACT);                                  // into a string, nothing to flush
+        ~json_writer(); // flushes, the document is left as far as it got
+        json_writer(const json_writer &) = delete;
+        json_writer &operator=(const json_writer &) = delete;
+
+        json_writer &begin_object();
+        json_writer &end_object();
+        json_writer &begin_array();
+        json_writer &end_array();
+        json_writer &key(std::string_view name);
+
+        json_writer &value(std::string_view s);
+        json_writer &value(const char *s) { return value(std::string_view(s)); }
+        json_writer &value(const std::string &s) { return value(std::string_view(s)); }
+        json_writer &value(std::int64_t i);
+        json_writer &value(int i) { return value(static_cast<std::int64_t>(i)); }
+        json_writer &value(std::uint64_t i);
+        json_writer &value(double d); // NaN and infinities come out as null, JSON has no spelling for them
+        json_writer &value(bool b);
+        json_writer &null();
+        json_writer &value(const wdl_value &v); // Pair as {"left", "right"}, Map keys as strings, the way Cromwell writes them
+
+        void flush();
+        std::size_t depth() const { return stack.size(); }
+        std::uint64_t bytes_written() const { return target ? target->size() : written + buf.size(); }
+
+    private:
+        struct frame
+        {
+            bool is_object;
+            bool has_items = false;
+        };
+
+        int fd = -1;
+        std::string path;
+        std::string *target = nullptr;
+        std::string buf;
+        std::size_t buffer_bytes = 0;
+        json_style style;
+        std::vector<frame> stack;
+        bool after_key = false;
+        std::uint64_t written = 0;
+
+        std::string &sink() { return target ? *target : buf; }
+        void before_value();
+        void newline_indent();
+        void append_string(std::string_view s);
+        void maybe_flush()
+        {
+            if (fd >= 0 && buf.size() >= buffer_bytes)
+                flush();
+        }
+    };
+
+}
+
+#endif // JSON_WRITER_H
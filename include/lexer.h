@@ -2,6 +2,7 @@
 #define LEXER_H
 #include <string>
 #include <iostream>
+#include "source_lines.h"
 #include "token.h"
 
 namespace soto
@@ -15,8 +16,7 @@ namespace soto
         unsigned char c_char;
         unsigned char n_char;
         std::string source;
-        std::shared_ptr<int> line; // this is for line and col tracking... if you ask me, just for nice error reporting or whatever or maybe it may help linters for our language in the future...
-        std::shared_ptr<int> column;
+        std::shared_ptr<const source_lines> lines; // line starts of `source`, built once... tokens keep offsets into it
 
         lexer(std::string);
         lexer() = default;
@@ -24,6 +24,7 @@ namespace soto
 
         // important instance methods....
         token lex();
+        token peek(); // lex() without moving... saves and restores the cursor instead of copying the whole source
         void next_token();
         void consume_whitespace();
         void skip_comments();
@@ -45,7 +46,6 @@ namespace soto
         static bool is_newline_char(unsigned char);
         bool is_unicode(const char &);
         bool is_char_a_valid_ident_elem(char32_t);
-        std::string canonicalize_source_str(const std::string &);
     };
 
 }
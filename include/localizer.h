@@ -0,0 +1,100 @@
+#ifndef LOCALIZER_H
+#define LOCALIZER_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace soto
+{
+
+    // how a file made it into (or out of) a call directory... in order of preference
+    enum localize_strategy
+    {
+        L_REFLINK,  // FICLONE, shares extents, copy-on-write (btrfs, xfs, ...)
+        L_HARDLINK, // same inode, only on the same filesystem
+        L_SYMLINK,  // pointer back at the original
+        L_COPY,     // the slow path, bytes actually move...
+        L_FAILED,
+    };
+
+    inline const char *localize_strategy_to_string(localize_strategy s)
+    {
+        switch (s)
+        {
+        case L_REFLINK:
+            return "reflink";
+        case L_HARDLINK:
+            return "hardlink";
+        case L_SYMLINK:
+            return "symlink";
+        case L_COPY:
+            return "copy";
+        default:
+            return "failed";
+        }
+    }
+
+    // what a filesystem (device) lets us do, probed once per device and cached...
+    struct fs_capabilities
+    {
+        bool reflink = false;
+        bool hardlink = false;
+        bool symlink = false;
+    };
+
+    struct localizer_options
+    {
+        bool allow_symlink = true; // docker backends can't follow links that point outside the mount, they turn this off
+        bool allow_reflink = true;
+        bool allow_hardlink = true;
+    };
+
+    // per-call report... how long it took and what strategy each file ended up with
+    struct localize_report
+    {
+        double seconds = 0;
+        std::size_t counts[L_FAILED + 1] = {0};
+        std::vector<std::string> paths; // localized path for each input, same order as given
+    };
+
+    // puts File inputs into call directories without copying when we can get away with it
+    // chain is reflink -> hardlink -> symlink -> copy, anything the destination filesystem
+    // can't do is skipped up front using the cached capabilities...
+    struct localizer
+    {
+    public:
+        // work_root is probed right away, that's where all call dirs live...
+        explicit localizer(const std::string &work_root, localizer_options options = {});
+        localizer() = delete;
+        ~localizer() = default;
+
+        // src -> dest (full path of the new file), an existing dest is replaced only once the new one is there
+        localize_strategy localize(const std::string &src, const std::string &dest);
+        // outputs leaving a call dir for the final output dir... same chain minus symlinks,
+        // a link into a call dir dangles as soon as that call dir is cleaned up
+        localize_strategy delocalize(const std::string &src, const std::string &dest);
+
+        // all inputs of one call into call_dir/inputs/<basename>, timed...
+        localize_report localize_call(const std::vector<std::string> &inputs, const std::string &call_dir);
+
+        fs_capabilities capabilities_of(const std::string &dir);
+
+    private:
+        localizer_options options;
+        std::unordered_map<std::uint64_t, fs_capabilities> caps; // device -> what works there
+        std::mutex caps_mutex;
+
+        fs_capabilities capabilities_of(std::uint64_t dev, const std::string &dir);
+        localize_strategy place(const std::string &src, const std::string &dest, bool allow_symlink);
+        static fs_capabilities probe(const std::string &dir);
+    };
+
+    // the copy fallback on its own, in-kernel (copy_file_range) where available...
+    bool copy_file_contents(const std::string &src, const std::string &dest);
+
+}
+
+#endif // LOCALIZER_H
@@ -0,0 +1,95 @@
+#ifndef LSP_SERVER_H
+#define LSP_SERVER_H
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "file_hash.h"
+#include "json_reader.h"
+#include "parser.h"
+
+namespace soto
+{
+
+    // one parse of one chunk's text... shared by every document (and every version of one) that has the same chunk
+    struct lsp_parsed_chunk
+    {
+    public:
+        std::string text;
+        ast_node_ptr program;
+        std::vector<parse_diagnostic> diagnostics; // lines relative to the chunk, 1-based like the parser's
+    };
+
+    // the unit of incremental reparsing: one top-level task/workflow/struct and whatever trails it up to the
+    // next one, or the header (version, imports, anything before the first declaration). an edit inside a task
+    // re-parses that task, every other chunk is found unchanged in the cache by its text
+    struct lsp_chunk
+    {
+    public:
+        std::size_t begin = 0; // byte offsets into the document
+        std::size_t end = 0;
+        std::string keyword;   // task / workflow / struct, empty for the header
+        std::string name;
+        std::size_t name_offset = 0;
+        std::shared_ptr<const lsp_parsed_chunk> parsed;
+    };
+
+    struct lsp_document
+    {
+    public:
+        std::string uri;
+        std::string path;
+        std::int64_t version = 0;
+        std::string text;
+        std::vector<std::size_t> line_starts;
+        std::vector<lsp_chunk> chunks;
+        file_stamp stamp{}; // only for files read from disk, open documents are whatever the editor says
+    };
+
+    // `wdlrunner lsp`... a language server over stdio (JSON-RPC with Content-Length framing).
+    // diagnostics on open/change, document symbols, go-to-definition for calls, imports and declarations,
+    // hover with declared types and task signatures. positions are UTF-16 code units as LSP wants them.
+    // the symbol index is every open document plus the imports they reach, read from disk on demand
+    struct lsp_server
+    {
+    public:
+        lsp_server(std::istream &in, std::ostream &out);
+        int run(); // until `exit`, returns the exit code the spec asks for
+
+        void handle(const json_node &message); // one decoded message, replies go to `out`
+
+    private:
+        std::istream &in;
+        std::ostream &out;
+        bool shutdown_requested = false;
+        bool exit_requested = false;
+
+        std::unordered_map<std::string, lsp_document> open; // by uri
+        std::unordered_map<std::string, lsp_document> disk; // by canonical path, reloaded when stat_file() disagrees
+        std::unordered_map<std::uint64_t, std::weak_ptr<const lsp_parsed_chunk>> chunk_cache;
+        std::uint64_t chunks_parsed = 0;
+        std::uint64_t chunks_reused = 0;
+        std::int64_t last_update_us = 0;
+
+        bool read_message(std::string &body);
+        void send(const std::string &body);
+        void reply(const json_node &id, const std::string &result_json);
+        void reply_error(const json_node &id, int code, const std::string &message);
+
+        void update(lsp_document &doc);
+        void publish_diagnostics(const lsp_document &doc);
+        const lsp_document *document_for_path(const std::string &path);
+        const lsp_document *document_for_uri(const std::string &uri);
+
+        std::string document_symbols(const lsp_document &doc);
+        std::string definition(const lsp_document &doc, std::size_t offset);
+        std::string hover(const lsp_document &doc, std::size_t offset);
+    };
+
+}
+
+#endif // LSP_SERVER_H
@@ -0,0 +1,30 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace soto
+{
+
+    // read-only mmap of a whole file... for inputs JSON, read_lines() and friends where we scan once
+    // front to back and don't want a second copy of a 100 MB file on the heap
+    struct mapped_file
+    {
+    public:
+        explicit mapped_file(const std::string &path); // throws std::runtime_error
+        ~mapped_file();
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        std::string_view view() const { return {data, size}; }
+
+    private:
+        const char *data = nullptr;
+        std::size_t size = 0;
+    };
+
+}
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,118 @@
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "parser.h"
+
+namespace soto
+{
+
+    // heap counters... only move when the counting operator new/delete in src/mem_hooks.cpp is linked in
+    // (-DWDLRUNNER_MEM_HOOKS=ON), otherwise they stay 0 and the report only has the structural numbers below
+    struct mem_counters
+    {
+    public:
+        std::atomic<std::uint64_t> allocs{0};
+        std::atomic<std::uint64_t> frees{0};
+        std::atomic<std::uint64_t> bytes{0}; // allocated, ever
+        std::atomic<std::uint64_t> live{0};  // allocated - freed
+        std::atomic<std::uint64_t> peak{0};  // max of live since the last mem_reset_peak()
+    };
+    extern mem_counters mem_heap;
+    extern bool mem_hooks_active; // set by mem_hooks.cpp's static init
+
+    inline void mem_note_alloc(std::size_t n)
+    {
+        mem_heap.allocs.fetch_add(1, std::memory_order_relaxed);
+        mem_heap.bytes.fetch_add(n, std::memory_order_relaxed);
+        std::uint64_t live = mem_heap.live.fetch_add(n, std::memory_order_relaxed) + n;
+        std::uint64_t peak = mem_heap.peak.load(std::memory_order_relaxed);
+        while (live > peak && !mem_heap.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            ;
+    }
+    inline void mem_note_free(std::size_t n)
+    {
+        mem_heap.frees.fetch_add(1, std::memory_order_relaxed);
+        mem_heap.live.fetch_sub(n, std::memory_order_relaxed);
+    }
+    void mem_reset_peak();
+
+    struct mem_phase_stats
+    {
+    public:
+        std::string name;
+        std::uint64_t allocs = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t peak = 0;    // highest live bytes reached above where the phase started
+        std::int64_t retained = 0; // live bytes the phase left behind (the AST for parse, say)
+    };
+
+    // what the token stream costs if every token of the file is held at once, which is what
+    // the lexeme/literal layout in token.h decides... distinct_* is what interning the lexemes would keep
+    struct token_stream_stats
+    {
+    public:
+        std::size_t tokens = 0;
+        std::size_t token_bytes = 0;   // sizeof(token) each
+        std::size_t lexeme_bytes = 0;  // heap behind lexemes too long for the small-string buffer
+        std::size_t literal_bytes = 0; // the shared_ptr'd int_val/float_val boxes
+        std::size_t lexeme_chars = 0;
+        std::size_t distinct_lexemes = 0;
+        std::size_t distinct_lexeme_chars = 0;
+    };
+
+    // the same for a parsed program, every node reachable from the root counted once
+    struct ast_stats
+    {
+    public:
+        std::size_t nodes = 0;
+        std::size_t node_bytes = 0;   // sizeof(ast_node) each, the variant is as big as its largest alternative
+        std::size_t vector_bytes = 0; // capacity of the child vectors
+        std::size_t tokens = 0;       // distinct token objects hanging off nodes (tok, op, version_number)
+        std::size_t token_bytes = 0;  // those tokens plus the ones literal_expr holds by value
+        std::size_t string_bytes = 0; // lexeme heap of all of them
+        std::map<std::string, std::size_t> by_type; // node count per ast_node_type
+    };
+
+    token_stream_stats account_token_stream(const std::string &source);
+    ast_stats account_ast(const ast_node_ptr &root);
+
+    // collects the phases and the structural numbers for --mem-report
+    struct mem_report
+    {
+    public:
+        std::vector<mem_phase_stats> phases;
+        token_stream_stats token_stream;
+        ast_stats ast;
+        bool has_tokens = false;
+        bool has_ast = false;
+
+        void print(std::ostream &out) const;
+    };
+
+    // RAII, one row of the report per scope... phases must not nest, each one resets the peak.
+    // a null report makes it a no-op so call sites don't need an if
+    struct mem_phase
+    {
+    public:
+        mem_phase(mem_report *report, const char *name);
+        ~mem_phase();
+        mem_phase(const mem_phase &) = delete;
+        mem_phase &operator=(const mem_phase &) = delete;
+
+    private:
+        mem_report *report;
+        const char *name;
+        std::uint64_t allocs0 = 0;
+        std::uint64_t bytes0 = 0;
+        std::uint64_t live0 = 0;
+    };
+
+}
+
+#endif // MEM_REPORT_H
@@ -1,9 +1,11 @@
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <string>
 #include "token.h"
 #include <variant>
 #include "lexer.h"
+#include "wdl_value.h"
 
 #include <optional>
 
@@ -61,6 +63,9 @@ namespace soto
         N_SCATTER_STMT,
         N_STRUCT_DECL,
         N_PAIR,
+        N_CONSTANT, // an expression folded down to its value (wdl_fold.h)
+        N_INDEX,    // xs[i], m["key"]
+        N_STRUCT_LITERAL, // a map literal laid out as the struct it's declared as (wdl_struct.h)
     };
 
     inline const char *ast_node_type_to_string(ast_node_type type)
@@ -154,6 +159,12 @@ namespace soto
             return "N_STRUCT_DECL";
         case N_PAIR:
             return "N_PAIR"; // this is WDL's tuple type...
+        case N_CONSTANT:
+            return "N_CONSTANT";
+        case N_INDEX:
+            return "N_INDEX";
+        case N_STRUCT_LITERAL:
+            return "N_STRUCT_LITERAL";
 
         default:
             return "UNKNOWN AST_NODE_TYPE";
@@ -170,6 +181,7 @@ namespace soto
         ast_node_ptr version;
         std::vector<ast_node_ptr> imports;
         std::vector<ast_node_ptr> declarations;
+        std::shared_ptr<const source_lines> lines; // the lexer's, so token offsets in this tree still mean something after it's gone
     };
 
     struct input_decl
@@ -177,10 +189,15 @@ namespace soto
         ast_node_ptr body;
         std::vector<ast_node_ptr> members;
     };
+    struct command_template; // command_template.h
+
     struct command_decl
     {
         ast_node_ptr body;                   // body text...a stringLiteral...of the command String...
         std::vector<ast_node_ptr> arguments; // arguments to the command ~{nameOfVariable}...
+        bool heredoc = true;                 // command <<< >>>, where ${} is the shell's... command { } takes ${} as a placeholder too
+        // compiled once by the resolver (wdl_resolve.h), its placeholders' names rewritten to slots... null until then
+        std::shared_ptr<const command_template> compiled;
     };
     struct output_decl
     {
@@ -208,6 +225,11 @@ namespace soto
         ast_node_ptr first;
         ast_node_ptr second;
     };
+    struct index_expr
+    {
+        ast_node_ptr collection;
+        ast_node_ptr index;
+    };
     struct runtime_decl
     {
         std::vector<std::tuple<ast_node_ptr, ast_node_ptr>> members; // runtime members (identifier, value (expr))
@@ -226,10 +248,16 @@ namespace soto
     //     std::vector<std::tuple<ast_node_ptr, ast_node_ptr>> arguments;
     // };
 
+    struct struct_layout; // wdl_struct.h
+
     struct member_access
     {
         ast_node_ptr object;
         ast_node_ptr member;
+        // left by the struct compiler when it knows `object` is a struct: its layout, and the slot of the member
+        // named right after the '.'
+        std::shared_ptr<const struct_layout> layout;
+        std::uint32_t field = 0;
     };
     struct call_decl
     {
@@ -327,6 +355,35 @@ namespace soto
         ast_node_ptr version;
         std::shared_ptr<token> version_number;
     };
+    // what the folder leaves in place of an expression it could work out without any inputs... tok is the
+    // replaced expression's, so errors still point somewhere
+    struct constant_expr
+    {
+        wdl_value value;
+    };
+    struct frame_layout; // wdl_eval.h
+
+    // what the resolver (wdl_resolve.h) leaves on an identifier it found the declaration of: slot `slot` of
+    // `frame`, which is `depth` frames out from where the name is used. tok still has the name
+    struct slot_ref
+    {
+        std::shared_ptr<const frame_layout> frame;
+        std::uint32_t depth = 0;
+        std::uint32_t slot = 0;
+    };
+    // what the resolver leaves on a string literal with placeholders ("~{sample}.bam"): its template, compiled
+    // once instead of per evaluation, with the placeholders' names rewritten to slots. tok still has the text
+    struct interpolation
+    {
+        std::shared_ptr<const command_template> compiled;
+    };
+    // what the struct compiler (wdl_struct.h) leaves in place of a map literal declared as a struct: the member
+    // values in the layout's slot order, nullptr for an optional member the literal leaves out
+    struct struct_expr
+    {
+        std::shared_ptr<const struct_layout> layout;
+        std::vector<ast_node_ptr> values;
+    };
     struct assign_expr
     {
         ast_node_ptr left;
@@ -367,12 +424,30 @@ namespace soto
                      map_expr,
                      scatter_stmt,
                      struct_decl,
-                     pair_expr
+                     pair_expr,
+                     constant_expr,
+                     slot_ref,
+                     index_expr,
+                     struct_expr,
+                     interpolation
 
                      >
             node;
     };
 
+    // one parser error... to_string() is the "[ERROR] [line N] at 'x': message" line printed to stderr
+    struct parse_diagnostic
+    {
+    public:
+        int line = 0;   // 1-based
+        int column = 0; // 1-based, in bytes
+        std::string lexeme; // the token it's at, empty at the end of the file and for lexer errors
+        bool at_end = false;
+        std::string message;
+
+        std::string to_string() const;
+    };
+
     struct parser
     {
     public:
@@ -381,17 +456,21 @@ namespace soto
         std::shared_ptr<token> prev_tok;
         std::optional<token> next_tok;
         bool error_state;
+        std::vector<parse_diagnostic> *diagnostics = nullptr; // when set, errors land here instead of on stderr
 
         // constructor
         parser(std::unique_ptr<lexer>);
+        parser(std::unique_ptr<lexer>, std::vector<parse_diagnostic> *diagnostics);
 
         ast_node_ptr parse_program();
+        ast_node_ptr parse_standalone_expr(); // one expression and then the end of the input, e.g a placeholder's
         void print_ast_node(const ast_node_ptr &, int indent);
         void write_ast_node_to_file(const ast_node_ptr &, const std::string &, int indent);
 
         // helper methods...
     private:
         void read_token_or_emit_error();
+        void skip_if_stuck(const std::shared_ptr<token> &before);
         token next_token();
         bool peek_token(const token_kind &);
         void emit_error(const std::string &, const token &);
@@ -406,6 +485,7 @@ namespace soto
         ast_node_ptr parse_class_decl();
         ast_node_ptr parse_struct_decl();
         ast_node_ptr parse_var_decl();
+        std::string parse_type_params(const std::string &);
         ast_node_ptr parse_block();
         ast_node_ptr parse_stmt();
         ast_node_ptr parse_scatter_stmt();
@@ -427,6 +507,7 @@ namespace soto
         ast_node_ptr parse_term_expr();
         ast_node_ptr parse_factor_expr();
 
+        ast_node_ptr parse_postfix_expr(); // a primary and its [index]es
         ast_node_ptr parse_primary_expr();
 
         ast_node_ptr parse_call_statement();
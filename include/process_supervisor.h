@@ -0,0 +1,111 @@
+#ifndef PROCESS_SUPERVISOR_H
+#define PROCESS_SUPERVISOR_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace soto
+{
+
+    // keeps only the LAST capacity bytes written to it... for error messages,
+    // the full log is on disk already. storage is allocated on first write so idle streams cost nothing
+    struct tail_buffer
+    {
+    public:
+        explicit tail_buffer(std::size_t capacity = 0) : capacity(capacity) {}
+
+        void append(const char *data, std::size_t len);
+        std::string str() const;
+        std::size_t size() const { return wrapped ? capacity : end; }
+
+    private:
+        std::size_t capacity;
+        std::unique_ptr<char[]> ring;
+        std::size_t end = 0; // next write position
+        bool wrapped = false;
+    };
+
+    // what to run... the command goes to bash -c as is, the way WDL command blocks expect
+    struct process_spec
+    {
+        std::string command;
+        std::string working_dir;
+        std::string stdout_path; // these are what stdout()/stderr() hand back to the workflow
+        std::string stderr_path;
+    };
+
+    struct process_result
+    {
+        std::uint64_t id = 0;
+        int pid = -1;
+        int exit_code = -1;  // -1 when killed by a signal
+        int term_signal = 0; // signal number, if any
+        double seconds = 0;
+        long max_rss_kb = 0; // peak RSS of the biggest process in the task
+        double user_seconds = 0;
+        double system_seconds = 0;
+        std::uint64_t stdout_bytes = 0;
+        std::uint64_t stderr_bytes = 0;
+        std::string stdout_tail;
+        std::string stderr_tail;
+        std::string error; // spawn failed, nothing ran...
+    };
+
+    // runs task commands and captures their output...
+    // ONE thread, one epoll set for every running child: stdout/stderr pipes and a pidfd per child.
+    // output goes to the stdout/stderr files through a per-stream write buffer, only a bounded tail is
+    // kept in memory, so a wide scatter of chatty GATK tools costs (write buffer + tail) per RUNNING child.
+    struct process_supervisor
+    {
+    public:
+        explicit process_supervisor(std::size_t tail_bytes = 16u << 10, std::size_t write_buffer_bytes = 64u << 10);
+        ~process_supervisor(); // kills whatever is still running and reaps it
+        process_supervisor(const process_supervisor &) = delete;
+        process_supervisor &operator=(const process_supervisor &) = delete;
+
+        // on_exit runs on the supervisor thread, keep it short... a spawn that fails gets there too, with
+        // result.error set, never on the caller's thread
+        std::uint64_t spawn(const process_spec &spec, std::function<void(const process_result &)> on_exit = nullptr);
+        process_result wait(std::uint64_t id);
+        std::size_t running();
+
+        struct child;  // one spawned process and its two streams, see process_supervisor.cpp
+        struct stream; // one captured pipe
+
+    private:
+        std::size_t tail_bytes;
+        std::size_t write_buffer_bytes;
+        int epoll_fd = -1;
+        int wake_fd = -1;
+        bool stopping = false;
+        std::thread io_thread;
+
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        std::uint64_t next_id = 1;
+        std::unordered_map<std::uint64_t, std::unique_ptr<child>> children;
+        std::unordered_map<std::uint64_t, process_result> finished;
+        std::vector<std::unique_ptr<child>> retired; // io thread only
+        std::vector<child *> unreaped;               // io thread only, pipes closed and no pidfd to say it exited
+        std::vector<std::pair<std::function<void(const process_result &)>, process_result>> unspawned; // for the io thread's on_exit
+
+        void loop();
+        void on_readable(stream &s);
+        void on_exited(child &c);
+        void maybe_finish(child &c);
+        void reap_unreaped();
+        void wake();
+        static void raise_fd_limit();
+    };
+
+}
+
+#endif // PROCESS_SUPERVISOR_H
@@ -0,0 +1,105 @@
+#ifndef RUN_METADATA_H
+#define RUN_METADATA_H
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "json_writer.h"
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    enum call_status
+    {
+        CS_DONE,
+        CS_FAILED,
+        CS_ABORTED,
+    };
+
+    inline const char *call_status_to_string(call_status status)
+    {
+        switch (status)
+        {
+        case CS_DONE:
+            return "Done";
+        case CS_FAILED:
+            return "Failed";
+        case CS_ABORTED:
+            return "Aborted";
+        default:
+            return "Unknown";
+        }
+    }
+
+    // everything we know about one finished call, i.e one element of "calls" in the metadata
+    struct call_metadata
+    {
+        std::string name; // W.T, or the alias it was called as
+        int shard = -1;   // -1 outside a scatter
+        int attempt = 1;
+        call_status status = CS_DONE;
+        int return_code = -1;
+        bool cache_hit = false;
+        std::string cache_key;
+        std::string call_root;
+        std::string stdout_path;
+        std::string stderr_path;
+        double start = 0; // unix time, seconds
+        double end = 0;
+        long max_rss_kb = 0; // straight from process_result
+        double user_seconds = 0;
+        double system_seconds = 0;
+        std::vector<std::pair<std::string, wdl_value>> outputs;
+    };
+
+    // metadata.json, written as the run goes...
+    // {"workflowName", "id", "start", "calls": [ one object per call, appended as it finishes ], "end", "status"}
+    // every call is on disk by the time call_finished returns, so `tail -f` shows progress and memory stays
+    // flat no matter how many calls there are. calls is a flat array rather than Cromwell's name -> [shards] map,
+    // grouping would mean holding on to them until the end
+    struct metadata_writer
+    {
+    public:
+        metadata_writer(const std::string &path, const std::string &workflow, const std::string &run_id, json_style style = JSON_PRETTY);
+        ~metadata_writer(); // a run that never called finish() is written out as Aborted
+        metadata_writer(const metadata_writer &) = delete;
+        metadata_writer &operator=(const metadata_writer &) = delete;
+
+        void call_finished(const call_metadata &call); // safe from any thread
+        void finish(const std::string &status);         // "Succeeded", "Failed", ...
+        std::size_t calls_written();
+
+    private:
+        std::mutex mutex;
+        json_writer out;
+        bool finished = false;
+        std::size_t calls = 0;
+    };
+
+    // outputs.json... {"outputs": {"W.x": value, ...}, "id": run_id}, each output written as soon as it's known
+    struct outputs_writer
+    {
+    public:
+        outputs_writer(const std::string &path, const std::string &run_id, json_style style = JSON_PRETTY);
+        ~outputs_writer();
+        outputs_writer(const outputs_writer &) = delete;
+        outputs_writer &operator=(const outputs_writer &) = delete;
+
+        void output(const std::string &name, const wdl_value &value); // safe from any thread
+        void finish();
+
+    private:
+        std::mutex mutex;
+        json_writer out;
+        std::string run_id;
+        bool finished = false;
+    };
+
+    // 2024-05-01T12:34:56.789Z
+    std::string iso8601_utc(double unix_seconds);
+
+}
+
+#endif // RUN_METADATA_H
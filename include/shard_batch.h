@@ -0,0 +1,81 @@
+#ifndef SHARD_BATCH_H
+#define SHARD_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "call_cache.h"
+#include "parser.h"
+#include "process_supervisor.h"
+#include "wdl_eval.h"
+
+namespace soto
+{
+
+    // how the shards of one scatter's task go to processes... a process per shard unless asked otherwise, by the
+    // task (`batch_shards: 50` in its runtime section) or by whoever runs it
+    struct batch_policy
+    {
+    public:
+        std::size_t shards_per_batch = 1; // consecutive shards one worker runs, 1 is a process per shard
+        std::size_t parallel = 0;         // processes running at once, 0 for one per hardware thread
+
+        bool enabled() const { return shards_per_batch > 1; }
+    };
+
+    // `fallback` with shards_per_batch from the task's `batch_shards` runtime attribute, when it has one...
+    // evaluated in `scope`, throws std::runtime_error when it isn't a positive Int
+    batch_policy batch_policy_of(const runtime_decl &runtime, const eval_scope &scope, const batch_policy &fallback = {});
+
+    // one shard's call, as it would be spawned on its own: command, call dir, stdout/stderr paths
+    struct batch_shard
+    {
+    public:
+        process_spec spec;
+        std::string cache_key; // empty when it isn't cached
+        std::vector<std::pair<std::string, std::string>> outputs; // name -> path, what the cache keeps when it succeeds
+    };
+
+    struct batch_shard_result
+    {
+    public:
+        int exit_code = -1; // -1 when it never ran, the worker died first
+        double seconds = 0;
+        bool cached = false; // restored from the call cache, not run
+        std::uint64_t stdout_bytes = 0;
+        std::uint64_t stderr_bytes = 0;
+        std::string stderr_tail; // of a shard that failed
+        std::vector<std::pair<std::string, std::string>> outputs; // a cache hit's, where they were restored to
+        std::string error;
+    };
+
+    struct batch_stats
+    {
+    public:
+        std::size_t processes = 0; // spawned, workers and lone shards
+        std::size_t shards_run = 0;
+        std::size_t cache_hits = 0;
+        std::size_t failed = 0;
+        std::size_t stored = 0; // cache entries written
+    };
+
+    // runs one task's shards through `supervisor`. shards the cache already has are restored into their call
+    // dir and don't run. with batching on, each shards_per_batch consecutive ones that are left go to one
+    // worker: a script in `batch_dir` that runs them in turn, each in a subshell of its own in its call dir
+    // with its own stdout/stderr files, as if it had been spawned alone... a shard's exit
+    // doesn't stop the ones after it, and one the worker never got to (killed, say) comes back with -1 and an
+    // error so it can be run again. either way, every shard that exits 0 gets its cache entry.
+    // results are in the order of `shards`
+    std::vector<batch_shard_result> run_shards(process_supervisor &supervisor, const std::vector<batch_shard> &shards, const batch_policy &policy,
+                                               const std::string &batch_dir, call_cache *cache = nullptr, batch_stats *stats = nullptr);
+
+    // the worker script for the shards at `which`... a line per shard, it prints `shard <i> <rc> <start> <end>`
+    // after each, i being the shard's index in `shards`. it's plain sh, sourced with `.` by whichever shell
+    // the supervisor has
+    std::string batch_script(const std::vector<batch_shard> &shards, const std::vector<std::size_t> &which);
+
+}
+
+#endif // SHARD_BATCH_H
@@ -0,0 +1,29 @@
+#ifndef SOURCE_LINES_H
+#define SOURCE_LINES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace soto
+{
+
+    // where every line of a source starts, built once per file... tokens only carry a byte offset and
+    // line/column are looked up here (binary search) when a diagnostic actually needs them
+    struct source_lines
+    {
+    public:
+        std::vector<std::uint32_t> starts; // starts[0] == 0, one entry per line
+
+        source_lines() : starts{0} {}
+        explicit source_lines(std::string_view source);
+
+        int line_of(std::size_t offset) const;   // 1-based
+        int column_of(std::size_t offset) const; // 1-based, in bytes
+        int lines() const { return static_cast<int>(starts.size()); }
+    };
+
+}
+
+#endif // SOURCE_LINES_H
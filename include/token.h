@@ -219,12 +219,11 @@ namespace soto
     {
     public:
         token_kind kind;
+        int offset = 0; // byte offset of the lexeme in the lexer's source... lexer::lines turns it into line/column
         std::string lexeme;
         std::shared_ptr<token> next;
         std::shared_ptr<int> int_val;
         std::shared_ptr<double> float_val;
-        int line; // current line this token is in..
-        int column;
 
         token(token_kind kind, const std::string &literal) : kind(kind), lexeme(literal), next(nullptr), int_val(nullptr), float_val(nullptr) {}
         token(token_kind kind, const std::string &literal, int int_val) : kind(kind), lexeme(literal), next(nullptr), int_val(std::make_shared<int>(int_val)), float_val(nullptr) {}
@@ -240,7 +239,7 @@ namespace soto
 
     inline std::ostream &operator<<(std::ostream &os, const token &tok)
     {
-        os << "token(kind=" << token_kind_to_string(tok.kind) << ", lexeme=\"" << tok.lexeme << "\"" << ", line=" << tok.line << ", column=" << tok.column;
+        os << "token(kind=" << token_kind_to_string(tok.kind) << ", lexeme=\"" << tok.lexeme << "\"" << ", offset=" << tok.offset;
 
         if (tok.int_val)
         {
@@ -0,0 +1,75 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace soto
+{
+
+    // where the time goes... scoped begin/end events into per-thread buffers, exported as
+    // Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+    // off by default, an idle WDL_TRACE_SCOPE is one relaxed load + never-taken branch going in and a
+    // never-taken branch on a local coming out, no clock reads, no stores anywhere shared.
+    // build with -DWDLRUNNER_TRACING=OFF and the macros are gone altogether
+    extern std::atomic<bool> tracing_enabled;
+
+    inline std::uint64_t trace_now_ns()
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now().time_since_epoch())
+                                              .count());
+    }
+
+    void trace_start();                                  // clears nothing, just starts recording from here
+    void trace_stop();
+    void trace_thread_name(const std::string &name);    // shows up as the track name in the viewer
+    void trace_record(const char *name, std::uint64_t begin_ns, std::uint64_t end_ns, std::string_view detail = {});
+    bool trace_write_chrome_json(const std::string &path); // false when the file can't be written
+    std::size_t trace_event_count();
+
+    struct trace_scope
+    {
+    public:
+        explicit trace_scope(const char *name) : name(name)
+        {
+            if (__builtin_expect(tracing_enabled.load(std::memory_order_relaxed), 0))
+                begin = trace_now_ns();
+        }
+        // the detail (a file name, a task) has to outlive the scope, it's only copied when tracing is on
+        trace_scope(const char *name, std::string_view detail) : name(name), detail(detail)
+        {
+            if (__builtin_expect(tracing_enabled.load(std::memory_order_relaxed), 0))
+                begin = trace_now_ns();
+        }
+        ~trace_scope()
+        {
+            if (__builtin_expect(begin != 0, 0))
+                trace_record(name, begin, trace_now_ns(), detail);
+        }
+        trace_scope(const trace_scope &) = delete;
+        trace_scope &operator=(const trace_scope &) = delete;
+
+    private:
+        const char *name;
+        std::string_view detail;
+        std::uint64_t begin = 0;
+    };
+
+}
+
+#define WDL_TRACE_CONCAT_(a, b) a##b
+#define WDL_TRACE_CONCAT(a, b) WDL_TRACE_CONCAT_(a, b)
+
+#ifdef WDLRUNNER_TRACING
+#define WDL_TRACE_SCOPE(name) soto::trace_scope WDL_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define WDL_TRACE_SCOPE_DETAIL(name, detail) soto::trace_scope WDL_TRACE_CONCAT(trace_scope_, __LINE__)(name, detail)
+#else
+#define WDL_TRACE_SCOPE(name) ((void)0)
+#define WDL_TRACE_SCOPE_DETAIL(name, detail) ((void)0)
+#endif
+
+#endif // TRACE_H
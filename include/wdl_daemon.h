@@ -0,0 +1,70 @@
+#ifndef WDL_DAEMON_H
+#define WDL_DAEMON_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "wdl_module.h"
+
+namespace soto
+{
+
+    // parsed modules by canonical path... a hit costs one stat(), a changed stamp reparses that one file only
+    struct module_cache
+    {
+    public:
+        std::shared_ptr<const wdl_module> get(const std::string &canonical_path, bool &was_cached); // throws like load_wdl_module
+        void clear() { modules.clear(); }
+        std::size_t size() const { return modules.size(); }
+
+        std::uint64_t hits = 0;
+        std::uint64_t loads = 0; // first loads and reloads of changed files
+
+    private:
+        std::unordered_map<std::string, std::shared_ptr<const wdl_module>> modules;
+    };
+
+    // `wdlrunner --serve <socket>`... a long-lived process on a unix socket that keeps modules parsed between
+    // requests, so a gateway validating the same workflows (and the task libraries they all import) over and
+    // over only pays for what changed. one request per line, one compact JSON object per line back:
+    //   validate <wdl>               parse the file and everything it imports, diagnostics for all of them
+    //   inputs <wdl> <inputs.json>   validate, then bind and type-check the inputs JSON against the workflow
+    //   stats | flush | shutdown
+    // single-threaded on purpose, requests are mostly cache hits and the cache needs no locking that way
+    struct wdl_daemon
+    {
+    public:
+        explicit wdl_daemon(const std::string &socket_path); // throws std::runtime_error
+        ~wdl_daemon();                                       // closes and unlinks the socket
+        wdl_daemon(const wdl_daemon &) = delete;
+        wdl_daemon &operator=(const wdl_daemon &) = delete;
+
+        void serve(); // until `shutdown`, SIGINT or SIGTERM
+        std::string handle(const std::string &request); // one request line -> one response line (no '\n')
+
+    private:
+        struct client
+        {
+            int fd = -1;
+            std::string in;
+        };
+
+        std::string socket_path;
+        int listen_fd = -1;
+        int epoll_fd = -1;
+        int signal_fd = -1;
+        bool stopping = false;
+        module_cache cache;
+        std::uint64_t requests = 0;
+        std::unordered_map<int, client> clients;
+
+        void accept_clients();
+        void read_client(client &c);
+        void drop_client(int fd);
+    };
+
+}
+
+#endif // WDL_DAEMON_H
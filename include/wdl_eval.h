@@ -0,0 +1,102 @@
+#ifndef WDL_EVAL_H
+#define WDL_EVAL_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    // the names of one frame (a task, a workflow, a scatter or if body) in slot order... built by the resolver
+    // (wdl_resolve.h), which points every identifier it resolves at one of these slots
+    struct frame_layout
+    {
+    public:
+        std::vector<std::string> names;
+        std::unordered_map<std::string, std::uint32_t> index;
+
+        std::uint32_t add(const std::string &name); // the slot it already has when it's there twice
+        const std::uint32_t *find(const std::string &name) const;
+        std::size_t size() const { return names.size(); }
+    };
+
+    // where a slot is at... a deferred one has a declaration that hasn't been asked for yet, and is evaluated
+    // (once) the first time something reads it
+    enum slot_state : std::uint8_t
+    {
+        SLOT_EMPTY, // a slot nothing was set in yet isn't None, it's not there
+        SLOT_DEFERRED,
+        SLOT_EVALUATING, // being evaluated right now... reading it again means it depends on itself
+        SLOT_BOUND,
+    };
+
+    // the names bound while evaluating... one frame per scope (task, workflow, scatter body) chained to its
+    // parent, lookups walk the chain innermost first. a frame made from a frame_layout keeps its values in
+    // slots, and an identifier the resolver rewrote to a slot_ref is read straight out of them.
+    // a slot can also be given its declaration instead of a value (defer()), it's evaluated against the frame
+    // that declared it the first time anything reads it and the value kept from then on... so a declaration
+    // nothing asks for costs nothing, and one every shard of a scatter reads is evaluated once per workflow.
+    // frames aren't thread-safe... reading a deferred slot writes it, const or not, and that includes the
+    // parents a lookup walks into. a chain with anything still deferred belongs to one thread at a time
+    struct eval_scope
+    {
+    public:
+        const eval_scope *parent = nullptr;
+        std::unordered_map<std::string, wdl_value> values;
+        std::shared_ptr<const frame_layout> layout;
+        mutable std::vector<wdl_value> slots;
+        mutable std::vector<slot_state> state;
+        std::vector<const ast_node *> initializers; // of the deferred slots, empty until something's deferred
+        mutable std::size_t deferred = 0;  // declarations handed to defer()
+        mutable std::size_t evaluated = 0; // of those, how many something asked for
+
+        eval_scope() = default;
+        explicit eval_scope(const eval_scope *parent) : parent(parent) {}
+        eval_scope(std::shared_ptr<const frame_layout> layout, const eval_scope *parent);
+
+        const wdl_value *find(const std::string &name) const; // nullptr when nothing in the chain has it
+        // nullptr when the chain isn't laid out the way the resolver saw it... the caller looks the name up instead
+        const wdl_value *at(const slot_ref &ref) const;
+        void set(const std::string &name, wdl_value value);
+        void set_slot(std::uint32_t slot, wdl_value value)
+        {
+            slots[slot] = std::move(value);
+            state[slot] = SLOT_BOUND;
+        }
+        // the slot's value is `initializer` evaluated in this frame, when something first wants it. a name
+        // that's already bound (an input that was given) keeps its value. throws std::runtime_error when
+        // the layout has no slot for the name
+        void defer(const std::string &name, const ast_node &initializer);
+        void defer_slot(std::uint32_t slot, const ast_node &initializer);
+
+    private:
+        // a deferred slot's value, evaluating it if need be... unsynchronized, see above
+        const wdl_value *force(std::uint32_t slot) const;
+    };
+
+    // defers every declaration with an initializer among a task's or workflow's members (or a scatter / if
+    // block's statements) into a frame laid out for them... returns how many
+    std::size_t defer_declarations(eval_scope &scope, const std::vector<ast_node_ptr> &members);
+
+    // evaluates an expression node of the parser's AST against a scope... throws std::runtime_error on type
+    // errors, unknown names and anything that isn't an expression. an unset optional is wdl_value::none(),
+    // and like WDL's interpolation, "text" + None is None so a placeholder around it comes out empty
+    wdl_value evaluate(const ast_node_ptr &expr, const eval_scope &scope);
+    wdl_value evaluate(const ast_node &expr, const eval_scope &scope);
+
+    // a string literal's text with its escapes resolved and ~{} placeholders filled in
+    wdl_value evaluate_string_literal(const std::string &lexeme, const eval_scope &scope);
+    // just the escapes resolved... \~{ and \${ stay escaped, so this is what a literal's template is compiled from
+    std::string string_literal_text(const std::string &lexeme);
+
+    // one expression parsed out of text (a placeholder's, say)... throws std::runtime_error with the parser's message
+    ast_node_ptr parse_wdl_expression(const std::string &text);
+
+}
+
+#endif // WDL_EVAL_H
@@ -0,0 +1,45 @@
+#ifndef WDL_FOLD_H
+#define WDL_FOLD_H
+
+#include <cstddef>
+#include "parser.h"
+#include "wdl_eval.h"
+
+namespace soto
+{
+
+    // what a folding pass did... node counts are over the expressions it visited, so nodes_before - nodes_after
+    // is how much less evaluate() has to walk for every shard that runs them
+    struct fold_stats
+    {
+    public:
+        std::size_t expressions = 0;
+        std::size_t nodes_before = 0;
+        std::size_t nodes_after = 0;
+        std::size_t folded = 0;       // subtrees replaced by their value
+        std::size_t simplified = 0;   // true && x -> x, if true then a else b -> a, select_first([a, ...]) -> a ...
+        std::size_t constant_decls = 0; // declarations that came out a constant, and so fed the ones after them
+
+        fold_stats &operator+=(const fold_stats &other);
+    };
+
+    // folds one expression in place... names `known` has a value for count as constants, everything else is
+    // left for run time. only the builtins that don't touch files are called (no read_*, write_*, size, glob),
+    // and anything that throws (1/0, select_first of all None) is left as is so the error shows up when it runs
+    void fold_expression(ast_node_ptr &expr, const eval_scope &known, fold_stats *stats = nullptr);
+
+    // every expression of one task or workflow (an N_CLASS_DECL)... declarations, runtime values, outputs, call
+    // inputs, scatter collections and if conditions. a declaration that folds to a constant feeds the ones after
+    // it. an input is a constant only when `inputs` has it (None for an optional that's left unset)... whatever
+    // isn't there, a scatter's per-shard File say, is still a name at run time, default or not
+    fold_stats fold_declarations(ast_node &decl, const eval_scope *inputs = nullptr);
+
+    // fold_declarations over every task and workflow of a parsed program, no inputs
+    fold_stats fold_program(ast_node &prog);
+
+    // how many nodes hang off (and include) this one
+    std::size_t count_nodes(const ast_node_ptr &node);
+
+}
+
+#endif // WDL_FOLD_H
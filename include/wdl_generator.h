@@ -0,0 +1,49 @@
+#ifndef WDL_GENERATOR_H
+#define WDL_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace soto
+{
+
+    // knobs for the synthetic workflow generator... everything the real corpus is too small to tell us about.
+    // same options + same seed = byte-identical output, on any machine
+    struct wdl_gen_options
+    {
+        std::uint64_t seed = 1;
+        std::size_t tasks = 100;            // tasks in the main file
+        std::size_t calls = 0;              // 0 = one call per task
+        std::size_t imports = 0;            // extra files, each imported "as lib_N" and called from the workflow
+        std::size_t tasks_per_import = 10;
+        std::size_t structs = 4;
+        std::size_t struct_members = 6;
+        std::size_t inputs_per_task = 6;    // on top of the File every task takes
+        std::size_t outputs_per_task = 2;
+        std::size_t expr_depth = 3;         // nesting of the derived-value expressions in tasks and the workflow
+        std::size_t scatter_depth = 1;      // scatters nested inside each other around every group of calls
+        std::size_t calls_per_scatter = 8;  // calls chained inside one (innermost) scatter body
+        std::size_t command_lines = 10;     // lines per command block
+    };
+
+    struct generated_wdl
+    {
+    public:
+        std::string main;                                          // the workflow file
+        std::vector<std::pair<std::string, std::string>> imports; // file name (relative to main) -> source
+        std::size_t lines = 0;                                    // over all files
+        std::size_t bytes = 0;
+    };
+
+    // valid WDL 1.0: structs, tasks (inputs with defaults, private declarations, command <<< >>>, outputs,
+    // runtime), one workflow whose calls are chained output -> input inside nested scatters
+    generated_wdl generate_wdl(const wdl_gen_options &options);
+
+    // main goes to dir/main_name, imports next to it. creates dir
+    void write_generated_wdl(const generated_wdl &wdl, const std::string &dir, const std::string &main_name);
+
+}
+
+#endif // WDL_GENERATOR_H
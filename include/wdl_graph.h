@@ -0,0 +1,123 @@
+#ifndef WDL_GRAPH_H
+#define WDL_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+#include "wdl_eval.h"
+
+namespace soto
+{
+
+    enum graph_node_kind : std::uint8_t
+    {
+        GN_DECL,
+        GN_CALL,
+        GN_SCATTER, // the whole scatter, its shards are the scheduler's to run
+        GN_IF,
+    };
+
+    // one statement of a workflow body, or of an if block in it... a scatter's body isn't taken apart, the
+    // scatter is one node that waits on everything its body reads from outside
+    struct graph_node
+    {
+    public:
+        graph_node_kind kind = GN_DECL;
+        const ast_node *stmt = nullptr;
+        std::vector<std::string> names; // what it puts in the workflow's frame: a call's or declaration's name, what a scatter gathers
+        std::int32_t parent = -1;       // the if block it's in
+        std::vector<std::uint32_t> children; // an if's
+        std::vector<std::uint32_t> depends;  // nodes it reads a name of, and its if
+        std::vector<std::uint32_t> dependents;
+        std::size_t calls = 0; // call statements it stands for: 1 for a call, everything in a scatter's body
+        // a scatter's: the scatter itself, then the ones flattened into it, outermost first. its shards are
+        // every combination of their elements, the last level's varying fastest
+        std::vector<const ast_node *> levels;
+    };
+
+    // the dependencies between the statements of one workflow, in the order they're written... built once
+    // per workflow, shared by every run of it.
+    // with `flatten`, a scatter whose whole body is another scatter, over a collection that doesn't read the
+    // outer one's variable (`scatter (s in samples) { scatter (i in intervals) { ... } }`), is one node over
+    // all N x M shards instead of N scatters of M to expand and gather one at a time... and so on down when
+    // the inner one is the same
+    struct workflow_graph
+    {
+    public:
+        const ast_node *workflow = nullptr;
+        std::vector<graph_node> nodes;
+        std::unordered_map<std::string, std::uint32_t> declared; // name -> the node it comes out of
+        std::size_t calls = 0;
+        std::size_t flattened = 0; // scatters folded into the one around them
+
+        // throws std::runtime_error when `workflow` isn't one
+        static workflow_graph build(const ast_node &workflow, bool flatten = true);
+    };
+
+    enum graph_node_state : std::uint8_t
+    {
+        GS_WAITING,
+        GS_READY,  // a call or scatter handed to the scheduler
+        GS_DONE,
+        GS_PRUNED, // in an if whose condition came out false... never runs, its names are None
+    };
+
+    struct graph_stats
+    {
+    public:
+        std::size_t conditions = 0;    // if conditions evaluated
+        std::size_t pruned_nodes = 0;
+        std::size_t pruned_calls = 0;  // call statements that were never handed out, those in pruned scatters too
+        std::size_t materialized = 0;  // calls handed out, a scatter's counted once per shard
+    };
+
+    // one run of a workflow_graph against the workflow's frame (inputs already bound). a node settles as soon
+    // as the nodes it reads have: a declaration is deferred into the frame and evaluated when something reads
+    // it, an if's condition is evaluated right away and a false one prunes its whole block there and then,
+    // calls and scatters go on `ready` for the scheduler. so what the scheduler holds is only what can run.
+    // a scatter's collections are evaluated before it's handed out, `shards` has the size of its iteration
+    // space (N x M for two levels), `item()` what a shard's variables are and `gather()` puts what the shards
+    // produced back into one Array per level
+    struct graph_run
+    {
+    public:
+        const workflow_graph &graph;
+        eval_scope &scope;
+        std::vector<graph_node_state> state;
+        std::vector<std::uint32_t> waiting; // depends not settled yet
+        std::vector<std::size_t> shards;
+        std::vector<std::vector<wdl_value>> collections; // a scatter's, one Array per level
+        std::deque<std::uint32_t> ready;
+        graph_stats stats;
+
+        // defers the workflow's declarations into `scope` and settles everything that waits on nothing.
+        // throws std::runtime_error, like evaluate(), when a condition or collection can't be evaluated
+        graph_run(const workflow_graph &graph, eval_scope &scope);
+
+        // a call that ran, with its outputs as an object... or a scatter, with an object of what it gathered
+        // (name -> Array). binds the names and settles whatever was waiting on them
+        void finish(std::uint32_t node, const wdl_value &outputs);
+        bool done() const { return unsettled == 0; }
+
+        // the element of level `level`'s collection that shard `shard` of a scatter runs with
+        const wdl_value &item(std::uint32_t node, std::size_t level, std::size_t shard) const;
+        // one value per shard, in shard order, as the scatter gathers it: an Array of N Arrays of M for two levels
+        wdl_value gather(std::uint32_t node, wdl_array flat) const;
+
+    private:
+        std::size_t unsettled = 0;
+        std::vector<std::uint32_t> work;
+
+        void settle(std::uint32_t node, graph_node_state to);
+        void prune(std::uint32_t node);
+        void visit(std::uint32_t node);
+        void drain();
+    };
+
+}
+
+#endif // WDL_GRAPH_H
@@ -0,0 +1,37 @@
+#ifndef WDL_MODULE_H
+#define WDL_MODULE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "file_hash.h"
+#include "json_inputs.h"
+#include "parser.h"
+
+namespace soto
+{
+
+    // one parsed .wdl file and everything later requests want from it without parsing again...
+    // immutable once loaded, a changed file gets a new module
+    struct wdl_module
+    {
+    public:
+        std::string path; // canonical
+        file_stamp stamp{}; // from when it was read, the cache reloads it once stat_file() disagrees
+        std::size_t bytes = 0;
+        ast_node_ptr program;
+        std::vector<parse_diagnostic> diagnostics;
+        std::vector<std::string> imports;     // canonical paths, in source order
+        std::string workflow;                 // its workflow's name, empty for a task library
+        std::vector<workflow_input> inputs;   // that workflow's typed inputs... what bind_inputs checks against
+        struct_table structs;
+    };
+
+    std::string canonical_wdl_path(const std::string &path);
+    // throws std::runtime_error when the file can't be read, parse errors go in diagnostics
+    std::shared_ptr<const wdl_module> load_wdl_module(const std::string &path);
+
+}
+
+#endif // WDL_MODULE_H
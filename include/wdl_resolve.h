@@ -0,0 +1,43 @@
+#ifndef WDL_RESOLVE_H
+#define WDL_RESOLVE_H
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+#include "wdl_eval.h"
+
+namespace soto
+{
+
+    // what resolving a program left behind... the frame every task, workflow, scatter and if body runs in, and
+    // a diagnostic for every name used that nothing declares
+    struct resolve_result
+    {
+    public:
+        std::size_t frames = 0;
+        std::size_t declarations = 0;
+        std::size_t references = 0; // identifiers resolved to a slot
+        std::vector<parse_diagnostic> diagnostics;
+        // N_CLASS_DECL, N_SCATTER_STMT and N_IF_STMT nodes -> the layout of the frame their body runs in
+        std::unordered_map<const ast_node *, std::shared_ptr<const frame_layout>> layouts;
+
+        std::shared_ptr<const frame_layout> layout_of(const ast_node &node) const; // nullptr when it has no frame
+    };
+
+    // gives every declaration of a task or workflow a slot in its frame: inputs, private declarations, outputs,
+    // call names, and in a scatter's frame its variable. scatter and if bodies get a frame of their own whose
+    // declarations are also slots of the frames around them (where they're the gathered Array / the optional).
+    // then every identifier used in an expression becomes a slot_ref, so evaluating it against scopes built from
+    // the same layouts is a few pointer hops and an index instead of a hash lookup per frame. string literals with
+    // placeholders and commands are compiled once and kept (interpolation, command_decl::compiled), and the names
+    // in their placeholders become slot_refs too. `lines` is for the diagnostics' line numbers
+    resolve_result resolve_declarations(ast_node &decl, const source_lines *lines = nullptr);
+
+    // resolve_declarations over every task and workflow of a parsed program
+    resolve_result resolve_program(ast_node &prog);
+
+}
+
+#endif // WDL_RESOLVE_H
@@ -0,0 +1,44 @@
+#ifndef WDL_STDLIB_H
+#define WDL_STDLIB_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    // a builtin gets its arguments already evaluated... and throws std::runtime_error("name: what's wrong")
+    using wdl_builtin = wdl_value (*)(const std::vector<wdl_value> &args);
+
+    struct builtin_info
+    {
+    public:
+        const char *name;
+        std::size_t min_args;
+        std::size_t max_args;
+        wdl_builtin fn;
+        bool pure = true; // same arguments, same value, nothing touched... false for the ones reading or writing files
+    };
+
+    // the WDL 1.0 standard library, plus the 1.1 functions that cost nothing to have (min, max, sep, keys, ...).
+    // nullptr for a name that isn't a builtin
+    const builtin_info *find_builtin(std::string_view name);
+    const std::vector<builtin_info> &builtins();
+
+    // find_builtin + the argument count check + the call
+    wdl_value call_builtin(std::string_view name, const std::vector<wdl_value> &args);
+
+    // where write_lines() and friends put their files... named by a hash of what's in them, so writing the same
+    // lines twice (every shard of a scatter, say) is one file. defaults to <tmp>/wdlrunner-writes
+    void set_stdlib_write_dir(const std::string &dir);
+    const std::string &stdlib_write_dir();
+
+    // how many compiled patterns sub() keeps around per thread
+    constexpr std::size_t SUB_REGEX_CACHE_SIZE = 256;
+
+}
+
+#endif // WDL_STDLIB_H
@@ -0,0 +1,63 @@
+#ifndef WDL_STRUCT_H
+#define WDL_STRUCT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+#include "wdl_value.h"
+
+namespace soto
+{
+
+    // one struct's members in declaration order... a struct value keeps its members in this order, so member
+    // `fields[i]` of any value laid out by it is members[i]
+    struct struct_layout
+    {
+    public:
+        std::string name;
+        std::vector<std::string> fields;
+        std::vector<wdl_type> types;
+        std::unordered_map<std::string, std::uint32_t> index;
+
+        const std::uint32_t *find(const std::string &field) const; // nullptr when it has no such member
+        std::size_t size() const { return fields.size(); }
+    };
+
+    using struct_layouts = std::unordered_map<std::string, std::shared_ptr<const struct_layout>>; // by struct name
+
+    // what compiling a program's structs left behind... a layout per struct it declares, and a diagnostic for
+    // every struct literal that doesn't fit its struct
+    struct struct_result
+    {
+    public:
+        std::size_t literals = 0; // map literals turned into struct_exprs
+        std::size_t accesses = 0; // member accesses given their field's slot
+        std::vector<parse_diagnostic> diagnostics;
+        struct_layouts layouts;
+
+        std::shared_ptr<const struct_layout> layout_of(const std::string &name) const; // nullptr when it's not declared here
+    };
+
+    // what a declaration says it is... false when it says nothing we can parse
+    bool declared_type(const var_decl &var, wdl_type &type);
+
+    // lays out every struct_decl of a parsed program, then goes through its tasks and workflows with the types of
+    // what they declare: a map literal a declaration gives a struct type (`Sample s = {"id": ..., "bam": ...}`,
+    // in an Array or Map of them too) becomes a struct_expr with its values in slot order, checked for members
+    // the struct doesn't have, members given twice and required members left out. and `s.bam`, with s
+    // declared a Sample, gets the slot of bam, so evaluating it is an index instead of a search by name.
+    // structs that come from an import are looked up in `imported` (a struct declared here wins), literals of
+    // one that's in neither stay maps. runs before the resolver, which would take a literal's member names for
+    // undeclared identifiers
+    struct_result compile_structs(ast_node &prog, const struct_layouts *imported = nullptr);
+
+    // just the layouts of the structs a parsed program declares, no diagnostics... what a file importing it gets
+    struct_layouts layout_structs(const ast_node &prog);
+
+}
+
+#endif // WDL_STRUCT_H
@@ -0,0 +1,203 @@
+#ifndef WDL_VALUE_H
+#define WDL_VALUE_H
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace soto
+{
+
+    enum wdl_type_kind
+    {
+        WT_NONE, // the value of an unset optional... never a declared type
+        WT_ANY,  // what an element of an empty array literal is, or anything inside an Object
+        WT_BOOLEAN,
+        WT_INT,
+        WT_FLOAT,
+        WT_STRING,
+        WT_FILE,
+        WT_DIRECTORY,
+        WT_ARRAY,
+        WT_MAP,
+        WT_PAIR,
+        WT_OBJECT,
+        WT_STRUCT,
+    };
+
+    inline const char *wdl_type_kind_to_string(wdl_type_kind kind)
+    {
+        switch (kind)
+        {
+        case WT_NONE:
+            return "None";
+        case WT_ANY:
+            return "Any";
+        case WT_BOOLEAN:
+            return "Boolean";
+        case WT_INT:
+            return "Int";
+        case WT_FLOAT:
+            return "Float";
+        case WT_STRING:
+            return "String";
+        case WT_FILE:
+            return "File";
+        case WT_DIRECTORY:
+            return "Directory";
+        case WT_ARRAY:
+            return "Array";
+        case WT_MAP:
+            return "Map";
+        case WT_PAIR:
+            return "Pair";
+        case WT_OBJECT:
+            return "Object";
+        case WT_STRUCT:
+            return "Struct";
+        default:
+            return "UNKNOWN WDL_TYPE";
+        }
+    }
+
+    // a WDL type... the parser leaves types on N_TYPE nodes as a lexeme like "Array[File]+?" or "Map[String,Int]",
+    // wdl_type::parse turns that into something we can check values against
+    struct wdl_type
+    {
+    public:
+        wdl_type_kind kind = WT_ANY;
+        bool optional = false;
+        bool non_empty = false;       // Array[X]+
+        std::string name;             // struct name for WT_STRUCT
+        std::vector<wdl_type> params; // Array: element, Map: key + value, Pair: left + right
+
+        wdl_type() = default;
+        explicit wdl_type(wdl_type_kind kind, bool optional = false) : kind(kind), optional(optional) {}
+
+        static wdl_type parse(std::string_view text); // throws std::invalid_argument on garbage
+        std::string to_string() const;
+        bool is_primitive() const { return kind >= WT_BOOLEAN && kind <= WT_DIRECTORY; }
+    };
+
+    struct wdl_value;
+    using wdl_array = std::vector<wdl_value>;
+    using wdl_pair = std::pair<wdl_value, wdl_value>;
+    struct wdl_map;
+    struct struct_layout; // wdl_struct.h
+    struct wdl_object
+    {
+        std::string struct_name; // empty for a plain Object
+        std::vector<std::pair<std::string, wdl_value>> members;
+        // set on a struct built from a struct literal... its members are then in the layout's order, member i
+        // is field i. one bound from JSON has them in declaration order too, just without the pointer
+        std::shared_ptr<const struct_layout> layout;
+    };
+
+    // a WDL value... scalars inline, compound values behind a shared_ptr to const so copying a
+    // 50k-element Array[File] into every scatter shard is a refcount bump, not a deep copy
+    struct wdl_value
+    {
+    public:
+        wdl_type_kind kind = WT_NONE;
+        std::variant<std::monostate,
+                     bool,
+                     std::int64_t,
+                     double,
+                     std::string,
+                     std::shared_ptr<const wdl_array>,
+                     std::shared_ptr<const wdl_map>,
+                     std::shared_ptr<const wdl_pair>,
+                     std::shared_ptr<const wdl_object>>
+            data;
+
+        static wdl_value none() { return {}; }
+        static wdl_value boolean(bool b);
+        static wdl_value integer(std::int64_t i);
+        static wdl_value floating(double d);
+        static wdl_value string(std::string s, wdl_type_kind kind = WT_STRING); // WT_FILE / WT_DIRECTORY too
+        static wdl_value array(wdl_array elements);
+        static wdl_value map(wdl_map entries);
+        static wdl_value pair(wdl_value left, wdl_value right);
+        static wdl_value object(wdl_object object); // WT_STRUCT when it has a struct_name
+
+        bool is_none() const { return kind == WT_NONE; }
+
+        // these throw std::runtime_error when the value isn't of that kind...
+        bool as_bool() const;
+        std::int64_t as_int() const;
+        double as_float() const; // Int promotes
+        const std::string &as_string() const; // String, File and Directory
+        const wdl_array &as_array() const;
+        const wdl_map &as_map() const;
+        const wdl_pair &as_pair() const;
+        const wdl_object &as_object() const;
+
+        // the Map to change... copied first when anything else still shares it, so the scopes that do see
+        // the one they had
+        wdl_map &edit_map();
+
+        std::string to_string() const; // how it reads inside a command line, compound values come out as JSON-ish text
+    };
+
+    bool operator==(const wdl_value &a, const wdl_value &b);
+    inline bool operator!=(const wdl_value &a, const wdl_value &b) { return !(a == b); }
+
+    // agrees with ==... a String, File and Directory with the same text hash the same, and so do an Int and the
+    // Float it equals
+    std::uint64_t hash_value(const wdl_value &v);
+
+    // a WDL Map... entries in insertion order, which is the order WDL gives them back in, plus an
+    // open-addressing index over them once there are more than a few: one control byte per bucket (empty, or
+    // 7 bits of the key's hash), probed 16 at a time (SSE2 where there is, a plain loop elsewhere), and a bucket
+    // holds the entry's position. a lookup touches the control bytes and the one entry whose bits match,
+    // instead of comparing keys down the whole list. there's no erase, WDL has no way to take a key out
+    struct wdl_map
+    {
+    public:
+        using entry = std::pair<wdl_value, wdl_value>;
+        using const_iterator = std::vector<entry>::const_iterator;
+
+        wdl_map() = default;
+        wdl_map(std::initializer_list<entry> init); // a key given twice keeps the last value
+
+        const_iterator begin() const { return entries.begin(); }
+        const_iterator end() const { return entries.end(); }
+        std::size_t size() const { return entries.size(); }
+        bool empty() const { return entries.empty(); }
+        const entry &operator[](std::size_t i) const { return entries[i]; }
+        void reserve(std::size_t n);
+
+        const wdl_value *find(const wdl_value &key) const; // nullptr when it's not there
+        std::size_t position(const wdl_value &key) const;  // of its entry, npos when it's not there
+        // false when the key is there already, its value untouched
+        bool insert(wdl_value key, wdl_value value);
+        // inserts, or replaces the value of the key that's there... where it was in the order
+        void set(wdl_value key, wdl_value value);
+
+        // a list built elsewhere (read_map's lines, say) indexed in one pass, which can fetch the buckets of
+        // the keys ahead while it checks this one... `duplicate` is where the first key that's there twice is
+        // the second time, npos when there's none (and then the map is empty)
+        static wdl_map from_entries(std::vector<entry> list, std::size_t &duplicate);
+
+        friend bool operator==(const wdl_map &a, const wdl_map &b) { return a.entries == b.entries; } // ordered, like WDL
+
+    private:
+        std::vector<entry> entries;
+        std::vector<std::uint64_t> hashes; // of the keys, so growing doesn't hash them again
+        std::vector<std::uint8_t> control; // one per bucket, a multiple of 16 of them... empty until indexed
+        std::vector<std::uint32_t> buckets; // the entry a full bucket holds
+
+        std::size_t lookup(const wdl_value &key, std::uint64_t hash) const;
+        void place(std::uint32_t position, std::uint64_t hash);
+        void rebuild(std::size_t capacity);
+        void append(wdl_value key, wdl_value value, std::uint64_t hash);
+    };
+
+}
+
+#endif // WDL_VALUE_H
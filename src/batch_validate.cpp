@@ -0,0 +1,239 @@
+#include "batch_validate.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "json_writer.h"
+#include "trace.h"
+#include "wdl_module.h"
+
+#include <glob.h>
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    static bool is_glob(const std::string &s)
+    {
+        return s.find_first_of("*?[") != std::string::npos;
+    }
+
+    static void add_path_or_dir(const std::string &path, std::vector<std::string> &out)
+    {
+        std::error_code ec;
+        if (fs::is_directory(path, ec))
+        {
+            for (fs::recursive_directory_iterator it(path, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec))
+                if (it->is_regular_file(ec) && it->path().extension() == ".wdl")
+                    out.push_back(canonical_wdl_path(it->path().string()));
+            return;
+        }
+        // a missing file stays in, validate_batch reports it like any other unreadable file
+        out.push_back(canonical_wdl_path(path));
+    }
+
+    std::vector<std::string> expand_wdl_paths(const std::vector<std::string> &args)
+    {
+        std::vector<std::string> out;
+        for (const auto &arg : args)
+        {
+            if (!is_glob(arg))
+            {
+                add_path_or_dir(arg, out);
+                continue;
+            }
+            glob_t g{};
+            if (::glob(arg.c_str(), 0, nullptr, &g) == 0)
+                for (std::size_t i = 0; i < g.gl_pathc; ++i)
+                    add_path_or_dir(g.gl_pathv[i], out);
+            ::globfree(&g);
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+        return out;
+    }
+
+    batch_report validate_batch(const std::vector<std::string> &paths, unsigned threads)
+    {
+        WDL_TRACE_SCOPE("validate_batch");
+        const auto started = std::chrono::steady_clock::now();
+
+        // imports turn up while files are being parsed, so this is a queue the workers feed themselves...
+        // a deque because it never moves what's already in it, workers hold pointers into it
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<batch_file_result> results;
+        std::unordered_map<std::string, batch_file_result *> seen;
+        std::deque<batch_file_result *> queue;
+        std::size_t in_flight = 0;
+
+        auto enqueue = [&](const std::string &path, const std::string &importer)
+        {
+            // caller holds the lock
+            if (seen.count(path))
+                return;
+            batch_file_result &r = results.emplace_back();
+            r.path = path;
+            r.imported_by = importer;
+            r.requested = importer.empty();
+            seen.emplace(path, &r);
+            queue.push_back(&r);
+            cv.notify_one();
+        };
+        {
+            // every requested file goes in before any import does, so a file that's both counts as requested
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &p : paths)
+                enqueue(canonical_wdl_path(p), "");
+        }
+
+        auto worker = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;)
+            {
+                cv.wait(lock, [&]()
+                        { return !queue.empty() || in_flight == 0; });
+                if (queue.empty())
+                {
+                    cv.notify_all(); // nothing queued and nobody parsing who could queue more, we're done
+                    return;
+                }
+                batch_file_result *r = queue.front();
+                queue.pop_front();
+                in_flight++;
+                lock.unlock();
+
+                std::vector<std::string> imports;
+                try
+                {
+                    auto module = load_wdl_module(r->path);
+                    r->bytes = module->bytes;
+                    for (const auto &d : module->diagnostics)
+                        r->diagnostics.push_back(d.to_string());
+                    imports = module->imports;
+                }
+                catch (const std::exception &e)
+                {
+                    r->diagnostics.push_back(std::string("[ERROR] ") + e.what());
+                }
+
+                lock.lock();
+                for (const auto &imp : imports)
+                    enqueue(imp, r->path);
+                in_flight--;
+                if (queue.empty() && in_flight == 0)
+                    cv.notify_all();
+            }
+        };
+
+        unsigned n_threads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        n_threads = static_cast<unsigned>(std::min<std::size_t>(n_threads, std::max<std::size_t>(1, results.size())));
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < n_threads; ++t)
+            pool.emplace_back([&]()
+                              {
+                                  trace_thread_name("validate-worker");
+                                  worker(); });
+        worker(); // this thread works too...
+        for (auto &t : pool)
+            t.join();
+
+        batch_report report;
+        report.threads = n_threads;
+        report.files.assign(std::make_move_iterator(results.begin()), std::make_move_iterator(results.end()));
+        std::sort(report.files.begin(), report.files.end(), [](const batch_file_result &a, const batch_file_result &b)
+                  { return a.path < b.path; });
+        for (const auto &f : report.files)
+        {
+            report.requested += f.requested;
+            report.bytes += f.bytes;
+            report.diagnostics += f.diagnostics.size();
+            report.files_with_diagnostics += !f.diagnostics.empty();
+        }
+        report.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        return report;
+    }
+
+    // relative to where we were run from when that's shorter, it usually is
+    static std::string display_path(const std::string &path)
+    {
+        std::error_code ec;
+        fs::path rel = fs::path(path).lexically_relative(fs::current_path(ec));
+        if (ec || rel.empty() || *rel.begin() == "..")
+            return path;
+        return rel.string();
+    }
+
+    void write_batch_report_text(const batch_report &report, std::ostream &out)
+    {
+        for (const auto &f : report.files)
+        {
+            if (f.diagnostics.empty())
+                continue;
+            out << display_path(f.path);
+            if (!f.requested)
+                out << " (imported by " << display_path(f.imported_by) << ")";
+            out << "\n";
+            for (const auto &d : f.diagnostics)
+                out << "  " << d << "\n";
+        }
+        char summary[200];
+        std::snprintf(summary, sizeof(summary), "checked %zu file(s) (%zu only as imports), %.1f KB: %zu diagnostic(s) in %zu file(s), %.1f ms on %u thread(s)\n",
+                      report.files.size(), report.files.size() - report.requested, report.bytes / 1024.0, report.diagnostics,
+                      report.files_with_diagnostics, report.wall_ms, report.threads);
+        out << summary;
+    }
+
+    void write_batch_report_json(const batch_report &report, const std::string &path)
+    {
+        std::string text;
+        auto write = [&](json_writer &json)
+        {
+            json.begin_object();
+            json.key("ok").value(report.ok());
+            json.key("files").value(static_cast<std::uint64_t>(report.files.size()));
+            json.key("requested").value(static_cast<std::uint64_t>(report.requested));
+            json.key("bytes").value(static_cast<std::uint64_t>(report.bytes));
+            json.key("diagnostics").value(static_cast<std::uint64_t>(report.diagnostics));
+            json.key("threads").value(static_cast<std::uint64_t>(report.threads));
+            json.key("wall_ms").value(report.wall_ms);
+            json.key("results").begin_array();
+            for (const auto &f : report.files)
+            {
+                json.begin_object();
+                json.key("path").value(f.path);
+                json.key("requested").value(f.requested);
+                if (!f.requested)
+                    json.key("imported_by").value(f.imported_by);
+                json.key("bytes").value(static_cast<std::uint64_t>(f.bytes));
+                json.key("diagnostics").begin_array();
+                for (const auto &d : f.diagnostics)
+                    json.value(d);
+                json.end_array();
+                json.end_object();
+            }
+            json.end_array();
+            json.end_object();
+        };
+        if (path == "-")
+        {
+            {
+                json_writer json(text, JSON_PRETTY);
+                write(json);
+            }
+            std::cout << text << std::endl;
+            return;
+        }
+        json_writer json(path, JSON_PRETTY);
+        write(json);
+        json.flush();
+    }
+
+}
@@ -0,0 +1,420 @@
+#include "call_cache.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include "wdl_struct.h"
+
+namespace soto
+{
+    namespace fs = std::filesystem;
+
+    // lexemes are length-prefixed so "(" inside a string literal can never fake a node boundary...
+    static void append_lexeme(std::string &out, const std::string &lexeme)
+    {
+        out += std::to_string(lexeme.size());
+        out += ':';
+        out += lexeme;
+    }
+    static void normalize_node(const ast_node_ptr &node, std::string &out)
+    {
+        if (!node)
+        {
+            out += "()";
+            return;
+        }
+        out += '(';
+        out += ast_node_type_to_string(node->type);
+        if (node->is_nullable)
+            out += '?';
+        if (node->tok)
+        {
+            out += ' ';
+            out += std::to_string(node->tok->kind);
+            out += ' ';
+            append_lexeme(out, node->tok->lexeme);
+        }
+
+        std::visit(
+            [&](auto &&value)
+            {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, program>)
+                {
+                    // leaf nodes (idents, literals, types) carry an empty program variant...
+                    if (node->type != N_PROGRAM)
+                        return;
+                    normalize_node(value.version, out);
+                    for (const auto &import : value.imports)
+                        normalize_node(import, out);
+                    for (const auto &decl : value.declarations)
+                        normalize_node(decl, out);
+                }
+                else if constexpr (std::is_same_v<T, func_decl>)
+                {
+                    normalize_node(value.type, out);
+                    normalize_node(value.identifier, out);
+                    for (const auto &param : value.parameters)
+                        normalize_node(param, out);
+                    normalize_node(value.body, out);
+                }
+                else if constexpr (std::is_same_v<T, class_decl> || std::is_same_v<T, struct_decl>)
+                {
+                    normalize_node(value.identifier, out);
+                    for (const auto &member : value.members)
+                        normalize_node(member, out);
+                }
+                else if constexpr (std::is_same_v<T, input_decl> || std::is_same_v<T, output_decl>)
+                {
+                    normalize_node(value.body, out);
+                    for (const auto &member : value.members)
+                        normalize_node(member, out);
+                }
+                else if constexpr (std::is_same_v<T, runtime_decl>)
+                {
+                    for (const auto &[key, val] : value.members)
+                    {
+                        normalize_node(key, out);
+                        normalize_node(val, out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, map_expr>)
+                {
+                    for (const auto &[key, val] : value.elements)
+                    {
+                        normalize_node(key, out);
+                        normalize_node(val, out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, meta_decl>)
+                {
+                    normalize_node(value.identifier, out);
+                    for (const auto &[key, val] : value.members)
+                    {
+                        normalize_node(key, out);
+                        normalize_node(val, out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, version_decl>)
+                {
+                    normalize_node(value.version, out);
+                }
+                else if constexpr (std::is_same_v<T, var_decl>)
+                {
+                    normalize_node(value.type, out);
+                    normalize_node(value.identifier, out);
+                    normalize_node(value.initializer, out);
+                }
+                else if constexpr (std::is_same_v<T, block>)
+                {
+                    for (const auto &stmt : value.statements)
+                        normalize_node(stmt, out);
+                }
+                else if constexpr (std::is_same_v<T, if_stmt>)
+                {
+                    normalize_node(value.condition, out);
+                    normalize_node(value.then_, out);
+                    normalize_node(value.else_if, out);
+                    normalize_node(value.else_, out);
+                }
+                else if constexpr (std::is_same_v<T, while_stmt>)
+                {
+                    normalize_node(value.condition, out);
+                    normalize_node(value.body, out);
+                }
+                else if constexpr (std::is_same_v<T, do_while_stmt>)
+                {
+                    normalize_node(value.body, out);
+                    normalize_node(value.condition, out);
+                }
+                else if constexpr (std::is_same_v<T, ret_stmt> || std::is_same_v<T, expr_stmt>)
+                {
+                    normalize_node(value.expr, out);
+                }
+                else if constexpr (std::is_same_v<T, binary_expr> || std::is_same_v<T, assign_expr>)
+                {
+                    normalize_node(value.left, out);
+                    normalize_node(value.right, out);
+                }
+                else if constexpr (std::is_same_v<T, unary_expr>)
+                {
+                    normalize_node(value.operand, out);
+                }
+                else if constexpr (std::is_same_v<T, literal_expr>)
+                {
+                    append_lexeme(out, value.value.lexeme);
+                }
+                else if constexpr (std::is_same_v<T, func_call>)
+                {
+                    normalize_node(value.identifier, out);
+                    normalize_node(value.default_value, out);
+                    for (const auto &arg : value.arguments)
+                        normalize_node(arg, out);
+                }
+                else if constexpr (std::is_same_v<T, array_expr>)
+                {
+                    normalize_node(value.identifier, out);
+                    for (const auto &element : value.elements)
+                        normalize_node(element, out);
+                }
+                else if constexpr (std::is_same_v<T, command_decl>)
+                {
+                    normalize_node(value.body, out);
+                }
+                else if constexpr (std::is_same_v<T, call_decl>)
+                {
+                    normalize_node(value.member_accessed, out);
+                    normalize_node(value.alias, out);
+                    for (const auto &[key, val] : value.arguments)
+                    {
+                        normalize_node(key, out);
+                        normalize_node(val, out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, member_access>)
+                {
+                    normalize_node(value.object, out);
+                    normalize_node(value.member, out);
+                }
+                else if constexpr (std::is_same_v<T, pair_expr>)
+                {
+                    normalize_node(value.first, out);
+                    normalize_node(value.second, out);
+                }
+                else if constexpr (std::is_same_v<T, index_expr>)
+                {
+                    normalize_node(value.collection, out);
+                    normalize_node(value.index, out);
+                }
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    // in slot order, with the names... a member moving in the struct is a different literal
+                    for (std::size_t i = 0; i < value.values.size(); ++i)
+                    {
+                        append_lexeme(out, value.layout->fields[i]);
+                        normalize_node(value.values[i], out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, constant_expr>)
+                {
+                    out += ' ';
+                    out += wdl_type_kind_to_string(value.value.kind); // Int 1 and String "1" aren't the same task
+                    append_lexeme(out, value.value.to_string());
+                }
+                else if constexpr (std::is_same_v<T, import_decl>)
+                {
+                    normalize_node(value.path, out);
+                    normalize_node(value.alias, out);
+                }
+                else if constexpr (std::is_same_v<T, scatter_stmt>)
+                {
+                    normalize_node(value.identifier, out);
+                    normalize_node(value.collection, out);
+                    normalize_node(value.body, out);
+                }
+            },
+            node->node);
+        out += ')';
+    }
+
+    std::string normalize_task_ast(const ast_node_ptr &task)
+    {
+        std::string out;
+        if (!task)
+            return out;
+        const auto *klass = std::get_if<class_decl>(&task->node);
+        if (!klass)
+        {
+            normalize_node(task, out);
+            return out;
+        }
+        // inputs come in through their evaluated VALUES, and parameter_meta never changes what a task produces...
+        // so only the parts that decide the result go into the key
+        for (const auto &member : klass->members)
+        {
+            if (!member)
+                continue;
+            switch (member->type)
+            {
+            case N_VAR_DECL:
+            case N_COMMAND_DECL:
+            case N_RUNTIME_DECL:
+            case N_OUTPUT_DECL:
+                normalize_node(member, out);
+                break;
+            default:
+                break;
+            }
+        }
+        return out;
+    }
+
+    static std::vector<std::string> split_tabs(const std::string &line)
+    {
+        std::vector<std::string> parts;
+        std::size_t start = 0;
+        for (;;)
+        {
+            std::size_t tab = line.find('\t', start);
+            parts.push_back(line.substr(start, tab - start));
+            if (tab == std::string::npos)
+                break;
+            start = tab + 1;
+        }
+        return parts;
+    }
+
+    // a field can't hold the row's own separators... a String output can have tabs and newlines in it
+    static void append_field(std::string &out, const std::string &field)
+    {
+        for (char c : field)
+        {
+            if (c == '\t')
+                out += "\\t";
+            else if (c == '\n')
+                out += "\\n";
+            else if (c == '\\')
+                out += "\\\\";
+            else
+                out += c;
+        }
+    }
+    static std::string unescape_field(const std::string &field)
+    {
+        if (field.find('\\') == std::string::npos)
+            return field;
+        std::string out;
+        out.reserve(field.size());
+        for (std::size_t i = 0; i < field.size(); ++i)
+        {
+            if (field[i] != '\\' || i + 1 == field.size())
+            {
+                out += field[i];
+                continue;
+            }
+            const char c = field[++i];
+            out += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+        }
+        return out;
+    }
+
+    // the hash memo sits next to the index... the root has to exist before the hasher opens it
+    static std::string memo_path_under(const std::string &root)
+    {
+        fs::create_directories(root);
+        return (fs::path(root) / "hash_memo.tsv").string();
+    }
+
+    call_cache::call_cache(const std::string &root)
+        : root(root), index_path((fs::path(root) / "index.tsv").string()), hasher(memo_path_under(root)), links(root)
+    {
+        load_index();
+    }
+
+    // index.tsv: key \t call_dir \t n_outputs \t (name \t value)*, fields escaped by append_field()
+    // last row for a key wins so re-storing a key is just another append...
+    void call_cache::load_index()
+    {
+        std::ifstream file(index_path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            auto parts = split_tabs(line);
+            if (parts.size() < 3)
+                continue; // torn write from a crash, skip it...
+            std::size_t n = std::strtoull(parts[2].c_str(), nullptr, 10);
+            if (parts.size() != 3 + 2 * n)
+                continue;
+            call_cache_entry entry{unescape_field(parts[0]), unescape_field(parts[1]), {}};
+            for (std::size_t i = 0; i < n; ++i)
+                entry.outputs.emplace_back(unescape_field(parts[3 + 2 * i]), unescape_field(parts[4 + 2 * i]));
+            index[entry.key] = std::move(entry);
+        }
+    }
+    std::string call_cache::make_key(const ast_node_ptr &task, const call_cache_inputs &inputs)
+    {
+        std::string material = normalize_task_ast(task);
+
+        // std::map keeps values sorted by name already...
+        for (const auto &[name, value] : inputs.values)
+        {
+            material += "\nv ";
+            append_lexeme(material, name);
+            append_lexeme(material, value);
+        }
+
+        auto files = inputs.files;
+        std::sort(files.begin(), files.end());
+        std::vector<std::string> paths;
+        paths.reserve(files.size());
+        for (const auto &file : files)
+            paths.push_back(file.second);
+        auto digests = hash_files(paths);
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            material += "\nf ";
+            append_lexeme(material, files[i].first);
+            material += digests[i];
+        }
+        return hash_string(material);
+    }
+
+    const call_cache_entry *call_cache::lookup(const std::string &key) const
+    {
+        auto it = index.find(key);
+        return it == index.end() ? nullptr : &it->second;
+    }
+
+    void call_cache::store(const call_cache_entry &entry)
+    {
+        std::string row;
+        append_field(row, entry.key);
+        row += '\t';
+        append_field(row, entry.call_dir);
+        row += '\t' + std::to_string(entry.outputs.size());
+        for (const auto &[name, value] : entry.outputs)
+        {
+            row += '\t';
+            append_field(row, name);
+            row += '\t';
+            append_field(row, value);
+        }
+        row += '\n';
+
+        std::ofstream file(index_path, std::ios::app);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + index_path);
+        file << row;
+        file.flush();
+        if (!file)
+            throw std::runtime_error("Failed to write to file: " + index_path);
+        index[entry.key] = entry;
+    }
+
+    bool call_cache::restore(const call_cache_entry &entry, const std::string &dest_dir, std::vector<std::pair<std::string, std::string>> &restored)
+    {
+        restored.clear();
+        fs::create_directories(dest_dir);
+        const fs::path call_dir(entry.call_dir);
+        for (const auto &[name, value] : entry.outputs)
+        {
+            // only outputs that are files produced inside the old call dir need moving, Int/String outputs pass straight through...
+            fs::path src(value);
+            auto rel = src.lexically_relative(call_dir);
+            if (rel.empty() || *rel.begin() == "..")
+            {
+                restored.emplace_back(name, value);
+                continue;
+            }
+            std::error_code ec;
+            if (!fs::exists(src, ec))
+                return false;
+            fs::path dest = fs::path(dest_dir) / rel;
+            if (links.delocalize(src.string(), dest.string()) == L_FAILED)
+                return false;
+            restored.emplace_back(name, dest.string());
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,563 @@
+#include "command_template.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace soto
+{
+
+    static bool is_blank(std::string_view line)
+    {
+        for (char c : line)
+            if (c != ' ' && c != '\t')
+                return false;
+        return true;
+    }
+
+    static std::size_t leading_whitespace(std::string_view line)
+    {
+        std::size_t n = 0;
+        while (n < line.size() && (line[n] == ' ' || line[n] == '\t'))
+            ++n;
+        return n;
+    }
+
+    // what WDL does to a command before running it... the rest of the `command <<<` line and a whitespace-only
+    // last line go, then every line loses the indentation all the non-blank lines share
+    static std::string dedent_command(std::string_view body)
+    {
+        std::size_t begin = 0, end = body.size();
+        std::size_t first_nl = body.find('\n');
+        if (first_nl != std::string_view::npos && is_blank(body.substr(0, first_nl)))
+            begin = first_nl + 1;
+        std::size_t last_nl = body.rfind('\n');
+        if (last_nl != std::string_view::npos && last_nl + 1 >= begin && is_blank(body.substr(last_nl + 1)))
+            end = last_nl + 1;
+        body = body.substr(begin, end - begin);
+
+        std::size_t indent = std::string_view::npos;
+        for (std::size_t at = 0; at < body.size();)
+        {
+            std::size_t nl = body.find('\n', at);
+            std::string_view line = body.substr(at, nl == std::string_view::npos ? std::string_view::npos : nl - at);
+            if (!is_blank(line))
+                indent = std::min(indent, leading_whitespace(line));
+            at = nl == std::string_view::npos ? body.size() : nl + 1;
+        }
+        if (indent == std::string_view::npos || indent == 0)
+            return std::string(body);
+
+        std::string out;
+        out.reserve(body.size());
+        for (std::size_t at = 0; at < body.size();)
+        {
+            std::size_t nl = body.find('\n', at);
+            std::size_t line_end = nl == std::string_view::npos ? body.size() : nl + 1;
+            std::string_view line = body.substr(at, line_end - at);
+            line.remove_prefix(std::min(indent, leading_whitespace(line)));
+            out.append(line.data(), line.size());
+            at = line_end;
+        }
+        return out;
+    }
+
+    // the '}' closing a placeholder whose text starts at from... braces of a map literal and quoted '}' don't count
+    static std::size_t placeholder_end(const std::string &s, std::size_t from)
+    {
+        int depth = 0;
+        char quote = 0;
+        for (std::size_t i = from; i < s.size(); ++i)
+        {
+            char c = s[i];
+            if (quote)
+            {
+                if (c == '\\')
+                    ++i;
+                else if (c == quote)
+                    quote = 0;
+                continue;
+            }
+            if (c == '"' || c == '\'')
+                quote = c;
+            else if (c == '{')
+                ++depth;
+            else if (c == '}' && depth-- == 0)
+                return i;
+        }
+        return std::string::npos;
+    }
+
+    static bool is_plain_string_literal(const ast_node &node)
+    {
+        if (node.type != N_LITERAL || !node.tok || node.tok->kind != T_SLITERAL)
+            return false;
+        const std::string &s = node.tok->lexeme;
+        return s.find('\\') == std::string::npos && s.find("~{") == std::string::npos && s.find("${") == std::string::npos;
+    }
+
+    // a.b.c with nothing but names in it
+    static bool member_path(const ast_node &node, std::vector<std::string> &path)
+    {
+        const auto *access = std::get_if<member_access>(&node.node);
+        if (!access || !access->object || !access->object->tok || !access->member)
+            return false;
+        path.push_back(access->object->tok->lexeme);
+        if (access->member->type == N_IDENT && access->member->tok)
+        {
+            path.push_back(access->member->tok->lexeme);
+            return true;
+        }
+        return member_path(*access->member, path);
+    }
+
+    static placeholder_term make_term(const ast_node_ptr &node)
+    {
+        placeholder_term term;
+        std::vector<std::string> path;
+        if (is_plain_string_literal(*node))
+        {
+            term.kind = placeholder_term::PT_TEXT;
+            term.text = node->tok->lexeme;
+        }
+        else if (node->type == N_IDENT && node->tok)
+        {
+            term.kind = placeholder_term::PT_NAME;
+            term.text = node->tok->lexeme;
+            term.name = node.get();
+        }
+        else if (member_path(*node, path))
+        {
+            term.kind = placeholder_term::PT_PATH;
+            term.text = std::move(path.front());
+            term.path.assign(std::make_move_iterator(path.begin() + 1), std::make_move_iterator(path.end()));
+            term.expr = node.get();
+            term.name = std::get<member_access>(node->node).object.get();
+        }
+        else
+            term.expr = node.get();
+        return term;
+    }
+
+    // "-L " + intervals + " " + extra... a + chain that starts with a string literal is a string all the way
+    // (that's how the evaluator reads it too), so its pieces can be written one by one. anything else stays one term
+    static bool flatten_concat(const ast_node_ptr &node, std::vector<placeholder_term> &terms)
+    {
+        if (const auto *bin = std::get_if<binary_expr>(&node->node))
+        {
+            if (!bin->op || bin->op->kind != T_PLUS || !bin->left || !bin->right || !flatten_concat(bin->left, terms))
+                return false;
+            terms.push_back(make_term(bin->right));
+            return true;
+        }
+        if (!is_plain_string_literal(*node))
+            return false;
+        terms.push_back(make_term(node));
+        return true;
+    }
+
+    static command_placeholder compile_placeholder(const std::string &source)
+    {
+        command_placeholder p;
+        p.source = source;
+        std::size_t i = 0;
+        // sep=" " true="--x" false="" default="1"... any of them, before the expression
+        for (;;)
+        {
+            while (i < source.size() && std::isspace(static_cast<unsigned char>(source[i])))
+                ++i;
+            std::size_t word_end = i;
+            while (word_end < source.size() && (std::isalpha(static_cast<unsigned char>(source[word_end])) || source[word_end] == '_'))
+                ++word_end;
+            std::string word = source.substr(i, word_end - i);
+            std::size_t eq = word_end;
+            while (eq < source.size() && std::isspace(static_cast<unsigned char>(source[eq])))
+                ++eq;
+            if ((word != "sep" && word != "true" && word != "false" && word != "default") ||
+                eq >= source.size() || source[eq] != '=' || (eq + 1 < source.size() && source[eq + 1] == '='))
+                break;
+            std::size_t open = eq + 1;
+            while (open < source.size() && std::isspace(static_cast<unsigned char>(source[open])))
+                ++open;
+            if (open >= source.size() || (source[open] != '"' && source[open] != '\''))
+                throw std::runtime_error("Expected a quoted value after '" + word + "=' in placeholder: " + source);
+            std::size_t close = open + 1;
+            while (close < source.size() && source[close] != source[open])
+                close += source[close] == '\\' ? 2 : 1;
+            if (close >= source.size())
+                throw std::runtime_error("Unterminated '" + word + "=' value in placeholder: " + source);
+            std::string value = source.substr(open + 1, close - open - 1);
+            if (word == "sep")
+            {
+                p.has_sep = true;
+                p.sep = std::move(value);
+            }
+            else if (word == "default")
+            {
+                p.has_default = true;
+                p.default_value = std::move(value);
+            }
+            else
+            {
+                p.has_true_false = true;
+                (word == "true" ? p.if_true : p.if_false) = std::move(value);
+            }
+            i = close + 1;
+        }
+        std::string expr_text = source.substr(i);
+        if (is_blank(expr_text))
+            throw std::runtime_error("Empty placeholder: ~{" + source + "}");
+
+        p.expr = parse_wdl_expression(expr_text);
+        if (!flatten_concat(p.expr, p.terms) || p.terms.size() < 2)
+            p.terms.assign(1, make_term(p.expr));
+        return p;
+    }
+
+    command_template command_template::compile(std::string_view body, bool dollar_placeholders, bool dedent)
+    {
+        command_template t;
+        t.text = dedent ? dedent_command(body) : std::string(body);
+        const std::string &s = t.text;
+        std::size_t literal_begin = 0;
+        for (std::size_t i = 0; i + 1 < s.size(); ++i)
+        {
+            const char c = s[i];
+            if (c == '\\' && i + 2 < s.size() && (s[i + 1] == '~' || s[i + 1] == '$') && s[i + 2] == '{')
+            {
+                // \~{ isn't a placeholder... a string literal (dedent off) drops the backslash, a command keeps it for the shell
+                if (!dedent)
+                {
+                    t.parts.push_back({static_cast<std::uint32_t>(literal_begin), static_cast<std::uint32_t>(i), -1});
+                    literal_begin = i + 1;
+                }
+                i += 2;
+                continue;
+            }
+            if ((c != '~' && !(c == '$' && dollar_placeholders)) || s[i + 1] != '{')
+                continue;
+            std::size_t end = placeholder_end(s, i + 2);
+            if (end == std::string::npos)
+                throw std::runtime_error("Unterminated placeholder in command: " + s.substr(i, 40));
+            t.parts.push_back({static_cast<std::uint32_t>(literal_begin), static_cast<std::uint32_t>(i), static_cast<int>(t.placeholders.size())});
+            t.placeholders.push_back(compile_placeholder(s.substr(i + 2, end - i - 2)));
+            literal_begin = end + 1;
+            i = end;
+        }
+        if (literal_begin < s.size() || t.parts.empty())
+            t.parts.push_back({static_cast<std::uint32_t>(literal_begin), static_cast<std::uint32_t>(s.size()), -1});
+
+        for (const part &p : t.parts)
+            t.literal_bytes += p.end - p.begin;
+        for (const command_placeholder &p : t.placeholders)
+            for (const placeholder_term &term : p.terms)
+                t.expr_terms += term.kind == placeholder_term::PT_EXPR || term.kind == placeholder_term::PT_PATH;
+        return t;
+    }
+
+    command_template command_template::from_command(const command_decl &command)
+    {
+        if (!command.body || !command.body->tok)
+            throw std::runtime_error("Command without a body");
+        return compile(command.body->tok->lexeme, !command.heredoc);
+    }
+
+    namespace
+    {
+        // a few values on the stack, the heap only for unusually busy commands... render() allocates nothing else
+        template <typename T, std::size_t N>
+        struct scratch_array
+        {
+        public:
+            T inline_items[N];
+            std::vector<T> heap;
+            T *items;
+
+            explicit scratch_array(std::size_t n) : items(inline_items)
+            {
+                if (n > N)
+                {
+                    heap.resize(n);
+                    items = heap.data();
+                }
+            }
+        };
+
+        enum fill_kind : unsigned char
+        {
+            F_EMPTY,   // None without a default
+            F_DEFAULT, // None with one
+            F_TRUE,    // a Boolean with true=/false=
+            F_FALSE,
+            F_JOIN,  // an array with sep=
+            F_TERMS, // the terms, one after the other... a single plain value too
+        };
+
+        const wdl_value none_value;
+
+        // the member of a Pair or struct value by name, in place... nullptr when there's no such member
+        const wdl_value *find_member(const wdl_value &object, const std::string &name)
+        {
+            if (object.kind == WT_PAIR && (name == "left" || name == "right"))
+                return name == "left" ? &object.as_pair().first : &object.as_pair().second;
+            if (object.kind == WT_OBJECT || object.kind == WT_STRUCT)
+                for (const auto &[key, value] : object.as_object().members)
+                    if (key == name)
+                        return &value;
+            return nullptr;
+        }
+
+        // a term's name, through its slot when the resolver left one that fits this scope, by name otherwise
+        const wdl_value *find_name(const placeholder_term &term, const eval_scope &scope)
+        {
+            if (const auto *ref = term.name ? std::get_if<slot_ref>(&term.name->node) : nullptr)
+                if (const wdl_value *v = scope.at(*ref))
+                    return v;
+            return scope.find(term.text);
+        }
+
+        bool is_scalar(const wdl_value &v)
+        {
+            return v.kind >= WT_BOOLEAN && v.kind <= WT_DIRECTORY;
+        }
+
+        std::size_t int_digits(std::int64_t i)
+        {
+            std::uint64_t u = i < 0 ? 0 - static_cast<std::uint64_t>(i) : static_cast<std::uint64_t>(i);
+            std::size_t n = i < 0;
+            do
+            {
+                ++n;
+                u /= 10;
+            } while (u);
+            return n;
+        }
+
+        std::size_t scalar_size(const wdl_value &v)
+        {
+            switch (v.kind)
+            {
+            case WT_BOOLEAN:
+                return v.as_bool() ? 4 : 5;
+            case WT_INT:
+                return int_digits(v.as_int());
+            case WT_FLOAT:
+            {
+                char buf[64];
+                return static_cast<std::size_t>(std::snprintf(buf, sizeof(buf), "%.6f", v.as_float()));
+            }
+            case WT_STRING:
+            case WT_FILE:
+            case WT_DIRECTORY:
+                return v.as_string().size();
+            default:
+                return 0;
+            }
+        }
+
+        char *write_bytes(char *p, const char *data, std::size_t n)
+        {
+            std::memcpy(p, data, n);
+            return p + n;
+        }
+
+        // same text wdl_value::to_string() makes, without the string
+        char *write_scalar(char *p, const wdl_value &v)
+        {
+            switch (v.kind)
+            {
+            case WT_BOOLEAN:
+                return v.as_bool() ? write_bytes(p, "true", 4) : write_bytes(p, "false", 5);
+            case WT_INT:
+            {
+                std::int64_t i = v.as_int();
+                std::uint64_t u = i < 0 ? 0 - static_cast<std::uint64_t>(i) : static_cast<std::uint64_t>(i);
+                char buf[24];
+                char *end = buf + sizeof(buf), *b = end;
+                do
+                {
+                    *--b = static_cast<char>('0' + u % 10);
+                    u /= 10;
+                } while (u);
+                if (i < 0)
+                    *--b = '-';
+                return write_bytes(p, b, static_cast<std::size_t>(end - b));
+            }
+            case WT_FLOAT:
+            {
+                char buf[64];
+                int n = std::snprintf(buf, sizeof(buf), "%.6f", v.as_float());
+                return write_bytes(p, buf, static_cast<std::size_t>(n));
+            }
+            case WT_STRING:
+            case WT_FILE:
+            case WT_DIRECTORY:
+                return write_bytes(p, v.as_string().data(), v.as_string().size());
+            default:
+                return p;
+            }
+        }
+    }
+
+    void command_template::render_into(const eval_scope &scope, std::string &out) const
+    {
+        std::size_t term_count = 0;
+        for (const command_placeholder &p : placeholders)
+            term_count += p.terms.size();
+        // the term's value (nullptr for literal text), a fill per placeholder, and room for what had to be evaluated
+        scratch_array<const wdl_value *, 32> values(term_count);
+        scratch_array<unsigned char, 32> fills(placeholders.size());
+        scratch_array<wdl_value, 8> evaluated(expr_terms + placeholders.size());
+        wdl_value *next_evaluated = evaluated.items;
+
+        // pass 1... every placeholder resolved and the exact size of the command added up
+        std::size_t size = literal_bytes;
+        const wdl_value **term_value = values.items;
+        for (std::size_t i = 0; i < placeholders.size(); ++i)
+        {
+            const command_placeholder &p = placeholders[i];
+            bool none = false;
+            for (std::size_t k = 0; k < p.terms.size(); ++k)
+            {
+                const placeholder_term &term = p.terms[k];
+                const wdl_value *v = nullptr;
+                if (term.kind == placeholder_term::PT_NAME)
+                {
+                    v = find_name(term, scope);
+                    if (!v && term.text != "None")
+                        throw std::runtime_error("Cannot evaluate placeholder ~{" + p.source + "}: unknown name '" + term.text + "'");
+                    if (!v)
+                        v = &none_value;
+                }
+                else if (term.kind == placeholder_term::PT_PATH)
+                {
+                    v = find_name(term, scope);
+                    for (std::size_t m = 0; v && !v->is_none() && m < term.path.size(); ++m)
+                        v = find_member(*v, term.path[m]);
+                    if (!v)
+                    {
+                        // whatever's wrong with it, the evaluator says it properly
+                        *next_evaluated = evaluate(*term.expr, scope);
+                        v = next_evaluated++;
+                    }
+                }
+                else if (term.kind == placeholder_term::PT_EXPR)
+                {
+                    *next_evaluated = evaluate(*term.expr, scope);
+                    v = next_evaluated++;
+                }
+                none |= v && v->is_none();
+                term_value[k] = v;
+            }
+
+            unsigned char fill = F_TERMS;
+            const wdl_value *single = p.terms.size() == 1 ? term_value[0] : nullptr;
+            if (none)
+                fill = p.has_default ? F_DEFAULT : F_EMPTY; // "-L " + intervals with intervals unset is nothing at all
+            else if (single && single->kind == WT_BOOLEAN && p.has_true_false)
+                fill = single->as_bool() ? F_TRUE : F_FALSE;
+            else if (single && single->kind == WT_ARRAY && p.has_sep)
+                fill = F_JOIN;
+            else if (single && !is_scalar(*single))
+            {
+                // a Map or Pair, or an array without sep=... rare enough to go through to_string()
+                *next_evaluated = wdl_value::string(single->to_string());
+                term_value[0] = next_evaluated++;
+            }
+
+            switch (fill)
+            {
+            case F_DEFAULT:
+                size += p.default_value.size();
+                break;
+            case F_TRUE:
+                size += p.if_true.size();
+                break;
+            case F_FALSE:
+                size += p.if_false.size();
+                break;
+            case F_JOIN:
+            {
+                const wdl_array &elements = single->as_array();
+                for (const wdl_value &e : elements)
+                {
+                    if (!is_scalar(e) && !e.is_none())
+                        throw std::runtime_error("Cannot evaluate placeholder ~{" + p.source + "}: sep= needs an array of primitive values");
+                    size += scalar_size(e);
+                }
+                if (!elements.empty())
+                    size += p.sep.size() * (elements.size() - 1);
+                break;
+            }
+            case F_TERMS:
+                for (std::size_t k = 0; k < p.terms.size(); ++k)
+                {
+                    const wdl_value *v = term_value[k];
+                    if (!v)
+                        size += p.terms[k].text.size();
+                    else if (!is_scalar(*v) || (p.terms.size() > 1 && v->kind == WT_BOOLEAN))
+                        throw std::runtime_error("Cannot evaluate placeholder ~{" + p.source + "}: only strings and numbers concatenate");
+                    else
+                        size += scalar_size(*v);
+                }
+                break;
+            default:
+                break;
+            }
+            fills.items[i] = fill;
+            term_value += p.terms.size();
+        }
+
+        // pass 2... one resize (none at all when out is being reused), then straight copies
+        out.resize(size);
+        char *w = out.data();
+        term_value = values.items;
+        for (const part &part : parts)
+        {
+            w = write_bytes(w, text.data() + part.begin, part.end - part.begin);
+            if (part.placeholder < 0)
+                continue;
+            const command_placeholder &p = placeholders[static_cast<std::size_t>(part.placeholder)];
+            switch (fills.items[part.placeholder])
+            {
+            case F_DEFAULT:
+                w = write_bytes(w, p.default_value.data(), p.default_value.size());
+                break;
+            case F_TRUE:
+                w = write_bytes(w, p.if_true.data(), p.if_true.size());
+                break;
+            case F_FALSE:
+                w = write_bytes(w, p.if_false.data(), p.if_false.size());
+                break;
+            case F_JOIN:
+            {
+                bool first = true;
+                for (const wdl_value &e : term_value[0]->as_array())
+                {
+                    if (!first)
+                        w = write_bytes(w, p.sep.data(), p.sep.size());
+                    w = write_scalar(w, e);
+                    first = false;
+                }
+                break;
+            }
+            case F_TERMS:
+                for (std::size_t k = 0; k < p.terms.size(); ++k)
+                    w = term_value[k] ? write_scalar(w, *term_value[k]) : write_bytes(w, p.terms[k].text.data(), p.terms[k].text.size());
+                break;
+            default:
+                break;
+            }
+            term_value += p.terms.size();
+        }
+    }
+
+    std::string command_template::render(const eval_scope &scope) const
+    {
+        std::string out;
+        render_into(scope, out);
+        return out;
+    }
+
+}
@@ -0,0 +1,427 @@
+#include "file_hash.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace soto
+{
+
+    static constexpr std::uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr std::uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr std::uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr std::uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr std::uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static inline std::uint64_t rotl64(std::uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+    static inline std::uint64_t read64(const unsigned char *p)
+    {
+        std::uint64_t v;
+        std::memcpy(&v, p, sizeof(v)); // little-endian hosts only, which is all we run on...
+        return v;
+    }
+    static inline std::uint32_t read32(const unsigned char *p)
+    {
+        std::uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+    static inline std::uint64_t xxh_round(std::uint64_t acc, std::uint64_t input)
+    {
+        acc += input * PRIME64_2;
+        acc = rotl64(acc, 31);
+        return acc * PRIME64_1;
+    }
+    static inline std::uint64_t xxh_merge(std::uint64_t acc, std::uint64_t val)
+    {
+        acc ^= xxh_round(0, val);
+        return acc * PRIME64_1 + PRIME64_4;
+    }
+
+    std::uint64_t xxh64(const void *data, std::size_t len, std::uint64_t seed)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        const unsigned char *end = p + len;
+        std::uint64_t h;
+
+        if (len >= 32)
+        {
+            // four independent lanes, this is where the speed comes from...
+            std::uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+            std::uint64_t v2 = seed + PRIME64_2;
+            std::uint64_t v3 = seed;
+            std::uint64_t v4 = seed - PRIME64_1;
+            const unsigned char *limit = end - 32;
+            do
+            {
+                v1 = xxh_round(v1, read64(p));
+                v2 = xxh_round(v2, read64(p + 8));
+                v3 = xxh_round(v3, read64(p + 16));
+                v4 = xxh_round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+            h = xxh_merge(h, v1);
+            h = xxh_merge(h, v2);
+            h = xxh_merge(h, v3);
+            h = xxh_merge(h, v4);
+        }
+        else
+        {
+            h = seed + PRIME64_5;
+        }
+
+        h += static_cast<std::uint64_t>(len);
+
+        while (p + 8 <= end)
+        {
+            h ^= xxh_round(0, read64(p));
+            h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+            p += 8;
+        }
+        if (p + 4 <= end)
+        {
+            h ^= static_cast<std::uint64_t>(read32(p)) * PRIME64_1;
+            h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+            p += 4;
+        }
+        while (p < end)
+        {
+            h ^= (*p) * PRIME64_5;
+            h = rotl64(h, 11) * PRIME64_1;
+            ++p;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static std::string to_hex(std::uint64_t h)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; --i)
+        {
+            out[i] = digits[h & 0xf];
+            h >>= 4;
+        }
+        return out;
+    }
+
+    std::string hash_string(const std::string &data)
+    {
+        return to_hex(xxh64(data.data(), data.size()));
+    }
+
+    bool stat_file(const std::string &path, file_stamp &stamp)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+            return false;
+        stamp.device = static_cast<std::uint64_t>(st.st_dev);
+        stamp.inode = static_cast<std::uint64_t>(st.st_ino);
+        stamp.size = static_cast<std::uint64_t>(st.st_size);
+        stamp.mtime_ns = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+        return true;
+    }
+
+    // one open input file... mapped if the kernel lets us, otherwise we pread() chunks of it
+    struct hash_source
+    {
+        int fd = -1;
+        std::size_t size = 0;
+        const unsigned char *map = nullptr;
+
+        ~hash_source()
+        {
+            if (map)
+                ::munmap(const_cast<unsigned char *>(map), size);
+            if (fd >= 0)
+                ::close(fd);
+        }
+    };
+
+    static void open_source(const std::string &path, hash_source &src)
+    {
+        src.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (src.fd < 0)
+            throw std::runtime_error("Failed to open file: " + path);
+        struct stat st;
+        if (::fstat(src.fd, &st) != 0)
+            throw std::runtime_error("Failed to stat file: " + path);
+        src.size = static_cast<std::size_t>(st.st_size);
+        if (src.size == 0)
+            return;
+        void *m = ::mmap(nullptr, src.size, PROT_READ, MAP_PRIVATE, src.fd, 0);
+        if (m != MAP_FAILED)
+        {
+            ::madvise(m, src.size, MADV_SEQUENTIAL);
+            src.map = static_cast<const unsigned char *>(m);
+        }
+    }
+
+    // big page-aligned buffer per worker for the pread() path... freed with the thread
+    struct aligned_buffer
+    {
+        unsigned char *data = nullptr;
+        aligned_buffer()
+        {
+            void *p = nullptr;
+            if (::posix_memalign(&p, 4096, file_hasher::CHUNK_SIZE) != 0)
+                throw std::bad_alloc();
+            data = static_cast<unsigned char *>(p);
+        }
+        ~aligned_buffer() { std::free(data); }
+    };
+
+    static std::uint64_t hash_chunk(const hash_source &src, std::size_t offset, std::size_t len, const std::string &path)
+    {
+        if (src.map)
+            return xxh64(src.map + offset, len);
+
+        thread_local aligned_buffer buf;
+        std::size_t done = 0;
+        while (done < len)
+        {
+            ssize_t n = ::pread(src.fd, buf.data + done, len - done, static_cast<off_t>(offset + done));
+            if (n <= 0)
+                throw std::runtime_error("Failed to read file: " + path);
+            done += static_cast<std::size_t>(n);
+        }
+        return xxh64(buf.data, len);
+    }
+
+    file_hasher::file_hasher(const std::string &memo_path, unsigned threads)
+        : memo_path(memo_path), threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        if (!memo_path.empty())
+            load_memo();
+    }
+
+    std::vector<std::string> file_hasher::hash_uncached(const std::vector<std::string> &paths)
+    {
+        std::vector<std::string> digests(paths.size());
+        const std::size_t window = std::max<std::size_t>(OPEN_FILES, threads);
+        for (std::size_t first = 0; first < paths.size(); first += window)
+        {
+            const std::size_t count = std::min(window, paths.size() - first);
+            std::vector<hash_source> sources(count);
+            std::vector<std::vector<std::uint64_t>> leaves(count);
+
+            // every (file, chunk) pair is one job, all of them go through the same pool...
+            std::vector<std::pair<std::size_t, std::size_t>> jobs;
+            for (std::size_t f = 0; f < count; ++f)
+            {
+                open_source(paths[first + f], sources[f]);
+                std::size_t n_chunks = (sources[f].size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+                leaves[f].resize(n_chunks);
+                for (std::size_t c = 0; c < n_chunks; ++c)
+                    jobs.emplace_back(f, c);
+            }
+
+            std::atomic<std::size_t> next{0};
+            std::atomic<std::size_t> total{0};
+            std::exception_ptr failure;
+            std::mutex failure_mutex;
+            auto worker = [&]()
+            {
+                WDL_TRACE_SCOPE("hash_chunks");
+                for (;;)
+                {
+                    std::size_t j = next.fetch_add(1, std::memory_order_relaxed);
+                    if (j >= jobs.size())
+                        return;
+                    auto [f, c] = jobs[j];
+                    std::size_t offset = c * CHUNK_SIZE;
+                    std::size_t len = std::min(CHUNK_SIZE, sources[f].size - offset);
+                    try
+                    {
+                        leaves[f][c] = hash_chunk(sources[f], offset, len, paths[first + f]);
+                        total.fetch_add(len, std::memory_order_relaxed);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(failure_mutex);
+                        if (!failure)
+                            failure = std::current_exception();
+                    }
+                }
+            };
+
+            std::size_t n_threads = std::min<std::size_t>(threads, std::max<std::size_t>(1, jobs.size()));
+            std::vector<std::thread> pool;
+            for (std::size_t t = 1; t < n_threads; ++t)
+                pool.emplace_back([&]()
+                                  {
+                                      trace_thread_name("hash-worker");
+                                      worker(); });
+            worker(); // this thread works too...
+            for (auto &t : pool)
+                t.join();
+            if (failure)
+                std::rethrow_exception(failure);
+            bytes += total.load();
+
+            // root of the tree = hash over the leaf digests with the size tacked on the end...
+            for (std::size_t f = 0; f < count; ++f)
+            {
+                leaves[f].push_back(static_cast<std::uint64_t>(sources[f].size));
+                digests[first + f] = to_hex(xxh64(leaves[f].data(), leaves[f].size() * sizeof(std::uint64_t)));
+            }
+        }
+        return digests;
+    }
+
+    std::vector<std::string> file_hasher::hash_all(const std::vector<std::string> &paths)
+    {
+        WDL_TRACE_SCOPE("hash_inputs");
+        std::vector<std::string> digests(paths.size());
+        std::vector<file_stamp> stamps(paths.size());
+        std::vector<std::size_t> misses;
+        {
+            std::lock_guard<std::mutex> lock(memo_mutex);
+            for (std::size_t i = 0; i < paths.size(); ++i)
+            {
+                if (!stat_file(paths[i], stamps[i]))
+                    throw std::runtime_error("Failed to stat file: " + paths[i]);
+                auto it = memo.find(stamps[i]);
+                if (it != memo.end())
+                {
+                    digests[i] = it->second;
+                    ++hits;
+                }
+                else
+                {
+                    misses.push_back(i);
+                }
+            }
+        }
+        if (misses.empty())
+            return digests;
+
+        // somebody wrote to a file while we were reading it, its digest is good for nothing... it's hashed again
+        // until it holds still, and given up on (throws) if it never does
+        static constexpr int ATTEMPTS = 3;
+        std::vector<std::pair<file_stamp, std::string>> rows;
+        for (int attempt = 1; !misses.empty(); ++attempt)
+        {
+            std::vector<std::string> miss_paths;
+            miss_paths.reserve(misses.size());
+            for (auto i : misses)
+                miss_paths.push_back(paths[i]);
+            auto fresh = hash_uncached(miss_paths);
+
+            std::vector<std::size_t> changed;
+            for (std::size_t k = 0; k < misses.size(); ++k)
+            {
+                std::size_t i = misses[k];
+                file_stamp after{};
+                if (!stat_file(paths[i], after))
+                    throw std::runtime_error("Failed to stat file: " + paths[i]);
+                if (!(after == stamps[i]))
+                {
+                    if (attempt == ATTEMPTS)
+                        throw std::runtime_error("File kept changing while it was hashed: " + paths[i]);
+                    stamps[i] = after;
+                    changed.push_back(i);
+                    continue;
+                }
+                digests[i] = fresh[k];
+                rows.emplace_back(stamps[i], fresh[k]);
+            }
+            misses = std::move(changed);
+        }
+
+        std::lock_guard<std::mutex> lock(memo_mutex);
+        for (const auto &[stamp, digest] : rows)
+            memo[stamp] = digest;
+        append_memo(rows);
+        return digests;
+    }
+
+    std::string file_hasher::hash(const std::string &path)
+    {
+        return hash_all({path}).front();
+    }
+
+    // memo file rows: device \t inode \t size \t mtime_ns \t digest
+    // only the newest row per (device, inode) is live, older ones belong to a previous version of the file...
+    void file_hasher::load_memo()
+    {
+        std::ifstream file(memo_path);
+        std::map<std::pair<std::uint64_t, std::uint64_t>, file_stamp> newest;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            file_stamp stamp{};
+            char digest[17] = {0};
+            unsigned long long dev, ino, size;
+            long long mtime;
+            if (std::sscanf(line.c_str(), "%llu\t%llu\t%llu\t%lld\t%16s", &dev, &ino, &size, &mtime, digest) != 5)
+                continue; // torn write from a crash, skip it...
+            stamp = {dev, ino, size, mtime};
+            auto [it, inserted] = newest.emplace(std::make_pair(stamp.device, stamp.inode), stamp);
+            if (!inserted)
+            {
+                memo.erase(it->second);
+                it->second = stamp;
+                ++stale_rows;
+            }
+            memo[stamp] = digest;
+        }
+        if (stale_rows > memo.size())
+            compact();
+    }
+
+    void file_hasher::append_memo(const std::vector<std::pair<file_stamp, std::string>> &rows)
+    {
+        if (memo_path.empty() || rows.empty())
+            return;
+        std::ofstream file(memo_path, std::ios::app);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + memo_path);
+        for (const auto &[s, digest] : rows)
+            file << s.device << '\t' << s.inode << '\t' << s.size << '\t' << s.mtime_ns << '\t' << digest << '\n';
+    }
+
+    void file_hasher::compact()
+    {
+        if (memo_path.empty())
+            return;
+        std::string tmp = memo_path + ".tmp";
+        {
+            std::ofstream file(tmp, std::ios::trunc);
+            if (!file)
+                throw std::runtime_error("Failed to open file: " + tmp);
+            for (const auto &[s, digest] : memo)
+                file << s.device << '\t' << s.inode << '\t' << s.size << '\t' << s.mtime_ns << '\t' << digest << '\n';
+            if (!file)
+                throw std::runtime_error("Failed to write to file: " + tmp);
+        }
+        if (std::rename(tmp.c_str(), memo_path.c_str()) != 0)
+            throw std::runtime_error("Failed to rename file: " + tmp);
+        stale_rows = 0;
+    }
+
+}
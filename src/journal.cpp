@@ -0,0 +1,349 @@
+#include "journal.h"
+#include "file_hash.h"
+#include "trace.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace soto
+{
+
+    // frame = u32 payload length | u32 checksum (low half of xxh64 of the payload) | payload
+    // payload = u8 kind | str call_id | i32 exit_code | str cache_key | u32 n | (str name, str value)*n | str workflow_digest
+    // str = u32 length + bytes... little-endian, same as everything else we write
+    static constexpr std::size_t FRAME_HEADER = 8;
+    static constexpr std::uint32_t MAX_PAYLOAD = 64u << 20; // anything bigger is a garbage length, not a record
+
+    static void put_u32(std::string &out, std::uint32_t v)
+    {
+        out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+    static void put_str(std::string &out, const std::string &s)
+    {
+        put_u32(out, static_cast<std::uint32_t>(s.size()));
+        out += s;
+    }
+    static std::uint32_t checksum(const char *data, std::size_t len)
+    {
+        return static_cast<std::uint32_t>(xxh64(data, len, 0x6a6f75726e616cULL));
+    }
+
+    static void encode_record(std::string &out, const journal_record &r)
+    {
+        std::size_t header_at = out.size();
+        out.append(FRAME_HEADER, '\0');
+        out.push_back(static_cast<char>(r.kind));
+        put_str(out, r.call_id);
+        put_u32(out, static_cast<std::uint32_t>(r.exit_code));
+        put_str(out, r.cache_key);
+        put_u32(out, static_cast<std::uint32_t>(r.outputs.size()));
+        for (const auto &[name, value] : r.outputs)
+        {
+            put_str(out, name);
+            put_str(out, value);
+        }
+        put_str(out, r.workflow_digest);
+
+        std::uint32_t len = static_cast<std::uint32_t>(out.size() - header_at - FRAME_HEADER);
+        std::uint32_t sum = checksum(out.data() + header_at + FRAME_HEADER, len);
+        std::memcpy(&out[header_at], &len, sizeof(len));
+        std::memcpy(&out[header_at + 4], &sum, sizeof(sum));
+    }
+
+    // bounds-checked reader over one payload... any overrun means the record is bad
+    struct payload_reader
+    {
+        const char *p;
+        const char *end;
+        bool ok = true;
+
+        std::uint32_t u32()
+        {
+            std::uint32_t v = 0;
+            if (end - p < 4)
+            {
+                ok = false;
+                return 0;
+            }
+            std::memcpy(&v, p, sizeof(v));
+            p += 4;
+            return v;
+        }
+        std::string str()
+        {
+            std::uint32_t len = u32();
+            if (!ok || static_cast<std::size_t>(end - p) < len)
+            {
+                ok = false;
+                return {};
+            }
+            std::string s(p, len);
+            p += len;
+            return s;
+        }
+    };
+
+    static bool decode_record(const char *data, std::size_t len, journal_record &r)
+    {
+        if (len < 1)
+            return false;
+        payload_reader in{data + 1, data + len};
+        std::uint8_t kind = static_cast<std::uint8_t>(data[0]);
+        if (kind < J_RUN || kind > J_CALL_FAILED)
+            return false;
+        r.kind = static_cast<journal_record_kind>(kind);
+        r.call_id = in.str();
+        r.exit_code = static_cast<int>(in.u32());
+        r.cache_key = in.str();
+        std::uint32_t n = in.u32();
+        r.outputs.clear();
+        for (std::uint32_t i = 0; in.ok && i < n; ++i)
+        {
+            std::string name = in.str();
+            std::string value = in.str();
+            r.outputs.emplace_back(std::move(name), std::move(value));
+        }
+        r.workflow_digest = in.str();
+        return in.ok && in.p == in.end;
+    }
+
+    static void apply_record(journal_state &state, journal_record &r)
+    {
+        if (r.kind == J_RUN)
+        {
+            state.workflow_digest = std::move(r.workflow_digest);
+            return;
+        }
+        journal_call &call = state.calls[r.call_id];
+        switch (r.kind)
+        {
+        case J_CALL_START:
+            call = journal_call{};
+            break;
+        case J_CALL_FINISH:
+            call.state = CALL_FINISHED;
+            call.exit_code = r.exit_code;
+            call.cache_key = std::move(r.cache_key);
+            call.outputs = std::move(r.outputs);
+            break;
+        case J_CALL_FAILED:
+            call.state = CALL_FAILED;
+            call.exit_code = r.exit_code;
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::size_t journal_state::count(call_state s) const
+    {
+        std::size_t n = 0;
+        for (const auto &[id, call] : calls)
+            if (call.state == s)
+                ++n;
+        return n;
+    }
+
+    journal_state journal::replay(const std::string &path)
+    {
+        journal_state state;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == ENOENT)
+                return state; // nothing ran yet, nothing to resume
+            throw std::runtime_error("Failed to open file: " + path);
+        }
+
+        // one pass over the file in big reads, frames can straddle reads so keep the leftover
+        std::string buf;
+        std::uint64_t consumed = 0; // file offset of buf[0]
+        std::size_t pos = 0;
+        bool eof = false;
+        auto fill = [&]
+        {
+            buf.erase(0, pos);
+            consumed += pos;
+            pos = 0;
+            char block[1 << 16];
+            ssize_t got;
+            do
+                got = ::read(fd, block, sizeof(block));
+            while (got < 0 && errno == EINTR);
+            if (got < 0)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to read file: " + path);
+            }
+            eof = got == 0;
+            buf.append(block, static_cast<std::size_t>(got));
+        };
+
+        journal_record r;
+        while (true)
+        {
+            if (buf.size() - pos < FRAME_HEADER)
+            {
+                if (eof)
+                    break;
+                fill();
+                continue;
+            }
+            std::uint32_t len, sum;
+            std::memcpy(&len, buf.data() + pos, sizeof(len));
+            std::memcpy(&sum, buf.data() + pos + 4, sizeof(sum));
+            if (len > MAX_PAYLOAD)
+                break;
+            if (buf.size() - pos < FRAME_HEADER + len)
+            {
+                if (eof)
+                    break;
+                fill();
+                continue;
+            }
+            const char *payload = buf.data() + pos + FRAME_HEADER;
+            if (checksum(payload, len) != sum || !decode_record(payload, len, r))
+                break; // torn or corrupt, nothing after it can be trusted either
+            apply_record(state, r);
+            state.records++;
+            pos += FRAME_HEADER + len;
+            state.valid_bytes = consumed + pos;
+        }
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+            state.torn_tail = static_cast<std::uint64_t>(st.st_size) != state.valid_bytes;
+        ::close(fd);
+        return state;
+    }
+
+    journal::journal(const std::string &path, bool resume, std::chrono::microseconds max_delay)
+        : path(path), max_delay(max_delay)
+    {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        if (resume)
+        {
+            state = replay(path);
+        }
+        else
+        {
+            flags |= O_TRUNC;
+        }
+        fd = ::open(path.c_str(), flags, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open file: " + path);
+        // a crash mid-write leaves half a frame behind, cut it off so new records don't land after garbage...
+        if (resume && (::ftruncate(fd, static_cast<off_t>(state.valid_bytes)) != 0 ||
+                       ::lseek(fd, static_cast<off_t>(state.valid_bytes), SEEK_SET) < 0))
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to truncate file: " + path);
+        }
+        flusher = std::thread([this]
+                              { flush_loop(); });
+    }
+
+    journal::~journal()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        pending_cv.notify_all();
+        flusher.join();
+        ::close(fd);
+    }
+
+    std::uint64_t journal::append(const journal_record &record)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        encode_record(pending, record);
+        std::uint64_t seq = ++appended_seq;
+        pending_cv.notify_one();
+        return seq;
+    }
+
+    void journal::sync(std::uint64_t seq)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        durable_cv.wait(lock, [&]
+                        { return durable_seq >= seq || !write_error.empty(); });
+        if (!write_error.empty())
+            throw std::runtime_error(write_error);
+    }
+
+    void journal::sync_all()
+    {
+        std::uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seq = appended_seq;
+        }
+        sync(seq);
+    }
+
+    std::uint64_t journal::fsync_count()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return fsyncs;
+    }
+
+    void journal::flush_loop()
+    {
+        trace_thread_name("journal-flusher");
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            pending_cv.wait(lock, [&]
+                            { return stopping || !pending.empty(); });
+            if (pending.empty())
+                break; // stopping and nothing left
+            if (max_delay.count() > 0 && !stopping)
+                pending_cv.wait_for(lock, max_delay, [&]
+                                    { return stopping; });
+
+            // take everything queued so far... appenders keep queueing into a fresh buffer while we write
+            batch.clear();
+            batch.swap(pending);
+            std::uint64_t upto = appended_seq;
+            lock.unlock();
+
+            WDL_TRACE_SCOPE("journal_group_commit");
+            std::string error;
+            std::size_t off = 0;
+            while (off < batch.size())
+            {
+                ssize_t n = ::write(fd, batch.data() + off, batch.size() - off);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                {
+                    error = "Failed to write to file: " + path + ": " + std::strerror(errno);
+                    break;
+                }
+                off += static_cast<std::size_t>(n);
+            }
+            if (error.empty() && ::fdatasync(fd) != 0)
+                error = "Failed to sync file: " + path + ": " + std::strerror(errno);
+
+            lock.lock();
+            if (error.empty())
+            {
+                durable_seq = upto;
+                fsyncs++;
+            }
+            else if (write_error.empty())
+            {
+                write_error = error; // sticky, a journal with a hole in it can't promise anything after it
+            }
+            durable_cv.notify_all();
+            if (!write_error.empty())
+                break;
+        }
+    }
+
+}
@@ -0,0 +1,993 @@
+#include "json_inputs.h"
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include "mapped_file.h"
+#include "string_utils.h"
+
+namespace soto
+{
+
+    static constexpr int MAX_JSON_DEPTH = 256; // json_reader's limit too, for values bound without a type
+    static constexpr std::size_t MAX_INPUT_ERRORS = 100; // a wrong type on a 400k-element array shouldn't print 400k lines...
+
+    static std::string trimmed(const std::string &s)
+    {
+        std::size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos)
+            return "";
+        std::size_t e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+
+    const ast_node *find_workflow(const ast_node_ptr &program_node, const std::string &name)
+    {
+        if (!program_node)
+            return nullptr;
+        const auto *prog = std::get_if<program>(&program_node->node);
+        if (!prog)
+            return nullptr;
+        for (const auto &decl : prog->declarations)
+        {
+            if (!decl || !decl->tok)
+                continue;
+            const auto *klass = std::get_if<class_decl>(&decl->node);
+            if (!klass || !klass->identifier || !klass->identifier->tok)
+                continue;
+            if (util::to_lowercase(trimmed(decl->tok->lexeme)) != "workflow")
+                continue;
+            if (name.empty() || trimmed(klass->identifier->tok->lexeme) == name)
+                return decl.get();
+        }
+        return nullptr;
+    }
+
+    static bool declared_var(const ast_node_ptr &node, const source_lines *lines, std::string &name, std::string &type_text, bool &has_default, int &line)
+    {
+        if (!node)
+            return false;
+        const auto *var = std::get_if<var_decl>(&node->node);
+        if (!var || !var->type || !var->type->tok || !var->identifier || !var->identifier->tok)
+            return false;
+        name = trimmed(var->identifier->tok->lexeme);
+        type_text = var->type->tok->lexeme;
+        // a nullable member type can leave the '?' on the node type only...
+        if (var->type->type == N_TYPE_NULLABLE && (type_text.empty() || type_text.back() != '?'))
+            type_text += '?';
+        has_default = var->initializer != nullptr;
+        line = lines ? lines->line_of(var->identifier->tok->offset) : 0;
+        return !name.empty();
+    }
+
+    std::vector<workflow_input> collect_workflow_inputs(const ast_node_ptr &program_node, const ast_node &workflow)
+    {
+        std::vector<workflow_input> inputs;
+        const auto *prog = program_node ? std::get_if<program>(&program_node->node) : nullptr;
+        const source_lines *lines = prog ? prog->lines.get() : nullptr;
+        const auto *klass = std::get_if<class_decl>(&workflow.node);
+        if (!klass)
+            return inputs;
+        for (const auto &member : klass->members)
+        {
+            if (!member)
+                continue;
+            const auto *input = std::get_if<input_decl>(&member->node);
+            if (!input || !input->body)
+                continue;
+            const auto *body = std::get_if<block>(&input->body->node);
+            if (!body)
+                continue;
+            for (const auto &stmt : body->statements)
+            {
+                workflow_input in;
+                std::string type_text;
+                if (!declared_var(stmt, lines, in.name, type_text, in.has_default, in.line))
+                    continue;
+                in.type = wdl_type::parse(type_text);
+                inputs.push_back(std::move(in));
+            }
+        }
+        return inputs;
+    }
+
+    struct_table collect_structs(const ast_node_ptr &program_node)
+    {
+        struct_table structs;
+        const auto *prog = program_node ? std::get_if<program>(&program_node->node) : nullptr;
+        if (!prog)
+            return structs;
+        for (const auto &decl : prog->declarations)
+        {
+            const auto *sd = decl ? std::get_if<struct_decl>(&decl->node) : nullptr;
+            if (!sd || !sd->identifier || !sd->identifier->tok)
+                continue;
+            auto &members = structs[trimmed(sd->identifier->tok->lexeme)];
+            for (const auto &m : sd->members)
+            {
+                std::string name, type_text;
+                bool has_default;
+                int line;
+                if (declared_var(m, nullptr, name, type_text, has_default, line))
+                    members.emplace_back(name, wdl_type::parse(type_text));
+            }
+        }
+        return structs;
+    }
+
+    // thrown for malformed JSON, there's no sensible way to carry on after one of these...
+    struct json_syntax_error
+    {
+        std::string message;
+        const char *at;
+    };
+
+    // pull-style cursor over the raw JSON text... nothing is materialized unless the binder asks for it
+    struct json_cursor
+    {
+        const char *begin;
+        const char *p;
+        const char *end;
+
+        // line/column are only worked out when something goes wrong, and errors come in order,
+        // so we carry on counting from the last error instead of rescanning a 100 MB file each time
+        const char *counted = nullptr;
+        std::size_t line = 1;
+        std::size_t column = 1;
+
+        [[noreturn]] void fail(const std::string &message) const
+        {
+            throw json_syntax_error{message, p};
+        }
+
+        void skip_ws()
+        {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+                ++p;
+        }
+        char peek()
+        {
+            skip_ws();
+            return p < end ? *p : '\0';
+        }
+        void expect(char c)
+        {
+            if (peek() != c)
+                fail(std::string("expected '") + c + "'");
+            ++p;
+        }
+        bool consume(char c)
+        {
+            if (peek() != c)
+                return false;
+            ++p;
+            return true;
+        }
+
+        void literal(const char *word)
+        {
+            std::size_t n = std::strlen(word);
+            if (static_cast<std::size_t>(end - p) < n || std::memcmp(p, word, n) != 0)
+                fail("invalid literal");
+            p += n;
+        }
+
+        void read_string(std::string &out)
+        {
+            expect('"');
+            const char *start = p;
+            // fast path, nothing escaped... that's every path in a real inputs file
+            while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20)
+                ++p;
+            if (p < end && *p == '"')
+            {
+                out.assign(start, p);
+                ++p;
+                return;
+            }
+            out.assign(start, p);
+            while (true)
+            {
+                if (p >= end)
+                    fail("unterminated string");
+                char c = *p++;
+                if (c == '"')
+                    return;
+                if (static_cast<unsigned char>(c) < 0x20)
+                    fail("control character in string");
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (p >= end)
+                    fail("unterminated string");
+                switch (*p++)
+                {
+                case '"':
+                    out += '"';
+                    break;
+                case '\\':
+                    out += '\\';
+                    break;
+                case '/':
+                    out += '/';
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                    append_utf8(out, read_codepoint());
+                    break;
+                default:
+                    fail("invalid escape in string");
+                }
+            }
+        }
+
+        unsigned read_hex4()
+        {
+            if (end - p < 4)
+                fail("truncated \\u escape");
+            unsigned v = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *p++;
+                v <<= 4;
+                if (c >= '0' && c <= '9')
+                    v |= static_cast<unsigned>(c - '0');
+                else if (c >= 'a' && c <= 'f')
+                    v |= static_cast<unsigned>(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F')
+                    v |= static_cast<unsigned>(c - 'A' + 10);
+                else
+                    fail("invalid \\u escape");
+            }
+            return v;
+        }
+        unsigned read_codepoint()
+        {
+            unsigned cp = read_hex4();
+            if (cp >= 0xD800 && cp <= 0xDBFF) // high surrogate, the low half has to follow
+            {
+                if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                    fail("unpaired surrogate in \\u escape");
+                p += 2;
+                unsigned lo = read_hex4();
+                if (lo < 0xDC00 || lo > 0xDFFF)
+                    fail("unpaired surrogate in \\u escape");
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            }
+            return cp;
+        }
+        static void append_utf8(std::string &out, unsigned cp)
+        {
+            if (cp < 0x80)
+                out += static_cast<char>(cp);
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        // checks the JSON number grammar and hands back the raw text, integral = no fraction/exponent
+        std::string_view read_number(bool &integral)
+        {
+            skip_ws();
+            const char *start = p;
+            auto digits = [&]
+            {
+                const char *d = p;
+                while (p < end && *p >= '0' && *p <= '9')
+                    ++p;
+                return p != d;
+            };
+            if (p < end && *p == '-')
+                ++p;
+            if (p < end && *p == '0')
+                ++p;
+            else if (!digits())
+                fail("invalid number");
+            integral = true;
+            if (p < end && *p == '.')
+            {
+                ++p;
+                integral = false;
+                if (!digits())
+                    fail("invalid number");
+            }
+            if (p < end && (*p == 'e' || *p == 'E'))
+            {
+                ++p;
+                integral = false;
+                if (p < end && (*p == '+' || *p == '-'))
+                    ++p;
+                if (!digits())
+                    fail("invalid number");
+            }
+            return {start, static_cast<std::size_t>(p - start)};
+        }
+
+        // skips one value of any shape... iterative so hostile nesting can't blow the stack,
+        // and the bracket stack is a short string so shallow skips don't allocate
+        void skip_value()
+        {
+            std::string open;
+            bool integral;
+            while (true)
+            {
+                char c = peek();
+                if (c == '{' || c == '[')
+                {
+                    ++p;
+                    if (!consume(c == '{' ? '}' : ']'))
+                    {
+                        open.push_back(c);
+                        if (c == '{')
+                        {
+                            skip_string();
+                            expect(':');
+                        }
+                        continue;
+                    }
+                }
+                else if (c == '"')
+                    skip_string();
+                else if (c == 't')
+                    literal("true");
+                else if (c == 'f')
+                    literal("false");
+                else if (c == 'n')
+                    literal("null");
+                else
+                    read_number(integral);
+
+                // after a value: on to the next element/member, or close up
+                while (!open.empty())
+                {
+                    if (consume(','))
+                    {
+                        if (open.back() == '{')
+                        {
+                            skip_string();
+                            expect(':');
+                        }
+                        break;
+                    }
+                    expect(open.back() == '{' ? '}' : ']');
+                    open.pop_back();
+                }
+                if (open.empty())
+                    return;
+            }
+        }
+
+        void skip_string()
+        {
+            expect('"');
+            while (p < end && *p != '"')
+                p += (*p == '\\') ? 2 : 1;
+            if (p >= end)
+                fail("unterminated string");
+            ++p;
+        }
+
+        std::pair<std::size_t, std::size_t> position_of(const char *at)
+        {
+            if (!counted || at < counted)
+            {
+                counted = begin;
+                line = 1;
+                column = 1;
+            }
+            for (; counted < at && counted < end; ++counted)
+            {
+                if (*counted == '\n')
+                {
+                    ++line;
+                    column = 1;
+                }
+                else
+                {
+                    ++column;
+                }
+            }
+            return {line, column};
+        }
+    };
+
+
+    static const char *json_kind_name(char c)
+    {
+        switch (c)
+        {
+        case '{':
+            return "an object";
+        case '[':
+            return "an array";
+        case '"':
+            return "a string";
+        case 't':
+        case 'f':
+            return "a boolean";
+        case 'n':
+            return "null";
+        default:
+            return "a number";
+        }
+    }
+
+    // walks the JSON with the declared type in hand and builds the value as it goes...
+    struct input_binder
+    {
+        json_cursor in;
+        const struct_table &structs;
+        bound_inputs &result;
+        int decl_line = 0;
+
+        // where we are, kept as pieces and only joined into "W.x[3].bam" when there's an error to report
+        struct path_piece
+        {
+            std::string_view name;
+            std::size_t index;
+            bool is_index;
+        };
+        std::vector<path_piece> path;
+
+        std::string path_string() const
+        {
+            std::string out;
+            for (const auto &piece : path)
+            {
+                if (piece.is_index)
+                {
+                    out += '[';
+                    out += std::to_string(piece.index);
+                    out += ']';
+                }
+                else
+                {
+                    if (!out.empty())
+                        out += '.';
+                    out += piece.name;
+                }
+            }
+            return out;
+        }
+
+        void error_at(const char *at, const std::string &message)
+        {
+            if (result.errors.size() >= MAX_INPUT_ERRORS)
+                return;
+            input_error e;
+            e.key = path_string();
+            e.message = message;
+            auto [line, column] = in.position_of(at);
+            e.json_line = line;
+            e.json_column = column;
+            e.decl_line = decl_line;
+            result.errors.push_back(std::move(e));
+            if (result.errors.size() == MAX_INPUT_ERRORS)
+            {
+                input_error stop;
+                stop.message = "too many errors, giving up";
+                result.errors.push_back(std::move(stop));
+                throw json_syntax_error{"", nullptr}; // not a syntax error, just a way out...
+            }
+        }
+
+        // the JSON has the wrong shape for this type: report, skip it, keep going with the rest
+        wdl_value mismatch(const wdl_type &type, const char *at)
+        {
+            error_at(at, "expected " + type.to_string() + ", got " + json_kind_name(*at));
+            in.skip_value();
+            return wdl_value::none();
+        }
+
+        wdl_value bind(const wdl_type &type)
+        {
+            char c = in.peek();
+            const char *at = in.p;
+            if (c == 'n')
+            {
+                in.literal("null");
+                if (!type.optional && type.kind != WT_ANY && type.kind != WT_OBJECT)
+                    error_at(at, "expected " + type.to_string() + ", got null");
+                return wdl_value::none();
+            }
+            switch (type.kind)
+            {
+            case WT_BOOLEAN:
+                if (c == 't')
+                {
+                    in.literal("true");
+                    return wdl_value::boolean(true);
+                }
+                if (c == 'f')
+                {
+                    in.literal("false");
+                    return wdl_value::boolean(false);
+                }
+                return mismatch(type, at);
+            case WT_INT:
+            case WT_FLOAT:
+                if (c == '-' || (c >= '0' && c <= '9'))
+                    return bind_number(type, at);
+                return mismatch(type, at);
+            case WT_STRING:
+            case WT_FILE:
+            case WT_DIRECTORY:
+            {
+                if (c != '"')
+                    return mismatch(type, at);
+                std::string s;
+                in.read_string(s);
+                return wdl_value::string(std::move(s), type.kind);
+            }
+            case WT_ARRAY:
+                if (c != '[')
+                    return mismatch(type, at);
+                return bind_array(type, at);
+            case WT_MAP:
+                if (c != '{')
+                    return mismatch(type, at);
+                return bind_map(type);
+            case WT_PAIR:
+                if (c != '{')
+                    return mismatch(type, at);
+                return bind_pair(type, at);
+            case WT_STRUCT:
+                if (c != '{')
+                    return mismatch(type, at);
+                return bind_struct(type, at);
+            default:
+                return bind_any();
+            }
+        }
+
+        wdl_value bind_number(const wdl_type &type, const char *at)
+        {
+            bool integral;
+            std::string_view raw = in.read_number(integral);
+            if (type.kind == WT_INT)
+            {
+                std::int64_t v = 0;
+                if (!integral)
+                {
+                    error_at(at, "expected Int, got " + std::string(raw));
+                    return wdl_value::none();
+                }
+                auto r = std::from_chars(raw.data(), raw.data() + raw.size(), v);
+                if (r.ec != std::errc())
+                {
+                    error_at(at, "Int out of range: " + std::string(raw));
+                    return wdl_value::none();
+                }
+                return wdl_value::integer(v);
+            }
+            double d = 0;
+            auto r = std::from_chars(raw.data(), raw.data() + raw.size(), d);
+            if (r.ec != std::errc())
+            {
+                error_at(at, "Float out of range: " + std::string(raw));
+                return wdl_value::none();
+            }
+            return wdl_value::floating(d);
+        }
+
+        wdl_value bind_array(const wdl_type &type, const char *at)
+        {
+            in.expect('[');
+            wdl_array elements;
+            if (!in.consume(']'))
+            {
+                path.push_back({{}, 0, true});
+                do
+                {
+                    path.back().index = elements.size();
+                    elements.push_back(bind(type.params[0]));
+                } while (in.consume(','));
+                path.pop_back();
+                in.expect(']');
+            }
+            if (type.non_empty && elements.empty())
+                error_at(at, "expected " + type.to_string() + ", got an empty array");
+            return wdl_value::array(std::move(elements));
+        }
+
+        // JSON object keys are always strings, the map's key type decides what they turn into
+        bool coerce_key(const wdl_type &key_type, std::string &&text, wdl_value &out, const char *at)
+        {
+            switch (key_type.kind)
+            {
+            case WT_STRING:
+            case WT_FILE:
+            case WT_DIRECTORY:
+                out = wdl_value::string(std::move(text), key_type.kind);
+                return true;
+            case WT_INT:
+            {
+                std::int64_t v;
+                auto r = std::from_chars(text.data(), text.data() + text.size(), v);
+                if (r.ec == std::errc() && r.ptr == text.data() + text.size())
+                {
+                    out = wdl_value::integer(v);
+                    return true;
+                }
+                break;
+            }
+            case WT_FLOAT:
+            {
+                double d;
+                auto r = std::from_chars(text.data(), text.data() + text.size(), d);
+                if (r.ec == std::errc() && r.ptr == text.data() + text.size())
+                {
+                    out = wdl_value::floating(d);
+                    return true;
+                }
+                break;
+            }
+            case WT_BOOLEAN:
+                if (text == "true" || text == "false")
+                {
+                    out = wdl_value::boolean(text == "true");
+                    return true;
+                }
+                break;
+            default:
+                break;
+            }
+            error_at(at, "map key \"" + text + "\" is not a valid " + key_type.to_string());
+            return false;
+        }
+
+        wdl_value bind_map(const wdl_type &type)
+        {
+            in.expect('{');
+            wdl_map entries;
+            if (in.consume('}'))
+                return wdl_value::map(std::move(entries));
+            do
+            {
+                in.skip_ws();
+                const char *key_at = in.p;
+                std::string key;
+                in.read_string(key);
+                in.expect(':');
+                path.push_back({key, 0, false});
+                wdl_value k;
+                if (coerce_key(type.params[0], std::string(key), k, key_at))
+                    entries.set(std::move(k), bind(type.params[1]));
+                else
+                    in.skip_value();
+                path.pop_back();
+            } while (in.consume(','));
+            in.expect('}');
+            return wdl_value::map(std::move(entries));
+        }
+
+        wdl_value bind_pair(const wdl_type &type, const char *at)
+        {
+            in.expect('{');
+            wdl_value halves[2];
+            bool seen[2] = {false, false};
+            if (!in.consume('}'))
+            {
+                do
+                {
+                    in.skip_ws();
+                    const char *key_at = in.p;
+                    std::string key;
+                    in.read_string(key);
+                    in.expect(':');
+                    int side = -1;
+                    if (key == "left")
+                        side = 0;
+                    else if (key == "right")
+                        side = 1;
+                    path.push_back({key, 0, false});
+                    if (side < 0)
+                    {
+                        error_at(key_at, "a Pair only has \"left\" and \"right\"");
+                        in.skip_value();
+                    }
+                    else
+                    {
+                        halves[side] = bind(type.params[side]);
+                        seen[side] = true;
+                    }
+                    path.pop_back();
+                } while (in.consume(','));
+                in.expect('}');
+            }
+            if (!seen[0] || !seen[1])
+                error_at(at, "expected " + type.to_string() + ", needs both \"left\" and \"right\"");
+            return wdl_value::pair(std::move(halves[0]), std::move(halves[1]));
+        }
+
+        wdl_value bind_struct(const wdl_type &type, const char *at)
+        {
+            auto layout = structs.find(type.name);
+            if (layout == structs.end())
+            {
+                error_at(at, "unknown struct type " + type.name);
+                in.skip_value();
+                return wdl_value::none();
+            }
+            const auto &members = layout->second;
+            in.expect('{');
+            wdl_object object;
+            object.struct_name = type.name;
+            object.members.reserve(members.size());
+            for (const auto &[name, member_type] : members)
+                object.members.emplace_back(name, wdl_value::none());
+            std::vector<bool> seen(members.size(), false);
+            if (!in.consume('}'))
+            {
+                do
+                {
+                    in.skip_ws();
+                    const char *key_at = in.p;
+                    std::string key;
+                    in.read_string(key);
+                    in.expect(':');
+                    path.push_back({key, 0, false});
+                    std::size_t i = 0;
+                    while (i < members.size() && members[i].first != key)
+                        ++i;
+                    if (i == members.size())
+                    {
+                        error_at(key_at, "struct " + type.name + " has no member " + key);
+                        in.skip_value();
+                    }
+                    else
+                    {
+                        object.members[i].second = bind(members[i].second);
+                        seen[i] = true;
+                    }
+                    path.pop_back();
+                } while (in.consume(','));
+                in.expect('}');
+            }
+            for (std::size_t i = 0; i < members.size(); ++i)
+                if (!seen[i] && !members[i].second.optional)
+                    error_at(at, "struct " + type.name + " is missing member " + members[i].first + " (" + members[i].second.to_string() + ")");
+            return wdl_value::object(std::move(object));
+        }
+
+        // Object, or anything we have no declared type for: take the JSON as it comes... as deep as
+        // MAX_JSON_DEPTH, a [[[[...]]]] past that is an error instead of a stack overflow
+        wdl_value bind_any(int depth = 0)
+        {
+            char c = in.peek();
+            if ((c == '{' || c == '[') && depth >= MAX_JSON_DEPTH)
+            {
+                error_at(in.p, "nested more than " + std::to_string(MAX_JSON_DEPTH) + " levels deep");
+                in.skip_value();
+                return wdl_value::none();
+            }
+            switch (c)
+            {
+            case '{':
+            {
+                in.expect('{');
+                wdl_object object;
+                if (!in.consume('}'))
+                {
+                    do
+                    {
+                        std::string key;
+                        in.read_string(key);
+                        in.expect(':');
+                        wdl_value v = bind_any(depth + 1);
+                        object.members.emplace_back(std::move(key), std::move(v));
+                    } while (in.consume(','));
+                    in.expect('}');
+                }
+                return wdl_value::object(std::move(object));
+            }
+            case '[':
+            {
+                in.expect('[');
+                wdl_array elements;
+                if (!in.consume(']'))
+                {
+                    do
+                        elements.push_back(bind_any(depth + 1));
+                    while (in.consume(','));
+                    in.expect(']');
+                }
+                return wdl_value::array(std::move(elements));
+            }
+            case '"':
+            {
+                std::string s;
+                in.read_string(s);
+                return wdl_value::string(std::move(s));
+            }
+            case 't':
+                in.literal("true");
+                return wdl_value::boolean(true);
+            case 'f':
+                in.literal("false");
+                return wdl_value::boolean(false);
+            case 'n':
+                in.literal("null");
+                return wdl_value::none();
+            default:
+            {
+                bool integral;
+                const char *at = in.p;
+                in.read_number(integral);
+                in.p = at;
+                return bind_number(wdl_type(integral ? WT_INT : WT_FLOAT), at);
+            }
+            }
+        }
+    };
+
+    bound_inputs bind_inputs(std::string_view json, const std::string &workflow, const std::vector<workflow_input> &inputs, const struct_table &structs)
+    {
+        bound_inputs result;
+        result.workflow = workflow;
+
+        std::unordered_map<std::string_view, const workflow_input *> declared;
+        for (const auto &input : inputs)
+            declared.emplace(input.name, &input);
+
+        input_binder binder{json_cursor{json.data(), json.data(), json.data() + json.size()}, structs, result, 0, {}};
+        json_cursor &in = binder.in;
+        const std::string prefix = workflow + ".";
+        try
+        {
+            in.expect('{');
+            if (!in.consume('}'))
+            {
+                do
+                {
+                    in.skip_ws();
+                    const char *key_at = in.p;
+                    std::string key;
+                    in.read_string(key);
+                    in.expect(':');
+
+                    binder.decl_line = 0;
+                    binder.path.assign(1, {key, 0, false});
+                    std::string_view name(key);
+                    if (name.compare(0, prefix.size(), prefix) != 0)
+                    {
+                        binder.error_at(key_at, "not an input of workflow " + workflow);
+                        in.skip_value();
+                        continue;
+                    }
+                    name.remove_prefix(prefix.size());
+                    if (name.find('.') != std::string_view::npos)
+                    {
+                        result.ignored_keys.push_back(key); // W.call.input, a call-level override
+                        in.skip_value();
+                        continue;
+                    }
+                    auto it = declared.find(name);
+                    if (it == declared.end())
+                    {
+                        binder.error_at(key_at, "not an input of workflow " + workflow);
+                        in.skip_value();
+                        continue;
+                    }
+                    const workflow_input &input = *it->second;
+                    binder.decl_line = input.line;
+                    if (result.values.count(input.name))
+                    {
+                        binder.error_at(key_at, "set more than once");
+                        in.skip_value();
+                        continue;
+                    }
+                    result.values.emplace(input.name, binder.bind(input.type));
+                } while (in.consume(','));
+                in.expect('}');
+            }
+            if (in.peek() != '\0')
+                in.fail("trailing characters after the inputs object");
+        }
+        catch (const json_syntax_error &e)
+        {
+            if (e.at) // the error cap throws with no position, that one's already reported
+            {
+                binder.path.clear();
+                binder.decl_line = 0;
+                input_error syntax;
+                syntax.message = "invalid JSON: " + e.message;
+                std::tie(syntax.json_line, syntax.json_column) = in.position_of(e.at);
+                result.errors.push_back(std::move(syntax));
+            }
+            return result;
+        }
+
+        for (const auto &input : inputs)
+        {
+            if (input.type.optional || input.has_default || result.values.count(input.name))
+                continue;
+            input_error missing;
+            missing.key = prefix + input.name;
+            missing.message = "missing required input (" + input.type.to_string() + ")";
+            missing.decl_line = input.line;
+            result.errors.push_back(std::move(missing));
+        }
+        return result;
+    }
+
+    bound_inputs bind_inputs_json(const std::string &json_path, const ast_node_ptr &program, const std::string &workflow)
+    {
+        const ast_node *wf = find_workflow(program, workflow);
+        if (!wf)
+        {
+            bound_inputs result;
+            result.workflow = workflow;
+            input_error none;
+            none.message = workflow.empty() ? "no workflow to bind inputs to" : "no workflow named " + workflow;
+            result.errors.push_back(std::move(none));
+            return result;
+        }
+        const std::string name = trimmed(std::get<class_decl>(wf->node).identifier->tok->lexeme);
+        std::vector<workflow_input> inputs;
+        struct_table structs;
+        try
+        {
+            inputs = collect_workflow_inputs(program, *wf);
+            structs = collect_structs(program);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            // a declaration the parser let through but we can't make sense of...
+            bound_inputs result;
+            result.workflow = name;
+            input_error bad_type;
+            bad_type.message = e.what();
+            result.errors.push_back(std::move(bad_type));
+            return result;
+        }
+        mapped_file json(json_path);
+        return bind_inputs(json.view(), name, inputs, structs);
+    }
+
+    std::string format_input_error(const input_error &error, const std::string &json_path)
+    {
+        std::string out = json_path;
+        if (error.json_line)
+            out += ":" + std::to_string(error.json_line) + ":" + std::to_string(error.json_column);
+        out += ": ";
+        if (!error.key.empty())
+            out += error.key + ": ";
+        out += error.message;
+        if (error.decl_line)
+            out += " (declared at line " + std::to_string(error.decl_line) + ")";
+        return out;
+    }
+
+}
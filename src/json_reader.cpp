@@ -0,0 +1,272 @@
+#include "json_reader.h"
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace soto
+{
+
+    static const json_node json_null{};
+
+    const json_node &json_node::operator[](std::string_view key) const
+    {
+        if (kind == JN_OBJECT)
+            for (const auto &[name, value] : members)
+                if (name == key)
+                    return value;
+        return json_null;
+    }
+
+    bool json_node::has(std::string_view key) const
+    {
+        return &(*this)[key] != &json_null;
+    }
+
+    struct json_parser
+    {
+    public:
+        const char *p;
+        const char *end;
+        int depth = 0;
+
+        [[noreturn]] void fail(const std::string &message) const
+        {
+            throw std::runtime_error("Invalid JSON: " + message);
+        }
+        void skip_ws()
+        {
+            while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+                ++p;
+        }
+        void literal(std::string_view word)
+        {
+            if (static_cast<std::size_t>(end - p) < word.size() || std::string_view(p, word.size()) != word)
+                fail("invalid literal");
+            p += word.size();
+        }
+
+        static void append_utf8(std::string &out, std::uint32_t cp)
+        {
+            if (cp < 0x80)
+                out += static_cast<char>(cp);
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+        std::uint32_t hex4()
+        {
+            if (end - p < 4)
+                fail("short \\u escape");
+            std::uint32_t v = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *p++;
+                v <<= 4;
+                if (c >= '0' && c <= '9')
+                    v |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    v |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    v |= c - 'A' + 10;
+                else
+                    fail("bad \\u escape");
+            }
+            return v;
+        }
+        void read_string(std::string &out)
+        {
+            ++p; // the opening quote
+            const char *start = p;
+            while (p < end && *p != '"' && *p != '\\')
+                ++p;
+            out.assign(start, p);
+            while (true)
+            {
+                if (p >= end)
+                    fail("unterminated string");
+                char c = *p++;
+                if (c == '"')
+                    return;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (p >= end)
+                    fail("unterminated string");
+                switch (*p++)
+                {
+                case '"':
+                    out += '"';
+                    break;
+                case '\\':
+                    out += '\\';
+                    break;
+                case '/':
+                    out += '/';
+                    break;
+                case 'b':
+                    out += '\b';
+                    break;
+                case 'f':
+                    out += '\f';
+                    break;
+                case 'n':
+                    out += '\n';
+                    break;
+                case 'r':
+                    out += '\r';
+                    break;
+                case 't':
+                    out += '\t';
+                    break;
+                case 'u':
+                {
+                    std::uint32_t cp = hex4();
+                    if (cp >= 0xD800 && cp < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                    {
+                        p += 2;
+                        std::uint32_t low = hex4();
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    fail("bad escape");
+                }
+            }
+        }
+
+        void value(json_node &out)
+        {
+            if (++depth > 256)
+                fail("nested too deep");
+            skip_ws();
+            if (p >= end)
+                fail("unexpected end");
+            switch (*p)
+            {
+            case '{':
+                out.kind = JN_OBJECT;
+                ++p;
+                skip_ws();
+                if (p < end && *p == '}')
+                {
+                    ++p;
+                    break;
+                }
+                while (true)
+                {
+                    skip_ws();
+                    if (p >= end || *p != '"')
+                        fail("expected a key");
+                    auto &member = out.members.emplace_back();
+                    read_string(member.first);
+                    skip_ws();
+                    if (p >= end || *p++ != ':')
+                        fail("expected ':'");
+                    value(member.second);
+                    skip_ws();
+                    if (p < end && *p == ',')
+                    {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == '}')
+                    {
+                        ++p;
+                        break;
+                    }
+                    fail("expected ',' or '}'");
+                }
+                break;
+            case '[':
+                out.kind = JN_ARRAY;
+                ++p;
+                skip_ws();
+                if (p < end && *p == ']')
+                {
+                    ++p;
+                    break;
+                }
+                while (true)
+                {
+                    value(out.items.emplace_back());
+                    skip_ws();
+                    if (p < end && *p == ',')
+                    {
+                        ++p;
+                        continue;
+                    }
+                    if (p < end && *p == ']')
+                    {
+                        ++p;
+                        break;
+                    }
+                    fail("expected ',' or ']'");
+                }
+                break;
+            case '"':
+                out.kind = JN_STRING;
+                read_string(out.text);
+                break;
+            case 't':
+                literal("true");
+                out.kind = JN_BOOL;
+                out.boolean = true;
+                break;
+            case 'f':
+                literal("false");
+                out.kind = JN_BOOL;
+                break;
+            case 'n':
+                literal("null");
+                break;
+            default:
+            {
+                // strtod wants a terminator, numbers are short... copy them out
+                const char *start = p;
+                while (p < end && (std::isdigit(static_cast<unsigned char>(*p)) || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E'))
+                    ++p;
+                if (p == start)
+                    fail("unexpected character");
+                std::string digits(start, p);
+                char *stop = nullptr;
+                out.kind = JN_NUMBER;
+                out.number = std::strtod(digits.c_str(), &stop);
+                if (stop != digits.c_str() + digits.size())
+                    fail("bad number");
+            }
+            }
+            --depth;
+        }
+    };
+
+    json_node parse_json(std::string_view text)
+    {
+        json_parser parser{text.data(), text.data() + text.size()};
+        json_node root;
+        parser.value(root);
+        parser.skip_ws();
+        if (parser.p != parser.end)
+            parser.fail("trailing characters");
+        return root;
+    }
+
+}
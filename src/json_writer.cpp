@@ -0,0 +1,304 @@
+#include "json_writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace soto
+{
+
+    json_writer::json_writer(const std::string &path, json_style style, std::size_t buffer_bytes)
+        : path(path), buffer_bytes(buffer_bytes), style(style)
+    {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open file: " + path);
+        buf.reserve(buffer_bytes);
+    }
+
+    json_writer::json_writer(std::string &target, json_style style)
+        : target(&target), style(style)
+    {
+    }
+
+    json_writer::~json_writer()
+    {
+        try
+        {
+            flush();
+        }
+        catch (const std::exception &)
+        {
+            // nothing sensible to do about a full disk from a destructor...
+        }
+        if (fd >= 0)
+            ::close(fd);
+    }
+
+    void json_writer::flush()
+    {
+        if (target || buf.empty())
+            return;
+        std::size_t off = 0;
+        while (off < buf.size())
+        {
+            ssize_t n = ::write(fd, buf.data() + off, buf.size() - off);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0)
+            {
+                buf.clear();
+                throw std::runtime_error("Failed to write to file: " + path + ": " + std::strerror(errno));
+            }
+            off += static_cast<std::size_t>(n);
+        }
+        written += buf.size();
+        buf.clear();
+    }
+
+    void json_writer::newline_indent()
+    {
+        std::string &out = sink();
+        out += '\n';
+        out.append(stack.size() * 2, ' ');
+    }
+
+    void json_writer::before_value()
+    {
+        if (after_key)
+        {
+            after_key = false;
+            return;
+        }
+        if (stack.empty())
+            return;
+        if (stack.back().is_object)
+            throw std::logic_error("json_writer: a value inside an object needs a key first");
+        std::string &out = sink();
+        if (stack.back().has_items)
+            out += ',';
+        stack.back().has_items = true;
+        if (style == JSON_PRETTY)
+            newline_indent();
+    }
+
+    json_writer &json_writer::key(std::string_view name)
+    {
+        if (stack.empty() || !stack.back().is_object || after_key)
+            throw std::logic_error("json_writer: key outside of an object");
+        std::string &out = sink();
+        if (stack.back().has_items)
+            out += ',';
+        stack.back().has_items = true;
+        if (style == JSON_PRETTY)
+            newline_indent();
+        append_string(name);
+        out += style == JSON_PRETTY ? ": " : ":";
+        after_key = true;
+        return *this;
+    }
+
+    json_writer &json_writer::begin_object()
+    {
+        before_value();
+        sink() += '{';
+        stack.push_back({true});
+        return *this;
+    }
+
+    json_writer &json_writer::begin_array()
+    {
+        before_value();
+        sink() += '[';
+        stack.push_back({false});
+        return *this;
+    }
+
+    json_writer &json_writer::end_object()
+    {
+        if (stack.empty() || !stack.back().is_object || after_key)
+            throw std::logic_error("json_writer: end_object without a matching begin_object");
+        bool had_items = stack.back().has_items;
+        stack.pop_back();
+        if (style == JSON_PRETTY && had_items)
+            newline_indent();
+        sink() += '}';
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::end_array()
+    {
+        if (stack.empty() || stack.back().is_object)
+            throw std::logic_error("json_writer: end_array without a matching begin_array");
+        bool had_items = stack.back().has_items;
+        stack.pop_back();
+        if (style == JSON_PRETTY && had_items)
+            newline_indent();
+        sink() += ']';
+        maybe_flush();
+        return *this;
+    }
+
+    void json_writer::append_string(std::string_view s)
+    {
+        static const char HEX[] = "0123456789abcdef";
+        std::string &out = sink();
+        out += '"';
+        std::size_t run = 0; // start of the stretch that needs no escaping, copied in one go
+        for (std::size_t i = 0; i < s.size(); ++i)
+        {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\')
+                continue;
+            out.append(s.data() + run, i - run);
+            run = i + 1;
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\b':
+                out += "\\b";
+                break;
+            case '\f':
+                out += "\\f";
+                break;
+            default:
+                out += "\\u00";
+                out += HEX[c >> 4];
+                out += HEX[c & 0xF];
+                break;
+            }
+        }
+        out.append(s.data() + run, s.size() - run);
+        out += '"';
+    }
+
+    json_writer &json_writer::value(std::string_view s)
+    {
+        before_value();
+        append_string(s);
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::value(std::int64_t i)
+    {
+        before_value();
+        char tmp[24];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), i);
+        sink().append(tmp, r.ptr);
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::value(std::uint64_t i)
+    {
+        before_value();
+        char tmp[24];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), i);
+        sink().append(tmp, r.ptr);
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::value(double d)
+    {
+        if (!std::isfinite(d))
+            return null();
+        before_value();
+        char tmp[32];
+        auto r = std::to_chars(tmp, tmp + sizeof(tmp), d); // shortest text that reads back as the same double
+        std::string &out = sink();
+        out.append(tmp, r.ptr);
+        // keep it a float on the way back in, 25 would come back as an Int...
+        if (std::find_if(tmp, r.ptr, [](char c)
+                         { return c == '.' || c == 'e'; }) == r.ptr)
+            out += ".0";
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::value(bool b)
+    {
+        before_value();
+        sink() += b ? "true" : "false";
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::null()
+    {
+        before_value();
+        sink() += "null";
+        maybe_flush();
+        return *this;
+    }
+
+    json_writer &json_writer::value(const wdl_value &v)
+    {
+        switch (v.kind)
+        {
+        case WT_NONE:
+            return null();
+        case WT_BOOLEAN:
+            return value(v.as_bool());
+        case WT_INT:
+            return value(v.as_int());
+        case WT_FLOAT:
+            return value(v.as_float());
+        case WT_STRING:
+        case WT_FILE:
+        case WT_DIRECTORY:
+            return value(std::string_view(v.as_string()));
+        case WT_ARRAY:
+            begin_array();
+            for (const auto &e : v.as_array())
+                value(e);
+            return end_array();
+        case WT_MAP:
+            begin_object();
+            for (const auto &[k, e] : v.as_map())
+            {
+                if (k.kind == WT_STRING || k.kind == WT_FILE || k.kind == WT_DIRECTORY)
+                    key(k.as_string());
+                else
+                    key(k.to_string());
+                value(e);
+            }
+            return end_object();
+        case WT_PAIR:
+            begin_object();
+            key("left").value(v.as_pair().first);
+            key("right").value(v.as_pair().second);
+            return end_object();
+        case WT_OBJECT:
+        case WT_STRUCT:
+            begin_object();
+            for (const auto &[name, e] : v.as_object().members)
+                key(name).value(e);
+            return end_object();
+        default:
+            return null();
+        }
+    }
+
+}
@@ -13,13 +13,17 @@ namespace soto
 {
 
     lexer::lexer(std::string input)
-        : source(std::move(input)), position(-2), line(std::make_shared<int>(1)), column(std::make_shared<int>(-1))
+        : source(std::move(input)), position(-2)
     {
+#ifdef WDLRUNNER_DEBUG_TOKENS
         std::cout << "the input source to be tokenized is >>> " << source << std::endl;
+#endif
 
+        // the source is kept byte for byte so token offsets are file offsets... \r and runs of blank lines,
+        // which used to be stripped out up front, are skipped by lex() instead
+        lines = std::make_shared<const source_lines>(source);
         if (!source.empty())
         {
-            source = canonicalize_source_str(source);
             c_char = source[0];
             n_char = (source.length() > 1) ? source[1] : '\0';
         }
@@ -36,43 +40,16 @@ namespace soto
     {
         return std::make_unique<lexer>(*this);
     }
-    std::string lexer::canonicalize_source_str(const std::string &source)
+    token lexer::peek()
     {
-        std::string result;
-        result.reserve(source.size());
-
-        bool last_was_newline = false;
-
-        for (size_t i = 0; i < source.length(); ++i)
-        {
-            if (source[i] == '\r')
-            {
-                if (i + 1 < source.length() && source[i + 1] == '\n')
-                {
-                    continue;
-                }
-                continue;
-            }
-
-            if (source[i] == '\n')
-            {
-                if (last_was_newline)
-                {
-                    continue; // Skip consecutive newlines
-                }
-                last_was_newline = true;
-            }
-            else
-            {
-                last_was_newline = false;
-            }
-
-            result += source[i];
-        }
-
-        return result;
+        const int saved_position = position;
+        const unsigned char saved_c = c_char, saved_n = n_char;
+        token t = lex();
+        position = saved_position;
+        c_char = saved_c;
+        n_char = saved_n;
+        return t;
     }
-
     token lexer::lex()
     {
         token tok{T_EOF, "\0"};
@@ -90,10 +67,15 @@ namespace soto
         }
         else if (is_newline_char(c_char))
         {
-            return new_token(T_ENDL, "\\n", position);
+            // blank lines (and the \r of \r\n) fold into this one T_ENDL, the parser never wants more than one
+            int start_pos = position;
+            while (n_char == '\n' || n_char == '\r')
+                next_token();
+            return new_token(T_ENDL, "\\n", start_pos);
         }
         else if (c_char == '\0')
         {
+            tok.offset = static_cast<int>(source.size()); // EOF doesn't go through new_token(), errors "at end" still want a line
             return tok;
         }
         else if (c_char == '(')
@@ -134,6 +116,7 @@ namespace soto
             if (n_char == '=')
             {
                 l += n_char;
+                next_token();
                 return new_token(T_EQUALITY, l, position);
             }
             return new_token(T_ASSIGN, l, position);
@@ -195,6 +178,8 @@ namespace soto
             {
                 next_token();
             }
+            while (n_char == '\n' || n_char == '\r') // blank lines after it go with the newline that ends it
+                next_token();
             return lex();
         }
         else if (c_char == '&')
@@ -288,13 +273,13 @@ namespace soto
             return new_token(T_DOT, l, position);
         }
 
-        return tok;
+        // a stray character ('\\', '$', '~', '@'...) used to come back as T_EOF and quietly cut the file short...
+        return new_token(T_ERROR, "[ERROR] Invalid token: " + l, position);
     }
     token lexer::new_token(const token_kind &kind, const std::string &lexeme, int start_pos)
     {
         token tok{kind, lexeme};
-        tok.line = *line;                              // set it to current line int value on the lexer...
-        tok.column = *column - (position - start_pos); // a token's column is it's start index / start index of it's lexeme in the source code...
+        tok.offset = start_pos; // line and column are worked out from lines when somebody asks
         return tok;
     }
     token lexer::new_token(const token_kind &kind, const std::string &lexeme, int start_pos, int int_val)
@@ -321,8 +306,6 @@ namespace soto
         {
             n_char = '\0';
         }
-        (*column)++;
-        // this is no longer needed...if (position >= 0) //only start incrementing column once we've reach the start of the source.... not while we're still advancing away from EOF...inshort BOM
     }
     token lexer::make_string_literal_token()
     {
@@ -363,7 +346,7 @@ namespace soto
         {
             return new_token(T_ERROR, std::string(1, c_char), start_pos);
         }
-        next_token();
+        // no unconditional step first... it put whatever follows a one-letter name ("i ", "x.") into its lexeme
         while ((std::isalnum(c_char) || c_char == '_') && is_char_a_valid_ident_elem(n_char))
         {
             next_token();
@@ -377,16 +360,48 @@ namespace soto
                 return new_token(T_ERROR, "Expect <<< or { after command keyword", start_pos);
             }
             size_t cmd_start = position + 1;
-            std::string_view stop_codon = (tok.kind == T_LSHIFT_ASSIGN) ? ">>>" : "}";
-            size_t end_pos = source.find(stop_codon, cmd_start);
-            // size_t end_pos = source.find(">>>", cmd_start);
+            size_t end_pos = std::string::npos;
+            if (tok.kind == T_LSHIFT_ASSIGN)
+            {
+                end_pos = source.find(">>>", cmd_start);
+            }
+            else
+            {
+                // command { ... } closes on the '}' matching the '{', not on the first one... ~{x} and ${x} nest
+                int depth = 0;
+                for (size_t i = cmd_start; i < source.size(); ++i)
+                {
+                    if (source[i] == '{')
+                        depth++;
+                    else if (source[i] == '}' && depth-- == 0)
+                    {
+                        end_pos = i;
+                        break;
+                    }
+                }
+            }
             if (end_pos == std::string::npos)
             {
                 return new_token(T_ERROR, "Unterminated command block", start_pos);
             }
             std::string cmd_body = source.substr(cmd_start, end_pos - cmd_start);
+            if (cmd_body.find('\r') != std::string::npos) // a CRLF file... the script itself gets plain \n
+                cmd_body.erase(std::remove(cmd_body.begin(), cmd_body.end(), '\r'), cmd_body.end());
+#ifdef WDLRUNNER_DEBUG_TOKENS
             std::cout << "command body >>> " << cmd_body << std::endl;
-            position = end_pos + 3; // we move past the closing >>> i.e T_RSHIFT_ASSIGN
+#endif
+            if (tok.kind == T_LSHIFT_ASSIGN)
+            {
+                // sitting on the last '>' of the closing >>>, the next lex() steps past it... n_char has to follow
+                // or it still holds the character after the opening <<< and whatever follows >>> gets replaced by it
+                position = end_pos + 2;
+                n_char = end_pos + 3 < source.length() ? source[end_pos + 3] : '\0';
+            }
+            else
+            {
+                position = end_pos; // sitting on the '}', the next lex() steps past it
+                n_char = end_pos + 1 < source.length() ? source[end_pos + 1] : '\0';
+            }
             return new_token(T_COMMAND, cmd_body, start_pos);
         }
         return new_token(T_IDENT, ident, start_pos);
@@ -450,11 +465,7 @@ namespace soto
         for (;;)
         {
             if (is_newline_char(c_char))
-            {
-                (*line)++; // increment the line...
-                (*column) = 1;
                 break;
-            }
             if (c_char != '\0' && std::isspace(c_char))
             {
                 next_token();
@@ -468,11 +479,7 @@ namespace soto
     void lexer::skip_comments()
     {
         if (is_newline_char(c_char))
-        {
-            (*line)++; // increment the line...
-            (*column) = 1;
             return;
-        }
         if (c_char != '\0' && (c_char == '#' || (c_char = '/' && n_char == '/')))
         {
             // skip the comment...
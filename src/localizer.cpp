@@ -0,0 +1,264 @@
+#include "localizer.h"
+#include "trace.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace soto
+{
+    namespace fs = std::filesystem;
+
+    static bool try_reflink(const std::string &src, const std::string &dest)
+    {
+#ifdef FICLONE
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
+            return false;
+        struct stat st;
+        if (::fstat(in, &st) != 0)
+        {
+            ::close(in);
+            return false;
+        }
+        int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+        if (out < 0)
+        {
+            ::close(in);
+            return false;
+        }
+        bool ok = ::ioctl(out, FICLONE, in) == 0;
+        ::close(out);
+        ::close(in);
+        if (!ok)
+            ::unlink(dest.c_str());
+        return ok;
+#else
+        (void)src;
+        (void)dest;
+        return false;
+#endif
+    }
+
+    bool copy_file_contents(const std::string &src, const std::string &dest)
+    {
+        int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in < 0)
+            return false;
+        struct stat st;
+        if (::fstat(in, &st) != 0)
+        {
+            ::close(in);
+            return false;
+        }
+        int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777);
+        if (out < 0)
+        {
+            ::close(in);
+            return false;
+        }
+
+        bool ok = true;
+        off_t remaining = st.st_size;
+        bool in_kernel = true;
+        while (remaining > 0 && in_kernel)
+        {
+            // no bytes through userspace if the kernel can do it, and on NFS/CIFS this may even be server side...
+            ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, static_cast<std::size_t>(remaining), 0);
+            if (n > 0)
+            {
+                remaining -= n;
+                continue;
+            }
+            if (n == 0)
+                break;
+            if (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)
+                in_kernel = false; // old kernel or cross-fs, do it by hand below from where we stopped...
+            else
+            {
+                ok = false;
+                break;
+            }
+        }
+        if (ok && remaining > 0)
+        {
+            std::vector<char> buf(1 << 20);
+            for (;;)
+            {
+                ssize_t n = ::read(in, buf.data(), buf.size());
+                if (n < 0)
+                {
+                    ok = false;
+                    break;
+                }
+                if (n == 0)
+                    break;
+                for (ssize_t done = 0; done < n;)
+                {
+                    ssize_t w = ::write(out, buf.data() + done, static_cast<std::size_t>(n - done));
+                    if (w < 0)
+                    {
+                        ok = false;
+                        break;
+                    }
+                    done += w;
+                }
+                if (!ok)
+                    break;
+            }
+        }
+        ::close(out);
+        ::close(in);
+        if (!ok)
+            ::unlink(dest.c_str());
+        return ok;
+    }
+
+    // try every strategy once on a throwaway file in dir... what works here works for every call dir on this device
+    fs_capabilities localizer::probe(const std::string &dir)
+    {
+        static std::atomic<unsigned> counter{0};
+        fs_capabilities result{};
+        std::string base = (fs::path(dir) / (".wdlrunner_probe_" + std::to_string(::getpid()) + "_" + std::to_string(counter++))).string();
+        int fd = ::open(base.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+            return result; // can't even write here, nothing is going to work...
+        bool wrote = ::write(fd, "probe\n", 6) == 6;
+        ::close(fd);
+        if (wrote)
+        {
+            std::string clone = base + ".clone", link = base + ".link", sym = base + ".sym";
+            result.reflink = try_reflink(base, clone);
+            result.hardlink = ::link(base.c_str(), link.c_str()) == 0;
+            result.symlink = ::symlink(base.c_str(), sym.c_str()) == 0;
+            ::unlink(clone.c_str());
+            ::unlink(link.c_str());
+            ::unlink(sym.c_str());
+        }
+        ::unlink(base.c_str());
+        return result;
+    }
+
+    localizer::localizer(const std::string &work_root, localizer_options options) : options(options)
+    {
+        fs::create_directories(work_root);
+        capabilities_of(work_root);
+    }
+
+    fs_capabilities localizer::capabilities_of(const std::string &dir)
+    {
+        struct stat st;
+        if (::stat(dir.c_str(), &st) != 0)
+            throw std::runtime_error("Failed to stat directory: " + dir);
+        return capabilities_of(static_cast<std::uint64_t>(st.st_dev), dir);
+    }
+    fs_capabilities localizer::capabilities_of(std::uint64_t dev, const std::string &dir)
+    {
+        std::lock_guard<std::mutex> lock(caps_mutex);
+        auto it = caps.find(dev);
+        if (it != caps.end())
+            return it->second;
+        fs_capabilities found = probe(dir);
+        caps.emplace(dev, found);
+        return found;
+    }
+
+    localize_strategy localizer::place(const std::string &src, const std::string &dest, bool allow_symlink)
+    {
+        struct stat src_st;
+        if (::stat(src.c_str(), &src_st) != 0)
+            return L_FAILED;
+        fs::path dest_dir = fs::path(dest).parent_path();
+        if (dest_dir.empty())
+            dest_dir = ".";
+        std::error_code ec;
+        fs::create_directories(dest_dir, ec);
+        struct stat dir_st;
+        if (::stat(dest_dir.c_str(), &dir_st) != 0)
+            return L_FAILED;
+        fs_capabilities dest_caps = capabilities_of(static_cast<std::uint64_t>(dir_st.st_dev), dest_dir.string());
+        bool same_fs = src_st.st_dev == dir_st.st_dev; // reflinks and hardlinks never cross a filesystem...
+
+        // src already is dest (a cache hit restored into the call dir it was stored from)... nothing to do,
+        // and unlinking dest first would have deleted the only copy
+        struct stat dest_st;
+        if (::lstat(dest.c_str(), &dest_st) == 0 && dest_st.st_dev == src_st.st_dev && dest_st.st_ino == src_st.st_ino)
+            return L_HARDLINK;
+
+        // built next to dest and renamed over it, so an attempt that fails leaves whatever dest was alone
+        static std::atomic<unsigned> counter{0};
+        const std::string tmp = dest + ".wdlrunner_tmp_" + std::to_string(::getpid()) + "_" + std::to_string(counter++);
+        auto commit = [&](localize_strategy used)
+        {
+            if (::rename(tmp.c_str(), dest.c_str()) == 0)
+                return used;
+            ::unlink(tmp.c_str());
+            return L_FAILED;
+        };
+
+        // capabilities only say the filesystem CAN do it, the actual call can still refuse
+        // (permissions, protected_hardlinks, quota...) so every step falls through on failure
+        if (options.allow_reflink && same_fs && dest_caps.reflink && try_reflink(src, tmp))
+            return commit(L_REFLINK);
+        if (options.allow_hardlink && same_fs && dest_caps.hardlink && ::link(src.c_str(), tmp.c_str()) == 0)
+            return commit(L_HARDLINK);
+        if (allow_symlink && dest_caps.symlink)
+        {
+            std::string target = fs::absolute(src, ec).string();
+            if (!ec && ::symlink(target.c_str(), tmp.c_str()) == 0)
+                return commit(L_SYMLINK);
+        }
+        if (copy_file_contents(src, tmp))
+            return commit(L_COPY);
+        return L_FAILED;
+    }
+
+    localize_strategy localizer::localize(const std::string &src, const std::string &dest)
+    {
+        return place(src, dest, options.allow_symlink);
+    }
+
+    localize_strategy localizer::delocalize(const std::string &src, const std::string &dest)
+    {
+        return place(src, dest, false);
+    }
+
+    localize_report localizer::localize_call(const std::vector<std::string> &inputs, const std::string &call_dir)
+    {
+        WDL_TRACE_SCOPE_DETAIL("localize_call", call_dir);
+        auto t0 = std::chrono::steady_clock::now();
+        localize_report report{};
+        fs::path inputs_dir = fs::path(call_dir) / "inputs";
+        fs::create_directories(inputs_dir);
+
+        std::unordered_set<std::string> taken;
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            std::string name = fs::path(inputs[i]).filename().string();
+            fs::path dest = inputs_dir / name;
+            // two different inputs with the same basename (sample1/reads.bam, sample2/reads.bam) get their own subdir...
+            if (!taken.insert(name).second)
+                dest = inputs_dir / std::to_string(i) / name;
+
+            localize_strategy used = localize(inputs[i], dest.string());
+            if (used == L_FAILED)
+                throw std::runtime_error("Failed to localize input: " + inputs[i]);
+            report.counts[used]++;
+            report.paths.push_back(dest.string());
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        return report;
+    }
+
+}
@@ -0,0 +1,1050 @@
+#include "lsp_server.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include "json_writer.h"
+#include "lexer.h"
+#include "trace.h"
+#include "wdl_module.h"
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    // LSP error codes
+    static const int PARSE_ERROR = -32700;
+    static const int METHOD_NOT_FOUND = -32601;
+
+    // LSP symbol kinds
+    static const int SK_MODULE = 2;
+    static const int SK_CLASS = 5;
+    static const int SK_FIELD = 8;
+    static const int SK_FUNCTION = 12;
+    static const int SK_VARIABLE = 13;
+    static const int SK_STRUCT = 23;
+
+    static bool ident_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    static std::string trimmed(const std::string &s)
+    {
+        std::size_t b = s.find_first_not_of(" \t\r\n\"'");
+        if (b == std::string::npos)
+            return "";
+        std::size_t e = s.find_last_not_of(" \t\r\n\"'");
+        return s.substr(b, e - b + 1);
+    }
+
+    static std::string uri_to_path(const std::string &uri)
+    {
+        if (uri.rfind("file://", 0) != 0)
+            return uri;
+        std::string path;
+        for (std::size_t i = 7; i < uri.size(); ++i)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2])))
+            {
+                path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            }
+            else
+                path += uri[i];
+        }
+        return path;
+    }
+
+    static std::string path_to_uri(const std::string &path)
+    {
+        static const char *hex = "0123456789ABCDEF";
+        std::string uri = "file://";
+        for (unsigned char c : path)
+        {
+            if (std::isalnum(c) || c == '/' || c == '-' || c == '_' || c == '.' || c == '~')
+                uri += static_cast<char>(c);
+            else
+            {
+                uri += '%';
+                uri += hex[c >> 4];
+                uri += hex[c & 15];
+            }
+        }
+        return uri;
+    }
+
+    // ---- positions... byte offsets inside, UTF-16 (line, character) on the wire
+
+    static std::size_t line_of(const lsp_document &doc, std::size_t offset)
+    {
+        auto it = std::upper_bound(doc.line_starts.begin(), doc.line_starts.end(), offset);
+        return static_cast<std::size_t>(it - doc.line_starts.begin()) - 1;
+    }
+
+    static std::size_t line_end(const lsp_document &doc, std::size_t line)
+    {
+        std::size_t end = line + 1 < doc.line_starts.size() ? doc.line_starts[line + 1] - 1 : doc.text.size();
+        if (end > doc.line_starts[line] && doc.text[end - 1] == '\r')
+            --end;
+        return end;
+    }
+
+    static std::size_t utf16_units(std::string_view s)
+    {
+        std::size_t units = 0;
+        for (std::size_t i = 0; i < s.size();)
+        {
+            unsigned char c = static_cast<unsigned char>(s[i]);
+            std::size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+            units += len == 4 ? 2 : 1;
+            i += len;
+        }
+        return units;
+    }
+
+    static void write_position(json_writer &json, const lsp_document &doc, std::size_t offset)
+    {
+        offset = std::min(offset, doc.text.size());
+        std::size_t line = line_of(doc, offset);
+        std::size_t start = doc.line_starts[line];
+        json.begin_object();
+        json.key("line").value(static_cast<std::uint64_t>(line));
+        json.key("character").value(static_cast<std::uint64_t>(utf16_units(std::string_view(doc.text).substr(start, offset - start))));
+        json.end_object();
+    }
+
+    static void write_range(json_writer &json, const lsp_document &doc, std::size_t begin, std::size_t end)
+    {
+        json.begin_object();
+        json.key("start");
+        write_position(json, doc, begin);
+        json.key("end");
+        write_position(json, doc, end);
+        json.end_object();
+    }
+
+    static std::size_t offset_of(const lsp_document &doc, const json_node &position)
+    {
+        std::int64_t line = position["line"].integer();
+        std::int64_t character = position["character"].integer();
+        if (line < 0 || doc.line_starts.empty())
+            return 0;
+        if (static_cast<std::size_t>(line) >= doc.line_starts.size())
+            return doc.text.size();
+        std::size_t i = doc.line_starts[static_cast<std::size_t>(line)];
+        std::size_t end = line_end(doc, static_cast<std::size_t>(line));
+        for (std::int64_t units = 0; i < end && units < character;)
+        {
+            unsigned char c = static_cast<unsigned char>(doc.text[i]);
+            std::size_t len = c < 0x80 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+            units += len == 4 ? 2 : 1;
+            i += len;
+        }
+        return std::min(i, end);
+    }
+
+    // ---- chunks
+
+    static const char *const TOP_LEVEL[] = {"task", "workflow", "struct"};
+
+    // one linear pass... braces are counted outside strings, comments and <<< >>> commands, and a keyword
+    // in column 0 starts a declaration whatever the count says, so one unbalanced brace in a command
+    // can't merge the rest of the file into a single chunk
+    static std::vector<lsp_chunk> split_chunks(const std::string &text)
+    {
+        std::vector<lsp_chunk> chunks(1); // the header, possibly empty
+        const std::size_t n = text.size();
+        int depth = 0;
+        char quote = 0;
+        bool heredoc = false;
+        bool line_start = true;
+        for (std::size_t i = 0; i < n;)
+        {
+            if (line_start)
+            {
+                line_start = false;
+                std::size_t j = i;
+                while (j < n && (text[j] == ' ' || text[j] == '\t'))
+                    ++j;
+                if (!heredoc && !quote && (depth == 0 || j == i))
+                {
+                    for (const char *kw : TOP_LEVEL)
+                    {
+                        std::size_t len = std::strlen(kw);
+                        if (text.compare(j, len, kw) != 0 || j + len >= n || !std::isspace(static_cast<unsigned char>(text[j + len])))
+                            continue;
+                        std::size_t k = j + len;
+                        while (k < n && (text[k] == ' ' || text[k] == '\t'))
+                            ++k;
+                        std::size_t name_begin = k;
+                        while (k < n && ident_char(text[k]))
+                            ++k;
+                        if (k == name_begin)
+                            continue;
+                        chunks.back().end = i;
+                        lsp_chunk &c = chunks.emplace_back();
+                        c.begin = i;
+                        c.keyword = kw;
+                        c.name = text.substr(name_begin, k - name_begin);
+                        c.name_offset = name_begin;
+                        depth = 0;
+                        break;
+                    }
+                }
+            }
+            char c = text[i];
+            if (heredoc)
+            {
+                if (text.compare(i, 3, ">>>") == 0)
+                {
+                    heredoc = false;
+                    i += 3;
+                    continue;
+                }
+            }
+            else if (quote)
+            {
+                if (c == '\\')
+                {
+                    i += 2;
+                    continue;
+                }
+                if (c == quote || c == '\n')
+                    quote = 0;
+            }
+            else if (c == '#')
+            {
+                while (i < n && text[i] != '\n')
+                    ++i;
+                continue;
+            }
+            else if (text.compare(i, 3, "<<<") == 0)
+            {
+                heredoc = true;
+                i += 3;
+                continue;
+            }
+            else if (c == '"' || c == '\'')
+                quote = c;
+            else if (c == '{')
+                ++depth;
+            else if (c == '}')
+                depth = std::max(0, depth - 1);
+            if (c == '\n')
+                line_start = true;
+            ++i;
+        }
+        chunks.back().end = n;
+        return chunks;
+    }
+
+    void lsp_server::update(lsp_document &doc)
+    {
+        WDL_TRACE_SCOPE_DETAIL("lsp_update", doc.path);
+        const auto started = std::chrono::steady_clock::now();
+        doc.line_starts.assign(1, 0);
+        for (std::size_t i = 0; i < doc.text.size(); ++i)
+            if (doc.text[i] == '\n')
+                doc.line_starts.push_back(i + 1);
+
+        // the cache only holds weak references... the previous version's chunks keep what didn't change alive until we've looked
+        std::vector<lsp_chunk> previous = std::move(doc.chunks);
+        doc.chunks = split_chunks(doc.text);
+        for (auto &chunk : doc.chunks)
+        {
+            std::string_view text = std::string_view(doc.text).substr(chunk.begin, chunk.end - chunk.begin);
+            const std::uint64_t key = xxh64(text.data(), text.size());
+            auto it = chunk_cache.find(key);
+            if (it != chunk_cache.end())
+            {
+                auto cached = it->second.lock();
+                if (cached && cached->text == text)
+                {
+                    chunk.parsed = std::move(cached);
+                    chunks_reused++;
+                    continue;
+                }
+            }
+            auto parsed = std::make_shared<lsp_parsed_chunk>();
+            parsed->text = std::string(text);
+            parser p{std::make_unique<lexer>(parsed->text), &parsed->diagnostics};
+            parsed->program = p.parse_program();
+            chunk_cache[key] = parsed;
+            chunk.parsed = std::move(parsed);
+            chunks_parsed++;
+        }
+        // chunks only the cache remembers are from versions nobody has open anymore
+        if (chunk_cache.size() > 4096)
+            for (auto it = chunk_cache.begin(); it != chunk_cache.end();)
+                it = it->second.expired() ? chunk_cache.erase(it) : std::next(it);
+        last_update_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    }
+
+    const lsp_document *lsp_server::document_for_uri(const std::string &uri)
+    {
+        auto it = open.find(uri);
+        return it == open.end() ? nullptr : &it->second;
+    }
+
+    const lsp_document *lsp_server::document_for_path(const std::string &path)
+    {
+        for (const auto &[uri, doc] : open)
+            if (doc.path == path)
+                return &doc;
+        file_stamp now{};
+        if (!stat_file(path, now))
+            return nullptr;
+        auto it = disk.find(path);
+        if (it != disk.end() && it->second.stamp == now)
+            return &it->second;
+        std::ifstream file(path);
+        if (!file)
+            return nullptr;
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        lsp_document &doc = disk[path];
+        doc.uri = path_to_uri(path);
+        doc.path = path;
+        doc.text = ss.str();
+        doc.stamp = now;
+        update(doc);
+        return &doc;
+    }
+
+    // ---- reading the AST of a chunk
+
+    static const ast_node *chunk_decl(const lsp_chunk &chunk)
+    {
+        if (!chunk.parsed || !chunk.parsed->program)
+            return nullptr;
+        const auto *prog = std::get_if<program>(&chunk.parsed->program->node);
+        if (!prog)
+            return nullptr;
+        for (const auto &d : prog->declarations)
+            if (d && (std::holds_alternative<class_decl>(d->node) || std::holds_alternative<struct_decl>(d->node)))
+                return d.get();
+        return nullptr;
+    }
+
+    struct lsp_decl
+    {
+    public:
+        std::string type;
+        std::string name;
+        std::string section; // input, output, or empty for private declarations and struct members
+    };
+
+    struct lsp_call
+    {
+    public:
+        std::string target; // task, or namespace.task
+        std::string alias;  // what its outputs are reached through, the task name when there's no `as`
+        bool aliased = false;
+    };
+
+    static void collect(const ast_node_ptr &node, const std::string &section, std::vector<lsp_decl> &decls, std::vector<lsp_call> *calls)
+    {
+        if (!node)
+            return;
+        std::visit(
+            [&](auto &&value)
+            {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, program>)
+                {
+                    for (const auto &d : value.declarations)
+                        collect(d, section, decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, var_decl>)
+                {
+                    if (!value.type || !value.type->tok || !value.identifier || !value.identifier->tok)
+                        return;
+                    std::string type = trimmed(value.type->tok->lexeme);
+                    if (value.type->type == N_TYPE_NULLABLE && (type.empty() || type.back() != '?'))
+                        type += '?';
+                    decls.push_back({type, trimmed(value.identifier->tok->lexeme), section});
+                }
+                else if constexpr (std::is_same_v<T, class_decl> || std::is_same_v<T, struct_decl>)
+                {
+                    for (const auto &m : value.members)
+                        collect(m, section, decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, input_decl>)
+                {
+                    collect(value.body, "input", decls, calls);
+                    for (const auto &m : value.members)
+                        collect(m, "input", decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, output_decl>)
+                {
+                    collect(value.body, "output", decls, calls);
+                    for (const auto &m : value.members)
+                        collect(m, "output", decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, block>)
+                {
+                    for (const auto &s : value.statements)
+                        collect(s, section, decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, scatter_stmt>)
+                {
+                    if (value.identifier && value.identifier->tok)
+                        decls.push_back({"scatter variable", trimmed(value.identifier->tok->lexeme), ""});
+                    collect(value.body, section, decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, if_stmt>)
+                {
+                    collect(value.then_, section, decls, calls);
+                    collect(value.else_if, section, decls, calls);
+                    collect(value.else_, section, decls, calls);
+                }
+                else if constexpr (std::is_same_v<T, call_decl>)
+                {
+                    const auto *access = value.member_accessed ? std::get_if<member_access>(&value.member_accessed->node) : nullptr;
+                    if (!calls || !access || !access->object || !access->object->tok)
+                        return;
+                    lsp_call call;
+                    call.target = trimmed(access->object->tok->lexeme);
+                    if (access->member && access->member->tok)
+                        call.target += "." + trimmed(access->member->tok->lexeme);
+                    call.aliased = value.alias && value.alias->tok;
+                    call.alias = call.aliased ? trimmed(value.alias->tok->lexeme) : call.target.substr(call.target.rfind('.') + 1);
+                    calls->push_back(std::move(call));
+                }
+            },
+            node->node);
+    }
+
+    // the declaration of `name` inside [begin, end)... the first whole-word occurrence that reads like one:
+    // a type (or `as`/`scatter (`) right before it, `=` or the end of the line right after it
+    static std::size_t find_declaration(const std::string &text, std::size_t begin, std::size_t end, const std::string &name)
+    {
+        for (std::size_t at = text.find(name, begin); at != std::string::npos && at + name.size() <= end; at = text.find(name, at + 1))
+        {
+            if ((at > 0 && ident_char(text[at - 1])) || (at + name.size() < text.size() && ident_char(text[at + name.size()])))
+                continue;
+            std::size_t before = at;
+            while (before > begin && (text[before - 1] == ' ' || text[before - 1] == '\t'))
+                --before;
+            if (before == at || before == begin)
+                continue;
+            char prev = text[before - 1];
+            if (!ident_char(prev) && prev != ']' && prev != '?' && prev != '(')
+                continue;
+            std::size_t after = at + name.size();
+            while (after < end && (text[after] == ' ' || text[after] == '\t'))
+                ++after;
+            if (after >= end || text[after] == '=' || text[after] == '\n' || text[after] == '\r' || text[after] == '{' ||
+                text.compare(after, 3, "in ") == 0)
+                return at;
+        }
+        return std::string::npos;
+    }
+
+    static const lsp_chunk *chunk_at(const lsp_document &doc, std::size_t offset)
+    {
+        for (const auto &c : doc.chunks)
+            if (offset >= c.begin && offset < std::max(c.end, c.begin + 1))
+                return &c;
+        return doc.chunks.empty() ? nullptr : &doc.chunks.back();
+    }
+
+    static const lsp_chunk *chunk_named(const lsp_document &doc, const std::string &name)
+    {
+        for (const auto &c : doc.chunks)
+            if (!c.keyword.empty() && c.name == name)
+                return &c;
+        return nullptr;
+    }
+
+    struct lsp_import
+    {
+    public:
+        std::string path; // canonical
+        std::string alias;
+        std::size_t literal_begin = 0; // where the path string is in the document, for go-to-definition on it
+        std::size_t literal_end = 0;
+    };
+
+    // out of the header's AST, positions by finding the literal in the header's text
+    static std::vector<lsp_import> imports_of(const lsp_document &doc)
+    {
+        std::vector<lsp_import> imports;
+        if (doc.chunks.empty() || !doc.chunks.front().parsed || !doc.chunks.front().parsed->program)
+            return imports;
+        const auto *prog = std::get_if<program>(&doc.chunks.front().parsed->program->node);
+        if (!prog)
+            return imports;
+        const fs::path dir = fs::path(doc.path).parent_path();
+        std::size_t search = doc.chunks.front().begin;
+        for (const auto &imp : prog->imports)
+        {
+            const auto *decl = imp ? std::get_if<import_decl>(&imp->node) : nullptr;
+            if (!decl || !decl->path || !decl->path->tok)
+                continue;
+            lsp_import out;
+            std::string target = trimmed(decl->path->tok->lexeme);
+            out.path = canonical_wdl_path((dir / target).string());
+            out.alias = decl->alias && decl->alias->tok ? trimmed(decl->alias->tok->lexeme) : fs::path(target).stem().string();
+            std::size_t at = doc.text.find(target, search);
+            if (at != std::string::npos && at < doc.chunks.front().end)
+            {
+                out.literal_begin = at;
+                out.literal_end = at + target.size();
+                search = out.literal_end;
+            }
+            imports.push_back(std::move(out));
+        }
+        return imports;
+    }
+
+    // ---- protocol
+
+    lsp_server::lsp_server(std::istream &in, std::ostream &out) : in(in), out(out) {}
+
+    bool lsp_server::read_message(std::string &body)
+    {
+        std::size_t length = 0;
+        bool have_length = false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty())
+            {
+                if (!have_length)
+                    continue; // stray blank line between messages
+                body.resize(length);
+                in.read(body.data(), static_cast<std::streamsize>(length));
+                return static_cast<std::size_t>(in.gcount()) == length;
+            }
+            static const std::string header = "content-length:";
+            if (line.size() > header.size() && std::equal(header.begin(), header.end(), line.begin(), [](char a, char b)
+                                                          { return a == std::tolower(static_cast<unsigned char>(b)); }))
+            {
+                length = std::strtoull(line.c_str() + header.size(), nullptr, 10);
+                have_length = true;
+            }
+        }
+        return false;
+    }
+
+    void lsp_server::send(const std::string &body)
+    {
+        out << "Content-Length: " << body.size() << "\r\n\r\n"
+            << body;
+        out.flush();
+    }
+
+    static std::string id_json(const json_node &id)
+    {
+        if (id.kind == JN_NUMBER)
+            return std::to_string(id.integer());
+        if (id.kind != JN_STRING)
+            return "null";
+        std::string s;
+        json_writer json(s);
+        json.value(id.text);
+        return s;
+    }
+
+    void lsp_server::reply(const json_node &id, const std::string &result_json)
+    {
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + id_json(id) + ",\"result\":" + result_json + "}");
+    }
+
+    void lsp_server::reply_error(const json_node &id, int code, const std::string &message)
+    {
+        std::string err;
+        {
+            json_writer json(err);
+            json.begin_object().key("code").value(code).key("message").value(message).end_object();
+        }
+        send("{\"jsonrpc\":\"2.0\",\"id\":" + id_json(id) + ",\"error\":" + err + "}");
+    }
+
+    int lsp_server::run()
+    {
+        std::string body;
+        while (!exit_requested && read_message(body))
+        {
+            json_node message;
+            try
+            {
+                message = parse_json(body);
+            }
+            catch (const std::exception &e)
+            {
+                reply_error(json_node{}, PARSE_ERROR, e.what());
+                continue;
+            }
+            handle(message);
+        }
+        return shutdown_requested ? 0 : 1;
+    }
+
+    void lsp_server::publish_diagnostics(const lsp_document &doc)
+    {
+        std::string body;
+        {
+            json_writer json(body);
+            json.begin_object();
+            json.key("jsonrpc").value("2.0");
+            json.key("method").value("textDocument/publishDiagnostics");
+            json.key("params").begin_object();
+            json.key("uri").value(doc.uri);
+            json.key("version").value(doc.version);
+            json.key("diagnostics").begin_array();
+            for (const auto &chunk : doc.chunks)
+            {
+                if (!chunk.parsed)
+                    continue;
+                const std::size_t first = line_of(doc, chunk.begin);
+                const std::size_t last = line_of(doc, chunk.end > chunk.begin ? chunk.end - 1 : chunk.begin);
+                for (const auto &d : chunk.parsed->diagnostics)
+                {
+                    // parser lines and columns are 1-based within the chunk
+                    std::size_t line = std::min(last, first + static_cast<std::size_t>(std::max(1, d.line)) - 1);
+                    std::size_t begin = doc.line_starts[line];
+                    std::size_t end = line_end(doc, line);
+                    std::size_t at = std::min(end, begin + static_cast<std::size_t>(std::max(1, d.column)) - 1);
+                    if (!d.lexeme.empty() && d.lexeme != "\\n" && doc.text.compare(at, d.lexeme.size(), d.lexeme) == 0)
+                    {
+                        begin = at;
+                        end = at + d.lexeme.size();
+                    }
+                    else
+                    {
+                        // at the end of the file or on a newline... the whole line, an empty range is easy to miss
+                        while (begin < end && std::isspace(static_cast<unsigned char>(doc.text[begin])))
+                            ++begin;
+                    }
+                    json.begin_object();
+                    json.key("range");
+                    write_range(json, doc, begin, end);
+                    json.key("severity").value(1);
+                    json.key("source").value("wdlrunner");
+                    json.key("message").value(d.message);
+                    json.end_object();
+                }
+            }
+            json.end_array();
+            json.end_object();
+            json.end_object();
+        }
+        send(body);
+    }
+
+    void lsp_server::handle(const json_node &message)
+    {
+        const std::string method = message["method"].str();
+        const json_node &id = message["id"];
+        const bool is_request = message.has("id");
+        const json_node &params = message["params"];
+        WDL_TRACE_SCOPE_DETAIL("lsp_message", method);
+
+        if (method == "initialize")
+        {
+            reply(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                      "\"documentSymbolProvider\":true,\"definitionProvider\":true,\"hoverProvider\":true},"
+                      "\"serverInfo\":{\"name\":\"wdlrunner\",\"version\":\"1.0\"}}");
+        }
+        else if (method == "shutdown")
+        {
+            shutdown_requested = true;
+            reply(id, "null");
+        }
+        else if (method == "exit")
+            exit_requested = true;
+        else if (method == "textDocument/didOpen")
+        {
+            const json_node &td = params["textDocument"];
+            lsp_document &doc = open[td["uri"].str()];
+            doc.uri = td["uri"].str();
+            doc.path = canonical_wdl_path(uri_to_path(doc.uri));
+            doc.version = td["version"].integer();
+            doc.text = td["text"].str();
+            update(doc);
+            publish_diagnostics(doc);
+        }
+        else if (method == "textDocument/didChange")
+        {
+            const json_node &td = params["textDocument"];
+            auto it = open.find(td["uri"].str());
+            if (it == open.end())
+                return;
+            lsp_document &doc = it->second;
+            doc.version = td["version"].integer(doc.version + 1);
+            for (const auto &change : params["contentChanges"].items)
+            {
+                if (!change.has("range"))
+                {
+                    doc.text = change["text"].str();
+                    update(doc);
+                    continue;
+                }
+                std::size_t begin = offset_of(doc, change["range"]["start"]);
+                std::size_t end = std::max(begin, offset_of(doc, change["range"]["end"]));
+                doc.text.replace(begin, end - begin, change["text"].str());
+                // the next change's range is against this text, line starts have to be current
+                doc.line_starts.assign(1, 0);
+                for (std::size_t i = 0; i < doc.text.size(); ++i)
+                    if (doc.text[i] == '\n')
+                        doc.line_starts.push_back(i + 1);
+            }
+            update(doc);
+            publish_diagnostics(doc);
+        }
+        else if (method == "textDocument/didClose")
+        {
+            auto it = open.find(params["textDocument"]["uri"].str());
+            if (it == open.end())
+                return;
+            lsp_document closed;
+            closed.uri = it->first;
+            closed.version = it->second.version;
+            open.erase(it);
+            publish_diagnostics(closed); // empty, clears what the editor shows
+        }
+        else if (method == "textDocument/documentSymbol" || method == "textDocument/definition" || method == "textDocument/hover")
+        {
+            const lsp_document *doc = document_for_uri(params["textDocument"]["uri"].str());
+            if (!doc)
+            {
+                reply(id, "null");
+                return;
+            }
+            if (method == "textDocument/documentSymbol")
+                reply(id, document_symbols(*doc));
+            else
+            {
+                std::size_t offset = offset_of(*doc, params["position"]);
+                reply(id, method == "textDocument/definition" ? definition(*doc, offset) : hover(*doc, offset));
+            }
+        }
+        else if (method == "wdlrunner/stats")
+        {
+            std::string result;
+            {
+                json_writer json(result);
+                json.begin_object();
+                json.key("openDocuments").value(static_cast<std::uint64_t>(open.size()));
+                json.key("diskDocuments").value(static_cast<std::uint64_t>(disk.size()));
+                json.key("chunksParsed").value(chunks_parsed);
+                json.key("chunksReused").value(chunks_reused);
+                json.key("lastUpdateUs").value(last_update_us);
+                json.end_object();
+            }
+            reply(id, result);
+        }
+        else if (is_request)
+            reply_error(id, METHOD_NOT_FOUND, "Unsupported method: " + method);
+        // any other notification ($/cancelRequest, initialized, ...) needs nothing from us
+    }
+
+    // ---- requests
+
+    std::string lsp_server::document_symbols(const lsp_document &doc)
+    {
+        std::string result;
+        json_writer json(result);
+        json.begin_array();
+        for (const auto &chunk : doc.chunks)
+        {
+            if (chunk.keyword.empty())
+                continue;
+            // the range ends where the declaration does, not after the blank lines trailing it
+            std::size_t end = chunk.end;
+            while (end > chunk.begin && std::isspace(static_cast<unsigned char>(doc.text[end - 1])))
+                --end;
+            const bool is_struct = chunk.keyword == "struct";
+            json.begin_object();
+            json.key("name").value(chunk.name);
+            json.key("detail").value(chunk.keyword);
+            json.key("kind").value(is_struct ? SK_STRUCT : chunk.keyword == "workflow" ? SK_CLASS : SK_FUNCTION);
+            json.key("range");
+            write_range(json, doc, chunk.begin, end);
+            json.key("selectionRange");
+            write_range(json, doc, chunk.name_offset, chunk.name_offset + chunk.name.size());
+            json.key("children").begin_array();
+            std::vector<lsp_decl> decls;
+            if (const ast_node *decl = chunk_decl(chunk))
+                std::visit([&](auto &&value)
+                           {
+                               using T = std::decay_t<decltype(value)>;
+                               if constexpr (std::is_same_v<T, class_decl> || std::is_same_v<T, struct_decl>)
+                                   for (const auto &m : value.members)
+                                       collect(m, "", decls, nullptr); },
+                           decl->node);
+            std::size_t search = chunk.name_offset + chunk.name.size();
+            for (const auto &d : decls)
+            {
+                std::size_t at = find_declaration(doc.text, search, end, d.name);
+                if (at == std::string::npos)
+                    continue;
+                json.begin_object();
+                json.key("name").value(d.name);
+                json.key("detail").value(d.section.empty() ? d.type : d.section + " " + d.type);
+                json.key("kind").value(is_struct ? SK_FIELD : SK_VARIABLE);
+                json.key("range");
+                write_range(json, doc, at, at + d.name.size());
+                json.key("selectionRange");
+                write_range(json, doc, at, at + d.name.size());
+                json.end_object();
+            }
+            json.end_array();
+            json.end_object();
+        }
+        for (const auto &imp : imports_of(doc))
+        {
+            if (imp.literal_end == 0)
+                continue;
+            json.begin_object();
+            json.key("name").value(imp.alias);
+            json.key("detail").value("import");
+            json.key("kind").value(SK_MODULE);
+            json.key("range");
+            write_range(json, doc, imp.literal_begin, imp.literal_end);
+            json.key("selectionRange");
+            write_range(json, doc, imp.literal_begin, imp.literal_end);
+            json.end_object();
+        }
+        json.end_array();
+        return result;
+    }
+
+    // what the cursor is on... a word with dots kept in, `lib.task` and `call_alias.output` are one thing to us
+    static std::string word_at(const std::string &text, std::size_t offset, std::size_t &begin)
+    {
+        std::size_t b = offset, e = offset;
+        while (b > 0 && (ident_char(text[b - 1]) || text[b - 1] == '.'))
+            --b;
+        while (e < text.size() && (ident_char(text[e]) || text[e] == '.'))
+            ++e;
+        begin = b;
+        return text.substr(b, e - b);
+    }
+
+    // where something the cursor names is declared, and what to say about it
+    struct lsp_target
+    {
+    public:
+        const lsp_document *doc = nullptr;
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::string hover;
+    };
+
+    static std::string signature(const lsp_chunk &chunk)
+    {
+        std::string out = chunk.keyword + " " + chunk.name;
+        std::vector<lsp_decl> decls;
+        if (const ast_node *decl = chunk_decl(chunk))
+            std::visit([&](auto &&value)
+                       {
+                           using T = std::decay_t<decltype(value)>;
+                           if constexpr (std::is_same_v<T, class_decl> || std::is_same_v<T, struct_decl>)
+                               for (const auto &m : value.members)
+                                   collect(m, "", decls, nullptr); },
+                       decl->node);
+        if (chunk.keyword == "struct")
+        {
+            out += " {";
+            for (const auto &d : decls)
+                out += "\n    " + d.type + " " + d.name;
+            return out + "\n}";
+        }
+        for (const char *section : {"input", "output"})
+        {
+            std::string line;
+            for (const auto &d : decls)
+                if (d.section == section)
+                    line += (line.empty() ? "" : ", ") + d.type + " " + d.name;
+            if (!line.empty())
+                out += std::string("\n  ") + section + ": " + line;
+        }
+        return out;
+    }
+
+    static lsp_target chunk_target(const lsp_document *doc, const lsp_chunk &chunk)
+    {
+        lsp_target t;
+        t.doc = doc;
+        t.begin = chunk.name_offset;
+        t.end = chunk.name_offset + chunk.name.size();
+        t.hover = signature(chunk);
+        return t;
+    }
+
+    static bool resolve(const lsp_document &doc, std::size_t offset, lsp_target &target,
+                        const std::function<const lsp_document *(const std::string &)> &load)
+    {
+        std::vector<lsp_import> imports = imports_of(doc);
+        for (const auto &imp : imports)
+        {
+            if (offset >= imp.literal_begin && offset <= imp.literal_end && imp.literal_end > 0)
+            {
+                const lsp_document *file = load(imp.path);
+                if (!file)
+                    return false;
+                target.doc = file;
+                target.begin = target.end = 0;
+                target.hover = "import \"" + doc.text.substr(imp.literal_begin, imp.literal_end - imp.literal_begin) + "\" as " + imp.alias;
+                return true;
+            }
+        }
+
+        std::size_t word_begin = 0;
+        std::string word = word_at(doc.text, offset, word_begin);
+        if (word.empty())
+            return false;
+        const lsp_chunk *here = chunk_at(doc, offset);
+        std::size_t dot = word.find('.');
+        std::string head = word.substr(0, dot);
+        std::string tail = dot == std::string::npos ? "" : word.substr(dot + 1);
+        // the cursor on `lib` in `lib.task` means the import, on `task` means the task
+        const bool on_head = dot == std::string::npos || offset <= word_begin + dot;
+
+        for (const auto &imp : imports)
+        {
+            if (imp.alias != head)
+                continue;
+            const lsp_document *file = load(imp.path);
+            if (!file)
+                return false;
+            if (on_head || tail.empty())
+            {
+                target.doc = file;
+                target.hover = "import as " + imp.alias + "\n" + imp.path;
+                return true;
+            }
+            if (const lsp_chunk *c = chunk_named(*file, tail.substr(0, tail.find('.'))))
+            {
+                target = chunk_target(file, *c);
+                return true;
+            }
+            return false;
+        }
+
+        // a call's alias, `call_alias.out` or the name after `as`... the call statement is the definition.
+        // an unaliased call's alias is just the task's name, so a bare `A` there is the task, not `call A`
+        if (here && here->parsed)
+        {
+            std::vector<lsp_decl> decls;
+            std::vector<lsp_call> calls;
+            collect(here->parsed->program, "", decls, &calls);
+            for (const auto &call : calls)
+            {
+                if (call.alias != head || (dot == std::string::npos && !call.aliased))
+                    continue;
+                // `call lib.task as x`... the name after `as` when there is one, the task's own name otherwise
+                std::size_t at = doc.text.find("call " + call.target, here->begin);
+                if (at == std::string::npos || at >= here->end)
+                    continue;
+                at += 5;
+                if (call.aliased)
+                {
+                    at = doc.text.find(" as " + call.alias, at);
+                    if (at == std::string::npos || at >= here->end)
+                        continue;
+                    at += 4;
+                }
+                else
+                    at += call.target.size() - call.alias.size();
+                target.doc = &doc;
+                target.begin = at;
+                target.end = at + call.alias.size();
+                target.hover = "call " + call.target + (call.aliased ? " as " + call.alias : "");
+                // and what the task takes and gives, wherever it lives
+                std::size_t t_dot = call.target.find('.');
+                const lsp_document *task_doc = &doc;
+                if (t_dot != std::string::npos)
+                {
+                    task_doc = nullptr;
+                    for (const auto &imp : imports)
+                        if (imp.alias == call.target.substr(0, t_dot))
+                            task_doc = load(imp.path);
+                }
+                const lsp_chunk *task = task_doc ? chunk_named(*task_doc, call.target.substr(t_dot == std::string::npos ? 0 : t_dot + 1)) : nullptr;
+                if (task)
+                    target.hover += "\n" + signature(*task);
+                return true;
+            }
+            // a declaration in the same task/workflow
+            for (const auto &d : decls)
+            {
+                if (d.name != head)
+                    continue;
+                std::size_t at = find_declaration(doc.text, here->name_offset + here->name.size(), here->end, d.name);
+                if (at == std::string::npos)
+                    continue;
+                target.doc = &doc;
+                target.begin = at;
+                target.end = at + d.name.size();
+                target.hover = (d.section.empty() ? "" : d.section + " ") + d.type + " " + d.name;
+                return true;
+            }
+        }
+
+        // a task, workflow or struct... here first, then anything imported (structs are global in WDL)
+        if (const lsp_chunk *c = chunk_named(doc, head))
+        {
+            target = chunk_target(&doc, *c);
+            return true;
+        }
+        for (const auto &imp : imports)
+        {
+            const lsp_document *file = load(imp.path);
+            const lsp_chunk *c = file ? chunk_named(*file, head) : nullptr;
+            if (c && c->keyword == "struct")
+            {
+                target = chunk_target(file, *c);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::string lsp_server::definition(const lsp_document &doc, std::size_t offset)
+    {
+        lsp_target target;
+        auto load = [this](const std::string &path)
+        { return document_for_path(path); };
+        if (!resolve(doc, offset, target, load))
+            return "null";
+        std::string result;
+        json_writer json(result);
+        json.begin_object();
+        json.key("uri").value(target.doc->uri);
+        json.key("range");
+        write_range(json, *target.doc, target.begin, target.end);
+        json.end_object();
+        return result;
+    }
+
+    std::string lsp_server::hover(const lsp_document &doc, std::size_t offset)
+    {
+        lsp_target target;
+        auto load = [this](const std::string &path)
+        { return document_for_path(path); };
+        if (!resolve(doc, offset, target, load) || target.hover.empty())
+            return "null";
+        std::string result;
+        json_writer json(result);
+        json.begin_object();
+        json.key("contents").begin_object();
+        json.key("kind").value("markdown");
+        json.key("value").value("```wdl\n" + target.hover + "\n```");
+        json.end_object();
+        json.end_object();
+        return result;
+    }
+
+}
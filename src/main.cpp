@@ -1,5 +1,9 @@
+#include <charconv>
 #include <iostream>
+#include <string_view>
+#include <system_error>
 #include <vector>
+#include "batch_validate.h"
 #include "boolean_network.h"
 #include <token.h>
 #include <lexer.h>
@@ -10,11 +14,19 @@
 #include <string>
 #include "soto.h"
 #include <parser.h>
+#include "file_hash.h"
+#include "journal.h"
+#include "json_inputs.h"
+#include "lsp_server.h"
+#include "mem_report.h"
+#include "trace.h"
+#include "wdl_daemon.h"
 
 // read file content into a string...
 // mostly used for source code reading in this codebase...
 std::string read_file(const std::string &path)
 {
+    WDL_TRACE_SCOPE_DETAIL("read_file", path);
     std::ifstream file(path);
     if (!file)
         throw std::runtime_error("Failed to open file: " + path);
@@ -38,8 +50,80 @@ void print_help()
 {
     std::cout << "wdlrunner v1.0" << std::endl;
     std::cout << "A simple WDL runner." << std::endl;
-    std::cout << "Usage: wdlrunner <source_file>" << std::endl;
-    std::cout << "Example: wdlrunner ../test3.wdl" << std::endl;
+    std::cout << "Usage: wdlrunner [options] <source_file>" << std::endl;
+    std::cout << "       wdlrunner validate [--json <path>|-] [-j N] <files, dirs or globs...>" << std::endl;
+    std::cout << "       wdlrunner lsp      (language server on stdin/stdout, for editors)" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --inputs <json>    workflow inputs, bound and type-checked against the workflow's input block" << std::endl;
+    std::cout << "  --journal <path>   record the run in an execution journal at <path>, none is written without it" << std::endl;
+    std::cout << "  --resume           report what the journal (default: wdlrunner.journal) says an earlier run finished and append to it, calls don't run yet so none are skipped" << std::endl;
+    std::cout << "  --trace-out <path> write a Chrome trace (chrome://tracing, ui.perfetto.dev) of where the time went" << std::endl;
+    std::cout << "  --mem-report       print what the token stream and the AST cost, and heap use per phase, to stderr" << std::endl;
+    std::cout << "  --serve <socket>   stay up on a unix socket, validate/inputs requests reuse modules parsed by earlier ones" << std::endl;
+    std::cout << "  --help, --version" << std::endl;
+    std::cout << "Example: wdlrunner --resume ../test3.wdl" << std::endl;
+}
+
+// --trace-out... written however main() returns, a failed run is the one you want to look at
+struct trace_output
+{
+public:
+    std::string path;
+    ~trace_output()
+    {
+        if (path.empty())
+            return;
+        soto::trace_stop();
+        if (!soto::trace_write_chrome_json(path))
+            std::cerr << "Failed to write trace: " << path << std::endl;
+    }
+};
+
+// `wdlrunner validate ...`... every file (and what it imports, once) in parallel, one report for all of them
+int run_validate(int argc, char *argv[])
+{
+    std::vector<std::string> args;
+    std::string json_path;
+    unsigned threads = 0;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc)
+            json_path = argv[++i];
+        else if ((arg == "-j" || arg == "--jobs") && i + 1 < argc)
+        {
+            // 1 to MAX_JOBS threads... stoul took "abc" for a throw out of main and "-1" for 4 billion
+            static constexpr unsigned MAX_JOBS = 1024;
+            const std::string_view n = argv[++i];
+            auto [end, ec] = std::from_chars(n.data(), n.data() + n.size(), threads);
+            if (ec != std::errc() || end != n.data() + n.size() || threads < 1 || threads > MAX_JOBS)
+            {
+                std::cerr << "Bad " << arg << " value: " << n << " (1 to " << MAX_JOBS << ")" << std::endl;
+                print_help();
+                return 2;
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_help();
+            return 2;
+        }
+        else
+            args.push_back(arg);
+    }
+    std::vector<std::string> paths = soto::expand_wdl_paths(args);
+    if (paths.empty())
+    {
+        std::cerr << "No .wdl files to validate" << std::endl;
+        return 2;
+    }
+    soto::batch_report report = soto::validate_batch(paths, threads);
+    // with --json - the JSON owns stdout, the text goes to stderr
+    soto::write_batch_report_text(report, json_path == "-" ? std::cerr : std::cout);
+    if (!json_path.empty())
+        soto::write_batch_report_json(report, json_path);
+    return report.ok() ? 0 : 1;
 }
 
 void print_version()
@@ -48,41 +132,157 @@ void print_version()
 }
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == "validate")
+        return run_validate(argc, argv);
+    if (argc > 1 && std::string(argv[1]) == "lsp")
+    {
+        // stdout is the protocol channel, nothing else may write to it
+        soto::lsp_server server{std::cin, std::cout};
+        return server.run();
+    }
     std::cout << "This is a test of the Workflow Definition Language (WDL) Runner v1.0\n";
 
-    // if (argc < 2)
-    // {
-    //     print_help();
-    //     return 1;
-    // }
-    // if (argc == 3 && std::string(argv[1]) == "--version")
-    // {
-    //     print_version();
-    //     return 0;
-    // }
-    // if (argc == 2 && std::string(argv[1]) == "--help")
-    // {
-    //     print_help();
-    //     return 0;
-    // }
-    // std::string source_code = read_file(argv[1]);
-    // std::cout << "Source code read from file:\n"
-    //           << source_code << std::endl;
+    std::string source_path;
+    std::string inputs_path;
+    std::string journal_path; // no journal unless --journal or --resume asks for one
+    std::string serve_path;
+    bool resume = false;
+    trace_output trace;
+    std::unique_ptr<soto::mem_report> mem; // null unless --mem-report, the phases are no-ops then
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--help")
+        {
+            print_help();
+            return 0;
+        }
+        if (arg == "--version")
+        {
+            print_version();
+            return 0;
+        }
+        if (arg == "--resume")
+            resume = true;
+        else if ((arg == "--inputs" || arg == "-i") && i + 1 < argc)
+            inputs_path = argv[++i];
+        else if (arg == "--journal" && i + 1 < argc)
+            journal_path = argv[++i];
+        else if (arg == "--trace-out" && i + 1 < argc)
+            trace.path = argv[++i];
+        else if (arg == "--serve" && i + 1 < argc)
+            serve_path = argv[++i];
+        else if (arg == "--mem-report")
+            mem = std::make_unique<soto::mem_report>();
+        else if (!arg.empty() && arg[0] != '-' && source_path.empty())
+            source_path = arg;
+        else
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_help();
+            return 1;
+        }
+    }
+    if (!trace.path.empty())
+        soto::trace_start();
+    if (!serve_path.empty())
+    {
+        soto::wdl_daemon daemon{serve_path};
+        std::cout << "Serving on " << serve_path << std::endl;
+        daemon.serve();
+        return 0;
+    }
+    if (source_path.empty())
+    {
+        print_help();
+        return 1;
+    }
 
-    std::string source_code = read_file("../test2.wdl");
+    std::string source_code;
+    {
+        soto::mem_phase phase{mem.get(), "read"};
+        source_code = read_file(source_path);
+    }
     std::cout << "Source code read from file:\n"
               << source_code << std::endl;
 
+    // the journal is what --resume replays... finished calls keep their outputs, started-but-not-finished ones re-run.
+    // only opened when asked for: opening one without --resume truncates it, and a plain parse shouldn't leave
+    // a file behind or wipe out the record of a crashed run
+    if (resume && journal_path.empty())
+        journal_path = "wdlrunner.journal";
+    std::unique_ptr<soto::journal> journal;
+    if (!journal_path.empty())
+    {
+        const std::string workflow_digest = soto::hash_string(source_code);
+        journal = std::make_unique<soto::journal>(journal_path, resume);
+        if (resume)
+        {
+            const soto::journal_state &previous = journal->recovered();
+            std::cout << "Resuming from " << journal_path << ": " << previous.count(soto::CALL_FINISHED) << " finished call(s), "
+                      << previous.count(soto::CALL_STARTED) + previous.count(soto::CALL_FAILED) << " started or failed\n";
+            if (previous.torn_tail)
+                std::cout << "Journal had a torn last record (crash mid-write), dropped it\n";
+            if (!previous.workflow_digest.empty() && previous.workflow_digest != workflow_digest)
+                std::cout << "Warning: " << source_path << " changed since the journal was written, only the call cache can tell what is still valid\n";
+        }
+        soto::journal_record run;
+        run.kind = soto::J_RUN;
+        run.workflow_digest = workflow_digest;
+        journal->sync(journal->append(run));
+    }
+
+    if (mem)
+    {
+        // the parser pulls tokens one at a time, this pass holds all of them to see what a full stream costs
+        soto::mem_phase phase{mem.get(), "lex"};
+        mem->token_stream = soto::account_token_stream(source_code);
+        mem->has_tokens = true;
+    }
+
     soto::lexer lexer{source_code};
     soto::parser parser{std::make_unique<soto::lexer>(lexer)};
-    const soto::ast_node_ptr prog = parser.parse_program();
+    soto::ast_node_ptr prog;
+    {
+        soto::mem_phase phase{mem.get(), "parse"};
+        prog = parser.parse_program();
+    }
+    if (mem)
+    {
+        mem->ast = soto::account_ast(prog);
+        mem->has_ast = true;
+    }
     std::cout << "Parsed program: " << std::endl;
-    parser.print_ast_node(prog, 0);
+    {
+        WDL_TRACE_SCOPE("print_ast");
+        soto::mem_phase phase{mem.get(), "print_ast"};
+        parser.print_ast_node(prog, 0);
+    }
     // parser.write_ast_node_to_file(prog, "output.ast", 0);
 
     std::cout << "AST written to output.ast\n";
 
     std::cout << "Parsed program successfully.\n";
 
+    if (!inputs_path.empty())
+    {
+        WDL_TRACE_SCOPE_DETAIL("bind_inputs", inputs_path);
+        soto::bound_inputs inputs;
+        {
+            soto::mem_phase phase{mem.get(), "bind_inputs"};
+            inputs = soto::bind_inputs_json(inputs_path, prog);
+        }
+        for (const auto &error : inputs.errors)
+            std::cerr << "[ERROR] " << soto::format_input_error(error, inputs_path) << std::endl;
+        if (!inputs.ok())
+            return 1;
+        std::cout << "Bound " << inputs.values.size() << " input(s) for workflow " << inputs.workflow;
+        if (!inputs.ignored_keys.empty())
+            std::cout << ", " << inputs.ignored_keys.size() << " call-level key(s) not bound yet";
+        std::cout << "\n";
+    }
+
+    if (mem)
+        mem->print(std::cerr);
     return 0;
 }
\ No newline at end of file
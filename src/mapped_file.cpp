@@ -0,0 +1,44 @@
+#include "mapped_file.h"
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace soto
+{
+
+    mapped_file::mapped_file(const std::string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("Failed to open file: " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to stat file: " + path);
+        }
+        size = static_cast<std::size_t>(st.st_size);
+        if (size > 0) // mmap of an empty file is EINVAL, an empty view is fine though...
+        {
+            void *m = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to map file: " + path);
+            }
+            ::madvise(m, size, MADV_SEQUENTIAL);
+            data = static_cast<const char *>(m);
+        }
+        ::close(fd); // the mapping keeps the file alive
+    }
+
+    mapped_file::~mapped_file()
+    {
+        if (data)
+            ::munmap(const_cast<char *>(data), size);
+    }
+
+}
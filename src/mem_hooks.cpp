@@ -0,0 +1,65 @@
+// counting global operator new/delete for --mem-report... not part of wdlcore, CMake links this into
+// wdlrunner only when WDLRUNNER_MEM_HOOKS is ON, and into the benches that count allocations through mem_heap
+//
+// sizes come from malloc_usable_size() on both sides, so a free always takes back what its allocation added
+
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include "mem_report.h"
+
+namespace
+{
+    struct mem_hooks_init
+    {
+        mem_hooks_init() { soto::mem_hooks_active = true; }
+    } init;
+
+    void *counted(void *p)
+    {
+        if (p)
+            soto::mem_note_alloc(malloc_usable_size(p));
+        return p;
+    }
+
+    void *counted_or_throw(void *p)
+    {
+        if (!p)
+            throw std::bad_alloc();
+        return counted(p);
+    }
+
+    void *aligned(std::size_t n, std::align_val_t al)
+    {
+        void *p = nullptr;
+        if (posix_memalign(&p, static_cast<std::size_t>(al), n ? n : 1) != 0)
+            return nullptr;
+        return p;
+    }
+
+    void release(void *p) noexcept
+    {
+        if (!p)
+            return;
+        soto::mem_note_free(malloc_usable_size(p));
+        std::free(p);
+    }
+}
+
+void *operator new(std::size_t n) { return counted_or_throw(std::malloc(n ? n : 1)); }
+void *operator new[](std::size_t n) { return counted_or_throw(std::malloc(n ? n : 1)); }
+void *operator new(std::size_t n, const std::nothrow_t &) noexcept { return counted(std::malloc(n ? n : 1)); }
+void *operator new[](std::size_t n, const std::nothrow_t &) noexcept { return counted(std::malloc(n ? n : 1)); }
+void *operator new(std::size_t n, std::align_val_t al) { return counted_or_throw(aligned(n, al)); }
+void *operator new[](std::size_t n, std::align_val_t al) { return counted_or_throw(aligned(n, al)); }
+
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, std::size_t) noexcept { release(p); }
+void operator delete[](void *p, std::size_t) noexcept { release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete(void *p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { release(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { release(p); }
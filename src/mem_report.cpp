@@ -0,0 +1,338 @@
+#include "mem_report.h"
+#include <algorithm>
+#include <cstdio>
+#include <string_view>
+#include <unordered_set>
+#include "lexer.h"
+#include "trace.h"
+
+namespace soto
+{
+
+    mem_counters mem_heap;
+    bool mem_hooks_active = false;
+
+    void mem_reset_peak()
+    {
+        mem_heap.peak.store(mem_heap.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    mem_phase::mem_phase(mem_report *report, const char *name) : report(report), name(name)
+    {
+        if (!report)
+            return;
+        allocs0 = mem_heap.allocs.load(std::memory_order_relaxed);
+        bytes0 = mem_heap.bytes.load(std::memory_order_relaxed);
+        live0 = mem_heap.live.load(std::memory_order_relaxed);
+        mem_reset_peak();
+    }
+
+    mem_phase::~mem_phase()
+    {
+        if (!report)
+            return;
+        mem_phase_stats stats;
+        stats.name = name;
+        stats.allocs = mem_heap.allocs.load(std::memory_order_relaxed) - allocs0;
+        stats.bytes = mem_heap.bytes.load(std::memory_order_relaxed) - bytes0;
+        std::uint64_t peak = mem_heap.peak.load(std::memory_order_relaxed);
+        stats.peak = peak > live0 ? peak - live0 : 0;
+        stats.retained = static_cast<std::int64_t>(mem_heap.live.load(std::memory_order_relaxed)) - static_cast<std::int64_t>(live0);
+        report->phases.push_back(std::move(stats));
+    }
+
+    // heap behind a string... nothing while it fits the small-string buffer
+    static std::size_t string_heap_bytes(const std::string &s)
+    {
+        static const std::size_t sso = std::string().capacity();
+        return s.capacity() > sso ? s.capacity() + 1 : 0;
+    }
+
+    // make_shared puts the object next to its two reference counts
+    template <typename T>
+    static constexpr std::size_t shared_box_bytes()
+    {
+        return sizeof(T) + 2 * sizeof(long);
+    }
+
+    static std::size_t literal_box_bytes(const token &t)
+    {
+        return (t.int_val ? shared_box_bytes<int>() : 0) + (t.float_val ? shared_box_bytes<double>() : 0);
+    }
+
+    token_stream_stats account_token_stream(const std::string &source)
+    {
+        token_stream_stats stats;
+        lexer lex{source};
+        std::vector<token> tokens;
+        {
+            // the only place the whole file is lexed without a parser pulling on it... lexing on its own, in a trace
+            WDL_TRACE_SCOPE("lex");
+            while (true)
+            {
+                token t = lex.lex();
+                const bool eof = t.kind == T_EOF;
+                tokens.push_back(std::move(t));
+                if (eof)
+                    break;
+            }
+        }
+        // views into `tokens`, which doesn't move again
+        std::unordered_set<std::string_view> distinct;
+        for (const auto &t : tokens)
+        {
+            stats.token_bytes += sizeof(token);
+            stats.lexeme_bytes += string_heap_bytes(t.lexeme);
+            stats.literal_bytes += literal_box_bytes(t);
+            stats.lexeme_chars += t.lexeme.size();
+            if (distinct.insert(t.lexeme).second)
+                stats.distinct_lexeme_chars += t.lexeme.size();
+        }
+        stats.tokens = tokens.size();
+        stats.distinct_lexemes = distinct.size();
+        return stats;
+    }
+
+    struct ast_accountant
+    {
+    public:
+        ast_stats stats;
+        std::unordered_set<const token *> seen;
+
+        void add_token(const std::shared_ptr<token> &t)
+        {
+            if (!t || !seen.insert(t.get()).second)
+                return;
+            stats.tokens++;
+            stats.token_bytes += shared_box_bytes<token>() + literal_box_bytes(*t);
+            stats.string_bytes += string_heap_bytes(t->lexeme);
+        }
+        template <typename V>
+        void add_vector(const V &v)
+        {
+            stats.vector_bytes += v.capacity() * sizeof(typename V::value_type);
+        }
+        void pairs(const std::vector<std::tuple<ast_node_ptr, ast_node_ptr>> &v)
+        {
+            add_vector(v);
+            for (const auto &[key, val] : v)
+            {
+                walk(key);
+                walk(val);
+            }
+        }
+        void list(const std::vector<ast_node_ptr> &v)
+        {
+            add_vector(v);
+            for (const auto &n : v)
+                walk(n);
+        }
+
+        void walk(const ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            stats.nodes++;
+            stats.node_bytes += sizeof(ast_node);
+            stats.by_type[ast_node_type_to_string(node->type)]++;
+            add_token(node->tok);
+            std::visit(
+                [&](auto &&value)
+                {
+                    using T = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<T, program>)
+                    {
+                        walk(value.version);
+                        list(value.imports);
+                        list(value.declarations);
+                    }
+                    else if constexpr (std::is_same_v<T, func_decl>)
+                    {
+                        walk(value.type);
+                        walk(value.identifier);
+                        list(value.parameters);
+                        walk(value.body);
+                    }
+                    else if constexpr (std::is_same_v<T, class_decl> || std::is_same_v<T, struct_decl>)
+                    {
+                        walk(value.identifier);
+                        list(value.members);
+                    }
+                    else if constexpr (std::is_same_v<T, input_decl> || std::is_same_v<T, output_decl>)
+                    {
+                        walk(value.body);
+                        list(value.members);
+                    }
+                    else if constexpr (std::is_same_v<T, runtime_decl>)
+                        pairs(value.members);
+                    else if constexpr (std::is_same_v<T, map_expr>)
+                        pairs(value.elements);
+                    else if constexpr (std::is_same_v<T, meta_decl>)
+                    {
+                        walk(value.identifier);
+                        pairs(value.members);
+                    }
+                    else if constexpr (std::is_same_v<T, version_decl>)
+                    {
+                        walk(value.version);
+                        add_token(value.version_number);
+                    }
+                    else if constexpr (std::is_same_v<T, var_decl>)
+                    {
+                        walk(value.type);
+                        walk(value.identifier);
+                        walk(value.initializer);
+                    }
+                    else if constexpr (std::is_same_v<T, block>)
+                        list(value.statements);
+                    else if constexpr (std::is_same_v<T, if_stmt>)
+                    {
+                        walk(value.condition);
+                        walk(value.then_);
+                        walk(value.else_if);
+                        walk(value.else_);
+                    }
+                    else if constexpr (std::is_same_v<T, while_stmt>)
+                    {
+                        walk(value.condition);
+                        walk(value.body);
+                    }
+                    else if constexpr (std::is_same_v<T, do_while_stmt>)
+                    {
+                        walk(value.body);
+                        walk(value.condition);
+                    }
+                    else if constexpr (std::is_same_v<T, ret_stmt> || std::is_same_v<T, expr_stmt>)
+                        walk(value.expr);
+                    else if constexpr (std::is_same_v<T, binary_expr>)
+                    {
+                        walk(value.left);
+                        add_token(value.op);
+                        walk(value.right);
+                    }
+                    else if constexpr (std::is_same_v<T, assign_expr>)
+                    {
+                        walk(value.left);
+                        walk(value.right);
+                    }
+                    else if constexpr (std::is_same_v<T, unary_expr>)
+                        walk(value.operand);
+                    else if constexpr (std::is_same_v<T, literal_expr>)
+                    {
+                        // held by value, its sizeof is already in node_bytes
+                        stats.string_bytes += string_heap_bytes(value.value.lexeme);
+                        stats.token_bytes += literal_box_bytes(value.value);
+                    }
+                    else if constexpr (std::is_same_v<T, func_call>)
+                    {
+                        walk(value.identifier);
+                        walk(value.default_value);
+                        list(value.arguments);
+                    }
+                    else if constexpr (std::is_same_v<T, array_expr>)
+                    {
+                        walk(value.identifier);
+                        list(value.elements);
+                    }
+                    else if constexpr (std::is_same_v<T, command_decl>)
+                    {
+                        walk(value.body);
+                        list(value.arguments);
+                    }
+                    else if constexpr (std::is_same_v<T, call_decl>)
+                    {
+                        walk(value.member_accessed);
+                        walk(value.alias);
+                        pairs(value.arguments);
+                    }
+                    else if constexpr (std::is_same_v<T, member_access>)
+                    {
+                        walk(value.object);
+                        walk(value.member);
+                    }
+                    else if constexpr (std::is_same_v<T, pair_expr>)
+                    {
+                        walk(value.first);
+                        walk(value.second);
+                    }
+                    else if constexpr (std::is_same_v<T, index_expr>)
+                    {
+                        walk(value.collection);
+                        walk(value.index);
+                    }
+                    else if constexpr (std::is_same_v<T, struct_expr>)
+                        list(value.values);
+                    else if constexpr (std::is_same_v<T, import_decl>)
+                    {
+                        walk(value.path);
+                        walk(value.alias);
+                    }
+                    else if constexpr (std::is_same_v<T, scatter_stmt>)
+                    {
+                        walk(value.identifier);
+                        walk(value.collection);
+                        walk(value.body);
+                    }
+                },
+                node->node);
+        }
+    };
+
+    ast_stats account_ast(const ast_node_ptr &root)
+    {
+        ast_accountant accountant;
+        accountant.walk(root);
+        return accountant.stats;
+    }
+
+    static std::string kb(double bytes)
+    {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.1f KB", bytes / 1024.0);
+        return buf;
+    }
+
+    void mem_report::print(std::ostream &out) const
+    {
+        char line[160];
+        out << "memory report";
+        if (!mem_hooks_active)
+            out << " (heap counters not compiled in, rebuild with -DWDLRUNNER_MEM_HOOKS=ON for the phase table)";
+        out << "\n";
+        if (mem_hooks_active)
+        {
+            std::snprintf(line, sizeof(line), "  %-12s %10s %12s %12s %12s\n", "phase", "allocs", "allocated", "peak live", "retained");
+            out << line;
+            for (const auto &p : phases)
+            {
+                std::snprintf(line, sizeof(line), "  %-12s %10llu %12s %12s %12s\n", p.name.c_str(), static_cast<unsigned long long>(p.allocs),
+                              kb(static_cast<double>(p.bytes)).c_str(), kb(static_cast<double>(p.peak)).c_str(),
+                              kb(static_cast<double>(p.retained)).c_str());
+                out << line;
+            }
+        }
+        if (has_tokens)
+        {
+            const token_stream_stats &t = token_stream;
+            out << "  token stream: " << t.tokens << " tokens x " << sizeof(token) << " B = " << kb(static_cast<double>(t.token_bytes))
+                << ", lexeme heap " << kb(static_cast<double>(t.lexeme_bytes)) << ", literal boxes " << kb(static_cast<double>(t.literal_bytes)) << "\n";
+            out << "  lexemes: " << t.lexeme_chars << " chars, " << t.distinct_lexemes << " distinct (" << t.distinct_lexeme_chars
+                << " chars) if interned\n";
+        }
+        if (has_ast)
+        {
+            const ast_stats &a = ast;
+            out << "  ast: " << a.nodes << " nodes x " << sizeof(ast_node) << " B = " << kb(static_cast<double>(a.node_bytes))
+                << ", child vectors " << kb(static_cast<double>(a.vector_bytes)) << ", " << a.tokens << " tokens "
+                << kb(static_cast<double>(a.token_bytes)) << ", strings " << kb(static_cast<double>(a.string_bytes)) << "\n";
+            std::vector<std::pair<std::string, std::size_t>> types(a.by_type.begin(), a.by_type.end());
+            std::sort(types.begin(), types.end(), [](const auto &x, const auto &y)
+                      { return x.second > y.second; });
+            out << "  most common nodes:";
+            for (std::size_t i = 0; i < types.size() && i < 6; ++i)
+                out << (i ? ", " : " ") << types[i].first << " " << types[i].second;
+            out << "\n";
+        }
+    }
+
+}
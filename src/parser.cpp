@@ -3,7 +3,8 @@
 #include <sstream>
 #include <string>
 #include "string_utils.h"
-#include <regex>
+#include "trace.h"
+#include <cctype>
 #include <fstream>
 
 namespace soto
@@ -14,6 +15,12 @@ namespace soto
 
         read_token_or_emit_error();
     }
+    // the first token is read right here, so the sink has to be in place before that
+    parser::parser(std::unique_ptr<lexer> lex, std::vector<parse_diagnostic> *diagnostics)
+        : m_lexer(std::move(lex)), curr_tok(std::make_shared<token>()), prev_tok(std::make_shared<token>()), error_state(false), diagnostics(diagnostics)
+    {
+        read_token_or_emit_error();
+    }
 
     // this EATS token... and also emits ERROR if we hit a T_ERROR anywhere...
     void parser::read_token_or_emit_error()
@@ -22,22 +29,31 @@ namespace soto
         for (;;)
         {
             token n_tok = next_token();
+#ifdef WDLRUNNER_DEBUG_TOKENS
             std::cout << "next token emitted in parser is " << n_tok << std::endl;
+#endif
             curr_tok = std::make_shared<token>(std::move(n_tok));
             if (curr_tok->kind != T_ERROR)
                 break;
             emit_error(curr_tok->lexeme, *curr_tok); // this is bada bad
         }
     }
+    // every token read is a fresh shared_ptr, so if curr_tok is still `before` nothing was consumed...
+    // a declaration nobody knows how to start (e.g a top-level `runtime`) would otherwise spin forever
+    void parser::skip_if_stuck(const std::shared_ptr<token> &before)
+    {
+        if (curr_tok != before || curr_tok->kind == T_EOF)
+            return;
+        emit_error("Unexpected token, skipping it.", *curr_tok);
+        read_token_or_emit_error();
+    }
     token parser::next_token()
     {
         return m_lexer->lex();
     }
     bool parser::peek_token(const token_kind &kind)
     {
-        std::unique_ptr<lexer> copy = std::make_unique<lexer>(*m_lexer); // deep copy
-        token t = copy->lex();
-        return t.kind == kind;
+        return m_lexer->peek().kind == kind; // copying the lexer here copied the whole source per peek
     }
 
     static bool is_unusual_type(const token_kind &kind)
@@ -73,24 +89,37 @@ namespace soto
     void parser::emit_error(const std::string &error_msg, const token &tok)
     {
         error_state = true;
-        std::ostringstream os;
-        os << "[ERROR] [line " << tok.line << "]";
-
-        if (tok.kind == T_EOF)
+        parse_diagnostic d;
+        d.line = m_lexer->lines->line_of(tok.offset);
+        d.column = m_lexer->lines->column_of(tok.offset);
+        d.at_end = tok.kind == T_EOF;
+        if (tok.kind != T_EOF && tok.kind != T_ERROR)
+            d.lexeme = tok.lexeme;
+        d.message = error_msg;
+        if (diagnostics)
         {
-            os << " at end";
-        }
-        else if (tok.kind != T_ERROR)
-        {
-            os << " at '" << tok.lexeme << "'";
+            diagnostics->push_back(std::move(d));
+            return;
         }
-
-        os << ": " << error_msg << std::endl;
-        std::cerr << os.str();
+        std::cerr << d.to_string() << std::endl;
         return;
     }
+    std::string parse_diagnostic::to_string() const
+    {
+        std::ostringstream os;
+        os << "[ERROR] [line " << line << "]";
+        if (at_end)
+            os << " at end";
+        else if (!lexeme.empty())
+            os << " at '" << lexeme << "'";
+        os << ": " << message;
+        return os.str();
+    }
     ast_node_ptr parser::parse_program()
     {
+        // lexing is pulled token by token, so it's in here too... a scope per token would cost more than the
+        // token does. --mem-report lexes the file on its own first, that pass is the trace's "lex"
+        WDL_TRACE_SCOPE("parse_program");
         ast_node_ptr prog = new_node(N_PROGRAM);
         program prow; // your variant type holding declarations
 
@@ -124,6 +153,7 @@ namespace soto
             {
                 // ast_node_ptr import_node = new_node(N_IMPORT_DECL);
                 // import_decl import_decl{};
+                WDL_TRACE_SCOPE("parse_imports");
 
                 do
                 {
@@ -155,7 +185,10 @@ namespace soto
 
                 } while (expect_token_and_read(T_IMPORT));
             }
+            if (expect_token(T_EOF))
+                continue; // nothing but a version and imports, the loop condition takes it from here
 
+            auto before = curr_tok;
             ast_node_ptr decl = parse_decl();
             if (decl)
             {
@@ -163,8 +196,10 @@ namespace soto
                 if (expect_token(T_ENDL))
                     expect_token_or_emit_error(T_ENDL, "Expect ';' or newline after declaration.");
             }
+            skip_if_stuck(before);
         }
 
+        prow.lines = m_lexer->lines;
         prog->node = std::move(prow); // set the variant in the ast_node
         return prog;                  // <-- you forgot to return the node
     }
@@ -216,21 +251,23 @@ namespace soto
                 ;
             return result;
         }
-        else if (expect_token(T_IDENT) && !m_lexer->is_reserved_word(util::to_lowercase(prev_tok->lexeme)))
+        else if (expect_token(T_IDENT) && !m_lexer->is_reserved_word(util::to_lowercase(curr_tok->lexeme)))
         {
             // this is some struct's VAR_DECL...e.g MyStruct myVar;
+            // parse_var_decl takes the type from prev_tok, so the struct name has to be consumed first...
+            read_token_or_emit_error();
             result = parse_var_decl();
             while (expect_token_and_read(T_ENDL))
                 ;
             return result;
         }
-        // else if (expect_token_and_read(T_SCATTER))
-        // {
-        //     result = parse_scatter_stmt();
-        //     while (expect_token_and_read(T_ENDL))
-        //         ;
-        //     return result;
-        // }
+        else if (expect_token_and_read(T_SCATTER)) // a scatter nested in a scatter (or an if) body
+        {
+            result = parse_scatter_stmt();
+            while (expect_token_and_read(T_ENDL))
+                ;
+            return result;
+        }
 
         result = parse_stmt();
         if (expect_token(T_ENDL))
@@ -307,7 +344,9 @@ namespace soto
     //  class have members... which can be fields or methods
     ast_node_ptr parser::parse_class_decl()
     {
+        WDL_TRACE_SCOPE("parse_class_decl");
         ast_node_ptr klass = new_node(N_CLASS_DECL);
+        klass->tok = prev_tok; // the 'workflow' or 'task' keyword, that's the only thing that tells them apart...
         class_decl decl{};
 
         // class have name...
@@ -320,104 +359,24 @@ namespace soto
 
         while (!expect_token(T_RCURLY) && !expect_token(T_EOF))
         {
-            // consume any endline T_ENDL before start of class members...
-            if (expect_token(T_ENDL))
-                expect_token_and_read(T_ENDL);
+            // consume any endline T_ENDL before start of class members... a whitespace-only line is more than one
+            while (expect_token_and_read(T_ENDL))
+                ;
+            if (expect_token(T_RCURLY))
+                break;
 
-            // expect type keyword at start of class member
-            if ((!expect_token(T_TYPE) && !is_unusual_type(curr_tok->kind)) && !expect_token(T_ENDL) && !expect_token(T_SCATTER))
+            // expect type keyword at start of class member... or a struct's name, `Sample s = ...`, `Sample? s`
+            const bool struct_typed = expect_token(T_IDENT) && (peek_token(T_IDENT) || peek_token(T_QUESTION));
+            if ((!expect_token(T_TYPE) && !is_unusual_type(curr_tok->kind) && !struct_typed) && !expect_token(T_ENDL) && !expect_token(T_SCATTER) && !expect_token(T_IF))
             {
                 emit_error("Expected type keyword at start of class member.", *curr_tok);
                 break;
             }
 
             // if it's a CALL construct, then it's a class (most-likely a WORKFLOW class) member...
-            if (expect_token_and_read(T_CALL))
+            if (expect_token(T_CALL))
             {
-                ast_node_ptr call = new_node(N_WTCALL);
-
-                expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct.");
-                ast_node_ptr task_name_to_call = new_node(N_IDENT);
-                task_name_to_call->tok = prev_tok;
-                call_decl input_decl{};
-
-                ast_node_ptr mem_access = new_node(N_MEMBER_ACCESS);
-
-                member_access member_access{};
-
-                ast_node_ptr member_access_obj = new_node(N_MEMBER_ACCESS_OBJ);
-                member_access_obj->tok = prev_tok;
-                member_access.object = std::move(member_access_obj); // Use the task_name_to_call as the object
-
-                // if it's a CALL construct with a member access... and with or without an ALIAS...
-                if (expect_token_and_read(T_DOT))
-                {
-                    expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct member access.");
-                    ast_node_ptr member_access_member = new_node(N_MEMBER_ACCESS_MEMBER);
-                    member_access_member->tok = prev_tok;
-                    member_access.member = std::move(member_access_member); // Use the task_name_to_call as the object
-
-                    if (expect_token_and_read(T_AS))
-                    {
-                        expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct member alias.");
-                        ast_node_ptr alias = new_node(N_ALIAS_DECL);
-                        alias->tok = prev_tok;
-
-                        input_decl.alias = std::move(alias);
-                    }
-
-                    mem_access->node = std::move(member_access);
-                    input_decl.member_accessed = std::move(mem_access); // Use the member_access as the member_accessed
-                }
-
-                if (!expect_token(T_LCURLY))
-                {
-                    // then this is an input less call construct...
-                    call->node = std::move(input_decl); // just push the no-input call...
-                    decl.members.push_back(std::move(call));
-                    continue;
-                }
-                expect_token_or_emit_error(T_LCURLY, "Expect '{' to begin call construct input body.");
-                if (expect_token(T_ENDL))
-                    expect_token_and_read(T_ENDL);
-                if (!expect_token(T_TYPE))
-                {
-                    // input keyword is a type... no need to check for T_IDENT
-                    // this is an INPUT-less call construct...
-                    // so this unserious user is trying to be funny...
-                    // a left CURLY without an intention of having inputs...
-                    call->node = std::move(input_decl); // just push the no-input call...
-                    decl.members.push_back(std::move(call));
-                    continue;
-                }
-                expect_token_or_emit_error(T_TYPE, "Expect identifier for call construct."); // input: some may not have inputs...handle that...input is a tTYPE
-                expect_token_or_emit_error(T_COLON, "Expect ':' after call construct input identifier.");
-
-                // input_decl.identifier = std::move(task_name_to_call);
-
-                do
-                {
-                    // if (expect_token_and_read(T_ENDL))
-                    //     continue;
-                    if (expect_token(T_ENDL))
-                        expect_token_and_read(T_ENDL);
-                    expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct input.");
-                    ast_node_ptr input_ident = new_node(N_CALL_PARAM_KEY);
-                    input_ident->tok = prev_tok;
-
-                    expect_token_or_emit_error(T_ASSIGN, "Expect ':' after call construct input identifier.");
-
-                    // expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct input.");
-                    ast_node_ptr input_value = parse_expr();
-                    // input_value->type = N_CALL_PARAM_VALUE;
-                    //  expect_token_or_emit_error(T_ENDL, "Expect ';' or newline after call construct input value.");
-                    input_decl.arguments.emplace_back(std::move(input_ident), std::move(input_value));
-                } while (expect_token_and_read(T_COMMA));
-                if (expect_token(T_ENDL))
-                    expect_token_and_read(T_ENDL);
-                expect_token_or_emit_error(T_RCURLY, "Expect '}' to close call construct body.");
-                call->node = std::move(input_decl);
-                decl.members.push_back(std::move(call));
+                decl.members.push_back(parse_call_statement());
                 continue;
             }
 
@@ -486,27 +445,30 @@ namespace soto
                 cmd_body->tok->kind = T_SLITERAL; // this is a string literal
                 std::string_view command_text = cmd_body->tok->lexeme;
                 command.body = std::move(cmd_body); // cmd_body is a N_LITERAL a StringLiteral to be specific...
+                {
+                    // the lexer skipped straight past what opened the body... it's <<< or {
+                    std::size_t after = static_cast<std::size_t>(prev_tok->offset) + 7; // "command"
+                    const std::string &src = m_lexer->source;
+                    while (after < src.size() && std::isspace(static_cast<unsigned char>(src[after])))
+                        ++after;
+                    command.heredoc = src.compare(after, 3, "<<<") == 0;
+                }
 
-                // parse command arguments
-                std::vector<std::string_view> args;
-
-                // Find all occurrences of ~{nameOfVariable} using a regex
-                std::regex variable_pattern(R"(\~\{([a-zA-Z_][a-zA-Z0-9_]*)\})");
-                std::smatch match;
-                std::string command_str(command_text);
-
-                while (std::regex_search(command_str, match, variable_pattern))
+                // parse command arguments... every bare ~{nameOfVariable}, the full placeholders are command_template's.
+                // a std::regex built and run per command used to be most of the parse time
+                for (std::size_t at = command_text.find("~{"); at != std::string_view::npos; at = command_text.find("~{", at + 2))
                 {
-                    if (match.size() > 1)
-                    {
-                        // we just use the owned lexer to create a new T_IDENT token on the fly for this command argument
-                        ast_node_ptr arg = new_node(N_IDENT);
-                        token tk = m_lexer->new_token(T_IDENT, match[1].str(), prev_tok->column);
-                        arg->tok = std::make_shared<token>(std::move(tk));
-                        command.arguments.push_back(std::move(arg)); // Extract the variable name
-                        // args.push_back(match[1].str());   // Extract the variable name
-                    }
-                    command_str = match.suffix().str(); // Move to the next match
+                    std::size_t begin = at + 2, end = begin;
+                    if (end < command_text.size() && (std::isalpha(static_cast<unsigned char>(command_text[end])) || command_text[end] == '_'))
+                        while (end < command_text.size() && (std::isalnum(static_cast<unsigned char>(command_text[end])) || command_text[end] == '_'))
+                            ++end;
+                    if (end == begin || end >= command_text.size() || command_text[end] != '}')
+                        continue;
+                    // we just use the owned lexer to create a new T_IDENT token on the fly for this command argument
+                    ast_node_ptr arg = new_node(N_IDENT);
+                    token tk = m_lexer->new_token(T_IDENT, std::string(command_text.substr(begin, end - begin)), prev_tok->offset);
+                    arg->tok = std::make_shared<token>(std::move(tk));
+                    command.arguments.push_back(std::move(arg)); // Extract the variable name
                 }
                 ast_node_ptr command_node = new_node(N_COMMAND_DECL);
                 command_node->node = std::move(command);
@@ -519,6 +481,13 @@ namespace soto
                 decl.members.push_back(std::move(result));
                 continue;
             }
+            if (expect_token_and_read(T_IF)) // a workflow's if (cond) { ... } block
+            {
+                decl.members.push_back(parse_if_stmt());
+                while (expect_token_and_read(T_ENDL))
+                    ;
+                continue;
+            }
 
             // parse type
             ast_node_ptr type = new_node(N_TYPE);
@@ -708,6 +677,8 @@ namespace soto
 
                     if (expect_token_and_read(T_ASSIGN))
                     {
+                        while (expect_token_and_read(T_ENDL))
+                            ;
                         var.initializer = parse_expr();
                     }
                     else
@@ -747,26 +718,25 @@ namespace soto
             member_access_obj->tok = prev_tok;
             member_access.object = std::move(member_access_obj); // Use the task_name_to_call as the object
 
-            // if it's a CALL construct with a member access... and with or without an ALIAS...
+            // if it's a CALL construct with a member access (an imported task, Lib.Task)...
             if (expect_token_and_read(T_DOT))
             {
                 expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct member access.");
                 ast_node_ptr member_access_member = new_node(N_MEMBER_ACCESS_MEMBER);
                 member_access_member->tok = prev_tok;
                 member_access.member = std::move(member_access_member); // Use the task_name_to_call as the object
+            }
+            // ...with or without an ALIAS, either way. a plain `call Task` is a member access with no member
+            if (expect_token_and_read(T_AS))
+            {
+                expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct member alias.");
+                ast_node_ptr alias = new_node(N_ALIAS_DECL);
+                alias->tok = prev_tok;
 
-                if (expect_token_and_read(T_AS))
-                {
-                    expect_token_or_emit_error(T_IDENT, "Expect identifier for call construct member alias.");
-                    ast_node_ptr alias = new_node(N_ALIAS_DECL);
-                    alias->tok = prev_tok;
-
-                    input_decl.alias = std::move(alias);
-                }
-
-                mem_access->node = std::move(member_access);
-                input_decl.member_accessed = std::move(mem_access); // Use the member_access as the member_accessed
+                input_decl.alias = std::move(alias);
             }
+            mem_access->node = std::move(member_access);
+            input_decl.member_accessed = std::move(mem_access); // Use the member_access as the member_accessed
 
             if (!expect_token(T_LCURLY))
             {
@@ -820,6 +790,7 @@ namespace soto
     // parse a struct declaration.../Task or Class declaration....
     ast_node_ptr parser::parse_struct_decl()
     {
+        WDL_TRACE_SCOPE("parse_struct_decl");
         ast_node_ptr strct = new_node(N_STRUCT_DECL);
         struct_decl decl{};
         // struct have name...
@@ -834,7 +805,9 @@ namespace soto
         {
             while (expect_token_and_read(T_ENDL))
                 ; // consume any endline T_ENDL before start of struct members...
-            expect_token_or_emit_error(T_TYPE, "Expect type keyword at start of struct member.");
+            // a member's type is a type keyword or another struct's name
+            if (!expect_token_and_read(T_TYPE) && !expect_token_and_read(T_IDENT))
+                emit_error("Expect type keyword at start of struct member.", *curr_tok);
             auto member = parse_var_decl();
             if (member)
             {
@@ -856,6 +829,42 @@ namespace soto
         node->type = type;
         return node;
     }
+    std::string parser::parse_type_params(const std::string &lexeme)
+    {
+        // we're right after Array, Map or Pair... read the [...] and give back the full type string
+        std::string type_string = lexeme;
+        const std::size_t n_params = util::to_lowercase(lexeme) == "array" ? 1 : 2;
+        expect_token_or_emit_error(T_LSQUARE, "Expect '[' to begin array declaration.");
+        type_string += prev_tok->lexeme;
+        for (std::size_t i = 0; i < n_params; ++i)
+        {
+            if (i > 0)
+            {
+                expect_token_or_emit_error(T_COMMA, "Expect ',' to separate key and value types in map declaration.");
+                type_string += prev_tok->lexeme; // eat the comma too...
+            }
+            // struct names come in as T_IDENT, e.g Array[Sample]
+            if (!expect_token_and_read(T_TYPE) && !expect_token_and_read(T_IDENT))
+            {
+                emit_error("Expect type inside '[' ']'.", *curr_tok);
+                break;
+            }
+            std::string param = prev_tok->lexeme;
+            if (util::is_reference_type(param))
+                param = parse_type_params(param); // Array[Array[File]], Array[Pair[String, File]]...
+            if (expect_token_and_read(T_QUESTION))
+                param += "?";
+            type_string += param;
+        }
+        expect_token_or_emit_error(T_RSQUARE, "Expect ']' to end array declaration.");
+        type_string += prev_tok->lexeme;
+        if (expect_token_and_read(T_PLUS))
+        {
+            // this is a NON-empty array declaration...
+            type_string += prev_tok->lexeme;
+        }
+        return type_string;
+    }
     ast_node_ptr parser::parse_var_decl()
     {
         // handle command, we're trying to parse command decl as a variable declaration...
@@ -866,79 +875,11 @@ namespace soto
         // read_token_or_emit_error(); // consume type
         var_node.type->tok = prev_tok;
         auto lexeme = var_node.type->tok->lexeme;
-        if (util::to_lowercase(lexeme) == "array")
+        if (util::is_reference_type(lexeme))
         {
-            std::string array_type_string = "";
-            // this is an array variable declaration...
-            expect_token_or_emit_error(T_LSQUARE, "Expect '[' to begin array declaration.");
-            array_type_string = lexeme + prev_tok->lexeme;
-            expect_token_and_read(T_TYPE); // consume the type
-            array_type_string += prev_tok->lexeme;
-            expect_token_or_emit_error(T_RSQUARE, "Expect ']' to end array declaration.");
-            array_type_string += prev_tok->lexeme;
-            if (expect_token(T_PLUS))
-            {
-                // this is a NON-empty array declaration...
-                expect_token_and_read(T_PLUS);
-                array_type_string += prev_tok->lexeme;
-            }
-            // do we want to distinguish between different TYPEs, to me TYPE is TYPE or NULLABLETYPE is NULLABLETYPE ..we can figure out the kind of TYPE in it's lexeme and by static analysis...
-            var_node.type->tok->lexeme = array_type_string;
-        }
-
-        if (util::to_lowercase(lexeme) == "map")
-        {
-            // Map[String, File] input_files = {
-            //     "sample1": "s1.bam",
-            //     "sample2": "s2.bam"
-            //   }
-            std::string array_type_string = "";
-            // this is an array variable declaration...
-            expect_token_or_emit_error(T_LSQUARE, "Expect '[' to begin array declaration.");
-            array_type_string = lexeme + prev_tok->lexeme;
-            expect_token_and_read(T_TYPE); // consume the type1 i.e type of KEY
-            array_type_string += prev_tok->lexeme;
-            expect_token_or_emit_error(T_COMMA, "Expect ',' to separate key and value types in map declaration.");
-            array_type_string += prev_tok->lexeme; // eat the comma too...
-            expect_token_and_read(T_TYPE);         // consume the type2 i.e type of VALUE
-            array_type_string += prev_tok->lexeme;
-            expect_token_or_emit_error(T_RSQUARE, "Expect ']' to end array declaration.");
-            array_type_string += prev_tok->lexeme;
-            if (expect_token(T_PLUS))
-            {
-                // this is a NON-empty array declaration...
-                expect_token_and_read(T_PLUS);
-                array_type_string += prev_tok->lexeme;
-            }
-            // do we want to distinguish between different TYPEs, to me TYPE is TYPE or NULLABLETYPE is NULLABLETYPE ..we can figure out the kind of TYPE in it's lexeme and by static analysis...
-            var_node.type->tok->lexeme = array_type_string;
-        }
-        if (util::to_lowercase(lexeme) == "pair")
-        {
-            // Pair[String, File] input_files = {
-            //     "sample1": "s1.bam",
-            //     "sample2": "s2.bam"
-            //   }
-            std::string array_type_string = "";
-            // this is an array variable declaration...
-            expect_token_or_emit_error(T_LSQUARE, "Expect '[' to begin array declaration.");
-            array_type_string = lexeme + prev_tok->lexeme;
-            expect_token_and_read(T_TYPE); // consume the typeLeft
-            array_type_string += prev_tok->lexeme;
-            expect_token_or_emit_error(T_COMMA, "Expect ',' to separate key and value types in map declaration.");
-            array_type_string += prev_tok->lexeme; // eat the comma too...
-            expect_token_and_read(T_TYPE);         // consume the typeRight...
-            array_type_string += prev_tok->lexeme;
-            expect_token_or_emit_error(T_RSQUARE, "Expect ']' to end array declaration.");
-            array_type_string += prev_tok->lexeme;
-            if (expect_token(T_PLUS))
-            {
-                // this is a NON-empty array declaration...
-                expect_token_and_read(T_PLUS);
-                array_type_string += prev_tok->lexeme;
-            }
-            // do we want to distinguish between different TYPEs, to me TYPE is TYPE or NULLABLETYPE is NULLABLETYPE ..we can figure out the kind of TYPE in it's lexeme and by static analysis...
-            var_node.type->tok->lexeme = array_type_string;
+            // Array[File], Map[String, File], Pair[String, Array[File]]... whatever the nesting,
+            // the whole type ends up in the type token's lexeme e.g Array[Array[File]]+
+            var_node.type->tok->lexeme = parse_type_params(lexeme);
         }
         if (expect_token(T_QUESTION)) // if its File? or Int? or String? whatever....it's a nullable table and we'll get a '?' before the type Identifier
         {
@@ -958,6 +899,8 @@ namespace soto
 
         if (expect_token_and_read(T_ASSIGN))
         {
+            while (expect_token_and_read(T_ENDL))
+                ; // `String x =` with the expression on the lines after
             var_node.initializer = parse_expr();
         }
         else
@@ -980,8 +923,10 @@ namespace soto
             while (expect_token_and_read(T_ENDL))
                 ; // consume any endline T_ENDL before start of block statements...
             // expect_token_and_read(T_ENDL); // consume any endline T_ENDL before start of block statements...
+            auto before = curr_tok;
             auto stmt = parse_decl();
             block.statements.push_back(std::move(stmt));
+            skip_if_stuck(before);
         }
         node->node = std::move(block);
 
@@ -1080,12 +1025,16 @@ namespace soto
         if_stmt.condition = parse_expr();
         // expect_token_or_emit_error(T_RPAREN, "Expect a closing ')' after if condition.");
         expect_token_or_emit_error(T_THEN, "Expect 'then' after if condition.");
+        while (expect_token_and_read(T_ENDL))
+            ;
         if_stmt.then_ = parse_stmt();
         // if there's an ELSE_IF...
         // actually no need for else if as else if is just else and if...
         // so it gets parsed nonetheless
         if (expect_token_and_read(T_ELSE))
         {
+            while (expect_token_and_read(T_ENDL))
+                ;
             if_stmt.else_ = parse_stmt();
         }
         node->node = std::move(if_stmt);
@@ -1171,6 +1120,7 @@ namespace soto
             binary_expr bin{};
 
             bin.left = std::move(node);
+            bin.op = bin_node->tok;
             bin.right = parse_logand_expr();
 
             bin_node->node = std::move(bin);
@@ -1188,6 +1138,7 @@ namespace soto
             bin_node->tok = prev_tok;
             binary_expr bin{};
             bin.left = std::move(node);
+            bin.op = bin_node->tok;
             bin.right = parse_equality_expr();
             bin_node->node = std::move(bin);
             node = std::move(bin_node);
@@ -1203,6 +1154,7 @@ namespace soto
             bin_node->tok = prev_tok;
             binary_expr bin{};
             bin.left = std::move(node);
+            bin.op = bin_node->tok;
             bin.right = parse_comparison_expr();
             bin_node->node = std::move(bin);
             node = std::move(bin_node);
@@ -1218,6 +1170,7 @@ namespace soto
             bin_node->tok = prev_tok;
             binary_expr bin{};
             bin.left = std::move(node);
+            bin.op = bin_node->tok;
             bin.right = parse_term_expr();
             bin_node->node = std::move(bin);
             node = std::move(bin_node);
@@ -1257,7 +1210,25 @@ namespace soto
             // std::cout << "Parsing a ternary-like expression..." << std::endl;
             return parse_ternary_if_stmt(); // this is a ternary-like expression...
         }
-        return parse_primary_expr();
+        return parse_postfix_expr();
+    }
+
+    ast_node_ptr parser::parse_postfix_expr()
+    {
+        ast_node_ptr node = parse_primary_expr();
+        // ScatterIntervals.scattered_interval_lists[scatter_index], matrix[i][j]...
+        while (node && expect_token_and_read(T_LSQUARE))
+        {
+            ast_node_ptr index_node = new_node(N_INDEX);
+            index_node->tok = prev_tok;
+            index_expr index{};
+            index.collection = std::move(node);
+            index.index = parse_expr();
+            expect_token_or_emit_error(T_RSQUARE, "Expect a closing ']' after index.");
+            index_node->node = std::move(index);
+            node = std::move(index_node);
+        }
+        return node;
     }
 
     ast_node_ptr parser::parse_primary_expr()
@@ -1280,7 +1251,11 @@ namespace soto
             expect_token_or_emit_error(T_DOT, "Expect '.' after object identifier.");
 
             // expect_token_or_emit_error(T_IDENT, "Expect member name after '.' operator.");
-            auto member = parse_expr(); // because some times, it may not be just simple .IDENT for member access, sometimes, it may be .FUNC_CALL.. like OncoAnotate.get_function(param1, param2)
+            // a primary, not a whole expression... sometimes it's not just .IDENT, it may be .FUNC_CALL like
+            // OncoAnotate.get_function(param1, param2) or a.b.c, but in `x.y + 1` the + isn't the member's
+            auto member = parse_primary_expr();
+            if (!member)
+                return nullptr;
             // member->type = N_MEMBER_ACCESS_MEMBER;
             access.member = std::move(member);
             access.member->tok = prev_tok;
@@ -1381,19 +1356,23 @@ namespace soto
         }
         if (expect_token_and_read(T_LPAREN)) // this is initialization of a WDL1.0 Pair... i.e Pair[TypeLeft, TypeRight] = (ValueLeft, ValueRight)
         {
+            // ...or just a parenthesized expression, the ',' is what tells them apart
             ast_node_ptr pair_node = new_node(N_PAIR);
             pair_expr pair{};
             if (!expect_token(T_RPAREN))
-                do
+            {
+                while (expect_token_and_read(T_ENDL))
+                    ; // consume any endline T_ENDL before start of map elements...
+                auto first = parse_expr();
+                if (!expect_token_and_read(T_COMMA))
                 {
-                    while (expect_token_and_read(T_ENDL))
-                        ; // consume any endline T_ENDL before start of map elements...
-                    auto first = parse_expr();
-                    expect_token_or_emit_error(T_COMMA, "Expect ',' after map key.");
-                    auto value = parse_expr();
-                    pair.first = std::move(first);
-                    pair.second = std::move(value);
-                } while (!expect_token(T_RPAREN));
+                    expect_token_or_emit_error(T_RPAREN, "Expect a closing ')' after expression.");
+                    return first;
+                }
+                auto value = parse_expr();
+                pair.first = std::move(first);
+                pair.second = std::move(value);
+            }
 
             pair_node->node = std::move(pair);
             while (expect_token_and_read(T_ENDL))
@@ -1413,10 +1392,17 @@ namespace soto
         curr_tok->kind = T_EOF;
         return nullptr;
     }
+    ast_node_ptr parser::parse_standalone_expr()
+    {
+        ast_node_ptr expr = parse_expr();
+        if (expr && !expect_token(T_EOF))
+            emit_error("Unexpected token after expression.", *curr_tok);
+        return expr;
+    }
     ast_node_ptr parser::parse_factor_expr()
     {
         ast_node_ptr node = parse_unary_expr();
-        while (expect_token_and_read(T_STAR) || expect_token_and_read(T_FSLASH))
+        while (expect_token_and_read(T_STAR) || expect_token_and_read(T_FSLASH) || expect_token_and_read(T_MODULO))
         {
             ast_node_ptr bin_node = new_node(N_BINARY_EXPR);
             bin_node->tok = prev_tok;
@@ -1635,6 +1621,26 @@ namespace soto
                 {
                     file << indentation << "Literal: " << value.value.lexeme << "\n";
                 }
+                else if constexpr (std::is_same_v<T, constant_expr>)
+                {
+                    file << indentation << "Constant: " << value.value.to_string() << "\n";
+                }
+                else if constexpr (std::is_same_v<T, index_expr>)
+                {
+                    file << indentation << "Index Expression:\n";
+                    write_ast_node_to_file(value.collection, file_name, indent + 2);
+                    write_ast_node_to_file(value.index, file_name, indent + 2);
+                }
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    file << indentation << "Struct Literal:\n";
+                    for (const auto &v : value.values)
+                        write_ast_node_to_file(v, file_name, indent + 2);
+                }
+                else if constexpr (std::is_same_v<T, interpolation>)
+                {
+                    file << indentation << "Interpolated String: " << (node->tok ? node->tok->lexeme : "") << "\n";
+                }
                 else
                 {
                     file << indentation << "Unhandled Node Type\n";
@@ -1697,6 +1703,26 @@ namespace soto
                     print_ast_node(value.first, indent + 2);
                     print_ast_node(value.second, indent + 2);
                 }
+                else if constexpr (std::is_same_v<T, constant_expr>)
+                {
+                    std::cout << indentation << "Constant: " << value.value.to_string() << "\n";
+                }
+                else if constexpr (std::is_same_v<T, index_expr>)
+                {
+                    std::cout << indentation << "Index Expression:\n";
+                    print_ast_node(value.collection, indent + 2);
+                    print_ast_node(value.index, indent + 2);
+                }
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    std::cout << indentation << "Struct Literal:\n";
+                    for (const auto &v : value.values)
+                        print_ast_node(v, indent + 2);
+                }
+                else if constexpr (std::is_same_v<T, interpolation>)
+                {
+                    std::cout << indentation << "Interpolated String: " << (node->tok ? node->tok->lexeme : "") << "\n";
+                }
                 else if constexpr (std::is_same_v<T, scatter_stmt>)
                 {
                     std::cout << indentation << "Scatter Statement:\n";
@@ -0,0 +1,511 @@
+#include "process_supervisor.h"
+#include "trace.h"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace soto
+{
+
+    void tail_buffer::append(const char *data, std::size_t len)
+    {
+        if (capacity == 0 || len == 0)
+            return;
+        if (!ring)
+            ring = std::make_unique<char[]>(capacity);
+        if (len >= capacity)
+        {
+            // only the last capacity bytes of this write survive anyway...
+            std::memcpy(ring.get(), data + (len - capacity), capacity);
+            end = 0;
+            wrapped = true;
+            return;
+        }
+        std::size_t first = std::min(len, capacity - end);
+        std::memcpy(ring.get() + end, data, first);
+        std::memcpy(ring.get(), data + first, len - first);
+        if (end + len >= capacity)
+            wrapped = true;
+        end = (end + len) % capacity;
+    }
+    std::string tail_buffer::str() const
+    {
+        if (!ring)
+            return "";
+        if (!wrapped)
+            return std::string(ring.get(), end);
+        std::string out(ring.get() + end, capacity - end);
+        out.append(ring.get(), end);
+        return out;
+    }
+
+    // everything the epoll set points at starts with one of these so the loop knows what woke it up...
+    enum watch_kind
+    {
+        W_WAKE,
+        W_STREAM,
+        W_PID,
+    };
+    struct watch
+    {
+        watch_kind kind;
+    };
+    static watch wake_watch{W_WAKE};
+
+    struct process_supervisor::stream : watch
+    {
+        process_supervisor::child *owner = nullptr;
+        int fd = -1;      // read end of the pipe
+        int file_fd = -1; // where it all ends up... -1 = nobody asked for the file
+        std::string path;
+        bool eof = false;
+        bool write_failed = false;
+        std::unique_ptr<char[]> buf; // write buffer, allocated when the first byte shows up
+        std::size_t used = 0;
+        std::uint64_t bytes = 0;
+        tail_buffer tail;
+
+        stream() : watch{W_STREAM} {}
+    };
+
+    struct process_supervisor::child : watch
+    {
+        std::uint64_t id = 0;
+        int pid = -1;
+        int pidfd = -1; // -1 on kernels without pidfd_open, then EOF on both pipes means "go reap it"
+        bool exited = false;
+        bool done = false; // result handed out, waiting to be freed at the end of the epoll batch
+        int status = 0;
+        struct rusage usage{}; // bash -c and everything it waited for
+        stream out;
+        stream err;
+        std::function<void(const process_result &)> on_exit;
+        std::chrono::steady_clock::time_point started;
+        std::uint64_t trace_begin = 0; // only set while tracing, spawn -> exit becomes one "task" event
+        std::string trace_command;
+
+        child() : watch{W_PID} {}
+    };
+
+    static void close_fd(int &fd)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+
+    static void flush_stream(process_supervisor::stream &s)
+    {
+        if (s.used == 0)
+            return;
+        if (s.file_fd >= 0 && !s.write_failed)
+        {
+            std::size_t done = 0;
+            while (done < s.used)
+            {
+                ssize_t n = ::write(s.file_fd, s.buf.get() + done, s.used - done);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    // disk full or so... keep draining the pipe so the child doesn't block on us
+                    s.write_failed = true;
+                    break;
+                }
+                done += static_cast<std::size_t>(n);
+            }
+        }
+        s.used = 0;
+    }
+
+    // every child gets stdout+stderr+pidfd, the default 1024 soft limit is ~300 tasks...
+    void process_supervisor::raise_fd_limit()
+    {
+        struct rlimit rl;
+        if (::getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+        {
+            rl.rlim_cur = rl.rlim_max;
+            ::setrlimit(RLIMIT_NOFILE, &rl);
+        }
+    }
+
+    process_supervisor::process_supervisor(std::size_t tail_bytes, std::size_t write_buffer_bytes)
+        : tail_bytes(tail_bytes), write_buffer_bytes(write_buffer_bytes ? write_buffer_bytes : 4096)
+    {
+        raise_fd_limit();
+        epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+            throw std::runtime_error(std::string("Failed to create epoll instance: ") + std::strerror(errno));
+        wake_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wake_fd < 0)
+            throw std::runtime_error(std::string("Failed to create eventfd: ") + std::strerror(errno));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &wake_watch;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+        io_thread = std::thread([this]()
+                                {
+                                    trace_thread_name("supervisor-io");
+                                    loop(); });
+    }
+
+    process_supervisor::~process_supervisor()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            for (auto &[id, c] : children)
+                if (!c->exited)
+                    ::kill(-c->pid, SIGKILL); // the whole process group, not just bash...
+        }
+        wake();
+        if (io_thread.joinable())
+            io_thread.join();
+        close_fd(wake_fd);
+        close_fd(epoll_fd);
+    }
+
+    void process_supervisor::wake()
+    {
+        std::uint64_t one = 1;
+        if (::write(wake_fd, &one, sizeof(one)) < 0)
+        {
+            // nothing to do, the eventfd is still readable from the last one...
+        }
+    }
+
+    std::uint64_t process_supervisor::spawn(const process_spec &spec, std::function<void(const process_result &)> on_exit)
+    {
+        auto c = std::make_unique<child>();
+        c->on_exit = std::move(on_exit);
+        c->out.owner = c.get();
+        c->err.owner = c.get();
+        c->out.path = spec.stdout_path;
+        c->err.path = spec.stderr_path;
+        c->out.tail = tail_buffer(tail_bytes);
+        c->err.tail = tail_buffer(tail_bytes);
+
+        int out_pipe[2], err_pipe[2];
+        if (::pipe2(out_pipe, O_CLOEXEC) != 0)
+            throw std::runtime_error(std::string("Failed to create pipe: ") + std::strerror(errno));
+        if (::pipe2(err_pipe, O_CLOEXEC) != 0)
+        {
+            ::close(out_pipe[0]);
+            ::close(out_pipe[1]);
+            throw std::runtime_error(std::string("Failed to create pipe: ") + std::strerror(errno));
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, 0, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, out_pipe[1], 1);
+        posix_spawn_file_actions_adddup2(&actions, err_pipe[1], 2);
+        if (!spec.working_dir.empty())
+            posix_spawn_file_actions_addchdir_np(&actions, spec.working_dir.c_str());
+
+        // own process group so a kill takes the whole pipeline down, and a clean signal mask...
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        sigset_t none;
+        sigemptyset(&none);
+        posix_spawnattr_setsigmask(&attr, &none);
+        posix_spawnattr_setpgroup(&attr, 0);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_USEVFORK);
+
+        static const char *shell = ::access("/bin/bash", X_OK) == 0 ? "/bin/bash" : "/bin/sh";
+        char *argv[] = {const_cast<char *>(shell), const_cast<char *>("-c"), const_cast<char *>(spec.command.c_str()), nullptr};
+        int rc = ::posix_spawn(&c->pid, shell, &actions, &attr, argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        ::close(out_pipe[1]);
+        ::close(err_pipe[1]);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        std::uint64_t id = next_id++;
+        c->id = id;
+        c->started = std::chrono::steady_clock::now();
+        if (tracing_enabled.load(std::memory_order_relaxed))
+        {
+            c->trace_begin = trace_now_ns();
+            c->trace_command = spec.command;
+        }
+
+        if (rc != 0)
+        {
+            ::close(out_pipe[0]);
+            ::close(err_pipe[0]);
+            process_result result{};
+            result.id = id;
+            result.error = std::string("Failed to spawn process: ") + std::strerror(rc);
+            if (c->on_exit)
+            {
+                // the io thread's to call like any other exit... the caller may hold what on_exit locks
+                unspawned.emplace_back(std::move(c->on_exit), std::move(result));
+                lock.unlock();
+                wake();
+            }
+            else
+            {
+                finished.emplace(id, std::move(result));
+                done_cv.notify_all();
+            }
+            return id;
+        }
+
+        c->out.fd = out_pipe[0];
+        c->err.fd = err_pipe[0];
+        for (stream *s : {&c->out, &c->err})
+        {
+            ::fcntl(s->fd, F_SETFL, ::fcntl(s->fd, F_GETFL) | O_NONBLOCK);
+            if (!s->path.empty())
+                s->file_fd = ::open(s->path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (!s->path.empty() && s->file_fd < 0)
+                s->write_failed = true;
+        }
+#ifdef SYS_pidfd_open
+        c->pidfd = static_cast<int>(::syscall(SYS_pidfd_open, c->pid, 0));
+        if (c->pidfd >= 0)
+            ::fcntl(c->pidfd, F_SETFD, FD_CLOEXEC);
+#endif
+
+        child *raw = c.get();
+        children.emplace(id, std::move(c));
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = static_cast<watch *>(&raw->out);
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, raw->out.fd, &ev);
+        ev.data.ptr = static_cast<watch *>(&raw->err);
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, raw->err.fd, &ev);
+        if (raw->pidfd >= 0)
+        {
+            ev.data.ptr = static_cast<watch *>(raw);
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, raw->pidfd, &ev);
+        }
+        return id;
+    }
+
+    process_result process_supervisor::wait(std::uint64_t id)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        auto running = children.find(id);
+        if (running != children.end() && running->second->on_exit)
+            throw std::logic_error("process was spawned with an exit callback, it can't be waited on");
+        if (running == children.end() && finished.find(id) == finished.end())
+            throw std::logic_error("unknown process id: " + std::to_string(id));
+        done_cv.wait(lock, [&]()
+                     { return finished.find(id) != finished.end(); });
+        process_result result = std::move(finished[id]);
+        finished.erase(id);
+        return result;
+    }
+
+    std::size_t process_supervisor::running()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return children.size();
+    }
+
+    void process_supervisor::on_readable(stream &s)
+    {
+        if (s.fd < 0)
+            return;
+        // level triggered, so a few reads per wakeup is plenty and keeps one firehose from starving the rest...
+        for (int round = 0; round < 4; ++round)
+        {
+            if (!s.buf)
+                s.buf = std::make_unique<char[]>(write_buffer_bytes);
+            ssize_t n = ::read(s.fd, s.buf.get() + s.used, write_buffer_bytes - s.used);
+            if (n > 0)
+            {
+                s.tail.append(s.buf.get() + s.used, static_cast<std::size_t>(n));
+                s.used += static_cast<std::size_t>(n);
+                s.bytes += static_cast<std::uint64_t>(n);
+                if (s.used == write_buffer_bytes)
+                    flush_stream(s);
+                continue;
+            }
+            if (n < 0 && (errno == EAGAIN || errno == EINTR))
+                return;
+            // EOF (or a dead pipe, same thing to us)
+            s.eof = true;
+            flush_stream(s);
+            s.buf.reset();
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s.fd, nullptr);
+            close_fd(s.fd);
+            close_fd(s.file_fd);
+            maybe_finish(*s.owner);
+            return;
+        }
+    }
+
+    void process_supervisor::on_exited(child &c)
+    {
+        if (c.exited)
+            return;
+        if (::wait4(c.pid, &c.status, WNOHANG, &c.usage) != c.pid)
+            return;
+        c.exited = true;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c.pidfd, nullptr);
+        close_fd(c.pidfd);
+
+        // whatever it wrote before dying is sitting in the pipes, get it all out...
+        // a background job that outlived the task and still holds the pipes gets cut off here
+        for (stream *s : {&c.out, &c.err})
+        {
+            while (s->fd >= 0)
+            {
+                std::size_t before = s->bytes;
+                on_readable(*s);
+                if (s->fd >= 0 && s->bytes == before)
+                {
+                    flush_stream(*s);
+                    s->buf.reset();
+                    s->eof = true;
+                    ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, s->fd, nullptr);
+                    close_fd(s->fd);
+                    close_fd(s->file_fd);
+                }
+            }
+        }
+        maybe_finish(c);
+    }
+
+    void process_supervisor::maybe_finish(child &c)
+    {
+        if (c.done || !c.out.eof || !c.err.eof)
+            return;
+        if (!c.exited)
+        {
+            if (c.pidfd >= 0)
+                return; // the pidfd will tell us, don't block the loop on waitpid
+            // no pidfd... a child that closed its pipes but hasn't exited yet is polled from the loop, a
+            // blocking wait here would stall every other child's output
+            if (::wait4(c.pid, &c.status, WNOHANG, &c.usage) != c.pid)
+            {
+                unreaped.push_back(&c);
+                return;
+            }
+            c.exited = true;
+        }
+
+        process_result result{};
+        result.id = c.id;
+        result.pid = c.pid;
+        if (WIFEXITED(c.status))
+            result.exit_code = WEXITSTATUS(c.status);
+        else if (WIFSIGNALED(c.status))
+            result.term_signal = WTERMSIG(c.status);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - c.started).count();
+        if (c.trace_begin)
+            trace_record("task", c.trace_begin, trace_now_ns(), c.trace_command);
+        result.max_rss_kb = c.usage.ru_maxrss;
+        result.user_seconds = c.usage.ru_utime.tv_sec + c.usage.ru_utime.tv_usec / 1e6;
+        result.system_seconds = c.usage.ru_stime.tv_sec + c.usage.ru_stime.tv_usec / 1e6;
+        result.stdout_bytes = c.out.bytes;
+        result.stderr_bytes = c.err.bytes;
+        result.stdout_tail = c.out.tail.str();
+        result.stderr_tail = c.err.tail.str();
+        if (c.out.write_failed)
+            result.error = "Failed to write to file: " + c.out.path;
+        else if (c.err.write_failed)
+            result.error = "Failed to write to file: " + c.err.path;
+
+        // the child object itself lives until the end of this epoll batch, a later event
+        // in the same batch may still point at it...
+        c.done = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = children.find(c.id);
+            retired.push_back(std::move(it->second));
+            children.erase(it);
+            if (!c.on_exit)
+            {
+                finished.emplace(result.id, std::move(result));
+                done_cv.notify_all();
+                return;
+            }
+        }
+        c.on_exit(result);
+    }
+
+    void process_supervisor::reap_unreaped()
+    {
+        for (std::size_t i = 0; i < unreaped.size();)
+        {
+            child &c = *unreaped[i];
+            const pid_t r = ::wait4(c.pid, &c.status, WNOHANG, &c.usage);
+            if (r == 0 || (r < 0 && errno == EINTR))
+            {
+                ++i;
+                continue;
+            }
+            c.exited = true; // or already reaped by somebody else, nothing to wait for either way
+            unreaped[i] = unreaped.back();
+            unreaped.pop_back();
+            maybe_finish(c);
+        }
+    }
+
+    void process_supervisor::loop()
+    {
+        static constexpr int REAP_POLL_MS = 10; // how often children without a pidfd are checked on
+        std::vector<epoll_event> events(256);
+        for (;;)
+        {
+            int n = ::epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), unreaped.empty() ? -1 : REAP_POLL_MS);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            for (int i = 0; i < n; ++i)
+            {
+                watch *w = static_cast<watch *>(events[i].data.ptr);
+                switch (w->kind)
+                {
+                case W_WAKE:
+                {
+                    std::uint64_t drained;
+                    while (::read(wake_fd, &drained, sizeof(drained)) > 0)
+                        ;
+                    decltype(unspawned) failed;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        failed.swap(unspawned);
+                    }
+                    for (auto &[on_exit, result] : failed)
+                        on_exit(result);
+                    break;
+                }
+                case W_STREAM:
+                    on_readable(*static_cast<stream *>(w));
+                    break;
+                case W_PID:
+                    on_exited(*static_cast<child *>(w));
+                    break;
+                }
+            }
+            reap_unreaped();
+            retired.clear();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping && children.empty() && unspawned.empty())
+                return;
+        }
+    }
+
+}
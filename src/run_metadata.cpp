@@ -0,0 +1,143 @@
+#include "run_metadata.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+namespace soto
+{
+
+    static double now_seconds()
+    {
+        return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    std::string iso8601_utc(double unix_seconds)
+    {
+        std::time_t secs = static_cast<std::time_t>(std::floor(unix_seconds));
+        int millis = static_cast<int>((unix_seconds - std::floor(unix_seconds)) * 1000.0);
+        std::tm tm{};
+        gmtime_r(&secs, &tm);
+        char buf[96]; // 7 ints of up to 11 chars each and the separators, whatever gmtime_r hands back
+        std::snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                      tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, millis);
+        return buf;
+    }
+
+    metadata_writer::metadata_writer(const std::string &path, const std::string &workflow, const std::string &run_id, json_style style)
+        : out(path, style)
+    {
+        out.begin_object();
+        out.key("workflowName").value(workflow);
+        out.key("id").value(run_id);
+        out.key("start").value(iso8601_utc(now_seconds()));
+        out.key("calls").begin_array();
+        out.flush();
+    }
+
+    metadata_writer::~metadata_writer()
+    {
+        try
+        {
+            finish("Aborted");
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+
+    void metadata_writer::call_finished(const call_metadata &call)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            return;
+        out.begin_object();
+        out.key("name").value(call.name);
+        out.key("shardIndex").value(call.shard);
+        out.key("attempt").value(call.attempt);
+        out.key("executionStatus").value(call_status_to_string(call.status));
+        out.key("returnCode").value(call.return_code);
+        out.key("callCaching").begin_object();
+        out.key("hit").value(call.cache_hit);
+        if (!call.cache_key.empty())
+            out.key("key").value(call.cache_key);
+        out.end_object();
+        out.key("callRoot").value(call.call_root);
+        out.key("stdout").value(call.stdout_path);
+        out.key("stderr").value(call.stderr_path);
+        out.key("start").value(iso8601_utc(call.start));
+        out.key("end").value(iso8601_utc(call.end));
+        out.key("resourceUsage").begin_object();
+        out.key("maxRssKb").value(static_cast<std::int64_t>(call.max_rss_kb));
+        out.key("userSeconds").value(call.user_seconds);
+        out.key("systemSeconds").value(call.system_seconds);
+        out.end_object();
+        out.key("outputs").begin_object();
+        for (const auto &[name, value] : call.outputs)
+            out.key(name).value(value);
+        out.end_object();
+        out.end_object();
+        out.flush(); // one write per call... a 50k-call run is 50k small writes, nothing next to running 50k processes
+        calls++;
+    }
+
+    void metadata_writer::finish(const std::string &status)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            return;
+        finished = true;
+        out.end_array();
+        out.key("end").value(iso8601_utc(now_seconds()));
+        out.key("status").value(status);
+        out.end_object();
+        out.flush();
+    }
+
+    std::size_t metadata_writer::calls_written()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return calls;
+    }
+
+    outputs_writer::outputs_writer(const std::string &path, const std::string &run_id, json_style style)
+        : out(path, style), run_id(run_id)
+    {
+        out.begin_object();
+        out.key("outputs").begin_object();
+        out.flush();
+    }
+
+    outputs_writer::~outputs_writer()
+    {
+        try
+        {
+            finish();
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+
+    void outputs_writer::output(const std::string &name, const wdl_value &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            return;
+        out.key(name).value(value);
+        out.flush();
+    }
+
+    void outputs_writer::finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            return;
+        finished = true;
+        out.end_object();
+        out.key("id").value(run_id);
+        out.end_object();
+        out.flush();
+    }
+
+}
@@ -0,0 +1,261 @@
+#include "shard_batch.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    batch_policy batch_policy_of(const runtime_decl &runtime, const eval_scope &scope, const batch_policy &fallback)
+    {
+        batch_policy policy = fallback;
+        for (const auto &[key, value] : runtime.members)
+        {
+            if (!key || !key->tok || key->tok->lexeme != "batch_shards" || !value)
+                continue;
+            const wdl_value n = evaluate(value, scope);
+            if (n.kind != WT_INT || n.as_int() < 1)
+                throw std::runtime_error("batch_shards needs a positive Int, got " + n.to_string());
+            policy.shards_per_batch = static_cast<std::size_t>(n.as_int());
+        }
+        return policy;
+    }
+
+    // single-quoted for sh, a ' inside becomes '\'' (close, escaped quote, reopen)... 'it'\''s'
+    static std::string quoted(const std::string &s)
+    {
+        std::string out = "'";
+        for (char c : s)
+        {
+            if (c == '\'')
+                out += "'\\''";
+            else
+                out += c;
+        }
+        return out + "'";
+    }
+
+    static std::string absolute(const std::string &path)
+    {
+        std::error_code ec;
+        fs::path p = fs::absolute(path, ec);
+        return ec ? path : p.string();
+    }
+
+    std::string batch_script(const std::vector<batch_shard> &shards, const std::vector<std::size_t> &which)
+    {
+        // eval, so a shard whose command doesn't even parse fails alone instead of taking the script with it.
+        // a subshell is a fork, no exec... that and not localizing anything is what batching saves.
+        // plain sh, the supervisor runs it with /bin/sh where there's no bash. bash 5's $EPOCHREALTIME costs
+        // nothing, any other shell gets its timestamps from date (whole seconds where there's no %N)
+        std::string script = "# wdlrunner batch worker, " + std::to_string(which.size()) + " shard(s)\nset +e\n";
+        const std::string now = "\"${EPOCHREALTIME:-$(date +%s.%N)}\"";
+        for (std::size_t i : which)
+        {
+            const process_spec &spec = shards[i].spec;
+            script += "t0=" + now + "; ( cd " + quoted(absolute(spec.working_dir)) + " && eval " + quoted(spec.command) + " ) >" +
+                      quoted(absolute(spec.stdout_path)) + " 2>" + quoted(absolute(spec.stderr_path)) +
+                      "; rc=$?; printf 'shard %s %s %s %s\\n' " + std::to_string(i) + " \"$rc\" \"$t0\" " + now + "\n";
+        }
+        return script;
+    }
+
+    static std::uint64_t size_of(const std::string &path)
+    {
+        std::error_code ec;
+        const auto n = fs::file_size(path, ec);
+        return ec ? 0 : static_cast<std::uint64_t>(n);
+    }
+
+    // the end of a shard's stderr, for the error message... the supervisor keeps this in memory for a lone shard
+    static std::string tail_of(const std::string &path, std::size_t bytes = 16u << 10)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return "";
+        file.seekg(0, std::ios::end);
+        const std::streamoff size = file.tellg();
+        const std::streamoff from = size > static_cast<std::streamoff>(bytes) ? size - static_cast<std::streamoff>(bytes) : 0;
+        file.seekg(from);
+        std::string tail(static_cast<std::size_t>(size - from), '\0');
+        file.read(tail.data(), static_cast<std::streamsize>(tail.size()));
+        return tail;
+    }
+
+    struct batch_job
+    {
+    public:
+        std::vector<std::size_t> which; // indices into the shards
+        std::string script;             // the worker's files without their extension, .sh .stdout .stderr
+        process_result result;
+    };
+
+    // what the worker printed... a shard without a line never ran
+    static void read_worker(const batch_job &job, std::vector<batch_shard_result> &results)
+    {
+        std::vector<bool> seen(results.size(), false);
+        std::ifstream out(job.script + ".stdout"); // where its `shard ...` lines go
+        std::string line;
+        while (std::getline(out, line))
+        {
+            std::istringstream fields(line);
+            std::string tag, start, end;
+            std::size_t i = 0;
+            int rc = -1;
+            if (!(fields >> tag >> i >> rc) || tag != "shard" || i >= results.size())
+                continue; // what a shard printed to the worker's own stdout, it shouldn't have any
+            fields >> start >> end;
+            results[i].exit_code = rc;
+            results[i].seconds = std::max(0.0, std::strtod(end.c_str(), nullptr) - std::strtod(start.c_str(), nullptr));
+            seen[i] = true;
+        }
+        for (std::size_t i : job.which)
+            if (!seen[i])
+            {
+                results[i].exit_code = -1;
+                results[i].error = "the batch worker exited before running it";
+                if (job.result.term_signal)
+                    results[i].error += " (killed by signal " + std::to_string(job.result.term_signal) + ")";
+                else if (!job.result.error.empty())
+                    results[i].error += ": " + job.result.error;
+            }
+    }
+
+    std::vector<batch_shard_result> run_shards(process_supervisor &supervisor, const std::vector<batch_shard> &shards, const batch_policy &policy,
+                                               const std::string &batch_dir, call_cache *cache, batch_stats *stats)
+    {
+        std::vector<batch_shard_result> results(shards.size());
+        batch_stats local;
+        batch_stats &st = stats ? *stats : local;
+
+        std::vector<std::size_t> pending;
+        pending.reserve(shards.size());
+        for (std::size_t i = 0; i < shards.size(); ++i)
+        {
+            const call_cache_entry *hit = cache && !shards[i].cache_key.empty() ? cache->lookup(shards[i].cache_key) : nullptr;
+            if (hit && cache->restore(*hit, shards[i].spec.working_dir, results[i].outputs))
+            {
+                results[i].cached = true;
+                results[i].exit_code = 0;
+                ++st.cache_hits;
+                continue;
+            }
+            results[i].outputs.clear();
+            pending.push_back(i);
+        }
+
+        const std::size_t per = policy.enabled() ? policy.shards_per_batch : 1;
+        std::vector<batch_job> jobs;
+        jobs.reserve((pending.size() + per - 1) / per);
+        for (std::size_t b = 0; b < pending.size(); b += per)
+            jobs.push_back({std::vector<std::size_t>(pending.begin() + static_cast<std::ptrdiff_t>(b),
+                                                     pending.begin() + static_cast<std::ptrdiff_t>(std::min(b + per, pending.size()))),
+                            "", {}});
+        if (per > 1 && !jobs.empty())
+        {
+            // every worker script written before anything is spawned, so a failure here leaves nothing running
+            fs::create_directories(batch_dir);
+            for (std::size_t j = 0; j < jobs.size(); ++j)
+            {
+                const std::string name = (fs::path(batch_dir) / ("batch-" + std::to_string(j))).string();
+                std::ofstream script(name + ".sh");
+                script << batch_script(shards, jobs[j].which);
+                script.close();
+                if (!script)
+                    throw std::runtime_error("Failed to write to file: " + name + ".sh");
+                jobs[j].script = name;
+            }
+        }
+
+        const std::size_t parallel = policy.parallel ? policy.parallel : std::max(1u, std::thread::hardware_concurrency());
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::size_t running = 0, finished = 0, spawned = 0;
+        // the callbacks point into this frame, so whatever was spawned is waited for even when a spawn throws
+        auto wait_spawned = [&]
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]
+                    { return finished == spawned; });
+        };
+        try
+        {
+            for (std::size_t j = 0; j < jobs.size(); ++j)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&]
+                            { return running < parallel; });
+                    ++running;
+                }
+                const std::string &name = jobs[j].script;
+                const process_spec spec = per == 1 ? shards[jobs[j].which.front()].spec
+                                                   : process_spec{". " + quoted(absolute(name + ".sh")), batch_dir, name + ".stdout", name + ".stderr"};
+                supervisor.spawn(spec, [&, j](const process_result &r)
+                                 {
+                                     std::lock_guard<std::mutex> lock(mutex);
+                                     jobs[j].result = r;
+                                     --running;
+                                     ++finished;
+                                     cv.notify_all(); });
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++spawned;
+                }
+                ++st.processes;
+            }
+        }
+        catch (...)
+        {
+            wait_spawned();
+            throw;
+        }
+        wait_spawned();
+
+        for (const batch_job &job : jobs)
+        {
+            if (per == 1)
+            {
+                batch_shard_result &r = results[job.which.front()];
+                r.exit_code = job.result.exit_code;
+                r.seconds = job.result.seconds;
+                r.error = job.result.error;
+                if (r.exit_code != 0)
+                    r.stderr_tail = job.result.stderr_tail;
+            }
+            else
+                read_worker(job, results);
+        }
+        for (std::size_t i : pending)
+        {
+            batch_shard_result &r = results[i];
+            const batch_shard &shard = shards[i];
+            r.stdout_bytes = size_of(shard.spec.stdout_path);
+            r.stderr_bytes = size_of(shard.spec.stderr_path);
+            if (r.exit_code != -1)
+                ++st.shards_run;
+            if (r.exit_code != 0)
+            {
+                ++st.failed;
+                if (per > 1 && r.exit_code != -1)
+                    r.stderr_tail = tail_of(shard.spec.stderr_path);
+                continue;
+            }
+            if (cache && !shard.cache_key.empty())
+            {
+                cache->store({shard.cache_key, shard.spec.working_dir, shard.outputs});
+                ++st.stored;
+            }
+        }
+        return results;
+    }
+
+}
@@ -0,0 +1,179 @@
+#include "trace.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "json_writer.h"
+
+#include <unistd.h>
+
+namespace soto
+{
+
+    std::atomic<bool> tracing_enabled{false};
+
+    struct trace_event
+    {
+        const char *name;
+        std::uint64_t begin_ns;
+        std::uint64_t end_ns;
+        std::string detail;
+    };
+
+    // events go into fixed-size blocks only the owning thread writes... the count is published with
+    // release so the exporter can read a block while its thread is still appending to it, no locks either way
+    struct trace_block
+    {
+        static constexpr std::size_t CAPACITY = 4096;
+        trace_event events[CAPACITY];
+        std::atomic<std::size_t> used{0};
+        std::atomic<trace_block *> next{nullptr};
+    };
+
+    struct trace_buffer
+    {
+        int tid = 0;
+        std::string thread_name;
+        std::unique_ptr<trace_block> head = std::make_unique<trace_block>();
+        trace_block *tail = head.get();
+        std::vector<std::unique_ptr<trace_block>> more; // owns everything after head
+    };
+
+    // buffers outlive their threads, a hash worker that's long gone still has its events exported
+    static std::mutex registry_mutex;
+    static std::vector<std::unique_ptr<trace_buffer>> registry;
+    static std::atomic<std::uint64_t> origin_ns{0};
+    static thread_local trace_buffer *local = nullptr;
+    static thread_local std::string pending_thread_name; // named before the thread's first event
+    static const std::thread::id main_thread = std::this_thread::get_id(); // static init runs on main()'s thread
+
+    static trace_buffer &local_buffer()
+    {
+        if (!local)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry.push_back(std::make_unique<trace_buffer>());
+            local = registry.back().get();
+            local->tid = static_cast<int>(registry.size());
+            if (!pending_thread_name.empty())
+                local->thread_name = pending_thread_name;
+            else if (std::this_thread::get_id() == main_thread)
+                local->thread_name = "main";
+            else
+                local->thread_name = "thread " + std::to_string(local->tid);
+        }
+        return *local;
+    }
+
+    void trace_start()
+    {
+        std::uint64_t expected = 0;
+        origin_ns.compare_exchange_strong(expected, trace_now_ns());
+        tracing_enabled.store(true, std::memory_order_relaxed);
+    }
+
+    void trace_stop()
+    {
+        tracing_enabled.store(false, std::memory_order_relaxed);
+    }
+
+    void trace_thread_name(const std::string &name)
+    {
+        pending_thread_name = name;
+        if (local)
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            local->thread_name = name;
+        }
+    }
+
+    void trace_record(const char *name, std::uint64_t begin_ns, std::uint64_t end_ns, std::string_view detail)
+    {
+        trace_buffer &buf = local_buffer();
+        trace_block *block = buf.tail;
+        std::size_t used = block->used.load(std::memory_order_relaxed);
+        if (used == trace_block::CAPACITY)
+        {
+            auto fresh = std::make_unique<trace_block>();
+            trace_block *raw = fresh.get();
+            {
+                // `more` is only walked at exit, the lock just keeps the vector itself sane
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                buf.more.push_back(std::move(fresh));
+            }
+            block->next.store(raw, std::memory_order_release);
+            buf.tail = block = raw;
+            used = 0;
+        }
+        trace_event &e = block->events[used];
+        e.name = name;
+        e.begin_ns = begin_ns;
+        e.end_ns = end_ns;
+        e.detail.assign(detail.data(), detail.size());
+        block->used.store(used + 1, std::memory_order_release);
+    }
+
+    std::size_t trace_event_count()
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        std::size_t n = 0;
+        for (const auto &buf : registry)
+            for (trace_block *b = buf->head.get(); b; b = b->next.load(std::memory_order_acquire))
+                n += b->used.load(std::memory_order_acquire);
+        return n;
+    }
+
+    bool trace_write_chrome_json(const std::string &path)
+    {
+        try
+        {
+            json_writer out(path, JSON_COMPACT);
+            const int pid = static_cast<int>(::getpid());
+            const std::uint64_t origin = origin_ns.load();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+
+            out.begin_object();
+            out.key("displayTimeUnit").value("ms");
+            out.key("traceEvents").begin_array();
+            out.begin_object();
+            out.key("name").value("process_name").key("ph").value("M").key("pid").value(pid);
+            out.key("args").begin_object().key("name").value("wdlrunner").end_object();
+            out.end_object();
+            for (const auto &buf : registry)
+            {
+                out.begin_object();
+                out.key("name").value("thread_name").key("ph").value("M").key("pid").value(pid).key("tid").value(buf->tid);
+                out.key("args").begin_object().key("name").value(buf->thread_name).end_object();
+                out.end_object();
+                for (trace_block *b = buf->head.get(); b; b = b->next.load(std::memory_order_acquire))
+                {
+                    std::size_t used = b->used.load(std::memory_order_acquire);
+                    for (std::size_t i = 0; i < used; ++i)
+                    {
+                        const trace_event &e = b->events[i];
+                        // complete events ("X"), timestamps in microseconds from trace_start()
+                        out.begin_object();
+                        out.key("name").value(e.name);
+                        out.key("ph").value("X");
+                        out.key("pid").value(pid);
+                        out.key("tid").value(buf->tid);
+                        out.key("ts").value(e.begin_ns >= origin ? (e.begin_ns - origin) / 1000.0 : 0.0);
+                        out.key("dur").value((e.end_ns - e.begin_ns) / 1000.0);
+                        if (!e.detail.empty())
+                            out.key("args").begin_object().key("detail").value(e.detail).end_object();
+                        out.end_object();
+                    }
+                }
+            }
+            out.end_array();
+            out.end_object();
+            out.flush();
+            return true;
+        }
+        catch (const std::exception &)
+        {
+            return false;
+        }
+    }
+
+}
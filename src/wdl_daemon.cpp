@@ -0,0 +1,332 @@
+#include "wdl_daemon.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include "json_writer.h"
+#include "mapped_file.h"
+#include "trace.h"
+
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace soto
+{
+
+    std::shared_ptr<const wdl_module> module_cache::get(const std::string &canonical_path, bool &was_cached)
+    {
+        auto it = modules.find(canonical_path);
+        file_stamp now{};
+        if (it != modules.end() && stat_file(canonical_path, now) && now == it->second->stamp)
+        {
+            hits++;
+            was_cached = true;
+            return it->second;
+        }
+        was_cached = false;
+        loads++;
+        auto module = load_wdl_module(canonical_path);
+        modules[canonical_path] = module;
+        return module;
+    }
+
+    static const std::size_t MAX_REQUEST_BYTES = 1 << 20;
+
+    wdl_daemon::wdl_daemon(const std::string &socket_path) : socket_path(socket_path)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+            throw std::runtime_error("Socket path too long: " + socket_path);
+        std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+        // a socket left behind by a daemon that died is in the way of bind(), anything else at that path is not ours
+        struct stat st;
+        if (::lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            ::unlink(socket_path.c_str());
+
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listen_fd < 0)
+            throw std::runtime_error(std::string("Failed to create socket: ") + std::strerror(errno));
+        if (::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(listen_fd, 64) != 0)
+        {
+            std::string err = std::strerror(errno);
+            ::close(listen_fd);
+            throw std::runtime_error("Failed to listen on " + socket_path + ": " + err);
+        }
+
+        // SIGINT/SIGTERM come in through the epoll set like everything else, so a stop never lands mid-request
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGINT);
+        sigaddset(&mask, SIGTERM);
+        ::sigprocmask(SIG_BLOCK, &mask, nullptr);
+        signal_fd = ::signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+
+        epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+            throw std::runtime_error(std::string("Failed to create epoll instance: ") + std::strerror(errno));
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = listen_fd;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+        if (signal_fd >= 0)
+        {
+            ev.data.fd = signal_fd;
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+        }
+    }
+
+    wdl_daemon::~wdl_daemon()
+    {
+        for (auto &[fd, c] : clients)
+            ::close(fd);
+        if (listen_fd >= 0)
+        {
+            ::close(listen_fd);
+            ::unlink(socket_path.c_str());
+        }
+        if (signal_fd >= 0)
+            ::close(signal_fd);
+        if (epoll_fd >= 0)
+            ::close(epoll_fd);
+    }
+
+    void wdl_daemon::serve()
+    {
+        epoll_event events[64];
+        while (!stopping)
+        {
+            int n = ::epoll_wait(epoll_fd, events, 64, -1);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+            }
+            for (int i = 0; i < n && !stopping; ++i)
+            {
+                int fd = events[i].data.fd;
+                if (fd == listen_fd)
+                    accept_clients();
+                else if (fd == signal_fd)
+                    stopping = true;
+                else
+                {
+                    auto it = clients.find(fd);
+                    if (it != clients.end())
+                        read_client(it->second);
+                }
+            }
+        }
+    }
+
+    void wdl_daemon::accept_clients()
+    {
+        int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        clients[fd].fd = fd;
+    }
+
+    void wdl_daemon::drop_client(int fd)
+    {
+        ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        clients.erase(fd);
+    }
+
+    // blocking writes... a client that sends requests and never reads the answers stalls everyone, don't be that client
+    static bool send_all(int fd, const std::string &data)
+    {
+        std::size_t off = 0;
+        while (off < data.size())
+        {
+            ssize_t w = ::send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0)
+                return false;
+            off += static_cast<std::size_t>(w);
+        }
+        return true;
+    }
+
+    void wdl_daemon::read_client(client &c)
+    {
+        const int fd = c.fd;
+        char buf[16384];
+        // level-triggered, one read per wakeup never blocks
+        ssize_t r = ::read(fd, buf, sizeof(buf));
+        if (r <= 0)
+        {
+            drop_client(fd);
+            return;
+        }
+        c.in.append(buf, static_cast<std::size_t>(r));
+        std::size_t start = 0;
+        for (std::size_t nl; (nl = c.in.find('\n', start)) != std::string::npos; start = nl + 1)
+        {
+            std::string response = handle(c.in.substr(start, nl - start));
+            response += '\n';
+            if (!send_all(fd, response) || stopping)
+            {
+                drop_client(fd);
+                return;
+            }
+        }
+        c.in.erase(0, start);
+        if (c.in.size() > MAX_REQUEST_BYTES)
+            drop_client(fd);
+    }
+
+    // module and everything it imports, depth first, each file once... a missing import is a diagnostic
+    // of the file importing it, not a failed request
+    struct validation
+    {
+    public:
+        std::vector<std::shared_ptr<const wdl_module>> modules; // the requested one first
+        std::vector<std::pair<std::string, std::string>> diagnostics; // file, message
+        std::size_t loaded = 0;
+    };
+
+    static void collect_modules(module_cache &cache, const std::string &path, std::unordered_set<std::string> &seen, validation &v)
+    {
+        bool was_cached = false;
+        auto module = cache.get(path, was_cached);
+        if (!was_cached)
+            v.loaded++;
+        v.modules.push_back(module);
+        for (const auto &d : module->diagnostics)
+            v.diagnostics.emplace_back(module->path, d.to_string());
+        for (const auto &imp : module->imports)
+        {
+            if (!seen.insert(imp).second)
+                continue;
+            try
+            {
+                collect_modules(cache, imp, seen, v);
+            }
+            catch (const std::exception &e)
+            {
+                v.diagnostics.emplace_back(module->path, std::string("[ERROR] import: ") + e.what());
+            }
+        }
+    }
+
+    static std::string error_response(const std::string &message)
+    {
+        std::string out;
+        json_writer json(out);
+        json.begin_object().key("ok").value(false).key("error").value(message).end_object();
+        return out;
+    }
+
+    std::string wdl_daemon::handle(const std::string &request)
+    {
+        WDL_TRACE_SCOPE_DETAIL("daemon_request", request);
+        const auto started = std::chrono::steady_clock::now();
+        requests++;
+        std::istringstream words(request);
+        std::string command, path, inputs_path;
+        words >> command >> path >> inputs_path;
+
+        std::string out;
+        if (command == "stats")
+        {
+            json_writer json(out);
+            json.begin_object().key("ok").value(true);
+            json.key("modules").value(static_cast<std::uint64_t>(cache.size()));
+            json.key("requests").value(requests).key("hits").value(cache.hits).key("loads").value(cache.loads);
+            json.end_object();
+            return out;
+        }
+        if (command == "flush")
+        {
+            cache.clear();
+            return "{\"ok\":true}";
+        }
+        if (command == "shutdown")
+        {
+            stopping = true;
+            return "{\"ok\":true}";
+        }
+        if ((command != "validate" && command != "inputs") || path.empty() || (command == "inputs" && inputs_path.empty()))
+            return error_response("usage: validate <wdl> | inputs <wdl> <inputs.json> | stats | flush | shutdown");
+
+        validation v;
+        try
+        {
+            const std::string root = canonical_wdl_path(path);
+            std::unordered_set<std::string> seen{root};
+            collect_modules(cache, root, seen, v);
+        }
+        catch (const std::exception &e)
+        {
+            return error_response(e.what());
+        }
+        const wdl_module &root = *v.modules.front();
+
+        bound_inputs bound;
+        std::string bind_error;
+        if (command == "inputs")
+        {
+            if (root.workflow.empty())
+                bind_error = "No workflow in " + root.path;
+            else
+            {
+                // imported structs can type inputs too
+                struct_table structs;
+                for (const auto &m : v.modules)
+                    structs.insert(m->structs.begin(), m->structs.end());
+                try
+                {
+                    mapped_file json_file(inputs_path);
+                    bound = bind_inputs(json_file.view(), root.workflow, root.inputs, structs);
+                }
+                catch (const std::exception &e)
+                {
+                    bind_error = e.what();
+                }
+            }
+        }
+
+        const bool ok = v.diagnostics.empty() && bind_error.empty() && bound.ok();
+        json_writer json(out);
+        json.begin_object();
+        json.key("ok").value(ok);
+        json.key("path").value(root.path);
+        json.key("workflow").value(root.workflow);
+        json.key("files").value(static_cast<std::uint64_t>(v.modules.size()));
+        json.key("parsed").value(static_cast<std::uint64_t>(v.loaded));
+        json.key("diagnostics").begin_array();
+        for (const auto &[file, message] : v.diagnostics)
+            json.begin_object().key("file").value(file).key("message").value(message).end_object();
+        json.end_array();
+        if (command == "inputs")
+        {
+            json.key("bound").value(static_cast<std::uint64_t>(bound.values.size()));
+            json.key("input_errors").begin_array();
+            if (!bind_error.empty())
+                json.value(bind_error);
+            for (const auto &error : bound.errors)
+                json.value(format_input_error(error, inputs_path));
+            json.end_array();
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+        json.key("us").value(static_cast<std::int64_t>(elapsed.count()));
+        json.end_object();
+        return out;
+    }
+
+}
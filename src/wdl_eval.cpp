@@ -0,0 +1,551 @@
+#include "wdl_eval.h"
+#include <cmath>
+#include <stdexcept>
+#include "command_template.h"
+#include "string_utils.h"
+#include "wdl_stdlib.h"
+#include "wdl_struct.h"
+
+namespace soto
+{
+
+    std::uint32_t frame_layout::add(const std::string &name)
+    {
+        auto [it, inserted] = index.emplace(name, static_cast<std::uint32_t>(names.size()));
+        if (inserted)
+            names.push_back(name);
+        return it->second;
+    }
+
+    const std::uint32_t *frame_layout::find(const std::string &name) const
+    {
+        auto it = index.find(name);
+        return it == index.end() ? nullptr : &it->second;
+    }
+
+    eval_scope::eval_scope(std::shared_ptr<const frame_layout> layout, const eval_scope *parent)
+        : parent(parent), layout(std::move(layout)), slots(this->layout->size()), state(this->layout->size(), SLOT_EMPTY)
+    {
+    }
+
+    const wdl_value *eval_scope::find(const std::string &name) const
+    {
+        for (const eval_scope *s = this; s; s = s->parent)
+        {
+            auto it = s->values.find(name);
+            if (it != s->values.end())
+                return &it->second;
+            if (s->layout)
+                if (const std::uint32_t *slot = s->layout->find(name))
+                {
+                    if (s->state[*slot] == SLOT_BOUND)
+                        return &s->slots[*slot];
+                    if (s->state[*slot] != SLOT_EMPTY)
+                        return s->force(*slot);
+                }
+        }
+        return nullptr;
+    }
+
+    const wdl_value *eval_scope::at(const slot_ref &ref) const
+    {
+        // frames without a layout in between (a scratch frame on top, say) don't count... unless they hold
+        // names, which might be shadowing the slot, then it's the slow way
+        std::uint32_t depth = ref.depth;
+        for (const eval_scope *s = this; s; s = s->parent)
+        {
+            if (!s->layout)
+            {
+                if (!s->values.empty())
+                    return nullptr;
+                continue;
+            }
+            if (depth-- > 0)
+                continue;
+            if (s->layout != ref.frame)
+                return nullptr;
+            switch (s->state[ref.slot])
+            {
+            case SLOT_BOUND:
+                return &s->slots[ref.slot];
+            case SLOT_EMPTY:
+                return nullptr;
+            default:
+                return s->force(ref.slot);
+            }
+        }
+        return nullptr;
+    }
+
+    void eval_scope::set(const std::string &name, wdl_value value)
+    {
+        if (layout)
+            if (const std::uint32_t *slot = layout->find(name))
+            {
+                set_slot(*slot, std::move(value));
+                return;
+            }
+        values[name] = std::move(value);
+    }
+
+    void eval_scope::defer(const std::string &name, const ast_node &initializer)
+    {
+        const std::uint32_t *slot = layout ? layout->find(name) : nullptr;
+        if (!slot)
+            throw std::runtime_error("Can't defer '" + name + "', it has no slot in this frame.");
+        defer_slot(*slot, initializer);
+    }
+
+    void eval_scope::defer_slot(std::uint32_t slot, const ast_node &initializer)
+    {
+        if (state[slot] == SLOT_BOUND)
+            return; // given, the default doesn't matter
+        if (initializers.empty())
+            initializers.resize(slots.size(), nullptr);
+        if (state[slot] == SLOT_EMPTY)
+            ++deferred;
+        initializers[slot] = &initializer;
+        state[slot] = SLOT_DEFERRED;
+    }
+
+    const wdl_value *eval_scope::force(std::uint32_t slot) const
+    {
+        if (state[slot] == SLOT_EVALUATING)
+            throw std::runtime_error("'" + layout->names[slot] + "' depends on itself.");
+        state[slot] = SLOT_EVALUATING;
+        try
+        {
+            // against this frame, not whichever one inside it asked... what the declaration sees is what's
+            // around where it's written
+            slots[slot] = evaluate(*initializers[slot], *this);
+        }
+        catch (...)
+        {
+            state[slot] = SLOT_DEFERRED; // asking again gives the same error again
+            throw;
+        }
+        state[slot] = SLOT_BOUND;
+        ++evaluated;
+        return &slots[slot];
+    }
+
+    std::size_t defer_declarations(eval_scope &scope, const std::vector<ast_node_ptr> &members)
+    {
+        std::size_t n = 0;
+        auto one = [&](const var_decl &var)
+        {
+            if (!var.initializer || !var.identifier || !var.identifier->tok)
+                return;
+            scope.defer(var.identifier->tok->lexeme, *var.initializer);
+            ++n;
+        };
+        for (const auto &member : members)
+        {
+            if (!member)
+                continue;
+            if (const auto *var = std::get_if<var_decl>(&member->node))
+                one(*var);
+            else if (const auto *inputs = std::get_if<input_decl>(&member->node))
+                if (const auto *b = inputs->body ? std::get_if<block>(&inputs->body->node) : nullptr)
+                    for (const auto &d : b->statements)
+                        if (const auto *var = d ? std::get_if<var_decl>(&d->node) : nullptr)
+                            one(*var);
+        }
+        return n;
+    }
+
+    static bool is_stringy(const wdl_value &v)
+    {
+        return v.kind == WT_STRING || v.kind == WT_FILE || v.kind == WT_DIRECTORY;
+    }
+
+    static bool is_number(const wdl_value &v)
+    {
+        return v.kind == WT_INT || v.kind == WT_FLOAT;
+    }
+
+    static std::runtime_error eval_error(const ast_node &node, const std::string &message)
+    {
+        std::string at = node.tok && !node.tok->lexeme.empty() ? " at '" + node.tok->lexeme + "'" : "";
+        return std::runtime_error("Cannot evaluate" + at + ": " + message);
+    }
+
+    static std::string node_name(const ast_node_ptr &node)
+    {
+        return node && node->tok ? node->tok->lexeme : "";
+    }
+
+    // x.left, x.right, x.member... `object` is what comes before the '.' of `access`, whose member is a name
+    // or the rest of the chain
+    static wdl_value member_of(const wdl_value &object, const member_access &access)
+    {
+        if (!access.member)
+            return object;
+        const ast_node &member_node = *access.member;
+        const member_access *next = std::get_if<member_access>(&member_node.node);
+        std::string name;
+        if (next)
+            name = node_name(next->object);
+        else if (member_node.type == N_IDENT && member_node.tok)
+            name = member_node.tok->lexeme;
+        else
+            throw eval_error(member_node, "only names can follow a '.'");
+
+        wdl_value value;
+        if (object.kind == WT_PAIR && (name == "left" || name == "right"))
+            value = name == "left" ? object.as_pair().first : object.as_pair().second;
+        else if (object.kind == WT_OBJECT || object.kind == WT_STRUCT)
+        {
+            const wdl_object &o = object.as_object();
+            // the struct compiler's slot... straight in when the value was laid out by the same struct, and
+            // worth a name check on one bound from JSON, which has its members in declaration order too
+            const std::size_t slot = access.field;
+            if (access.layout && o.layout == access.layout)
+                value = o.members[slot].second;
+            else if (access.layout && slot < o.members.size() && o.members[slot].first == name)
+                value = o.members[slot].second;
+            else
+            {
+                bool found = false;
+                for (const auto &[key, v] : o.members)
+                    if (key == name)
+                    {
+                        value = v;
+                        found = true;
+                        break;
+                    }
+                if (!found)
+                    throw eval_error(member_node, "no member '" + name + "'");
+            }
+        }
+        else if (object.is_none())
+            return wdl_value::none(); // a member of an unset optional struct, unset too
+        else
+            throw eval_error(member_node, std::string("a ") + wdl_type_kind_to_string(object.kind) + " has no member '" + name + "'");
+        return next ? member_of(value, *next) : value;
+    }
+
+    static wdl_value arithmetic(const ast_node &node, token_kind op, const wdl_value &a, const wdl_value &b)
+    {
+        if (op == T_PLUS && (is_stringy(a) || is_stringy(b)))
+        {
+            // String + anything printable... a File on the left stays a File (a path with a suffix)
+            if ((!is_stringy(a) && !a.is_none() && !is_number(a)) || (!is_stringy(b) && !b.is_none() && !is_number(b)))
+                throw eval_error(node, "only strings and numbers concatenate");
+            return wdl_value::string(a.to_string() + b.to_string(), a.kind == WT_FILE ? WT_FILE : WT_STRING);
+        }
+        if (!is_number(a) || !is_number(b))
+            throw eval_error(node, std::string("expected numbers, got ") + wdl_type_kind_to_string(a.kind) + " and " + wdl_type_kind_to_string(b.kind));
+        if (a.kind == WT_INT && b.kind == WT_INT)
+        {
+            std::int64_t x = a.as_int(), y = b.as_int();
+            switch (op)
+            {
+            case T_PLUS:
+                return wdl_value::integer(x + y);
+            case T_MINUS:
+                return wdl_value::integer(x - y);
+            case T_STAR:
+                return wdl_value::integer(x * y);
+            case T_FSLASH:
+            case T_MODULO:
+                if (y == 0)
+                    throw eval_error(node, "division by zero");
+                return wdl_value::integer(op == T_FSLASH ? x / y : x % y);
+            default:
+                break;
+            }
+        }
+        double x = a.as_float(), y = b.as_float();
+        switch (op)
+        {
+        case T_PLUS:
+            return wdl_value::floating(x + y);
+        case T_MINUS:
+            return wdl_value::floating(x - y);
+        case T_STAR:
+            return wdl_value::floating(x * y);
+        case T_FSLASH:
+            return wdl_value::floating(x / y);
+        case T_MODULO:
+            return wdl_value::floating(std::fmod(x, y));
+        default:
+            throw eval_error(node, "unsupported operator");
+        }
+    }
+
+    static int compare(const ast_node &node, const wdl_value &a, const wdl_value &b)
+    {
+        if (is_number(a) && is_number(b))
+        {
+            if (a.kind == WT_INT && b.kind == WT_INT)
+                return a.as_int() < b.as_int() ? -1 : a.as_int() > b.as_int();
+            return a.as_float() < b.as_float() ? -1 : a.as_float() > b.as_float();
+        }
+        if (is_stringy(a) && is_stringy(b))
+            return a.as_string().compare(b.as_string());
+        if (a.kind == WT_BOOLEAN && b.kind == WT_BOOLEAN)
+            return static_cast<int>(a.as_bool()) - static_cast<int>(b.as_bool());
+        throw eval_error(node, std::string("cannot compare ") + wdl_type_kind_to_string(a.kind) + " and " + wdl_type_kind_to_string(b.kind));
+    }
+
+    static wdl_value evaluate_node(const ast_node &node, const eval_scope &scope);
+
+    static wdl_value evaluate_binary(const ast_node &node, const binary_expr &bin, const eval_scope &scope)
+    {
+        const token_kind op = bin.op ? bin.op->kind : T_ERROR;
+        if (!bin.left || !bin.right)
+            throw eval_error(node, "incomplete expression");
+        // && and || don't look at the right side unless they have to
+        if (op == T_AND || op == T_LOGICAL_AND || op == T_OR || op == T_LOGICAL_OR)
+        {
+            const bool is_and = op == T_AND || op == T_LOGICAL_AND;
+            if (evaluate_node(*bin.left, scope).as_bool() != is_and)
+                return wdl_value::boolean(!is_and);
+            return wdl_value::boolean(evaluate_node(*bin.right, scope).as_bool());
+        }
+        wdl_value a = evaluate_node(*bin.left, scope);
+        wdl_value b = evaluate_node(*bin.right, scope);
+        switch (op)
+        {
+        case T_EQUALITY:
+            return wdl_value::boolean(a == b);
+        case T_NEQ:
+            return wdl_value::boolean(a != b);
+        case T_LESS_THAN:
+            return wdl_value::boolean(compare(node, a, b) < 0);
+        case T_LESS_OR_EQUAL:
+            return wdl_value::boolean(compare(node, a, b) <= 0);
+        case T_GREATER_THAN:
+            return wdl_value::boolean(compare(node, a, b) > 0);
+        case T_GREATER_OR_EQUAL:
+            return wdl_value::boolean(compare(node, a, b) >= 0);
+        case T_PLUS:
+        case T_MINUS:
+        case T_STAR:
+        case T_FSLASH:
+        case T_MODULO:
+            if (a.is_none() || b.is_none())
+                return wdl_value::none(); // "-L " + intervals with intervals unset
+            return arithmetic(node, op, a, b);
+        default:
+            throw eval_error(node, "unsupported operator");
+        }
+    }
+
+    static wdl_value evaluate_literal(const ast_node &node, const eval_scope &scope)
+    {
+        const token &t = *node.tok;
+        switch (t.kind)
+        {
+        case T_NLITERAL:
+            if (t.float_val)
+                return wdl_value::floating(*t.float_val);
+            if (t.lexeme.find_first_of(".eE") != std::string::npos)
+                return wdl_value::floating(std::stod(t.lexeme));
+            return wdl_value::integer(std::stoll(t.lexeme)); // int_val is an int, an Int is 64 bits
+        case T_SLITERAL:
+            // the resolver compiled its placeholders already, a tree it hasn't been over compiles them every time
+            if (const auto *interpolated = std::get_if<interpolation>(&node.node))
+                return wdl_value::string(interpolated->compiled->render(scope));
+            return evaluate_string_literal(t.lexeme, scope);
+        case T_BLITERAL:
+            return wdl_value::boolean(util::to_lowercase(t.lexeme) == "true");
+        default:
+            throw eval_error(node, "not a literal");
+        }
+    }
+
+    static wdl_value evaluate_node(const ast_node &node, const eval_scope &scope)
+    {
+        if (node.type == N_LITERAL && node.tok)
+            return evaluate_literal(node, scope);
+        if (node.type == N_IDENT && node.tok)
+        {
+            if (const auto *ref = std::get_if<slot_ref>(&node.node))
+                if (const wdl_value *v = scope.at(*ref))
+                    return *v;
+            if (const wdl_value *v = scope.find(node.tok->lexeme))
+                return *v;
+            if (node.tok->lexeme == "None")
+                return wdl_value::none();
+            throw eval_error(node, "unknown name '" + node.tok->lexeme + "'");
+        }
+        return std::visit(
+            [&](auto &&value) -> wdl_value
+            {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, constant_expr>)
+                    return value.value;
+                else if constexpr (std::is_same_v<T, binary_expr>)
+                    return evaluate_binary(node, value, scope);
+                else if constexpr (std::is_same_v<T, unary_expr>)
+                {
+                    if (!value.operand)
+                        throw eval_error(node, "incomplete expression");
+                    wdl_value v = evaluate_node(*value.operand, scope);
+                    if (node.tok && node.tok->kind == T_NOT)
+                        return wdl_value::boolean(!v.as_bool());
+                    if (v.kind == WT_INT)
+                        return wdl_value::integer(-v.as_int());
+                    return wdl_value::floating(-v.as_float());
+                }
+                else if constexpr (std::is_same_v<T, if_stmt>)
+                {
+                    if (!value.condition)
+                        throw eval_error(node, "if without a condition");
+                    const ast_node_ptr &branch = evaluate_node(*value.condition, scope).as_bool() ? value.then_ : value.else_;
+                    if (!branch)
+                        throw eval_error(node, "if without an else");
+                    return evaluate(branch, scope);
+                }
+                else if constexpr (std::is_same_v<T, expr_stmt>)
+                {
+                    // the then/else of a ternary come wrapped like this
+                    if (!value.expr)
+                        throw eval_error(node, "empty expression");
+                    return evaluate_node(*value.expr, scope);
+                }
+                else if constexpr (std::is_same_v<T, member_access>)
+                {
+                    const std::string name = node_name(value.object);
+                    const wdl_value *object = nullptr;
+                    if (const auto *ref = value.object ? std::get_if<slot_ref>(&value.object->node) : nullptr)
+                        object = scope.at(*ref);
+                    if (!object)
+                        object = scope.find(name);
+                    if (!object)
+                        throw eval_error(node, "unknown name '" + name + "'");
+                    return member_of(*object, value);
+                }
+                else if constexpr (std::is_same_v<T, array_expr>)
+                {
+                    wdl_array elements;
+                    elements.reserve(value.elements.size());
+                    for (const auto &e : value.elements)
+                        elements.push_back(evaluate(e, scope));
+                    return wdl_value::array(std::move(elements));
+                }
+                else if constexpr (std::is_same_v<T, map_expr>)
+                {
+                    wdl_map entries;
+                    entries.reserve(value.elements.size());
+                    for (const auto &[k, v] : value.elements)
+                        entries.set(evaluate(k, scope), evaluate(v, scope)); // a key given twice keeps the last value
+                    return wdl_value::map(std::move(entries));
+                }
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    wdl_object object;
+                    object.struct_name = value.layout->name;
+                    object.layout = value.layout;
+                    object.members.reserve(value.values.size());
+                    for (std::size_t i = 0; i < value.values.size(); ++i)
+                        object.members.emplace_back(value.layout->fields[i], value.values[i] ? evaluate(value.values[i], scope) : wdl_value::none());
+                    return wdl_value::object(std::move(object));
+                }
+                else if constexpr (std::is_same_v<T, pair_expr>)
+                    return wdl_value::pair(evaluate(value.first, scope), evaluate(value.second, scope));
+                else if constexpr (std::is_same_v<T, index_expr>)
+                {
+                    const wdl_value collection = evaluate(value.collection, scope);
+                    const wdl_value index = evaluate(value.index, scope);
+                    if (collection.kind == WT_ARRAY)
+                    {
+                        const wdl_array &elements = collection.as_array();
+                        const std::int64_t i = index.as_int();
+                        if (i < 0 || static_cast<std::size_t>(i) >= elements.size())
+                            throw eval_error(node, "index " + std::to_string(i) + " out of bounds for an array of " + std::to_string(elements.size()));
+                        return elements[static_cast<std::size_t>(i)];
+                    }
+                    if (collection.kind == WT_MAP)
+                    {
+                        if (const wdl_value *v = collection.as_map().find(index))
+                            return *v;
+                        throw eval_error(node, "no key " + index.to_string() + " in the map");
+                    }
+                    throw eval_error(node, std::string("a ") + wdl_type_kind_to_string(collection.kind) + " can't be indexed");
+                }
+                else if constexpr (std::is_same_v<T, func_call>)
+                {
+                    const std::string name = node_name(value.identifier);
+                    if (!find_builtin(name))
+                        throw eval_error(node, "unknown function '" + name + "'");
+                    std::vector<wdl_value> args;
+                    args.reserve(value.arguments.size());
+                    for (const auto &arg : value.arguments)
+                        args.push_back(evaluate(arg, scope));
+                    return call_builtin(name, args);
+                }
+                else
+                    throw eval_error(node, std::string("not an expression (") + ast_node_type_to_string(node.type) + ")");
+            },
+            node.node);
+    }
+
+    wdl_value evaluate(const ast_node_ptr &expr, const eval_scope &scope)
+    {
+        if (!expr)
+            throw std::runtime_error("Cannot evaluate: missing expression");
+        return evaluate_node(*expr, scope);
+    }
+
+    wdl_value evaluate(const ast_node &expr, const eval_scope &scope)
+    {
+        return evaluate_node(expr, scope);
+    }
+
+    std::string string_literal_text(const std::string &lexeme)
+    {
+        std::string text;
+        text.reserve(lexeme.size());
+        for (std::size_t i = 0; i < lexeme.size(); ++i)
+        {
+            if (lexeme[i] != '\\' || i + 1 == lexeme.size())
+            {
+                text += lexeme[i];
+                continue;
+            }
+            switch (lexeme[++i])
+            {
+            case 'n':
+                text += '\n';
+                break;
+            case 't':
+                text += '\t';
+                break;
+            case '~':
+            case '$':
+                text += '\\'; // stays escaped, the template leaves \~{ alone
+                text += lexeme[i];
+                break;
+            default:
+                text += lexeme[i];
+            }
+        }
+        return text;
+    }
+
+    wdl_value evaluate_string_literal(const std::string &lexeme, const eval_scope &scope)
+    {
+        std::string text = string_literal_text(lexeme);
+        if (text.find("~{") == std::string::npos && text.find("${") == std::string::npos)
+            return wdl_value::string(std::move(text));
+        // "~{sample}.bam"... the same placeholders a command has
+        command_template interpolated = command_template::compile(text, true, false);
+        return wdl_value::string(interpolated.render(scope));
+    }
+
+    ast_node_ptr parse_wdl_expression(const std::string &text)
+    {
+        std::vector<parse_diagnostic> diagnostics;
+        parser p{std::make_unique<lexer>(text), &diagnostics};
+        ast_node_ptr expr = p.parse_standalone_expr();
+        if (!diagnostics.empty())
+            throw std::runtime_error("Invalid expression '" + text + "': " + diagnostics.front().message);
+        if (!expr)
+            throw std::runtime_error("Invalid expression '" + text + "'");
+        return expr;
+    }
+
+}
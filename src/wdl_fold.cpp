@@ -0,0 +1,458 @@
+#include "wdl_fold.h"
+#include <exception>
+#include <string>
+#include <utility>
+#include "wdl_stdlib.h"
+
+namespace soto
+{
+
+    fold_stats &fold_stats::operator+=(const fold_stats &other)
+    {
+        expressions += other.expressions;
+        nodes_before += other.nodes_before;
+        nodes_after += other.nodes_after;
+        folded += other.folded;
+        simplified += other.simplified;
+        constant_decls += other.constant_decls;
+        return *this;
+    }
+
+    std::size_t count_nodes(const ast_node_ptr &node)
+    {
+        if (!node)
+            return 0;
+        std::size_t n = 1;
+        std::visit(
+            [&](auto &&value)
+            {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, binary_expr>)
+                    n += count_nodes(value.left) + count_nodes(value.right);
+                else if constexpr (std::is_same_v<T, unary_expr>)
+                    n += count_nodes(value.operand);
+                else if constexpr (std::is_same_v<T, if_stmt>)
+                    n += count_nodes(value.condition) + count_nodes(value.then_) + count_nodes(value.else_);
+                else if constexpr (std::is_same_v<T, expr_stmt>)
+                    n += count_nodes(value.expr);
+                else if constexpr (std::is_same_v<T, member_access>)
+                    n += count_nodes(value.object) + count_nodes(value.member);
+                else if constexpr (std::is_same_v<T, array_expr>)
+                {
+                    for (const auto &e : value.elements)
+                        n += count_nodes(e);
+                }
+                else if constexpr (std::is_same_v<T, map_expr>)
+                {
+                    for (const auto &[k, v] : value.elements)
+                        n += count_nodes(k) + count_nodes(v);
+                }
+                else if constexpr (std::is_same_v<T, pair_expr>)
+                    n += count_nodes(value.first) + count_nodes(value.second);
+                else if constexpr (std::is_same_v<T, index_expr>)
+                    n += count_nodes(value.collection) + count_nodes(value.index);
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    for (const auto &v : value.values)
+                        n += count_nodes(v);
+                }
+                else if constexpr (std::is_same_v<T, func_call>)
+                {
+                    for (const auto &arg : value.arguments)
+                        n += count_nodes(arg);
+                }
+            },
+            node->node);
+        return n;
+    }
+
+    static bool is_constant(const ast_node_ptr &node)
+    {
+        return node && node->type == N_CONSTANT;
+    }
+
+    static const wdl_value &constant_of(const ast_node_ptr &node)
+    {
+        return std::get<constant_expr>(node->node).value;
+    }
+
+    static bool is_bool_constant(const ast_node_ptr &node, bool b)
+    {
+        return is_constant(node) && constant_of(node).kind == WT_BOOLEAN && constant_of(node).as_bool() == b;
+    }
+
+    static ast_node_ptr make_constant(const ast_node &replaced, wdl_value value)
+    {
+        ast_node_ptr node = std::make_unique<ast_node>();
+        node->type = N_CONSTANT;
+        node->tok = replaced.tok;
+        node->node = constant_expr{std::move(value)};
+        return node;
+    }
+
+    struct folder
+    {
+    public:
+        const eval_scope &known;
+        fold_stats &stats;
+
+        // the node's value if it has one without anything from run time... it's only called once everything under
+        // it is a constant (or a name `known` has), so a failure here is a real error for later, not a missing input
+        bool try_fold(ast_node_ptr &expr)
+        {
+            try
+            {
+                wdl_value v = evaluate(*expr, known);
+                expr = make_constant(*expr, std::move(v));
+                ++stats.folded;
+                return true;
+            }
+            catch (const std::exception &)
+            {
+                return false;
+            }
+        }
+
+        // parent = std::move(one of its own children)... the child has to leave the parent before the parent goes
+        void replace_with(ast_node_ptr &expr, ast_node_ptr &child)
+        {
+            ast_node_ptr keep = std::move(child);
+            expr = std::move(keep);
+            ++stats.simplified;
+        }
+
+        void fold(ast_node_ptr &expr)
+        {
+            if (!expr || expr->type == N_CONSTANT)
+                return;
+            ast_node &node = *expr;
+            if (node.type == N_LITERAL && node.tok)
+            {
+                try_fold(expr); // numbers parse once, a "~{sample}.bam" with sample known renders once
+                return;
+            }
+            if (node.type == N_IDENT && node.tok)
+            {
+                if (node.tok->lexeme == "None" || known.find(node.tok->lexeme))
+                    try_fold(expr);
+                return;
+            }
+
+            if (auto *bin = std::get_if<binary_expr>(&node.node))
+            {
+                fold(bin->left);
+                fold(bin->right);
+                if (is_constant(bin->left) && is_constant(bin->right))
+                {
+                    try_fold(expr);
+                    return;
+                }
+                const token_kind op = bin->op ? bin->op->kind : T_ERROR;
+                const bool is_and = op == T_AND || op == T_LOGICAL_AND;
+                const bool is_or = op == T_OR || op == T_LOGICAL_OR;
+                if (!is_and && !is_or)
+                    return;
+                // one side known... false && x is false, true && x is x, and the same the other way round for ||.
+                // x && true is x as well, but x && false stays: x still has to be a Boolean
+                if (is_bool_constant(bin->left, is_or))
+                    replace_with(expr, bin->left);
+                else if (is_bool_constant(bin->left, !is_or))
+                    replace_with(expr, bin->right);
+                else if (is_bool_constant(bin->right, !is_or))
+                    replace_with(expr, bin->left);
+                return;
+            }
+            if (auto *un = std::get_if<unary_expr>(&node.node))
+            {
+                fold(un->operand);
+                if (is_constant(un->operand))
+                    try_fold(expr);
+                return;
+            }
+            if (auto *stmt = std::get_if<expr_stmt>(&node.node))
+            {
+                // a ternary's then/else come wrapped... the wrapper is one more node to walk for nothing
+                fold(stmt->expr);
+                if (stmt->expr)
+                    replace_with(expr, stmt->expr);
+                return;
+            }
+            if (auto *cond = std::get_if<if_stmt>(&node.node))
+            {
+                fold(cond->condition);
+                fold(cond->then_);
+                fold(cond->else_);
+                if (is_constant(cond->condition) && constant_of(cond->condition).kind == WT_BOOLEAN)
+                {
+                    ast_node_ptr &branch = constant_of(cond->condition).as_bool() ? cond->then_ : cond->else_;
+                    if (branch)
+                        replace_with(expr, branch);
+                    return;
+                }
+                if (is_bool_constant(cond->then_, true) && is_bool_constant(cond->else_, false))
+                    replace_with(expr, cond->condition); // if c then true else false
+                else if (is_bool_constant(cond->then_, false) && is_bool_constant(cond->else_, true))
+                {
+                    // if c then false else true... !c
+                    ast_node_ptr negated = std::make_unique<ast_node>();
+                    negated->type = N_UNARY;
+                    negated->tok = std::make_shared<token>(T_NOT, "!");
+                    negated->tok->offset = node.tok ? node.tok->offset : 0;
+                    negated->node = unary_expr{std::move(cond->condition)};
+                    expr = std::move(negated);
+                    ++stats.simplified;
+                }
+                return;
+            }
+            if (auto *access = std::get_if<member_access>(&node.node))
+            {
+                // sample.name with sample known... the member side is names, nothing to fold in it
+                if (access->object && access->object->tok && known.find(access->object->tok->lexeme))
+                    try_fold(expr);
+                return;
+            }
+            if (auto *array = std::get_if<array_expr>(&node.node))
+            {
+                bool all = true;
+                for (auto &e : array->elements)
+                {
+                    fold(e);
+                    all = all && is_constant(e);
+                }
+                if (all)
+                    try_fold(expr);
+                return;
+            }
+            if (auto *map = std::get_if<map_expr>(&node.node))
+            {
+                bool all = true;
+                for (auto &[k, v] : map->elements)
+                {
+                    fold(k);
+                    fold(v);
+                    all = all && is_constant(k) && is_constant(v);
+                }
+                if (all)
+                    try_fold(expr);
+                return;
+            }
+            if (auto *literal = std::get_if<struct_expr>(&node.node))
+            {
+                bool all = true;
+                for (auto &v : literal->values)
+                {
+                    fold(v);
+                    all = all && (!v || is_constant(v)); // a member left out is None
+                }
+                if (all)
+                    try_fold(expr);
+                return;
+            }
+            if (auto *pair = std::get_if<pair_expr>(&node.node))
+            {
+                fold(pair->first);
+                fold(pair->second);
+                if (is_constant(pair->first) && is_constant(pair->second))
+                    try_fold(expr);
+                return;
+            }
+            if (auto *index = std::get_if<index_expr>(&node.node))
+            {
+                fold(index->collection);
+                fold(index->index);
+                if (is_constant(index->collection) && is_constant(index->index))
+                    try_fold(expr);
+                return;
+            }
+            if (auto *call = std::get_if<func_call>(&node.node))
+            {
+                bool all = true;
+                for (auto &arg : call->arguments)
+                {
+                    fold(arg);
+                    all = all && is_constant(arg);
+                }
+                const std::string name = call->identifier && call->identifier->tok ? call->identifier->tok->lexeme : "";
+                const builtin_info *builtin = find_builtin(name);
+                if (!builtin)
+                    return;
+                if (all && builtin->pure)
+                {
+                    try_fold(expr);
+                    return;
+                }
+                if (name == "select_first" && call->arguments.size() == 1)
+                    select_first_known(expr, call->arguments[0]);
+            }
+        }
+
+        // select_first([x, "default"]) with x not known... but select_first(["a", x]) is "a" whatever x is, and
+        // None in front of the first element that could be something can go
+        void select_first_known(ast_node_ptr &expr, ast_node_ptr &arg)
+        {
+            auto *array = arg ? std::get_if<array_expr>(&arg->node) : nullptr;
+            if (!array || array->elements.empty())
+                return;
+            std::size_t none = 0;
+            while (none + 1 < array->elements.size() && is_constant(array->elements[none]) && constant_of(array->elements[none]).is_none())
+                ++none;
+            if (none)
+            {
+                array->elements.erase(array->elements.begin(), array->elements.begin() + static_cast<std::ptrdiff_t>(none));
+                ++stats.simplified;
+            }
+            if (is_constant(array->elements.front()) && !constant_of(array->elements.front()).is_none())
+                replace_with(expr, array->elements.front());
+        }
+    };
+
+    static void fold_counted(ast_node_ptr &expr, const eval_scope &known, fold_stats &stats)
+    {
+        if (!expr)
+            return;
+        ++stats.expressions;
+        stats.nodes_before += count_nodes(expr);
+        folder{known, stats}.fold(expr);
+        stats.nodes_after += count_nodes(expr);
+    }
+
+    void fold_expression(ast_node_ptr &expr, const eval_scope &known, fold_stats *stats)
+    {
+        fold_stats ignored;
+        fold_counted(expr, known, stats ? *stats : ignored);
+    }
+
+    static std::string decl_name(const var_decl &decl)
+    {
+        return decl.identifier && decl.identifier->tok ? decl.identifier->tok->lexeme : "";
+    }
+
+    // the walk over a task's or workflow's members... `top` is false inside scatter and if bodies, where a
+    // declaration is one value per shard (or maybe none at all) and so can't be known to the ones after it
+    struct declaration_folder
+    {
+    public:
+        eval_scope known;
+        const eval_scope *inputs = nullptr;
+        fold_stats stats;
+
+        void statements(std::vector<ast_node_ptr> &members, bool top)
+        {
+            for (auto &member : members)
+                statement(member, top);
+        }
+
+        void body(ast_node_ptr &node, bool top)
+        {
+            if (!node)
+                return;
+            if (auto *b = std::get_if<block>(&node->node))
+                statements(b->statements, top);
+            else
+                statement(node, top);
+        }
+
+        void declaration(ast_node &node, bool top)
+        {
+            auto &decl = std::get<var_decl>(node.node);
+            fold_counted(decl.initializer, known, stats);
+            if (top && is_constant(decl.initializer))
+            {
+                known.set(decl_name(decl), constant_of(decl.initializer));
+                ++stats.constant_decls;
+            }
+        }
+
+        void input(ast_node &node)
+        {
+            auto &decl = std::get<var_decl>(node.node);
+            fold_counted(decl.initializer, known, stats);
+            if (!inputs)
+                return;
+            const std::string name = decl_name(decl);
+            if (const wdl_value *bound = inputs->find(name))
+            {
+                known.set(name, *bound);
+                ++stats.constant_decls;
+            }
+        }
+
+        void statement(ast_node_ptr &node, bool top)
+        {
+            if (!node)
+                return;
+            switch (node->type)
+            {
+            case N_VAR_DECL:
+                declaration(*node, top);
+                break;
+            case N_INPUT_DECL:
+            {
+                auto &in = std::get<input_decl>(node->node);
+                if (auto *b = in.body ? std::get_if<block>(&in.body->node) : nullptr)
+                    for (auto &d : b->statements)
+                        if (d && d->type == N_VAR_DECL)
+                            input(*d);
+                break;
+            }
+            case N_OUTPUT_DECL:
+            {
+                // outputs are worked out after the command, from its files... they're folded but never known
+                auto &out = std::get<output_decl>(node->node);
+                if (auto *b = out.body ? std::get_if<block>(&out.body->node) : nullptr)
+                    for (auto &d : b->statements)
+                        if (d && d->type == N_VAR_DECL)
+                            fold_counted(std::get<var_decl>(d->node).initializer, known, stats);
+                break;
+            }
+            case N_RUNTIME_DECL:
+                for (auto &[key, value] : std::get<runtime_decl>(node->node).members)
+                    fold_counted(value, known, stats);
+                break;
+            case N_WTCALL:
+                for (auto &[key, value] : std::get<call_decl>(node->node).arguments)
+                    fold_counted(value, known, stats);
+                break;
+            case N_SCATTER_STMT:
+            {
+                auto &scatter = std::get<scatter_stmt>(node->node);
+                fold_counted(scatter.collection, known, stats);
+                body(scatter.body, false);
+                break;
+            }
+            case N_IF_STMT:
+            {
+                auto &cond = std::get<if_stmt>(node->node);
+                fold_counted(cond.condition, known, stats);
+                body(cond.then_, false);
+                body(cond.else_, false);
+                break;
+            }
+            default:
+                break; // command (its placeholders are compiled on their own), meta, parameter_meta...
+            }
+        }
+    };
+
+    fold_stats fold_declarations(ast_node &decl, const eval_scope *inputs)
+    {
+        auto *klass = std::get_if<class_decl>(&decl.node);
+        if (!klass)
+            return {};
+        declaration_folder f;
+        f.inputs = inputs;
+        f.statements(klass->members, true);
+        return f.stats;
+    }
+
+    fold_stats fold_program(ast_node &prog)
+    {
+        fold_stats stats;
+        if (auto *p = std::get_if<program>(&prog.node))
+            for (auto &decl : p->declarations)
+                if (decl && decl->type == N_CLASS_DECL)
+                    stats += fold_declarations(*decl);
+        return stats;
+    }
+
+}
@@ -0,0 +1,327 @@
+#include "wdl_generator.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    // splitmix64... tiny, and unlike the <random> distributions it gives the same numbers everywhere
+    struct gen_rng
+    {
+    public:
+        explicit gen_rng(std::uint64_t seed) : state(seed) {}
+        std::uint64_t next()
+        {
+            std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+        std::size_t below(std::size_t n) { return n ? static_cast<std::size_t>(next() % n) : 0; }
+
+    private:
+        std::uint64_t state;
+    };
+
+    // one generated task, and what a call needs to know about it
+    struct gen_task
+    {
+    public:
+        std::string name;      // as called, lib_N.name for imported ones
+        bool has_int_input = false;
+    };
+
+    struct wdl_gen
+    {
+    public:
+        explicit wdl_gen(const wdl_gen_options &options) : options(options), rng(options.seed) {}
+
+        generated_wdl run();
+
+    private:
+        const wdl_gen_options &options;
+        gen_rng rng;
+        std::vector<gen_task> pool; // every task the workflow can call
+
+        std::string expr(std::size_t depth, const std::vector<std::string> &vars);
+        void emit_struct(std::string &out, std::size_t index);
+        void emit_task(std::string &out, const std::string &name, std::size_t index, bool with_structs);
+        void emit_workflow(std::string &out);
+    };
+
+    static const char *const INPUT_TYPES[] = {"Int", "String", "Float", "Boolean", "Array[String]", "Int?"};
+    static const char *const MEMBER_TYPES[] = {"String", "Int", "Float", "Boolean", "Array[String]", "Map[String, Int]", "File"};
+    static const char *const TOOLS[] = {"samtools view -b", "bcftools norm -m-any", "sort -k1,1 -k2,2n", "awk 'NR > 1'",
+                                        "cut -f1-4", "gzip -c", "grep -v '^#'", "uniq -c"};
+
+    std::string wdl_gen::expr(std::size_t depth, const std::vector<std::string> &vars)
+    {
+        if (depth == 0)
+        {
+            if (!vars.empty() && rng.below(3) != 0)
+                return vars[rng.below(vars.size())];
+            return std::to_string(1 + rng.below(64));
+        }
+        // two sub-expressions per level, so depth d is at most 2^d leaves... the condition of an if is a leaf.
+        // every rng draw is its own statement, the order operands of + get evaluated in is up to the compiler
+        std::size_t kind = rng.below(4);
+        if (kind == 3)
+        {
+            std::string cond = expr(0, vars);
+            std::string bound = std::to_string(rng.below(32));
+            std::string then_ = expr(depth - 1, vars);
+            std::string else_ = expr(depth - 1, vars);
+            return "(if " + cond + " > " + bound + " then " + then_ + " else " + else_ + ")";
+        }
+        static const char *const OPS[] = {" + ", " * ", " - "};
+        std::string left = expr(depth - 1, vars);
+        std::string right = expr(depth - 1, vars);
+        return "(" + left + OPS[kind] + right + ")";
+    }
+
+    void wdl_gen::emit_struct(std::string &out, std::size_t index)
+    {
+        out += "struct Record_" + std::to_string(index) + " {\n";
+        for (std::size_t m = 0; m < options.struct_members; ++m)
+        {
+            std::string type = MEMBER_TYPES[(index + m) % std::size(MEMBER_TYPES)];
+            if (index > 0 && m + 1 == options.struct_members)
+                type = "Record_" + std::to_string(index - 1) + "?"; // each struct nests the one before it
+            out += "    " + type + " field_" + std::to_string(m) + "\n";
+        }
+        out += "}\n\n";
+    }
+
+    void wdl_gen::emit_task(std::string &out, const std::string &name, std::size_t index, bool with_structs)
+    {
+        std::vector<std::string> ints;
+        std::string first_string;
+        out += "task " + name + " {\n";
+        out += "    input {\n";
+        out += "        File in_file\n";
+        for (std::size_t i = 0; i < options.inputs_per_task; ++i)
+        {
+            std::string type = INPUT_TYPES[i % std::size(INPUT_TYPES)];
+            std::string var;
+            std::string init;
+            if (type == "Int")
+            {
+                var = "n_" + std::to_string(i);
+                init = " = " + std::to_string(1 + (index + i) % 16);
+                ints.push_back(var);
+            }
+            else if (type == "String")
+            {
+                var = "label_" + std::to_string(i);
+                init = " = \"" + name + "_" + std::to_string(i) + "\"";
+                if (first_string.empty())
+                    first_string = var;
+            }
+            else if (type == "Float")
+            {
+                var = "scale_" + std::to_string(i);
+                init = " = " + std::to_string(1 + rng.below(9)) + ".5";
+            }
+            else if (type == "Boolean")
+            {
+                var = "flag_" + std::to_string(i);
+                init = rng.below(2) ? " = true" : " = false";
+            }
+            else if (type == "Array[String]")
+            {
+                var = "tags_" + std::to_string(i);
+                init = " = [\"a\", \"b\"]";
+            }
+            else
+            {
+                var = "limit_" + std::to_string(i);
+            }
+            if (with_structs && options.structs > 0 && i % std::size(INPUT_TYPES) == std::size(INPUT_TYPES) - 1)
+            {
+                type = "Record_" + std::to_string((index + i) % options.structs) + "?";
+                var = "record_" + std::to_string(i);
+                init.clear();
+            }
+            out += "        " + type + " " + var + init + "\n";
+        }
+        out += "    }\n\n";
+
+        out += "    Int derived = " + expr(options.expr_depth, ints) + "\n\n";
+
+        out += "    command <<<\n";
+        out += "        set -euo pipefail\n";
+        out += "        echo \"" + name + (first_string.empty() ? "" : " ~{" + first_string + "}") + "\" > out_0.txt\n";
+        for (std::size_t l = 0; l < options.command_lines; ++l)
+        {
+            const char *tool = TOOLS[(index + l) % std::size(TOOLS)];
+            std::string flag = ints.empty() ? "~{derived}" : "~{" + ints[l % ints.size()] + "}";
+            out += "        " + std::string(tool) + " ~{in_file} | head -n " + flag + " >> out_0.txt\n";
+        }
+        out += "    >>>\n\n";
+
+        out += "    output {\n";
+        out += "        File out = \"out_0.txt\"\n";
+        for (std::size_t o = 1; o < options.outputs_per_task; ++o)
+        {
+            if (o % 2)
+                out += "        Int count_" + std::to_string(o) + " = derived + " + std::to_string(o) + "\n";
+            else
+                out += "        String tag_" + std::to_string(o) + " = \"" + name + "_out_" + std::to_string(o) + "\"\n";
+        }
+        out += "    }\n\n";
+
+        out += "    runtime {\n";
+        out += "        docker: \"ubuntu:22.04\"\n";
+        out += "        cpu: " + std::to_string(1 + index % 4) + "\n";
+        out += "        memory: \"" + std::to_string(2 + index % 6) + " GiB\"\n";
+        out += "    }\n";
+        out += "}\n\n";
+    }
+
+    void wdl_gen::emit_workflow(std::string &out)
+    {
+        const std::size_t n_calls = options.calls ? options.calls : options.tasks;
+        const std::size_t depth = options.scatter_depth;
+        const std::size_t per_group = std::max<std::size_t>(1, options.calls_per_scatter);
+
+        out += "workflow generated_workflow {\n";
+        out += "    input {\n";
+        out += "        Array[File] samples\n";
+        out += "        Int shards = 4\n";
+        out += "        String prefix = \"gen\"\n";
+        out += "    }\n\n";
+        out += "    Int width = " + expr(options.expr_depth, {"shards"}) + "\n\n";
+
+        std::string first_group_last; // the output block collects this one, Array-wrapped once per scatter level
+        for (std::size_t first = 0; first < n_calls && !pool.empty(); first += per_group)
+        {
+            std::string indent = "    ";
+            std::string file_var = "samples[0]";
+            std::string int_var = "shards";
+            for (std::size_t d = 0; d < depth; ++d)
+            {
+                std::string suffix = std::to_string(first / per_group) + "_" + std::to_string(d);
+                if (d == 0)
+                {
+                    file_var = "sample_" + suffix;
+                    out += indent + "scatter (" + file_var + " in samples) {\n";
+                }
+                else
+                {
+                    int_var = "shard_" + suffix;
+                    out += indent + "scatter (" + int_var + " in range(shards)) {\n";
+                }
+                indent += "    ";
+            }
+            std::string prev;
+            for (std::size_t c = first; c < std::min(n_calls, first + per_group); ++c)
+            {
+                const gen_task &task = pool[c % pool.size()];
+                std::string alias = "call_" + std::to_string(c);
+                std::string in_file = prev.empty() ? file_var : prev + ".out";
+                out += indent + "call " + task.name + " as " + alias + " {\n";
+                out += indent + "    input:\n";
+                out += indent + "        in_file = " + in_file + (task.has_int_input ? ",\n" : "\n");
+                if (task.has_int_input)
+                    out += indent + "        n_0 = " + int_var + "\n";
+                out += indent + "}\n";
+                prev = alias;
+            }
+            if (first == 0)
+                first_group_last = prev;
+            for (std::size_t d = depth; d-- > 0;)
+            {
+                indent.resize(indent.size() - 4);
+                out += indent + "}\n";
+            }
+            out += "\n";
+        }
+
+        out += "    output {\n";
+        out += "        Int total_width = width\n";
+        if (!first_group_last.empty())
+        {
+            std::string type = "File";
+            for (std::size_t d = 0; d < depth; ++d)
+                type = "Array[" + type + "]";
+            out += "        " + type + " first_chain = " + first_group_last + ".out\n";
+        }
+        out += "    }\n";
+        out += "}\n";
+    }
+
+    generated_wdl wdl_gen::run()
+    {
+        generated_wdl wdl;
+        for (std::size_t f = 0; f < options.imports; ++f)
+        {
+            std::string lib = "lib_" + std::to_string(f);
+            std::string source = "version 1.0\n\n";
+            for (std::size_t t = 0; t < options.tasks_per_import; ++t)
+            {
+                std::string name = lib + "_task_" + std::to_string(t);
+                emit_task(source, name, t, false);
+                pool.push_back({lib + "." + name, options.inputs_per_task > 0});
+            }
+            wdl.imports.emplace_back(lib + ".wdl", std::move(source));
+        }
+
+        std::string &out = wdl.main;
+        out += "version 1.0\n\n";
+        out += "# generated by wdlgen, seed " + std::to_string(options.seed) + "\n\n";
+        for (std::size_t f = 0; f < options.imports; ++f)
+            out += "import \"lib_" + std::to_string(f) + ".wdl\" as lib_" + std::to_string(f) + "\n";
+        if (options.imports)
+            out += "\n";
+        for (std::size_t s = 0; s < options.structs; ++s)
+            emit_struct(out, s);
+        // main-file tasks go first in the pool so calls hit them before the imported ones
+        std::vector<gen_task> local;
+        for (std::size_t t = 0; t < options.tasks; ++t)
+        {
+            std::string name = "task_" + std::to_string(t);
+            emit_task(out, name, t, true);
+            local.push_back({name, options.inputs_per_task > 0});
+        }
+        pool.insert(pool.begin(), local.begin(), local.end());
+        emit_workflow(out);
+
+        wdl.bytes = wdl.main.size();
+        wdl.lines = static_cast<std::size_t>(std::count(wdl.main.begin(), wdl.main.end(), '\n'));
+        for (const auto &[name, source] : wdl.imports)
+        {
+            wdl.bytes += source.size();
+            wdl.lines += static_cast<std::size_t>(std::count(source.begin(), source.end(), '\n'));
+        }
+        return wdl;
+    }
+
+    generated_wdl generate_wdl(const wdl_gen_options &options)
+    {
+        wdl_gen gen{options};
+        return gen.run();
+    }
+
+    static void write_text(const fs::path &path, const std::string &content)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path.string());
+        file << content;
+        if (!file)
+            throw std::runtime_error("Failed to write to file: " + path.string());
+    }
+
+    void write_generated_wdl(const generated_wdl &wdl, const std::string &dir, const std::string &main_name)
+    {
+        fs::create_directories(dir);
+        write_text(fs::path(dir) / main_name, wdl.main);
+        for (const auto &[name, source] : wdl.imports)
+            write_text(fs::path(dir) / name, source);
+    }
+
+}
@@ -0,0 +1,478 @@
+#include "wdl_graph.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include "command_template.h"
+
+namespace soto
+{
+
+    static std::string name_of(const ast_node_ptr &node)
+    {
+        return node && node->tok ? node->tok->lexeme : "";
+    }
+
+    static std::string call_name(const call_decl &call)
+    {
+        if (call.alias && call.alias->tok)
+            return call.alias->tok->lexeme;
+        const auto *target = call.member_accessed ? std::get_if<member_access>(&call.member_accessed->node) : nullptr;
+        if (!target)
+            return "";
+        return target->member ? name_of(target->member) : name_of(target->object);
+    }
+
+    static const std::vector<ast_node_ptr> &statements_of(const ast_node_ptr &body)
+    {
+        static const std::vector<ast_node_ptr> none;
+        const auto *b = body ? std::get_if<block>(&body->node) : nullptr;
+        return b ? b->statements : none;
+    }
+
+    // the name an identifier stands for, as parsed or after the resolver made it a slot
+    static std::string referenced(const ast_node &node)
+    {
+        if (const auto *ref = std::get_if<slot_ref>(&node.node))
+            return ref->frame && ref->slot < ref->frame->size() ? ref->frame->names[ref->slot] : "";
+        return node.type == N_IDENT && node.tok ? node.tok->lexeme : "";
+    }
+
+    // every name an expression reads, placeholders of its strings included
+    static void names_in(const ast_node_ptr &e, std::vector<std::string> &out)
+    {
+        if (!e)
+            return;
+        const ast_node &node = *e;
+        if (node.type == N_IDENT || std::holds_alternative<slot_ref>(node.node))
+        {
+            out.push_back(referenced(node));
+            return;
+        }
+        if (node.type == N_LITERAL && node.tok)
+        {
+            if (const auto *interpolated = std::get_if<interpolation>(&node.node))
+            {
+                for (const auto &p : interpolated->compiled->placeholders)
+                    names_in(p.expr, out);
+                return;
+            }
+            const std::string &text = node.tok->lexeme;
+            if (node.tok->kind != T_SLITERAL || (text.find("~{") == std::string::npos && text.find("${") == std::string::npos))
+                return;
+            try
+            {
+                for (const auto &p : command_template::compile(text, true, false).placeholders)
+                    names_in(p.expr, out);
+            }
+            catch (const std::exception &)
+            {
+                // evaluate() reports it
+            }
+            return;
+        }
+        std::visit(
+            [&](auto &&value)
+            {
+                using T = std::decay_t<decltype(value)>;
+                if constexpr (std::is_same_v<T, binary_expr>)
+                {
+                    names_in(value.left, out);
+                    names_in(value.right, out);
+                }
+                else if constexpr (std::is_same_v<T, unary_expr>)
+                    names_in(value.operand, out);
+                else if constexpr (std::is_same_v<T, if_stmt>)
+                {
+                    names_in(value.condition, out);
+                    names_in(value.then_, out);
+                    names_in(value.else_, out);
+                }
+                else if constexpr (std::is_same_v<T, expr_stmt>)
+                    names_in(value.expr, out);
+                else if constexpr (std::is_same_v<T, member_access>)
+                {
+                    if (value.object)
+                        out.push_back(referenced(*value.object));
+                }
+                else if constexpr (std::is_same_v<T, array_expr>)
+                {
+                    for (const auto &element : value.elements)
+                        names_in(element, out);
+                }
+                else if constexpr (std::is_same_v<T, map_expr>)
+                {
+                    for (const auto &[k, v] : value.elements)
+                    {
+                        names_in(k, out);
+                        names_in(v, out);
+                    }
+                }
+                else if constexpr (std::is_same_v<T, pair_expr>)
+                {
+                    names_in(value.first, out);
+                    names_in(value.second, out);
+                }
+                else if constexpr (std::is_same_v<T, index_expr>)
+                {
+                    names_in(value.collection, out);
+                    names_in(value.index, out);
+                }
+                else if constexpr (std::is_same_v<T, struct_expr>)
+                {
+                    for (const auto &v : value.values)
+                        names_in(v, out);
+                }
+                else if constexpr (std::is_same_v<T, func_call>)
+                {
+                    for (const auto &arg : value.arguments)
+                        names_in(arg, out);
+                }
+            },
+            node.node);
+    }
+
+    // what a scatter body declares (gathered out of it), what it reads, and how many calls are in it...
+    // nested scatters and ifs included
+    struct scatter_body
+    {
+    public:
+        std::vector<std::string> declared;
+        std::vector<std::string> variables; // of the scatters, its own and nested ones... never gathered
+        std::vector<std::string> reads;
+        std::size_t calls = 0;
+
+        bool has(const std::string &name) const
+        {
+            return std::find(declared.begin(), declared.end(), name) != declared.end() ||
+                   std::find(variables.begin(), variables.end(), name) != variables.end();
+        }
+
+        void walk(const std::vector<ast_node_ptr> &statements)
+        {
+            for (const auto &s : statements)
+            {
+                if (!s)
+                    continue;
+                if (const auto *var = std::get_if<var_decl>(&s->node))
+                {
+                    declared.push_back(name_of(var->identifier));
+                    names_in(var->initializer, reads);
+                }
+                else if (const auto *call = std::get_if<call_decl>(&s->node))
+                {
+                    declared.push_back(call_name(*call));
+                    for (const auto &[key, value] : call->arguments)
+                        names_in(value, reads);
+                    ++calls;
+                }
+                else if (const auto *scatter = std::get_if<scatter_stmt>(&s->node))
+                {
+                    variables.push_back(name_of(scatter->identifier));
+                    names_in(scatter->collection, reads);
+                    walk(statements_of(scatter->body));
+                }
+                else if (const auto *cond = std::get_if<if_stmt>(&s->node))
+                {
+                    names_in(cond->condition, reads);
+                    walk(statements_of(cond->then_));
+                }
+            }
+        }
+    };
+
+    // the scatters nested in `outer` that can run as one iteration space with it... each one the whole body of
+    // the one around it, over a collection none of the variables around it go into
+    static std::vector<const ast_node *> nest_of(const ast_node &outer)
+    {
+        std::vector<const ast_node *> levels{&outer};
+        std::vector<std::string> variables{name_of(std::get<scatter_stmt>(outer.node).identifier)};
+        for (;;)
+        {
+            const auto &body = statements_of(std::get<scatter_stmt>(levels.back()->node).body);
+            const ast_node *inner = body.size() == 1 && body[0] && std::holds_alternative<scatter_stmt>(body[0]->node) ? body[0].get() : nullptr;
+            if (!inner)
+                break;
+            const auto &scatter = std::get<scatter_stmt>(inner->node);
+            std::vector<std::string> reads;
+            names_in(scatter.collection, reads);
+            for (const std::string &name : reads)
+                if (std::find(variables.begin(), variables.end(), name) != variables.end())
+                    return levels;
+            levels.push_back(inner);
+            variables.push_back(name_of(scatter.identifier));
+        }
+        return levels;
+    }
+
+    struct graph_builder
+    {
+    public:
+        workflow_graph &graph;
+        bool flatten = true;
+        std::vector<std::vector<std::string>> reads; // per node
+
+        std::uint32_t add(graph_node_kind kind, const ast_node &stmt, std::int32_t parent)
+        {
+            const auto index = static_cast<std::uint32_t>(graph.nodes.size());
+            graph_node &node = graph.nodes.emplace_back();
+            node.kind = kind;
+            node.stmt = &stmt;
+            node.parent = parent;
+            if (parent >= 0)
+                graph.nodes[parent].children.push_back(index);
+            reads.emplace_back();
+            return index;
+        }
+
+        void declare(std::uint32_t index, const std::string &name)
+        {
+            if (name.empty())
+                return;
+            graph.nodes[index].names.push_back(name);
+            graph.declared[name] = index;
+        }
+
+        void statements(const std::vector<ast_node_ptr> &body, std::int32_t parent)
+        {
+            for (const auto &s : body)
+            {
+                if (!s)
+                    continue;
+                if (const auto *var = std::get_if<var_decl>(&s->node))
+                {
+                    const std::uint32_t n = add(GN_DECL, *s, parent);
+                    declare(n, name_of(var->identifier));
+                    names_in(var->initializer, reads[n]);
+                }
+                else if (const auto *call = std::get_if<call_decl>(&s->node))
+                {
+                    const std::uint32_t n = add(GN_CALL, *s, parent);
+                    declare(n, call_name(*call));
+                    for (const auto &[key, value] : call->arguments)
+                        names_in(value, reads[n]);
+                    graph.nodes[n].calls = 1;
+                }
+                else if (const auto *scatter = std::get_if<scatter_stmt>(&s->node))
+                {
+                    const std::uint32_t n = add(GN_SCATTER, *s, parent);
+                    scatter_body inner;
+                    inner.variables.push_back(name_of(scatter->identifier));
+                    names_in(scatter->collection, reads[n]);
+                    inner.walk(statements_of(scatter->body));
+                    // what the body reads from out here... its own names don't count
+                    for (const std::string &name : inner.reads)
+                        if (!inner.has(name))
+                            reads[n].push_back(name);
+                    for (const std::string &name : inner.declared)
+                        declare(n, name);
+                    graph.nodes[n].calls = inner.calls;
+                    graph.nodes[n].levels = flatten ? nest_of(*s) : std::vector<const ast_node *>{s.get()};
+                    graph.flattened += graph.nodes[n].levels.size() - 1;
+                }
+                else if (const auto *cond = std::get_if<if_stmt>(&s->node))
+                {
+                    const std::uint32_t n = add(GN_IF, *s, parent);
+                    names_in(cond->condition, reads[n]);
+                    statements(statements_of(cond->then_), static_cast<std::int32_t>(n));
+                }
+            }
+        }
+
+        void link()
+        {
+            for (std::uint32_t n = 0; n < graph.nodes.size(); ++n)
+            {
+                graph_node &node = graph.nodes[n];
+                std::vector<std::uint32_t> &depends = node.depends;
+                if (node.parent >= 0)
+                    depends.push_back(static_cast<std::uint32_t>(node.parent));
+                for (const std::string &name : reads[n])
+                {
+                    auto it = graph.declared.find(name);
+                    if (it != graph.declared.end() && it->second != n)
+                        depends.push_back(it->second); // anything else is an input
+                }
+                std::sort(depends.begin(), depends.end());
+                depends.erase(std::unique(depends.begin(), depends.end()), depends.end());
+                for (std::uint32_t d : depends)
+                    graph.nodes[d].dependents.push_back(n);
+                graph.calls += node.kind == GN_IF ? 0 : node.calls;
+            }
+        }
+    };
+
+    workflow_graph workflow_graph::build(const ast_node &workflow, bool flatten)
+    {
+        const auto *klass = std::get_if<class_decl>(&workflow.node);
+        if (!klass || workflow.type != N_CLASS_DECL || !workflow.tok || workflow.tok->lexeme != "workflow")
+            throw std::runtime_error("Not a workflow.");
+        workflow_graph graph;
+        graph.workflow = &workflow;
+        graph_builder builder{graph, flatten, {}};
+        builder.statements(klass->members, -1);
+        builder.link();
+        return graph;
+    }
+
+    graph_run::graph_run(const workflow_graph &graph, eval_scope &scope)
+        : graph(graph), scope(scope), state(graph.nodes.size(), GS_WAITING), waiting(graph.nodes.size()),
+          shards(graph.nodes.size(), 0), collections(graph.nodes.size()), unsettled(graph.nodes.size())
+    {
+        // the input defaults and top-level declarations, then those inside if blocks... a pruned one is None
+        // before anything gets to read it
+        defer_declarations(scope, std::get<class_decl>(graph.workflow->node).members);
+        for (const graph_node &node : graph.nodes)
+            if (node.kind == GN_DECL && node.parent >= 0)
+                if (const auto &init = std::get<var_decl>(node.stmt->node).initializer)
+                    scope.defer(node.names.front(), *init);
+        for (std::uint32_t n = 0; n < graph.nodes.size(); ++n)
+        {
+            waiting[n] = static_cast<std::uint32_t>(graph.nodes[n].depends.size());
+            if (waiting[n] == 0)
+                work.push_back(n);
+        }
+        std::reverse(work.begin(), work.end()); // statement order
+        drain();
+    }
+
+    void graph_run::finish(std::uint32_t node, const wdl_value &outputs)
+    {
+        if (state[node] != GS_READY)
+            throw std::runtime_error("Finishing a node that wasn't handed out.");
+        const graph_node &n = graph.nodes[node];
+        if (n.kind == GN_CALL)
+            scope.set(n.names.front(), outputs);
+        else
+            for (const auto &[name, value] : outputs.as_object().members)
+                scope.set(name, value);
+        settle(node, GS_DONE);
+        drain();
+    }
+
+    const wdl_value &graph_run::item(std::uint32_t node, std::size_t level, std::size_t shard) const
+    {
+        const std::vector<wdl_value> &levels = collections[node];
+        for (std::size_t l = levels.size(); l-- > level + 1;)
+            shard /= levels[l].as_array().size();
+        const wdl_array &elements = levels[level].as_array();
+        return elements[shard % elements.size()];
+    }
+
+    // flat[begin, begin + size of levels[level..]) as nested Arrays
+    static wdl_value reshape(const std::vector<wdl_value> &levels, std::size_t level, wdl_array &flat, std::size_t begin)
+    {
+        const std::size_t n = levels[level].as_array().size();
+        wdl_array out;
+        if (level + 1 == levels.size())
+        {
+            out.assign(std::make_move_iterator(flat.begin() + static_cast<std::ptrdiff_t>(begin)),
+                       std::make_move_iterator(flat.begin() + static_cast<std::ptrdiff_t>(begin + n)));
+            return wdl_value::array(std::move(out));
+        }
+        std::size_t inner = 1;
+        for (std::size_t l = level + 1; l < levels.size(); ++l)
+            inner *= levels[l].as_array().size();
+        out.reserve(n);
+        for (std::size_t i = 0; i < n; ++i)
+            out.push_back(reshape(levels, level + 1, flat, begin + i * inner));
+        return wdl_value::array(std::move(out));
+    }
+
+    wdl_value graph_run::gather(std::uint32_t node, wdl_array flat) const
+    {
+        if (flat.size() != shards[node])
+            throw std::runtime_error("Gathering " + std::to_string(flat.size()) + " values from a scatter of " + std::to_string(shards[node]) + " shards.");
+        const std::vector<wdl_value> &levels = collections[node];
+        if (levels.size() == 1)
+            return wdl_value::array(std::move(flat));
+        return reshape(levels, 0, flat, 0);
+    }
+
+    void graph_run::settle(std::uint32_t node, graph_node_state to)
+    {
+        state[node] = to;
+        --unsettled;
+        for (std::uint32_t d : graph.nodes[node].dependents)
+            if (--waiting[d] == 0 && state[d] == GS_WAITING)
+                work.push_back(d);
+    }
+
+    // everything in a false if's block, nested blocks too... None for all it declares, and whatever waits on
+    // it can go ahead
+    void graph_run::prune(std::uint32_t node)
+    {
+        for (std::uint32_t c : graph.nodes[node].children)
+        {
+            if (state[c] == GS_PRUNED)
+                continue;
+            const graph_node &child = graph.nodes[c];
+            for (const std::string &name : child.names)
+                scope.set(name, wdl_value::none());
+            ++stats.pruned_nodes;
+            stats.pruned_calls += child.kind == GN_IF ? 0 : child.calls;
+            if (child.kind == GN_IF)
+                prune(c);
+            settle(c, GS_PRUNED);
+        }
+    }
+
+    void graph_run::visit(std::uint32_t node)
+    {
+        const graph_node &n = graph.nodes[node];
+        switch (n.kind)
+        {
+        case GN_DECL:
+            settle(node, GS_DONE); // deferred, it's evaluated when read
+            break;
+        case GN_IF:
+        {
+            ++stats.conditions;
+            const wdl_value taken = evaluate(std::get<if_stmt>(n.stmt->node).condition, scope);
+            if (!taken.as_bool())
+                prune(node);
+            settle(node, GS_DONE);
+            break;
+        }
+        case GN_CALL:
+            state[node] = GS_READY;
+            ready.push_back(node);
+            ++stats.materialized;
+            break;
+        case GN_SCATTER:
+        {
+            // every level's collection out here... none of them reads a variable of the ones around it
+            shards[node] = 1;
+            for (const ast_node *level : n.levels)
+            {
+                collections[node].push_back(evaluate(std::get<scatter_stmt>(level->node).collection, scope));
+                shards[node] *= collections[node].back().as_array().size();
+            }
+            if (shards[node] == 0)
+            {
+                // nothing to run, what it gathers is empty... or N empty Arrays when it's an inner level that is
+                for (const std::string &name : n.names)
+                    scope.set(name, gather(node, {}));
+                settle(node, GS_DONE);
+                break;
+            }
+            state[node] = GS_READY;
+            ready.push_back(node);
+            stats.materialized += shards[node] * n.calls;
+            break;
+        }
+        }
+    }
+
+    void graph_run::drain()
+    {
+        while (!work.empty())
+        {
+            const std::uint32_t node = work.back();
+            work.pop_back();
+            if (state[node] == GS_WAITING)
+                visit(node);
+        }
+    }
+
+}
@@ -0,0 +1,122 @@
+#include "wdl_module.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+#include "lexer.h"
+#include "trace.h"
+#include "wdl_resolve.h"
+#include "wdl_struct.h"
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    std::string canonical_wdl_path(const std::string &path)
+    {
+        std::error_code ec;
+        fs::path p = fs::weakly_canonical(fs::absolute(path, ec), ec);
+        return ec ? path : p.string();
+    }
+
+    static std::string unquoted(std::string s)
+    {
+        std::size_t b = s.find_first_not_of(" \t\"'");
+        if (b == std::string::npos)
+            return "";
+        std::size_t e = s.find_last_not_of(" \t\"'");
+        return s.substr(b, e - b + 1);
+    }
+
+    // canonical paths of what a parsed file at `path` imports, in source order
+    static std::vector<std::string> imports_of(const std::string &path, const ast_node_ptr &tree)
+    {
+        std::vector<std::string> imports;
+        const fs::path dir = fs::path(path).parent_path();
+        const auto *prog = tree ? std::get_if<program>(&tree->node) : nullptr;
+        if (!prog)
+            return imports;
+        for (const auto &imp : prog->imports)
+        {
+            const auto *decl = imp ? std::get_if<import_decl>(&imp->node) : nullptr;
+            if (!decl || !decl->path || !decl->path->tok)
+                continue;
+            std::string target = unquoted(decl->path->tok->lexeme);
+            if (!target.empty() && target.find("://") == std::string::npos) // http imports aren't ours to fetch
+                imports.push_back(canonical_wdl_path((dir / target).string()));
+        }
+        return imports;
+    }
+
+    // the structs of everything `imports` brings in, and what those import... WDL's structs are global, so a
+    // literal here can be of one declared two imports away. each file is parsed again for this, one that
+    // can't be read or parsed is skipped (loading it is what reports that)
+    static struct_layouts imported_structs(std::vector<std::string> imports)
+    {
+        struct_layouts layouts;
+        std::unordered_set<std::string> seen(imports.begin(), imports.end());
+        for (std::size_t i = 0; i < imports.size(); ++i)
+        {
+            std::ifstream file(imports[i]);
+            if (!file)
+                continue;
+            std::ostringstream ss;
+            ss << file.rdbuf();
+            std::vector<parse_diagnostic> diagnostics;
+            parser p{std::make_unique<lexer>(ss.str()), &diagnostics};
+            ast_node_ptr tree = p.parse_program();
+            if (!tree || !diagnostics.empty())
+                continue;
+            for (auto &[name, layout] : layout_structs(*tree))
+                layouts.emplace(name, std::move(layout)); // the first import to declare it wins
+            for (auto &next : imports_of(imports[i], tree))
+                if (seen.insert(next).second)
+                    imports.push_back(std::move(next));
+        }
+        return layouts;
+    }
+
+    std::shared_ptr<const wdl_module> load_wdl_module(const std::string &path)
+    {
+        WDL_TRACE_SCOPE_DETAIL("load_wdl_module", path);
+        auto module = std::make_shared<wdl_module>();
+        module->path = canonical_wdl_path(path);
+        // stamp before reading, a write racing the read then just makes the next request reload
+        if (!stat_file(module->path, module->stamp))
+            throw std::runtime_error("Failed to open file: " + path);
+        std::ifstream file(module->path);
+        if (!file)
+            throw std::runtime_error("Failed to open file: " + path);
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        std::string source = ss.str();
+        module->bytes = source.size();
+
+        parser p{std::make_unique<lexer>(std::move(source)), &module->diagnostics};
+        module->program = p.parse_program();
+        // struct literals that don't fit their struct, then names nothing declares... on a tree that parsed, a
+        // half-parsed one would only add noise to its errors
+        module->imports = imports_of(module->path, module->program);
+        if (module->program && module->diagnostics.empty())
+        {
+            const struct_layouts imported = module->imports.empty() ? struct_layouts{} : imported_structs(module->imports);
+            for (auto &d : compile_structs(*module->program, &imported).diagnostics)
+                module->diagnostics.push_back(std::move(d));
+            for (auto &d : resolve_program(*module->program).diagnostics)
+                module->diagnostics.push_back(std::move(d));
+        }
+
+        if (const ast_node *workflow = find_workflow(module->program))
+        {
+            const auto &klass = std::get<class_decl>(workflow->node);
+            if (klass.identifier && klass.identifier->tok)
+                module->workflow = unquoted(klass.identifier->tok->lexeme);
+            module->inputs = collect_workflow_inputs(module->program, *workflow);
+        }
+        module->structs = collect_structs(module->program);
+        return module;
+    }
+
+}
@@ -0,0 +1,436 @@
+#include "wdl_resolve.h"
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+#include "command_template.h"
+#include "source_lines.h"
+#include "wdl_struct.h"
+
+namespace soto
+{
+
+    std::shared_ptr<const frame_layout> resolve_result::layout_of(const ast_node &node) const
+    {
+        auto it = layouts.find(&node);
+        return it == layouts.end() ? nullptr : it->second;
+    }
+
+    static std::string name_of(const ast_node_ptr &node)
+    {
+        return node && node->tok ? node->tok->lexeme : "";
+    }
+
+    // `call Task`, `call lib.Task`, `call Task as alias`... the name its outputs go by
+    static std::string call_name(const call_decl &call)
+    {
+        if (call.alias && call.alias->tok)
+            return call.alias->tok->lexeme;
+        const auto *target = call.member_accessed ? std::get_if<member_access>(&call.member_accessed->node) : nullptr;
+        if (!target)
+            return "";
+        return target->member ? name_of(target->member) : name_of(target->object);
+    }
+
+    template <typename Fn>
+    static void for_each_decl(ast_node_ptr &body, Fn fn)
+    {
+        if (auto *b = body ? std::get_if<block>(&body->node) : nullptr)
+            for (auto &d : b->statements)
+                if (auto *var = d ? std::get_if<var_decl>(&d->node) : nullptr)
+                    fn(*var);
+    }
+
+    struct resolver
+    {
+    public:
+        const source_lines *lines = nullptr;
+        resolve_result &result;
+        std::vector<std::shared_ptr<const frame_layout>> stack; // innermost last
+        const token *anchor = nullptr; // inside a placeholder, where its string or command is... its own tokens are offsets into the placeholder
+
+        std::shared_ptr<frame_layout> open(const ast_node &owner)
+        {
+            auto frame = std::make_shared<frame_layout>();
+            result.layouts[&owner] = frame;
+            ++result.frames;
+            return frame;
+        }
+
+        void declare(frame_layout &frame, const std::string &name)
+        {
+            if (name.empty())
+                return;
+            const std::size_t before = frame.size();
+            frame.add(name);
+            result.declarations += frame.size() - before;
+        }
+
+        // first pass... every name a frame has, before anything is looked up in it, since a declaration can use
+        // one that comes after it
+        void collect(frame_layout &frame, std::vector<ast_node_ptr> &statements)
+        {
+            for (auto &node : statements)
+                collect(frame, node);
+        }
+
+        void collect_body(frame_layout &frame, ast_node_ptr &body)
+        {
+            if (!body)
+                return;
+            if (auto *b = std::get_if<block>(&body->node))
+                collect(frame, b->statements);
+            else
+                collect(frame, body);
+        }
+
+        void collect(frame_layout &frame, ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            switch (node->type)
+            {
+            case N_VAR_DECL:
+                declare(frame, name_of(std::get<var_decl>(node->node).identifier));
+                break;
+            case N_INPUT_DECL:
+                for_each_decl(std::get<input_decl>(node->node).body, [&](var_decl &var)
+                              { declare(frame, name_of(var.identifier)); });
+                break;
+            case N_OUTPUT_DECL:
+                for_each_decl(std::get<output_decl>(node->node).body, [&](var_decl &var)
+                              { declare(frame, name_of(var.identifier)); });
+                break;
+            case N_WTCALL:
+                declare(frame, call_name(std::get<call_decl>(node->node)));
+                break;
+            case N_SCATTER_STMT:
+            {
+                auto &scatter = std::get<scatter_stmt>(node->node);
+                auto inner = open(*node);
+                declare(*inner, name_of(scatter.identifier));
+                collect_body(*inner, scatter.body);
+                // what the body declares is there after it too, gathered into arrays... the variable isn't
+                for (std::size_t i = 1; i < inner->size(); ++i)
+                    declare(frame, inner->names[i]);
+                break;
+            }
+            case N_IF_STMT:
+            {
+                auto &cond = std::get<if_stmt>(node->node);
+                auto inner = open(*node);
+                collect_body(*inner, cond.then_);
+                collect_body(*inner, cond.else_);
+                for (const std::string &name : inner->names)
+                    declare(frame, name); // optional out here
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        bool lookup(const std::string &name, slot_ref &ref) const
+        {
+            for (std::size_t i = stack.size(); i-- > 0;)
+                if (const std::uint32_t *slot = stack[i]->find(name))
+                {
+                    ref.frame = stack[i];
+                    ref.depth = static_cast<std::uint32_t>(stack.size() - 1 - i);
+                    ref.slot = *slot;
+                    return true;
+                }
+            return false;
+        }
+
+        void undeclared(const token &at, const std::string &name)
+        {
+            const std::size_t offset = static_cast<std::size_t>((anchor ? anchor : &at)->offset);
+            parse_diagnostic d;
+            d.line = lines ? lines->line_of(offset) : 0;
+            d.column = lines ? lines->column_of(offset) : 0;
+            d.lexeme = name;
+            d.message = "Undeclared identifier.";
+            result.diagnostics.push_back(std::move(d));
+        }
+
+        // a name in an expression... a slot_ref from here on, placeholders' included: their templates are kept
+        void reference(ast_node &node)
+        {
+            const std::string &name = node.tok->lexeme;
+            slot_ref ref;
+            if (lookup(name, ref))
+            {
+                node.node = std::move(ref);
+                ++result.references;
+            }
+            else if (name != "None")
+                undeclared(*node.tok, name);
+        }
+
+        // compiled once here, evaluated as often as there are shards... null when a placeholder doesn't parse,
+        // which is evaluate()'s to report
+        std::shared_ptr<command_template> compiled(const token &at, const std::function<command_template()> &compile)
+        {
+            std::shared_ptr<command_template> t;
+            try
+            {
+                t = std::make_shared<command_template>(compile());
+            }
+            catch (const std::exception &)
+            {
+                return nullptr;
+            }
+            const token *outer = anchor;
+            anchor = anchor ? anchor : &at;
+            for (auto &p : t->placeholders)
+                expr(p.expr);
+            anchor = outer;
+            return t;
+        }
+
+        // a map literal's key... a bare name is one only in a literal declared a Map. anywhere else the literal may
+        // be a struct or object the struct pass didn't lay out (the type's unknown), and `id:` is a member name
+        void key(ast_node_ptr &k, bool map)
+        {
+            slot_ref ref;
+            if (map || !k || k->type != N_IDENT || !k->tok)
+                expr(k);
+            else if (lookup(k->tok->lexeme, ref))
+            {
+                k->node = std::move(ref);
+                ++result.references;
+            }
+        }
+
+        // a declaration's initializer, with the type it's declared as... Map literals in it, as deep as the type
+        // says, get their keys checked as names
+        void value(ast_node_ptr &e, const wdl_type *type)
+        {
+            if (!e || !type)
+            {
+                expr(e);
+                return;
+            }
+            if (auto *array = std::get_if<array_expr>(&e->node))
+            {
+                const wdl_type *element = type->kind == WT_ARRAY && !type->params.empty() ? &type->params[0] : nullptr;
+                for (auto &x : array->elements)
+                    value(x, element);
+            }
+            else if (auto *pair = std::get_if<pair_expr>(&e->node))
+            {
+                const bool typed = type->kind == WT_PAIR && type->params.size() == 2;
+                value(pair->first, typed ? &type->params[0] : nullptr);
+                value(pair->second, typed ? &type->params[1] : nullptr);
+            }
+            else if (auto *map = std::get_if<map_expr>(&e->node))
+            {
+                const bool typed = type->kind == WT_MAP && type->params.size() == 2;
+                for (auto &[k, v] : map->elements)
+                {
+                    key(k, typed);
+                    value(v, typed ? &type->params[1] : nullptr);
+                }
+            }
+            else
+                expr(e);
+        }
+
+        void initializer(var_decl &var)
+        {
+            wdl_type type;
+            value(var.initializer, var.initializer && declared_type(var, type) ? &type : nullptr);
+        }
+
+        void expr(ast_node_ptr &e)
+        {
+            if (!e)
+                return;
+            ast_node &node = *e;
+            if (node.type == N_IDENT && node.tok)
+            {
+                reference(node);
+                return;
+            }
+            if (node.type == N_LITERAL && node.tok)
+            {
+                const std::string &text = node.tok->lexeme;
+                if (node.tok->kind != T_SLITERAL || (text.find("~{") == std::string::npos && text.find("${") == std::string::npos))
+                    return;
+                // compiled from the text evaluate() would compile, escapes resolved
+                if (auto t = compiled(*node.tok, [&]
+                                      { return command_template::compile(string_literal_text(text), true, false); }))
+                    node.node = interpolation{std::move(t)};
+                return;
+            }
+            std::visit(
+                [&](auto &&value)
+                {
+                    using T = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<T, binary_expr>)
+                    {
+                        expr(value.left);
+                        expr(value.right);
+                    }
+                    else if constexpr (std::is_same_v<T, unary_expr>)
+                        expr(value.operand);
+                    else if constexpr (std::is_same_v<T, if_stmt>)
+                    {
+                        expr(value.condition);
+                        expr(value.then_);
+                        expr(value.else_);
+                    }
+                    else if constexpr (std::is_same_v<T, expr_stmt>)
+                        expr(value.expr);
+                    else if constexpr (std::is_same_v<T, member_access>)
+                    {
+                        // Task.out, sample.name... the object is a name, what follows the '.' is its member
+                        if (value.object && value.object->tok)
+                            reference(*value.object);
+                    }
+                    else if constexpr (std::is_same_v<T, array_expr>)
+                    {
+                        for (auto &element : value.elements)
+                            expr(element);
+                    }
+                    else if constexpr (std::is_same_v<T, map_expr>)
+                    {
+                        for (auto &[k, v] : value.elements)
+                        {
+                            key(k, false);
+                            expr(v);
+                        }
+                    }
+                    else if constexpr (std::is_same_v<T, pair_expr>)
+                    {
+                        expr(value.first);
+                        expr(value.second);
+                    }
+                    else if constexpr (std::is_same_v<T, index_expr>)
+                    {
+                        expr(value.collection);
+                        expr(value.index);
+                    }
+                    else if constexpr (std::is_same_v<T, struct_expr>)
+                    {
+                        for (auto &v : value.values)
+                            expr(v); // the member names are the layout's, not names here
+                    }
+                    else if constexpr (std::is_same_v<T, func_call>)
+                    {
+                        for (auto &arg : value.arguments)
+                            expr(arg);
+                    }
+                },
+                node.node);
+        }
+
+        void body(ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            if (auto *b = std::get_if<block>(&node->node))
+                for (auto &s : b->statements)
+                    statement(s);
+            else
+                statement(node);
+        }
+
+        // second pass... the same walk, looking names up in the frames it's inside of
+        void statement(ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            switch (node->type)
+            {
+            case N_VAR_DECL:
+                initializer(std::get<var_decl>(node->node));
+                break;
+            case N_INPUT_DECL:
+                for_each_decl(std::get<input_decl>(node->node).body, [&](var_decl &var)
+                              { initializer(var); });
+                break;
+            case N_OUTPUT_DECL:
+                for_each_decl(std::get<output_decl>(node->node).body, [&](var_decl &var)
+                              { initializer(var); });
+                break;
+            case N_RUNTIME_DECL:
+                for (auto &[key, value] : std::get<runtime_decl>(node->node).members)
+                    expr(value);
+                break;
+            case N_WTCALL:
+                for (auto &[key, value] : std::get<call_decl>(node->node).arguments)
+                    expr(value); // the key is the called task's input, not a name here
+                break;
+            case N_COMMAND_DECL:
+            {
+                auto &command = std::get<command_decl>(node->node);
+                if (!command.body || !command.body->tok)
+                    break;
+                command.compiled = compiled(*command.body->tok, [&]
+                                            { return command_template::from_command(command); });
+                break;
+            }
+            case N_SCATTER_STMT:
+            {
+                auto &scatter = std::get<scatter_stmt>(node->node);
+                expr(scatter.collection); // out here, the variable isn't a name yet
+                stack.push_back(result.layout_of(*node));
+                body(scatter.body);
+                stack.pop_back();
+                break;
+            }
+            case N_IF_STMT:
+            {
+                auto &cond = std::get<if_stmt>(node->node);
+                expr(cond.condition);
+                stack.push_back(result.layout_of(*node));
+                body(cond.then_);
+                body(cond.else_);
+                stack.pop_back();
+                break;
+            }
+            default:
+                break; // meta, parameter_meta
+            }
+        }
+    };
+
+    resolve_result resolve_declarations(ast_node &decl, const source_lines *lines)
+    {
+        resolve_result result;
+        auto *klass = std::get_if<class_decl>(&decl.node);
+        if (!klass)
+            return result;
+        resolver r{lines, result, {}, nullptr};
+        auto frame = r.open(decl);
+        r.collect(*frame, klass->members);
+        r.stack.push_back(frame);
+        for (auto &member : klass->members)
+            r.statement(member);
+        return result;
+    }
+
+    resolve_result resolve_program(ast_node &prog)
+    {
+        resolve_result result;
+        auto *p = std::get_if<program>(&prog.node);
+        if (!p)
+            return result;
+        for (auto &decl : p->declarations)
+        {
+            if (!decl || decl->type != N_CLASS_DECL)
+                continue;
+            resolve_result one = resolve_declarations(*decl, p->lines.get());
+            result.frames += one.frames;
+            result.declarations += one.declarations;
+            result.references += one.references;
+            for (auto &d : one.diagnostics)
+                result.diagnostics.push_back(std::move(d));
+            result.layouts.merge(one.layouts);
+        }
+        return result;
+    }
+
+}
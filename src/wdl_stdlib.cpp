@@ -0,0 +1,1027 @@
+#include "wdl_stdlib.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glob.h>
+#include <memory>
+#include <regex>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include "file_hash.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+
+namespace soto
+{
+
+    [[noreturn]] static void fail(const char *fn, const std::string &message)
+    {
+        throw std::runtime_error(std::string(fn) + ": " + message);
+    }
+
+    static bool is_stringy(const wdl_value &v)
+    {
+        return v.kind == WT_STRING || v.kind == WT_FILE || v.kind == WT_DIRECTORY;
+    }
+
+    static bool is_primitive(const wdl_value &v)
+    {
+        return v.kind >= WT_BOOLEAN && v.kind <= WT_DIRECTORY;
+    }
+
+    static const std::string &string_arg(const char *fn, const wdl_value &v)
+    {
+        if (!is_stringy(v))
+            fail(fn, std::string("expected a String or File, got ") + wdl_type_kind_to_string(v.kind));
+        return v.as_string();
+    }
+
+    static const wdl_array &array_arg(const char *fn, const wdl_value &v)
+    {
+        if (v.kind != WT_ARRAY)
+            fail(fn, std::string("expected an Array, got ") + wdl_type_kind_to_string(v.kind));
+        return v.as_array();
+    }
+
+    static const wdl_map &map_arg(const char *fn, const wdl_value &v)
+    {
+        if (v.kind != WT_MAP)
+            fail(fn, std::string("expected a Map, got ") + wdl_type_kind_to_string(v.kind));
+        return v.as_map();
+    }
+
+    static std::string primitive_text(const char *fn, const wdl_value &v)
+    {
+        if (!is_primitive(v))
+            fail(fn, std::string("expected primitive values, got ") + wdl_type_kind_to_string(v.kind));
+        return v.to_string();
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // reading files... mmapped and split with memchr, which glibc vectorizes, so the only per-line work
+    // is building the String
+
+    // calls line(text) for every line of text, without its \n (or \r\n). a last line without a newline counts
+    template <typename F>
+    static void for_each_line(std::string_view text, F &&line)
+    {
+        const char *p = text.data();
+        const char *end = p + text.size();
+        while (p < end)
+        {
+            const char *nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+            const char *line_end = nl ? nl : end;
+            std::size_t n = static_cast<std::size_t>(line_end - p);
+            if (n && p[n - 1] == '\r')
+                --n;
+            line(std::string_view(p, n));
+            p = nl ? nl + 1 : end;
+        }
+    }
+
+    static std::size_t count_lines(std::string_view text)
+    {
+        std::size_t n = 0;
+        const char *p = text.data();
+        const char *end = p + text.size();
+        while (const char *nl = static_cast<const char *>(std::memchr(p, '\n', static_cast<std::size_t>(end - p))))
+        {
+            ++n;
+            p = nl + 1;
+        }
+        return n + (p < end);
+    }
+
+    static wdl_array split_fields(std::string_view line)
+    {
+        wdl_array fields;
+        fields.reserve(static_cast<std::size_t>(std::count(line.begin(), line.end(), '\t')) + 1);
+        for (;;)
+        {
+            std::size_t tab = line.find('\t');
+            fields.push_back(wdl_value::string(std::string(line.substr(0, tab))));
+            if (tab == std::string_view::npos)
+                break;
+            line.remove_prefix(tab + 1);
+        }
+        return fields;
+    }
+
+    static std::string_view trim(std::string_view s)
+    {
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    static mapped_file open_arg(const char *fn, const wdl_value &v)
+    {
+        try
+        {
+            return mapped_file(string_arg(fn, v));
+        }
+        catch (const std::runtime_error &e)
+        {
+            fail(fn, e.what());
+        }
+    }
+
+    static wdl_value read_lines(const std::vector<wdl_value> &args)
+    {
+        mapped_file file = open_arg("read_lines", args[0]);
+        std::string_view text = file.view();
+        wdl_array lines;
+        lines.reserve(count_lines(text));
+        for_each_line(text, [&](std::string_view line)
+                      { lines.push_back(wdl_value::string(std::string(line))); });
+        return wdl_value::array(std::move(lines));
+    }
+
+    static wdl_value read_tsv(const std::vector<wdl_value> &args)
+    {
+        mapped_file file = open_arg("read_tsv", args[0]);
+        std::string_view text = file.view();
+        wdl_array rows;
+        rows.reserve(count_lines(text));
+        for_each_line(text, [&](std::string_view line)
+                      { rows.push_back(wdl_value::array(split_fields(line))); });
+        return wdl_value::array(std::move(rows));
+    }
+
+    // the map's index is built once all the lines are in, fetching ahead... and finds a duplicate on the way
+    static wdl_value read_map(const std::vector<wdl_value> &args)
+    {
+        mapped_file file = open_arg("read_map", args[0]);
+        std::string_view text = file.view();
+        std::vector<wdl_map::entry> lines;
+        lines.reserve(count_lines(text));
+        for_each_line(text, [&](std::string_view line)
+                      {
+            std::size_t tab = line.find('\t');
+            if (tab == std::string_view::npos || line.find('\t', tab + 1) != std::string_view::npos)
+                fail("read_map", "line " + std::to_string(lines.size() + 1) + " doesn't have exactly two columns");
+            lines.emplace_back(wdl_value::string(std::string(line.substr(0, tab))), wdl_value::string(std::string(line.substr(tab + 1)))); });
+        std::size_t duplicate = std::string::npos;
+        wdl_map entries = wdl_map::from_entries(std::move(lines), duplicate);
+        if (duplicate != std::string::npos)
+        {
+            // the list was moved in, the key's text is in the file still
+            std::size_t line_no = 0;
+            std::string key;
+            for_each_line(text, [&](std::string_view line)
+                          {
+                if (line_no++ == duplicate)
+                    key = std::string(line.substr(0, line.find('\t'))); });
+            fail("read_map", "duplicate key '" + key + "' on line " + std::to_string(duplicate + 1));
+        }
+        return wdl_value::map(std::move(entries));
+    }
+
+    static wdl_array read_object_rows(const char *fn, const wdl_value &path)
+    {
+        mapped_file file = open_arg(fn, path);
+        std::vector<std::string_view> lines;
+        for_each_line(file.view(), [&](std::string_view line)
+                      { lines.push_back(line); });
+        if (lines.empty())
+            fail(fn, "the file is empty, it needs a header line");
+        wdl_array header = split_fields(lines[0]);
+        wdl_array objects;
+        for (std::size_t i = 1; i < lines.size(); ++i)
+        {
+            wdl_array values = split_fields(lines[i]);
+            if (values.size() != header.size())
+                fail(fn, "line " + std::to_string(i + 1) + " has " + std::to_string(values.size()) + " columns, the header has " + std::to_string(header.size()));
+            wdl_object object;
+            for (std::size_t c = 0; c < header.size(); ++c)
+                object.members.emplace_back(header[c].as_string(), std::move(values[c]));
+            objects.push_back(wdl_value::object(std::move(object)));
+        }
+        return objects;
+    }
+
+    static wdl_value read_object(const std::vector<wdl_value> &args)
+    {
+        wdl_array objects = read_object_rows("read_object", args[0]);
+        if (objects.size() != 1)
+            fail("read_object", "expected a header line and one line of values, got " + std::to_string(objects.size()) + " lines of values");
+        return objects[0];
+    }
+
+    static wdl_value read_objects(const std::vector<wdl_value> &args)
+    {
+        return wdl_value::array(read_object_rows("read_objects", args[0]));
+    }
+
+    static wdl_value from_json(const json_node &node)
+    {
+        switch (node.kind)
+        {
+        case JN_BOOL:
+            return wdl_value::boolean(node.boolean);
+        case JN_NUMBER:
+            if (std::floor(node.number) == node.number && std::fabs(node.number) < 9007199254740992.0)
+                return wdl_value::integer(static_cast<std::int64_t>(node.number));
+            return wdl_value::floating(node.number);
+        case JN_STRING:
+            return wdl_value::string(node.text);
+        case JN_ARRAY:
+        {
+            wdl_array elements;
+            elements.reserve(node.items.size());
+            for (const json_node &item : node.items)
+                elements.push_back(from_json(item));
+            return wdl_value::array(std::move(elements));
+        }
+        case JN_OBJECT:
+        {
+            wdl_object object;
+            for (const auto &[key, member] : node.members)
+                object.members.emplace_back(key, from_json(member));
+            return wdl_value::object(std::move(object));
+        }
+        default:
+            return wdl_value::none();
+        }
+    }
+
+    static wdl_value read_json(const std::vector<wdl_value> &args)
+    {
+        mapped_file file = open_arg("read_json", args[0]);
+        try
+        {
+            return from_json(parse_json(file.view()));
+        }
+        catch (const std::runtime_error &e)
+        {
+            fail("read_json", e.what());
+        }
+    }
+
+    static std::string read_whole(const char *fn, const wdl_value &path)
+    {
+        mapped_file file = open_arg(fn, path);
+        return std::string(trim(file.view()));
+    }
+
+    static wdl_value read_string(const std::vector<wdl_value> &args)
+    {
+        mapped_file file = open_arg("read_string", args[0]);
+        std::string_view text = file.view();
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+            text.remove_suffix(1); // only the trailing newlines, whatever else is there is the string's
+        return wdl_value::string(std::string(text));
+    }
+
+    static wdl_value read_int(const std::vector<wdl_value> &args)
+    {
+        std::string text = read_whole("read_int", args[0]);
+        char *end = nullptr;
+        long long i = std::strtoll(text.c_str(), &end, 10);
+        if (text.empty() || *end)
+            fail("read_int", "'" + text + "' isn't an Int");
+        return wdl_value::integer(i);
+    }
+
+    static wdl_value read_float(const std::vector<wdl_value> &args)
+    {
+        std::string text = read_whole("read_float", args[0]);
+        char *end = nullptr;
+        double d = std::strtod(text.c_str(), &end);
+        if (text.empty() || *end)
+            fail("read_float", "'" + text + "' isn't a Float");
+        return wdl_value::floating(d);
+    }
+
+    static wdl_value read_boolean(const std::vector<wdl_value> &args)
+    {
+        std::string text = read_whole("read_boolean", args[0]);
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        if (text != "true" && text != "false")
+            fail("read_boolean", "'" + text + "' isn't a Boolean");
+        return wdl_value::boolean(text == "true");
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // writing files
+
+    static std::string write_dir_setting;
+
+    void set_stdlib_write_dir(const std::string &dir)
+    {
+        write_dir_setting = dir;
+    }
+
+    const std::string &stdlib_write_dir()
+    {
+        if (write_dir_setting.empty())
+            write_dir_setting = (fs::temp_directory_path() / "wdlrunner-writes").string();
+        return write_dir_setting;
+    }
+
+    // same content, same file... written next to its final name and renamed, so two shards writing it at once
+    // never see half of it
+    static wdl_value write_content(const char *fn, const std::string &content, const char *extension)
+    {
+        fs::path dir = stdlib_write_dir();
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+        fs::path path = dir / (hash_string(content) + extension);
+        struct stat st;
+        if (::stat(path.c_str(), &st) == 0 && static_cast<std::size_t>(st.st_size) == content.size())
+            return wdl_value::string(path.string(), WT_FILE);
+        fs::path tmp = path;
+        tmp += ".tmp" + std::to_string(::getpid()) + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            if (!out)
+                fail(fn, "Failed to open file: " + tmp.string());
+            out.write(content.data(), static_cast<std::streamsize>(content.size()));
+            if (!out)
+                fail(fn, "Failed to write file: " + tmp.string());
+        }
+        fs::rename(tmp, path, ec);
+        if (ec)
+            fail(fn, "Failed to write file: " + path.string() + " (" + ec.message() + ")");
+        return wdl_value::string(path.string(), WT_FILE);
+    }
+
+    static void append_row(const char *fn, std::string &out, const wdl_array &row)
+    {
+        for (std::size_t i = 0; i < row.size(); ++i)
+        {
+            if (i)
+                out += '\t';
+            out += primitive_text(fn, row[i]);
+        }
+        out += '\n';
+    }
+
+    static wdl_value write_lines(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        for (const wdl_value &line : array_arg("write_lines", args[0]))
+        {
+            content += primitive_text("write_lines", line);
+            content += '\n';
+        }
+        return write_content("write_lines", content, ".txt");
+    }
+
+    static wdl_value write_tsv(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        for (const wdl_value &row : array_arg("write_tsv", args[0]))
+            append_row("write_tsv", content, array_arg("write_tsv", row));
+        return write_content("write_tsv", content, ".tsv");
+    }
+
+    static wdl_value write_map(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        for (const auto &[key, value] : map_arg("write_map", args[0]))
+        {
+            content += primitive_text("write_map", key);
+            content += '\t';
+            content += primitive_text("write_map", value);
+            content += '\n';
+        }
+        return write_content("write_map", content, ".tsv");
+    }
+
+    static void append_objects(const char *fn, std::string &out, const wdl_array &objects)
+    {
+        if (objects.empty())
+            return;
+        for (const wdl_value &object : objects)
+            if (object.kind != WT_OBJECT && object.kind != WT_STRUCT)
+                fail(fn, std::string("expected an Object, got ") + wdl_type_kind_to_string(object.kind));
+        const auto &first = objects[0].as_object().members;
+        for (std::size_t i = 0; i < first.size(); ++i)
+            out += (i ? "\t" : "") + first[i].first;
+        out += '\n';
+        for (const wdl_value &object : objects)
+        {
+            const auto &members = object.as_object().members;
+            if (members.size() != first.size())
+                fail(fn, "all objects need the same members");
+            for (std::size_t i = 0; i < members.size(); ++i)
+            {
+                if (members[i].first != first[i].first)
+                    fail(fn, "all objects need the same members");
+                if (i)
+                    out += '\t';
+                out += primitive_text(fn, members[i].second);
+            }
+            out += '\n';
+        }
+    }
+
+    static wdl_value write_object(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        append_objects("write_object", content, wdl_array{args[0]});
+        return write_content("write_object", content, ".tsv");
+    }
+
+    static wdl_value write_objects(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        append_objects("write_objects", content, array_arg("write_objects", args[0]));
+        return write_content("write_objects", content, ".tsv");
+    }
+
+    static wdl_value write_json(const std::vector<wdl_value> &args)
+    {
+        std::string content;
+        {
+            json_writer json(content);
+            json.value(args[0]);
+        }
+        content += '\n';
+        return write_content("write_json", content, ".json");
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // arrays... compound values are shared_ptr to const, copying an element that's an array or a map is a
+    // refcount bump, so these only ever copy scalars
+
+    static wdl_value length(const std::vector<wdl_value> &args)
+    {
+        if (args[0].kind == WT_MAP)
+            return wdl_value::integer(static_cast<std::int64_t>(args[0].as_map().size()));
+        return wdl_value::integer(static_cast<std::int64_t>(array_arg("length", args[0]).size()));
+    }
+
+    static wdl_value range(const std::vector<wdl_value> &args)
+    {
+        std::int64_t n = args[0].as_int();
+        if (n < 0)
+            fail("range", "needs a non-negative Int, got " + std::to_string(n));
+        wdl_array elements;
+        elements.reserve(static_cast<std::size_t>(n));
+        for (std::int64_t i = 0; i < n; ++i)
+            elements.push_back(wdl_value::integer(i));
+        return wdl_value::array(std::move(elements));
+    }
+
+    static wdl_value flatten(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &outer = array_arg("flatten", args[0]);
+        std::size_t total = 0, non_empty = 0;
+        const wdl_value *only = nullptr;
+        for (const wdl_value &inner : outer)
+        {
+            std::size_t n = array_arg("flatten", inner).size();
+            total += n;
+            if (n)
+            {
+                ++non_empty;
+                only = &inner;
+            }
+        }
+        if (non_empty == 1)
+            return *only; // [[], xs, []]... that's xs, shared rather than copied
+        wdl_array elements;
+        elements.reserve(total);
+        for (const wdl_value &inner : outer)
+            for (const wdl_value &e : inner.as_array())
+                elements.push_back(e);
+        return wdl_value::array(std::move(elements));
+    }
+
+    static wdl_value zip(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &a = array_arg("zip", args[0]);
+        const wdl_array &b = array_arg("zip", args[1]);
+        if (a.size() != b.size())
+            fail("zip", "the arrays have different lengths (" + std::to_string(a.size()) + " and " + std::to_string(b.size()) + ")");
+        wdl_array pairs;
+        pairs.reserve(a.size());
+        for (std::size_t i = 0; i < a.size(); ++i)
+            pairs.push_back(wdl_value::pair(a[i], b[i]));
+        return wdl_value::array(std::move(pairs));
+    }
+
+    static wdl_value cross(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &a = array_arg("cross", args[0]);
+        const wdl_array &b = array_arg("cross", args[1]);
+        wdl_array pairs;
+        pairs.reserve(a.size() * b.size());
+        for (const wdl_value &x : a)
+            for (const wdl_value &y : b)
+                pairs.push_back(wdl_value::pair(x, y));
+        return wdl_value::array(std::move(pairs));
+    }
+
+    static wdl_value unzip(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &pairs = array_arg("unzip", args[0]);
+        wdl_array left, right;
+        left.reserve(pairs.size());
+        right.reserve(pairs.size());
+        for (const wdl_value &p : pairs)
+        {
+            left.push_back(p.as_pair().first);
+            right.push_back(p.as_pair().second);
+        }
+        return wdl_value::pair(wdl_value::array(std::move(left)), wdl_value::array(std::move(right)));
+    }
+
+    static wdl_value transpose(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &rows = array_arg("transpose", args[0]);
+        if (rows.empty())
+            return wdl_value::array({});
+        const std::size_t columns = array_arg("transpose", rows[0]).size();
+        std::vector<wdl_array> out(columns);
+        for (auto &column : out)
+            column.reserve(rows.size());
+        for (const wdl_value &row : rows)
+        {
+            const wdl_array &r = array_arg("transpose", row);
+            if (r.size() != columns)
+                fail("transpose", "the rows have different lengths");
+            for (std::size_t c = 0; c < columns; ++c)
+                out[c].push_back(r[c]);
+        }
+        wdl_array result;
+        result.reserve(columns);
+        for (auto &column : out)
+            result.push_back(wdl_value::array(std::move(column)));
+        return wdl_value::array(std::move(result));
+    }
+
+    static wdl_value affix(const char *fn, const std::string &affix, const wdl_value &array, bool before)
+    {
+        const wdl_array &elements = array_arg(fn, array);
+        wdl_array out;
+        out.reserve(elements.size());
+        for (const wdl_value &e : elements)
+            out.push_back(wdl_value::string(before ? affix + primitive_text(fn, e) : primitive_text(fn, e) + affix));
+        return wdl_value::array(std::move(out));
+    }
+
+    static wdl_value prefix(const std::vector<wdl_value> &args)
+    {
+        return affix("prefix", string_arg("prefix", args[0]), args[1], true);
+    }
+
+    static wdl_value suffix(const std::vector<wdl_value> &args)
+    {
+        return affix("suffix", string_arg("suffix", args[0]), args[1], false);
+    }
+
+    static wdl_value quote_with(const char *fn, const wdl_value &array, char q)
+    {
+        const wdl_array &elements = array_arg(fn, array);
+        wdl_array out;
+        out.reserve(elements.size());
+        for (const wdl_value &e : elements)
+            out.push_back(wdl_value::string(q + primitive_text(fn, e) + q));
+        return wdl_value::array(std::move(out));
+    }
+
+    static wdl_value quote(const std::vector<wdl_value> &args)
+    {
+        return quote_with("quote", args[0], '"');
+    }
+
+    static wdl_value squote(const std::vector<wdl_value> &args)
+    {
+        return quote_with("squote", args[0], '\'');
+    }
+
+    static wdl_value sep(const std::vector<wdl_value> &args)
+    {
+        const std::string &separator = string_arg("sep", args[0]);
+        std::string out;
+        bool first = true;
+        for (const wdl_value &e : array_arg("sep", args[1]))
+        {
+            if (!first)
+                out += separator;
+            out += primitive_text("sep", e);
+            first = false;
+        }
+        return wdl_value::string(std::move(out));
+    }
+
+    static wdl_value select_first(const std::vector<wdl_value> &args)
+    {
+        for (const wdl_value &e : array_arg("select_first", args[0]))
+            if (!e.is_none())
+                return e;
+        fail("select_first", "every element is None");
+    }
+
+    static wdl_value select_all(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &elements = array_arg("select_all", args[0]);
+        wdl_array out;
+        out.reserve(elements.size());
+        for (const wdl_value &e : elements)
+            if (!e.is_none())
+                out.push_back(e);
+        return wdl_value::array(std::move(out));
+    }
+
+    static wdl_value defined(const std::vector<wdl_value> &args)
+    {
+        return wdl_value::boolean(!args[0].is_none());
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // maps
+
+    static wdl_value keys(const std::vector<wdl_value> &args)
+    {
+        const wdl_map &entries = map_arg("keys", args[0]);
+        wdl_array out;
+        out.reserve(entries.size());
+        for (const auto &entry : entries)
+            out.push_back(entry.first);
+        return wdl_value::array(std::move(out));
+    }
+
+    static wdl_value as_pairs(const std::vector<wdl_value> &args)
+    {
+        const wdl_map &entries = map_arg("as_pairs", args[0]);
+        wdl_array out;
+        out.reserve(entries.size());
+        for (const auto &[k, v] : entries)
+            out.push_back(wdl_value::pair(k, v));
+        return wdl_value::array(std::move(out));
+    }
+
+    static wdl_value as_map(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &pairs = array_arg("as_map", args[0]);
+        wdl_map entries;
+        entries.reserve(pairs.size());
+        for (const wdl_value &p : pairs)
+        {
+            const wdl_pair &pair = p.as_pair();
+            if (!entries.insert(pair.first, pair.second))
+                fail("as_map", "duplicate key '" + pair.first.to_string() + "'");
+        }
+        return wdl_value::map(std::move(entries));
+    }
+
+    static wdl_value collect_by_key(const std::vector<wdl_value> &args)
+    {
+        const wdl_array &pairs = array_arg("collect_by_key", args[0]);
+        std::vector<std::pair<wdl_value, wdl_array>> groups;
+        wdl_map seen; // the keys in the order their groups are in
+        for (const wdl_value &p : pairs)
+        {
+            const wdl_pair &pair = p.as_pair();
+            std::size_t at = seen.position(pair.first);
+            if (at == std::string::npos)
+            {
+                at = groups.size();
+                seen.insert(pair.first, wdl_value::none());
+                groups.emplace_back(pair.first, wdl_array{});
+            }
+            groups[at].second.push_back(pair.second);
+        }
+        wdl_map entries;
+        entries.reserve(groups.size());
+        for (auto &[k, values] : groups)
+            entries.insert(std::move(k), wdl_value::array(std::move(values)));
+        return wdl_value::map(std::move(entries));
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // numbers
+
+    static double number_arg(const char *fn, const wdl_value &v)
+    {
+        if (v.kind != WT_INT && v.kind != WT_FLOAT)
+            fail(fn, std::string("expected a number, got ") + wdl_type_kind_to_string(v.kind));
+        return v.as_float();
+    }
+
+    static wdl_value floor_(const std::vector<wdl_value> &args)
+    {
+        return wdl_value::integer(static_cast<std::int64_t>(std::floor(number_arg("floor", args[0]))));
+    }
+
+    static wdl_value ceil_(const std::vector<wdl_value> &args)
+    {
+        return wdl_value::integer(static_cast<std::int64_t>(std::ceil(number_arg("ceil", args[0]))));
+    }
+
+    static wdl_value round_(const std::vector<wdl_value> &args)
+    {
+        return wdl_value::integer(static_cast<std::int64_t>(std::llround(number_arg("round", args[0]))));
+    }
+
+    static wdl_value min_max(const char *fn, const std::vector<wdl_value> &args, bool want_min)
+    {
+        const wdl_value &a = args[0], &b = args[1];
+        number_arg(fn, a);
+        number_arg(fn, b);
+        if (a.kind == WT_INT && b.kind == WT_INT)
+            return wdl_value::integer(want_min ? std::min(a.as_int(), b.as_int()) : std::max(a.as_int(), b.as_int()));
+        return wdl_value::floating(want_min ? std::min(a.as_float(), b.as_float()) : std::max(a.as_float(), b.as_float()));
+    }
+
+    static wdl_value min_(const std::vector<wdl_value> &args)
+    {
+        return min_max("min", args, true);
+    }
+
+    static wdl_value max_(const std::vector<wdl_value> &args)
+    {
+        return min_max("max", args, false);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // strings and paths
+
+    static wdl_value basename(const std::vector<wdl_value> &args)
+    {
+        std::string path = string_arg("basename", args[0]);
+        while (path.size() > 1 && path.back() == '/')
+            path.pop_back();
+        std::size_t slash = path.rfind('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        if (args.size() > 1)
+        {
+            const std::string &suffix = string_arg("basename", args[1]);
+            if (!suffix.empty() && name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+                name.resize(name.size() - suffix.size());
+        }
+        return wdl_value::string(std::move(name));
+    }
+
+    // compiling a std::regex costs far more than running it on a file name... sub() in a scatter compiles each
+    // pattern once per thread. a workflow with more distinct patterns than the cache holds just starts over
+    static const std::regex &cached_regex(const std::string &pattern)
+    {
+        thread_local std::unordered_map<std::string, std::unique_ptr<const std::regex>> cache;
+        auto it = cache.find(pattern);
+        if (it != cache.end())
+            return *it->second;
+        if (cache.size() >= SUB_REGEX_CACHE_SIZE)
+            cache.clear();
+        try
+        {
+            auto compiled = std::make_unique<const std::regex>(pattern, std::regex::extended);
+            return *cache.emplace(pattern, std::move(compiled)).first->second;
+        }
+        catch (const std::regex_error &e)
+        {
+            fail("sub", "invalid pattern '" + pattern + "': " + e.what());
+        }
+    }
+
+    static wdl_value sub(const std::vector<wdl_value> &args)
+    {
+        const std::string &input = string_arg("sub", args[0]);
+        const std::regex &pattern = cached_regex(string_arg("sub", args[1]));
+        return wdl_value::string(std::regex_replace(input, pattern, string_arg("sub", args[2])));
+    }
+
+    static wdl_value glob_(const std::vector<wdl_value> &args)
+    {
+        const std::string &pattern = string_arg("glob", args[0]);
+        glob_t matches{};
+        int rc = ::glob(pattern.c_str(), 0, nullptr, &matches);
+        wdl_array files;
+        if (rc == 0)
+        {
+            files.reserve(matches.gl_pathc);
+            for (std::size_t i = 0; i < matches.gl_pathc; ++i) // glob() sorts them already
+                files.push_back(wdl_value::string(matches.gl_pathv[i], WT_FILE));
+        }
+        ::globfree(&matches);
+        if (rc != 0 && rc != GLOB_NOMATCH)
+            fail("glob", "failed on '" + pattern + "'");
+        return wdl_value::array(std::move(files));
+    }
+
+    static wdl_value stdout_(const std::vector<wdl_value> &)
+    {
+        fail("stdout", "only means something in a task's output section");
+    }
+
+    static wdl_value stderr_(const std::vector<wdl_value> &)
+    {
+        fail("stderr", "only means something in a task's output section");
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // size()... an Array[File] of a cohort is thousands of paths, often on a network filesystem where each
+    // stat() is a round trip. every distinct path is stat'ed once, and big batches go out on a few threads at a time
+
+    // a String is taken as a path only when it's size()'s argument itself... inside an Array, Map, Pair or
+    // struct only File and Directory values count, a Map[String, File]'s keys are names, not files
+    static void collect_paths(const wdl_value &v, std::vector<const std::string *> &paths, bool top = true)
+    {
+        switch (v.kind)
+        {
+        case WT_NONE:
+            break;
+        case WT_STRING:
+            if (top)
+                paths.push_back(&v.as_string());
+            break;
+        case WT_FILE:
+        case WT_DIRECTORY:
+            paths.push_back(&v.as_string());
+            break;
+        case WT_ARRAY:
+            for (const wdl_value &e : v.as_array())
+                collect_paths(e, paths, false);
+            break;
+        case WT_MAP:
+            for (const auto &[k, e] : v.as_map())
+            {
+                collect_paths(k, paths, false);
+                collect_paths(e, paths, false);
+            }
+            break;
+        case WT_PAIR:
+            collect_paths(v.as_pair().first, paths, false);
+            collect_paths(v.as_pair().second, paths, false);
+            break;
+        case WT_OBJECT:
+        case WT_STRUCT:
+            for (const auto &[name, e] : v.as_object().members)
+                collect_paths(e, paths, false);
+            break;
+        default:
+            if (top)
+                fail("size", std::string("expected files, got ") + wdl_type_kind_to_string(v.kind));
+        }
+    }
+
+    // bytes under path, a directory counts everything in it... -1 when it doesn't exist
+    static std::int64_t bytes_of(const std::string &path)
+    {
+        struct stat st;
+        if (::stat(path.c_str(), &st) != 0)
+            return -1;
+        if (!S_ISDIR(st.st_mode))
+            return static_cast<std::int64_t>(st.st_size);
+        std::int64_t total = 0;
+        std::error_code ec;
+        for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+            if (it->is_regular_file(ec))
+                total += static_cast<std::int64_t>(it->file_size(ec));
+        return total;
+    }
+
+    static constexpr std::size_t PARALLEL_STAT_THRESHOLD = 64;
+
+    static double unit_divisor(const std::string &unit)
+    {
+        static const std::pair<const char *, double> UNITS[] = {
+            {"B", 1.0}, {"KB", 1e3}, {"K", 1e3}, {"MB", 1e6}, {"M", 1e6}, {"GB", 1e9}, {"G", 1e9}, {"TB", 1e12}, {"T", 1e12}, {"KiB", 1024.0}, {"Ki", 1024.0}, {"MiB", 1048576.0}, {"Mi", 1048576.0}, {"GiB", 1073741824.0}, {"Gi", 1073741824.0}, {"TiB", 1099511627776.0}, {"Ti", 1099511627776.0}};
+        for (const auto &[name, divisor] : UNITS)
+            if (unit == name)
+                return divisor;
+        fail("size", "unknown unit '" + unit + "'");
+    }
+
+    static wdl_value size(const std::vector<wdl_value> &args)
+    {
+        const double divisor = args.size() > 1 ? unit_divisor(string_arg("size", args[1])) : 1.0;
+        std::vector<const std::string *> paths;
+        collect_paths(args[0], paths);
+
+        std::vector<const std::string *> unique = paths;
+        std::sort(unique.begin(), unique.end(), [](const std::string *a, const std::string *b)
+                  { return *a < *b; });
+        unique.erase(std::unique(unique.begin(), unique.end(), [](const std::string *a, const std::string *b)
+                                 { return *a == *b; }),
+                     unique.end());
+
+        std::vector<std::int64_t> bytes(unique.size());
+        const unsigned threads = unique.size() < PARALLEL_STAT_THRESHOLD ? 1 : std::min(8u, std::max(1u, std::thread::hardware_concurrency()));
+        if (threads == 1)
+            for (std::size_t i = 0; i < unique.size(); ++i)
+                bytes[i] = bytes_of(*unique[i]);
+        else
+        {
+            std::vector<std::thread> workers;
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back([&, t]
+                                     {
+                    for (std::size_t i = t; i < unique.size(); i += threads)
+                        bytes[i] = bytes_of(*unique[i]); });
+            for (auto &w : workers)
+                w.join();
+        }
+
+        std::unordered_map<std::string_view, std::int64_t> by_path;
+        by_path.reserve(unique.size());
+        for (std::size_t i = 0; i < unique.size(); ++i)
+        {
+            if (bytes[i] < 0)
+                fail("size", "no such file: " + *unique[i]);
+            by_path.emplace(*unique[i], bytes[i]);
+        }
+        double total = 0;
+        for (const std::string *p : paths) // the same file twice in the array counts twice, like it would on disk
+            total += static_cast<double>(by_path[*p]);
+        return wdl_value::floating(total / divisor);
+    }
+
+    // ---------------------------------------------------------------------------------------------
+
+    const std::vector<builtin_info> &builtins()
+    {
+        static const std::vector<builtin_info> table = {
+            {"stdout", 0, 0, stdout_, false},
+            {"stderr", 0, 0, stderr_, false},
+            {"read_lines", 1, 1, read_lines, false},
+            {"read_tsv", 1, 1, read_tsv, false},
+            {"read_map", 1, 1, read_map, false},
+            {"read_object", 1, 1, read_object, false},
+            {"read_objects", 1, 1, read_objects, false},
+            {"read_json", 1, 1, read_json, false},
+            {"read_int", 1, 1, read_int, false},
+            {"read_string", 1, 1, read_string, false},
+            {"read_float", 1, 1, read_float, false},
+            {"read_boolean", 1, 1, read_boolean, false},
+            {"write_lines", 1, 1, write_lines, false},
+            {"write_tsv", 1, 1, write_tsv, false},
+            {"write_map", 1, 1, write_map, false},
+            {"write_object", 1, 1, write_object, false},
+            {"write_objects", 1, 1, write_objects, false},
+            {"write_json", 1, 1, write_json, false},
+            {"range", 1, 1, range},
+            {"transpose", 1, 1, transpose},
+            {"zip", 2, 2, zip},
+            {"cross", 2, 2, cross},
+            {"unzip", 1, 1, unzip},
+            {"length", 1, 1, length},
+            {"flatten", 1, 1, flatten},
+            {"prefix", 2, 2, prefix},
+            {"suffix", 2, 2, suffix},
+            {"quote", 1, 1, quote},
+            {"squote", 1, 1, squote},
+            {"sep", 2, 2, sep},
+            {"select_first", 1, 1, select_first},
+            {"select_all", 1, 1, select_all},
+            {"defined", 1, 1, defined},
+            {"keys", 1, 1, keys},
+            {"as_pairs", 1, 1, as_pairs},
+            {"as_map", 1, 1, as_map},
+            {"collect_by_key", 1, 1, collect_by_key},
+            {"basename", 1, 2, basename},
+            {"floor", 1, 1, floor_},
+            {"ceil", 1, 1, ceil_},
+            {"round", 1, 1, round_},
+            {"min", 2, 2, min_},
+            {"max", 2, 2, max_},
+            {"size", 1, 2, size, false},
+            {"sub", 3, 3, sub},
+            {"glob", 1, 1, glob_, false},
+        };
+        return table;
+    }
+
+    const builtin_info *find_builtin(std::string_view name)
+    {
+        static const std::unordered_map<std::string_view, const builtin_info *> by_name = []
+        {
+            std::unordered_map<std::string_view, const builtin_info *> m;
+            for (const builtin_info &b : builtins())
+                m.emplace(b.name, &b);
+            return m;
+        }();
+        auto it = by_name.find(name);
+        return it == by_name.end() ? nullptr : it->second;
+    }
+
+    wdl_value call_builtin(std::string_view name, const std::vector<wdl_value> &args)
+    {
+        const builtin_info *b = find_builtin(name);
+        if (!b)
+            throw std::runtime_error("Unknown function '" + std::string(name) + "'");
+        if (args.size() < b->min_args || args.size() > b->max_args)
+        {
+            std::string want = b->min_args == b->max_args ? std::to_string(b->min_args) : std::to_string(b->min_args) + " or " + std::to_string(b->max_args);
+            fail(b->name, "takes " + want + " argument(s), got " + std::to_string(args.size()));
+        }
+        return b->fn(args);
+    }
+
+}
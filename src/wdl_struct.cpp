@@ -0,0 +1,456 @@
+#include "wdl_struct.h"
+#include <stdexcept>
+#include <utility>
+#include "source_lines.h"
+
+namespace soto
+{
+
+    const std::uint32_t *struct_layout::find(const std::string &field) const
+    {
+        auto it = index.find(field);
+        return it == index.end() ? nullptr : &it->second;
+    }
+
+    std::shared_ptr<const struct_layout> struct_result::layout_of(const std::string &name) const
+    {
+        auto it = layouts.find(name);
+        return it == layouts.end() ? nullptr : it->second;
+    }
+
+    static std::string name_of(const ast_node_ptr &node)
+    {
+        return node && node->tok ? node->tok->lexeme : "";
+    }
+
+    bool declared_type(const var_decl &var, wdl_type &type)
+    {
+        if (!var.type || !var.type->tok)
+            return false;
+        std::string text = var.type->tok->lexeme;
+        if (var.type->type == N_TYPE_NULLABLE && (text.empty() || text.back() != '?'))
+            text += '?';
+        try
+        {
+            type = wdl_type::parse(text);
+        }
+        catch (const std::invalid_argument &)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    // id: or "id": in a literal, the member it's for either way
+    static bool member_name(const ast_node &key, std::string &name)
+    {
+        if (!key.tok || !(key.type == N_IDENT || (key.type == N_LITERAL && key.tok->kind == T_SLITERAL)))
+            return false;
+        name = key.tok->lexeme;
+        return true;
+    }
+
+    template <typename Fn>
+    static void for_each_decl(ast_node_ptr &body, Fn fn)
+    {
+        if (auto *b = body ? std::get_if<block>(&body->node) : nullptr)
+            for (auto &d : b->statements)
+                if (auto *var = d ? std::get_if<var_decl>(&d->node) : nullptr)
+                    fn(*var);
+    }
+
+    struct struct_compiler
+    {
+    public:
+        const source_lines *lines = nullptr;
+        struct_result &result;
+        const struct_layouts *imported = nullptr;
+        std::unordered_map<std::string, wdl_type> types; // what the task or workflow being compiled declares
+
+        std::shared_ptr<const struct_layout> find(const wdl_type &type) const
+        {
+            if (type.kind != WT_STRUCT)
+                return nullptr;
+            if (auto layout = result.layout_of(type.name))
+                return layout;
+            if (!imported)
+                return nullptr;
+            auto it = imported->find(type.name);
+            return it == imported->end() ? nullptr : it->second;
+        }
+
+        void diagnose(const token *at, const std::string &lexeme, std::string message)
+        {
+            parse_diagnostic d;
+            const std::size_t offset = at ? static_cast<std::size_t>(at->offset) : 0;
+            d.line = lines && at ? lines->line_of(offset) : 0;
+            d.column = lines && at ? lines->column_of(offset) : 0;
+            d.lexeme = lexeme;
+            d.message = std::move(message);
+            result.diagnostics.push_back(std::move(d));
+        }
+
+        void layout(const ast_node &node)
+        {
+            const auto &decl = std::get<struct_decl>(node.node);
+            const std::string name = name_of(decl.identifier);
+            if (name.empty())
+                return;
+            if (result.layouts.count(name))
+            {
+                diagnose(decl.identifier->tok.get(), name, "Struct declared twice.");
+                return;
+            }
+            auto layout = std::make_shared<struct_layout>();
+            layout->name = name;
+            for (const auto &m : decl.members)
+            {
+                const auto *var = m ? std::get_if<var_decl>(&m->node) : nullptr;
+                const std::string field = var ? name_of(var->identifier) : "";
+                if (field.empty())
+                    continue;
+                wdl_type type;
+                if (!declared_type(*var, type))
+                    type = wdl_type(WT_ANY);
+                const auto slot = static_cast<std::uint32_t>(layout->fields.size());
+                if (!layout->index.emplace(field, slot).second)
+                {
+                    diagnose(var->identifier->tok.get(), field, "Member declared twice in struct " + name + ".");
+                    continue;
+                }
+                layout->fields.push_back(field);
+                layout->types.push_back(std::move(type));
+            }
+            result.layouts.emplace(name, std::move(layout));
+        }
+
+        void declare(const var_decl &var)
+        {
+            wdl_type type;
+            const std::string name = name_of(var.identifier);
+            if (!name.empty() && declared_type(var, type))
+                types[name] = std::move(type);
+        }
+
+        // first pass... the type of every name the task or workflow declares, a scatter's variable is an element of
+        // its collection when that's a name with an Array type
+        void collect(std::vector<ast_node_ptr> &statements)
+        {
+            for (auto &node : statements)
+                collect(node);
+        }
+
+        void collect_body(ast_node_ptr &body)
+        {
+            if (auto *b = body ? std::get_if<block>(&body->node) : nullptr)
+                collect(b->statements);
+            else
+                collect(body);
+        }
+
+        void collect(ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            switch (node->type)
+            {
+            case N_VAR_DECL:
+                declare(std::get<var_decl>(node->node));
+                break;
+            case N_INPUT_DECL:
+                for_each_decl(std::get<input_decl>(node->node).body, [&](var_decl &var)
+                              { declare(var); });
+                break;
+            case N_OUTPUT_DECL:
+                for_each_decl(std::get<output_decl>(node->node).body, [&](var_decl &var)
+                              { declare(var); });
+                break;
+            case N_SCATTER_STMT:
+            {
+                auto &scatter = std::get<scatter_stmt>(node->node);
+                collect_body(scatter.body);
+                const auto *collection = scatter.collection && scatter.collection->type == N_IDENT ? &scatter.collection : nullptr;
+                auto it = collection ? types.find(name_of(*collection)) : types.end();
+                if (it != types.end() && it->second.kind == WT_ARRAY && !it->second.params.empty())
+                    types[name_of(scatter.identifier)] = it->second.params[0];
+                break;
+            }
+            case N_IF_STMT:
+            {
+                auto &cond = std::get<if_stmt>(node->node);
+                collect_body(cond.then_);
+                collect_body(cond.else_);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // a literal where a `type` is expected... a map literal for a struct becomes a struct_expr, and the
+        // elements of Array, Map and Pair literals are looked at with their own type
+        void literal(ast_node_ptr &e, const wdl_type &type, const token *anchor)
+        {
+            if (!e)
+                return;
+            if (auto *array = std::get_if<array_expr>(&e->node))
+            {
+                if (type.kind == WT_ARRAY && !type.params.empty())
+                    for (auto &element : array->elements)
+                        literal(element, type.params[0], anchor);
+                return;
+            }
+            if (auto *pair = std::get_if<pair_expr>(&e->node))
+            {
+                if (type.kind == WT_PAIR && type.params.size() == 2)
+                {
+                    literal(pair->first, type.params[0], anchor);
+                    literal(pair->second, type.params[1], anchor);
+                }
+                return;
+            }
+            auto *map = std::get_if<map_expr>(&e->node);
+            if (!map)
+                return;
+            if (type.kind == WT_MAP && type.params.size() == 2)
+            {
+                for (auto &[k, v] : map->elements)
+                    literal(v, type.params[1], anchor);
+                return;
+            }
+            std::shared_ptr<const struct_layout> layout = find(type);
+            if (!layout)
+                return; // a struct no import we read declares, or not a struct at all
+            struct_expr compiled;
+            compiled.layout = layout;
+            compiled.values.resize(layout->size());
+            for (auto &[k, v] : map->elements)
+            {
+                std::string field;
+                if (!k || !member_name(*k, field))
+                {
+                    diagnose(k && k->tok ? k->tok.get() : anchor, name_of(k), "A struct literal's keys are member names.");
+                    continue;
+                }
+                const std::uint32_t *slot = layout->find(field);
+                if (!slot)
+                {
+                    diagnose(k->tok.get(), field, "Struct " + layout->name + " has no such member.");
+                    continue;
+                }
+                if (compiled.values[*slot])
+                {
+                    diagnose(k->tok.get(), field, "Member given twice in a struct literal.");
+                    continue;
+                }
+                literal(v, layout->types[*slot], k->tok.get());
+                compiled.values[*slot] = std::move(v);
+            }
+            for (std::size_t i = 0; i < layout->size(); ++i)
+                if (!compiled.values[i] && !layout->types[i].optional)
+                    diagnose(anchor, anchor ? anchor->lexeme : "", "Struct " + layout->name + " literal is missing member '" + layout->fields[i] + "'.");
+            e->type = N_STRUCT_LITERAL;
+            e->node = std::move(compiled);
+            ++result.literals;
+        }
+
+        // `access` applied to a value of `type`... its member's slot when that's a struct we have the layout of,
+        // and on down a.b.c
+        void access(member_access &access, const wdl_type &type)
+        {
+            if (!access.member)
+                return;
+            auto *inner = std::get_if<member_access>(&access.member->node);
+            const std::string field = inner ? name_of(inner->object) : access.member->type == N_IDENT ? name_of(access.member) : "";
+            if (field.empty())
+                return;
+            if (type.kind == WT_PAIR && type.params.size() == 2 && (field == "left" || field == "right"))
+            {
+                if (inner)
+                    this->access(*inner, type.params[field == "left" ? 0 : 1]);
+                return;
+            }
+            std::shared_ptr<const struct_layout> layout = find(type);
+            if (!layout)
+                return;
+            const std::uint32_t *slot = layout->find(field);
+            if (!slot)
+            {
+                const token *at = inner ? inner->object->tok.get() : access.member->tok.get();
+                diagnose(at, field, "Struct " + layout->name + " has no such member.");
+                return;
+            }
+            access.layout = layout;
+            access.field = *slot;
+            ++result.accesses;
+            if (inner)
+                this->access(*inner, layout->types[*slot]);
+        }
+
+        void expr(ast_node_ptr &e)
+        {
+            if (!e)
+                return;
+            std::visit(
+                [&](auto &&value)
+                {
+                    using T = std::decay_t<decltype(value)>;
+                    if constexpr (std::is_same_v<T, binary_expr>)
+                    {
+                        expr(value.left);
+                        expr(value.right);
+                    }
+                    else if constexpr (std::is_same_v<T, unary_expr>)
+                        expr(value.operand);
+                    else if constexpr (std::is_same_v<T, if_stmt>)
+                    {
+                        expr(value.condition);
+                        expr(value.then_);
+                        expr(value.else_);
+                    }
+                    else if constexpr (std::is_same_v<T, expr_stmt>)
+                        expr(value.expr);
+                    else if constexpr (std::is_same_v<T, member_access>)
+                    {
+                        auto it = types.find(name_of(value.object));
+                        if (it != types.end())
+                            access(value, it->second);
+                    }
+                    else if constexpr (std::is_same_v<T, array_expr>)
+                    {
+                        for (auto &element : value.elements)
+                            expr(element);
+                    }
+                    else if constexpr (std::is_same_v<T, map_expr>)
+                    {
+                        for (auto &[k, v] : value.elements)
+                        {
+                            expr(k);
+                            expr(v);
+                        }
+                    }
+                    else if constexpr (std::is_same_v<T, struct_expr>)
+                    {
+                        for (auto &v : value.values)
+                            expr(v);
+                    }
+                    else if constexpr (std::is_same_v<T, pair_expr>)
+                    {
+                        expr(value.first);
+                        expr(value.second);
+                    }
+                    else if constexpr (std::is_same_v<T, index_expr>)
+                    {
+                        expr(value.collection);
+                        expr(value.index);
+                    }
+                    else if constexpr (std::is_same_v<T, func_call>)
+                    {
+                        for (auto &arg : value.arguments)
+                            expr(arg);
+                    }
+                },
+                e->node);
+        }
+
+        void initializer(var_decl &var)
+        {
+            wdl_type type;
+            if (var.initializer && declared_type(var, type))
+                literal(var.initializer, type, var.identifier ? var.identifier->tok.get() : nullptr);
+            expr(var.initializer);
+        }
+
+        void body(ast_node_ptr &node)
+        {
+            if (auto *b = node ? std::get_if<block>(&node->node) : nullptr)
+                for (auto &s : b->statements)
+                    statement(s);
+            else
+                statement(node);
+        }
+
+        // second pass... literals laid out, member accesses given their slots
+        void statement(ast_node_ptr &node)
+        {
+            if (!node)
+                return;
+            switch (node->type)
+            {
+            case N_VAR_DECL:
+                initializer(std::get<var_decl>(node->node));
+                break;
+            case N_INPUT_DECL:
+                for_each_decl(std::get<input_decl>(node->node).body, [&](var_decl &var)
+                              { initializer(var); });
+                break;
+            case N_OUTPUT_DECL:
+                for_each_decl(std::get<output_decl>(node->node).body, [&](var_decl &var)
+                              { initializer(var); });
+                break;
+            case N_RUNTIME_DECL:
+                for (auto &[key, value] : std::get<runtime_decl>(node->node).members)
+                    expr(value);
+                break;
+            case N_WTCALL:
+                for (auto &[key, value] : std::get<call_decl>(node->node).arguments)
+                    expr(value);
+                break;
+            case N_SCATTER_STMT:
+            {
+                auto &scatter = std::get<scatter_stmt>(node->node);
+                expr(scatter.collection);
+                body(scatter.body);
+                break;
+            }
+            case N_IF_STMT:
+            {
+                auto &cond = std::get<if_stmt>(node->node);
+                expr(cond.condition);
+                body(cond.then_);
+                body(cond.else_);
+                break;
+            }
+            default:
+                break; // commands: their placeholders are parsed again when they run, and meta
+            }
+        }
+    };
+
+    struct_result compile_structs(ast_node &prog, const struct_layouts *imported)
+    {
+        struct_result result;
+        auto *p = std::get_if<program>(&prog.node);
+        if (!p)
+            return result;
+        struct_compiler c{p->lines.get(), result, imported, {}};
+        for (auto &decl : p->declarations)
+            if (decl && std::holds_alternative<struct_decl>(decl->node))
+                c.layout(*decl);
+        for (auto &decl : p->declarations)
+        {
+            auto *klass = decl ? std::get_if<class_decl>(&decl->node) : nullptr;
+            if (!klass)
+                continue;
+            c.types.clear();
+            c.collect(klass->members);
+            for (auto &member : klass->members)
+                c.statement(member);
+        }
+        return result;
+    }
+
+    struct_layouts layout_structs(const ast_node &prog)
+    {
+        struct_result result;
+        const auto *p = std::get_if<program>(&prog.node);
+        if (!p)
+            return result.layouts;
+        struct_compiler c{nullptr, result, nullptr, {}};
+        for (const auto &decl : p->declarations)
+            if (decl && std::holds_alternative<struct_decl>(decl->node))
+                c.layout(*decl);
+        return std::move(result.layouts);
+    }
+
+}
@@ -0,0 +1,690 @@
+#include "wdl_value.h"
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "file_hash.h"
+#include "string_utils.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace soto
+{
+
+    static std::string_view trim_view(std::string_view s)
+    {
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+            s.remove_prefix(1);
+        while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    // recursive descent over the type text, pos is left after whatever was parsed...
+    static wdl_type parse_type_at(std::string_view text, std::size_t &pos)
+    {
+        auto skip_ws = [&]
+        {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+                ++pos;
+        };
+        auto fail = [&](const std::string &why) -> wdl_type
+        {
+            throw std::invalid_argument("Invalid type '" + std::string(text) + "': " + why);
+        };
+
+        skip_ws();
+        std::size_t start = pos;
+        while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) || text[pos] == '_'))
+            ++pos;
+        if (pos == start)
+            return fail("expected a type name");
+        std::string name(text.substr(start, pos - start));
+        std::string lower = util::to_lowercase(name);
+
+        wdl_type type;
+        std::size_t n_params = 0;
+        if (lower == "boolean")
+            type.kind = WT_BOOLEAN;
+        else if (lower == "int")
+            type.kind = WT_INT;
+        else if (lower == "float")
+            type.kind = WT_FLOAT;
+        else if (lower == "string")
+            type.kind = WT_STRING;
+        else if (lower == "file")
+            type.kind = WT_FILE;
+        else if (lower == "directory")
+            type.kind = WT_DIRECTORY;
+        else if (lower == "object")
+            type.kind = WT_OBJECT;
+        else if (lower == "array")
+        {
+            type.kind = WT_ARRAY;
+            n_params = 1;
+        }
+        else if (lower == "map")
+        {
+            type.kind = WT_MAP;
+            n_params = 2;
+        }
+        else if (lower == "pair")
+        {
+            type.kind = WT_PAIR;
+            n_params = 2;
+        }
+        else
+        {
+            type.kind = WT_STRUCT;
+            type.name = name;
+        }
+
+        if (n_params)
+        {
+            skip_ws();
+            if (pos >= text.size() || text[pos] != '[')
+                return fail("expected '[' after " + name);
+            ++pos;
+            for (std::size_t i = 0; i < n_params; ++i)
+            {
+                if (i)
+                {
+                    skip_ws();
+                    if (pos >= text.size() || text[pos] != ',')
+                        return fail("expected ',' in " + name + "[...]");
+                    ++pos;
+                }
+                type.params.push_back(parse_type_at(text, pos));
+            }
+            skip_ws();
+            if (pos >= text.size() || text[pos] != ']')
+                return fail("expected ']' to close " + name + "[...]");
+            ++pos;
+        }
+        skip_ws();
+        if (pos < text.size() && text[pos] == '+')
+        {
+            if (type.kind != WT_ARRAY)
+                return fail("only arrays can be non-empty (+)");
+            type.non_empty = true;
+            ++pos;
+            skip_ws();
+        }
+        if (pos < text.size() && text[pos] == '?')
+        {
+            type.optional = true;
+            ++pos;
+        }
+        return type;
+    }
+
+    wdl_type wdl_type::parse(std::string_view text)
+    {
+        text = trim_view(text);
+        std::size_t pos = 0;
+        wdl_type type = parse_type_at(text, pos);
+        if (trim_view(text.substr(pos)).size())
+            throw std::invalid_argument("Invalid type '" + std::string(text) + "': trailing characters");
+        return type;
+    }
+
+    std::string wdl_type::to_string() const
+    {
+        std::string out = kind == WT_STRUCT ? name : wdl_type_kind_to_string(kind);
+        if (!params.empty())
+        {
+            out += '[';
+            for (std::size_t i = 0; i < params.size(); ++i)
+            {
+                if (i)
+                    out += ", ";
+                out += params[i].to_string();
+            }
+            out += ']';
+        }
+        if (non_empty)
+            out += '+';
+        if (optional)
+            out += '?';
+        return out;
+    }
+
+    wdl_value wdl_value::boolean(bool b)
+    {
+        wdl_value v;
+        v.kind = WT_BOOLEAN;
+        v.data = b;
+        return v;
+    }
+    wdl_value wdl_value::integer(std::int64_t i)
+    {
+        wdl_value v;
+        v.kind = WT_INT;
+        v.data = i;
+        return v;
+    }
+    wdl_value wdl_value::floating(double d)
+    {
+        wdl_value v;
+        v.kind = WT_FLOAT;
+        v.data = d;
+        return v;
+    }
+    wdl_value wdl_value::string(std::string s, wdl_type_kind kind)
+    {
+        wdl_value v;
+        v.kind = kind;
+        v.data = std::move(s);
+        return v;
+    }
+    wdl_value wdl_value::array(wdl_array elements)
+    {
+        wdl_value v;
+        v.kind = WT_ARRAY;
+        v.data = std::shared_ptr<const wdl_array>(std::make_shared<wdl_array>(std::move(elements)));
+        return v;
+    }
+    wdl_value wdl_value::map(wdl_map entries)
+    {
+        wdl_value v;
+        v.kind = WT_MAP;
+        v.data = std::shared_ptr<const wdl_map>(std::make_shared<wdl_map>(std::move(entries)));
+        return v;
+    }
+    wdl_value wdl_value::pair(wdl_value left, wdl_value right)
+    {
+        wdl_value v;
+        v.kind = WT_PAIR;
+        v.data = std::shared_ptr<const wdl_pair>(std::make_shared<wdl_pair>(std::move(left), std::move(right)));
+        return v;
+    }
+    wdl_value wdl_value::object(wdl_object object)
+    {
+        wdl_value v;
+        v.kind = object.struct_name.empty() ? WT_OBJECT : WT_STRUCT;
+        v.data = std::shared_ptr<const wdl_object>(std::make_shared<wdl_object>(std::move(object)));
+        return v;
+    }
+
+    static std::runtime_error wrong_kind(wdl_type_kind have, const char *want)
+    {
+        return std::runtime_error(std::string("Expected a ") + want + " value but got " + wdl_type_kind_to_string(have));
+    }
+
+    bool wdl_value::as_bool() const
+    {
+        if (kind != WT_BOOLEAN)
+            throw wrong_kind(kind, "Boolean");
+        return std::get<bool>(data);
+    }
+    std::int64_t wdl_value::as_int() const
+    {
+        if (kind != WT_INT)
+            throw wrong_kind(kind, "Int");
+        return std::get<std::int64_t>(data);
+    }
+    double wdl_value::as_float() const
+    {
+        if (kind == WT_INT)
+            return static_cast<double>(std::get<std::int64_t>(data));
+        if (kind != WT_FLOAT)
+            throw wrong_kind(kind, "Float");
+        return std::get<double>(data);
+    }
+    const std::string &wdl_value::as_string() const
+    {
+        if (kind != WT_STRING && kind != WT_FILE && kind != WT_DIRECTORY)
+            throw wrong_kind(kind, "String");
+        return std::get<std::string>(data);
+    }
+    const wdl_array &wdl_value::as_array() const
+    {
+        if (kind != WT_ARRAY)
+            throw wrong_kind(kind, "Array");
+        return *std::get<std::shared_ptr<const wdl_array>>(data);
+    }
+    const wdl_map &wdl_value::as_map() const
+    {
+        if (kind != WT_MAP)
+            throw wrong_kind(kind, "Map");
+        return *std::get<std::shared_ptr<const wdl_map>>(data);
+    }
+    wdl_map &wdl_value::edit_map()
+    {
+        if (kind != WT_MAP)
+            throw wrong_kind(kind, "Map");
+        auto &shared = std::get<std::shared_ptr<const wdl_map>>(data);
+        if (shared.use_count() != 1)
+            shared = std::make_shared<wdl_map>(*shared);
+        return const_cast<wdl_map &>(*shared); // every wdl_map is made non-const, only handed out const
+    }
+    const wdl_pair &wdl_value::as_pair() const
+    {
+        if (kind != WT_PAIR)
+            throw wrong_kind(kind, "Pair");
+        return *std::get<std::shared_ptr<const wdl_pair>>(data);
+    }
+    const wdl_object &wdl_value::as_object() const
+    {
+        if (kind != WT_OBJECT && kind != WT_STRUCT)
+            throw wrong_kind(kind, "Object");
+        return *std::get<std::shared_ptr<const wdl_object>>(data);
+    }
+
+    static void append_quoted(std::string &out, const std::string &s)
+    {
+        out += '"';
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        out += '"';
+    }
+
+    static void append_value(std::string &out, const wdl_value &v, bool quote_strings)
+    {
+        switch (v.kind)
+        {
+        case WT_NONE:
+            out += quote_strings ? "null" : "";
+            break;
+        case WT_BOOLEAN:
+            out += v.as_bool() ? "true" : "false";
+            break;
+        case WT_INT:
+            out += std::to_string(v.as_int());
+            break;
+        case WT_FLOAT:
+        {
+            // WDL prints floats with 6 decimals, same as Cromwell...
+            char buf[64];
+            std::snprintf(buf, sizeof(buf), "%.6f", v.as_float());
+            out += buf;
+            break;
+        }
+        case WT_STRING:
+        case WT_FILE:
+        case WT_DIRECTORY:
+            if (quote_strings)
+                append_quoted(out, v.as_string());
+            else
+                out += v.as_string();
+            break;
+        case WT_ARRAY:
+        {
+            out += '[';
+            bool first = true;
+            for (const auto &e : v.as_array())
+            {
+                if (!first)
+                    out += ", ";
+                first = false;
+                append_value(out, e, true);
+            }
+            out += ']';
+            break;
+        }
+        case WT_MAP:
+        {
+            out += '{';
+            bool first = true;
+            for (const auto &[k, e] : v.as_map())
+            {
+                if (!first)
+                    out += ", ";
+                first = false;
+                append_value(out, k, true);
+                out += ": ";
+                append_value(out, e, true);
+            }
+            out += '}';
+            break;
+        }
+        case WT_PAIR:
+            out += '(';
+            append_value(out, v.as_pair().first, true);
+            out += ", ";
+            append_value(out, v.as_pair().second, true);
+            out += ')';
+            break;
+        case WT_OBJECT:
+        case WT_STRUCT:
+        {
+            out += '{';
+            bool first = true;
+            for (const auto &[name, e] : v.as_object().members)
+            {
+                if (!first)
+                    out += ", ";
+                first = false;
+                append_quoted(out, name);
+                out += ": ";
+                append_value(out, e, true);
+            }
+            out += '}';
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::string wdl_value::to_string() const
+    {
+        std::string out;
+        append_value(out, *this, false);
+        return out;
+    }
+
+    bool operator==(const wdl_value &a, const wdl_value &b)
+    {
+        bool a_string = a.kind == WT_STRING || a.kind == WT_FILE || a.kind == WT_DIRECTORY;
+        bool b_string = b.kind == WT_STRING || b.kind == WT_FILE || b.kind == WT_DIRECTORY;
+        if (a_string && b_string)
+            return a.as_string() == b.as_string();
+        if ((a.kind == WT_INT || a.kind == WT_FLOAT) && (b.kind == WT_INT || b.kind == WT_FLOAT))
+        {
+            if (a.kind == WT_INT && b.kind == WT_INT)
+                return a.as_int() == b.as_int();
+            return a.as_float() == b.as_float();
+        }
+        if (a.kind != b.kind)
+            return false;
+        switch (a.kind)
+        {
+        case WT_NONE:
+            return true;
+        case WT_BOOLEAN:
+            return a.as_bool() == b.as_bool();
+        case WT_ARRAY:
+            return a.as_array() == b.as_array();
+        case WT_MAP:
+            return a.as_map() == b.as_map();
+        case WT_PAIR:
+            return a.as_pair() == b.as_pair();
+        case WT_OBJECT:
+        case WT_STRUCT:
+            return a.as_object().struct_name == b.as_object().struct_name && a.as_object().members == b.as_object().members;
+        default:
+            return false;
+        }
+    }
+
+    static std::uint64_t mix(std::uint64_t x)
+    {
+        // splitmix64's finalizer, small ints spread over all 64 bits
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    static std::uint64_t combine(std::uint64_t seed, std::uint64_t h)
+    {
+        return mix(seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+    }
+
+    std::uint64_t hash_value(const wdl_value &v)
+    {
+        switch (v.kind)
+        {
+        case WT_NONE:
+            return 0;
+        case WT_BOOLEAN:
+            return mix(v.as_bool() ? 2 : 1);
+        case WT_INT:
+            return mix(static_cast<std::uint64_t>(v.as_int()));
+        case WT_FLOAT:
+        {
+            const double d = v.as_float();
+            if (d == std::trunc(d) && d >= -9.2e18 && d <= 9.2e18)
+                return mix(static_cast<std::uint64_t>(static_cast<std::int64_t>(d))); // 2.0 == 2
+            std::uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            return mix(bits);
+        }
+        case WT_STRING:
+        case WT_FILE:
+        case WT_DIRECTORY:
+        {
+            const std::string &s = v.as_string();
+            return xxh64(s.data(), s.size());
+        }
+        case WT_ARRAY:
+        {
+            std::uint64_t h = mix(WT_ARRAY);
+            for (const wdl_value &e : v.as_array())
+                h = combine(h, hash_value(e));
+            return h;
+        }
+        case WT_MAP:
+        {
+            std::uint64_t h = mix(WT_MAP);
+            for (const auto &[k, e] : v.as_map())
+                h = combine(combine(h, hash_value(k)), hash_value(e));
+            return h;
+        }
+        case WT_PAIR:
+            return combine(combine(mix(WT_PAIR), hash_value(v.as_pair().first)), hash_value(v.as_pair().second));
+        case WT_OBJECT:
+        case WT_STRUCT:
+        {
+            const wdl_object &o = v.as_object();
+            std::uint64_t h = xxh64(o.struct_name.data(), o.struct_name.size());
+            for (const auto &[name, e] : o.members)
+                h = combine(combine(h, xxh64(name.data(), name.size())), hash_value(e));
+            return h;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    // ---------------------------------------------------------------------------------------------
+    // wdl_map
+
+    static constexpr std::uint8_t bucket_empty = 0x80;
+    static constexpr std::size_t group_size = 16;
+    static constexpr std::size_t linear_max = 8; // up to this many entries a scan is faster than hashing the key
+
+    static std::uint8_t h2(std::uint64_t hash) { return static_cast<std::uint8_t>(hash & 0x7f); }
+
+    // bit i set where group[i] == byte
+    static std::uint32_t match(const std::uint8_t *group, std::uint8_t byte)
+    {
+#if defined(__SSE2__)
+        const __m128i ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(group));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+        std::uint32_t bits = 0;
+        for (std::size_t i = 0; i < group_size; ++i)
+            bits |= static_cast<std::uint32_t>(group[i] == byte) << i;
+        return bits;
+#endif
+    }
+
+    static int lowest_bit(std::uint32_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int i = 0;
+        while (!(bits & 1u))
+        {
+            bits >>= 1;
+            ++i;
+        }
+        return i;
+#endif
+    }
+
+    wdl_map::wdl_map(std::initializer_list<entry> init)
+    {
+        reserve(init.size());
+        for (const entry &e : init)
+            set(e.first, e.second);
+    }
+
+    void wdl_map::reserve(std::size_t n)
+    {
+        entries.reserve(n);
+        hashes.reserve(n);
+        if (n > linear_max)
+        {
+            std::size_t capacity = group_size;
+            while (capacity * 7 / 8 < n)
+                capacity *= 2;
+            if (capacity > control.size())
+                rebuild(capacity);
+        }
+    }
+
+    // groups probed one after the other, the first one picked by the hash... there's always an empty bucket
+    // (7/8 full at most), so a key that isn't there ends at the first group with one
+    std::size_t wdl_map::lookup(const wdl_value &key, std::uint64_t hash) const
+    {
+        if (control.empty())
+        {
+            for (std::size_t i = 0; i < entries.size(); ++i)
+                if (hashes[i] == hash && entries[i].first == key)
+                    return i;
+            return std::string::npos;
+        }
+        const std::size_t groups = control.size() / group_size;
+        std::size_t g = (hash >> 7) & (groups - 1);
+        for (std::size_t step = 1;; ++step)
+        {
+            const std::uint8_t *group = control.data() + g * group_size;
+            for (std::uint32_t bits = match(group, h2(hash)); bits; bits &= bits - 1)
+            {
+                const std::uint32_t at = buckets[g * group_size + lowest_bit(bits)];
+                if (entries[at].first == key) // 7 bits matched, 1 in 128 of the others get this far
+                    return at;
+            }
+            if (match(group, bucket_empty))
+                return std::string::npos;
+            g = (g + step) & (groups - 1); // triangular, visits every group
+        }
+    }
+
+    void wdl_map::place(std::uint32_t position, std::uint64_t hash)
+    {
+        const std::size_t groups = control.size() / group_size;
+        std::size_t g = (hash >> 7) & (groups - 1);
+        for (std::size_t step = 1;; ++step)
+        {
+            const std::uint32_t empty = match(control.data() + g * group_size, bucket_empty);
+            if (empty)
+            {
+                const std::size_t b = g * group_size + lowest_bit(empty);
+                control[b] = h2(hash);
+                buckets[b] = position;
+                return;
+            }
+            g = (g + step) & (groups - 1);
+        }
+    }
+
+    void wdl_map::rebuild(std::size_t capacity)
+    {
+        control.assign(capacity, bucket_empty);
+        buckets.assign(capacity, 0);
+        for (std::size_t i = 0; i < entries.size(); ++i)
+            place(static_cast<std::uint32_t>(i), hashes[i]);
+    }
+
+    void wdl_map::append(wdl_value key, wdl_value value, std::uint64_t hash)
+    {
+        entries.emplace_back(std::move(key), std::move(value));
+        hashes.push_back(hash);
+        if (control.empty())
+        {
+            if (entries.size() > linear_max)
+                rebuild(group_size * 2);
+            return;
+        }
+        if (entries.size() > control.size() * 7 / 8)
+            rebuild(control.size() * 2);
+        else
+            place(static_cast<std::uint32_t>(entries.size() - 1), hash);
+    }
+
+    wdl_map wdl_map::from_entries(std::vector<entry> list, std::size_t &duplicate)
+    {
+        duplicate = std::string::npos;
+        std::vector<std::uint64_t> hashes;
+        hashes.reserve(list.size());
+        for (const entry &e : list)
+            hashes.push_back(hash_value(e.first));
+        wdl_map m;
+        m.entries.reserve(list.size());
+        m.hashes.reserve(list.size());
+        if (list.size() > linear_max)
+        {
+            std::size_t capacity = group_size;
+            while (capacity * 7 / 8 < list.size())
+                capacity *= 2;
+            m.control.assign(capacity, bucket_empty);
+            m.buckets.assign(capacity, 0);
+        }
+        constexpr std::size_t ahead = 8;
+        const std::size_t groups = m.control.size() / group_size;
+        for (std::size_t i = 0; i < list.size(); ++i)
+        {
+#if defined(__GNUC__)
+            if (groups && i + ahead < list.size())
+            {
+                const std::size_t g = (hashes[i + ahead] >> 7) & (groups - 1);
+                __builtin_prefetch(m.control.data() + g * group_size, 1);
+                __builtin_prefetch(m.buckets.data() + g * group_size, 1);
+            }
+#endif
+            if (m.lookup(list[i].first, hashes[i]) != std::string::npos)
+            {
+                duplicate = i;
+                return {};
+            }
+            m.entries.push_back(std::move(list[i]));
+            m.hashes.push_back(hashes[i]);
+            if (groups)
+                m.place(static_cast<std::uint32_t>(i), hashes[i]);
+        }
+        return m;
+    }
+
+    const wdl_value *wdl_map::find(const wdl_value &key) const
+    {
+        const std::size_t at = lookup(key, hash_value(key));
+        return at == std::string::npos ? nullptr : &entries[at].second;
+    }
+
+    std::size_t wdl_map::position(const wdl_value &key) const
+    {
+        return lookup(key, hash_value(key));
+    }
+
+    bool wdl_map::insert(wdl_value key, wdl_value value)
+    {
+        const std::uint64_t hash = hash_value(key);
+        if (lookup(key, hash) != std::string::npos)
+            return false;
+        append(std::move(key), std::move(value), hash);
+        return true;
+    }
+
+    void wdl_map::set(wdl_value key, wdl_value value)
+    {
+        const std::uint64_t hash = hash_value(key);
+        const std::size_t at = lookup(key, hash);
+        if (at != std::string::npos)
+            entries[at].second = std::move(value);
+        else
+            append(std::move(key), std::move(value), hash);
+    }
+
+}